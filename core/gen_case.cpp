@@ -29,6 +29,7 @@
 #include <limits.h>
 
 #include <algorithm>
+#include <cstdio>
 #include <iterator>
 #include <fstream>
 #include <regex>  // NOLINT
@@ -100,6 +101,13 @@ __attribute__((__unused__)) int dump_data_output_ =
 __attribute__((__unused__)) int dump_data_file_ =
     mluop::getUintEnvVar("MLUOP_GEN_CASE_DUMP_DATA_FILE", 0);
 
+// MLUOP_GEN_CASE_DUMP_DATA_FILE_THRESHOLD: input tensors of at least this
+// many MB are dumped to a data file even if MLUOP_GEN_CASE_DUMP_DATA_FILE is
+// 0, a value dump of such tensors would hit the 2GB protobuf message limit.
+// 0 : means never, default value is 64
+__attribute__((__unused__)) uint64_t dump_data_file_threshold_mb_ =
+    mluop::getUintEnvVar("MLUOP_GEN_CASE_DUMP_DATA_FILE_THRESHOLD", 64);
+
 bool isGenCaseOn() { return gen_case_mode_ > 0; }
 
 int genCaseModeGet(bool first) {
@@ -554,14 +562,23 @@ void PbNode::dumpDataFile(std::string file_name, std::string folder_name,
     if (data_state == OUTPUT) {
       case_file << "  path: \"" << tensor_file_suffix << "\"\n";
     } else {
-      if (dump_data_file_ == 1) {
+      uint64_t data_size = total_num * mluop::getSizeOfDataType(dtype);
+      bool over_threshold = dump_data_file_threshold_mb_ > 0 &&
+                            data_size >= (dump_data_file_threshold_mb_ << 20);
+      if (dump_data_file_ == 1 || over_threshold) {
         std::string tensor_file_name = folder_name + "/" + tensor_file_suffix;
 
-        case_file << "  path: \"" << tensor_file_suffix << "\"\n";
+        // external tensor reference, checked and streamed by the test
+        // harness: path?offset=<bytes>&length=<bytes>&crc32=<hex>
+        char crc_str[9];
+        snprintf(crc_str, sizeof(crc_str), "%08x",
+                 mluop::crc32(0, data, data_size));
+        case_file << "  path: \"" << tensor_file_suffix
+                  << "?offset=0&length=" << data_size << "&crc32=" << crc_str
+                  << "\"\n";
         std::ofstream tensor_file;
         tensor_file.open(tensor_file_name.c_str(), std::ios::binary);
-        tensor_file.write(reinterpret_cast<const char *>(data),
-                          total_num * mluop::getSizeOfDataType(dtype));
+        tensor_file.write(reinterpret_cast<const char *>(data), data_size);
         tensor_file.close();
 
       } else {
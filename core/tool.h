@@ -137,6 +137,10 @@ inline bool isTwoArraysEqual(T *a, T *b, int num) {
   return false;
 }
 
+// CRC-32 (IEEE 802.3) of data, crc is the result of the previous chunk,
+// 0 for the first one.
+uint32_t crc32(uint32_t crc, const void *data, size_t size);
+
 int mkdirIfNotExist(const char *pathname);
 int mkdirRecursive(const char *pathname);
 uint64_t getUintEnvVar(const std::string &str, uint64_t default_para = 0);
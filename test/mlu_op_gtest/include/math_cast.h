@@ -0,0 +1,61 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_MATH_CAST_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_MATH_CAST_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/* NOTE: cnrt free, only depends on the c++ standard library, so it can be
+ * used by any tool that needs host side dtype conversion. */
+
+namespace mluoptest {
+
+// Array cast kernels, single thread, dispatched at runtime to the widest isa
+// the cpu supports (avx512f, avx2 + f16c, or portable c++). All isa give the
+// same bits:
+// - float -> half: round to nearest even, overflow to inf, nan keeps sign and
+//   high payload bits with quiet bit set (same as vcvtps2ph).
+// - half -> float: exact, inf stays inf (same as vcvtph2ps).
+// - float -> bf16: round to nearest even, every nan becomes 0x7fc0.
+// - bf16 -> float: exact.
+// - float -> int8/int16: truncate toward zero, then keep the low 8/16 bits
+//   of the int32 result (same as static_cast on x86).
+// - int8/int16 -> float: exact.
+void castFloatToHalf(uint16_t *dst, const float *src, size_t num);
+void castHalfToFloat(float *dst, const uint16_t *src, size_t num);
+void castFloatToBF16(uint16_t *dst, const float *src, size_t num);
+void castBF16ToFloat(float *dst, const uint16_t *src, size_t num);
+void castFloatToInt8(int8_t *dst, const float *src, size_t num);
+void castFloatToInt16(int16_t *dst, const float *src, size_t num);
+void castInt8ToFloat(float *dst, const int8_t *src, size_t num);
+void castInt16ToFloat(float *dst, const int16_t *src, size_t num);
+
+// isa picked by the cast kernels: "avx512", "avx2" or "scalar".
+// env MLUOP_GTEST_CAST_ISA can lower it (e.g. for debug), never raise it
+// beyond what the cpu supports.
+const char *castIsaName();
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_MATH_CAST_H_
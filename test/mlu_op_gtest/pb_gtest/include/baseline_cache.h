@@ -0,0 +1,110 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_BASELINE_CACHE_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_BASELINE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+namespace mluoptest {
+
+// 128-bit content key of a cpu baseline.
+struct BaselineCacheKey {
+  uint64_t hi = 0;
+  uint64_t lo = 0;
+  std::string hex() const;
+  bool operator==(const BaselineCacheKey &other) const {
+    return hi == other.hi && lo == other.lo;
+  }
+};
+
+// streaming non-cryptographic hash (xxh64 core, 4 lanes), fast enough to
+// digest input tensors of several GB.
+class BaselineHasher {
+ public:
+  explicit BaselineHasher(uint64_t seed = 0);
+  void update(const void *data, size_t size);
+  void update(uint64_t value) { update(&value, sizeof(value)); }
+  void update(const std::string &value) {
+    update((uint64_t)value.size());
+    update(value.data(), value.size());
+  }
+  BaselineCacheKey digest() const;
+
+ private:
+  void consumeStripe(const unsigned char *stripe);
+  uint64_t lane_[4];
+  unsigned char tail_[32];
+  size_t tail_size_ = 0;
+  uint64_t total_size_ = 0;
+};
+
+// hash of the cpu reference sources of op_name (its zoo dir), 0 if unknown.
+// generated at build time by gen_baseline_cache_version.py.
+uint64_t baselineCacheSourceHash(const std::string &op_name);
+
+struct BaselineBuffer {
+  void *ptr = nullptr;
+  size_t size = 0;
+};
+
+// on-disk cache of cpu baseline outputs, see Executor::cpuComputeWithCache().
+// entry is dir/<first 2 hex>/<hex>.bin, file mtime is the lru clock.
+// enabled by MLUOP_GTEST_BASELINE_CACHE_DIR.
+class BaselineCache {
+ public:
+  BaselineCache(const std::string &dir, size_t capacity_bytes,
+                int verify_percent);
+  // process-wide cache configured by env, nullptr if disabled.
+  static BaselineCache *instance();
+
+  // fill outputs with cached entry, false if missing or mismatched.
+  bool load(const BaselineCacheKey &key,
+            const std::vector<BaselineBuffer> &outputs);
+  void store(const BaselineCacheKey &key,
+             const std::vector<BaselineBuffer> &outputs);
+  void drop(const BaselineCacheKey &key);
+  // true if this hit should still be recomputed and compared.
+  bool needVerify(const BaselineCacheKey &key) const;
+  size_t totalBytes();
+
+ private:
+  std::string entryPath(const BaselineCacheKey &key) const;
+  void scanLocked();
+  // drop least recently used entries except keep.
+  void evictLocked(const std::string &keep);
+
+  std::string dir_;
+  size_t capacity_bytes_;
+  int verify_percent_;
+  std::mutex mtx_;
+  bool scanned_ = false;
+  size_t total_bytes_ = 0;
+};
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_BASELINE_CACHE_H_
@@ -0,0 +1,69 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_BILINEAR_SAMPLE_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_BILINEAR_SAMPLE_H_
+
+#include <cstdint>
+
+namespace mluoptest {
+
+// bilinear sampling of channel-last feature maps for the cpu baselines of
+// roi_align-like ops. A sample's corners and weights are worked out once,
+// then the gather and scatter below run over all channels of a pixel with
+// simd, as separate multiplies and adds in the order of the scalar
+// formulas, so results match them bit for bit.
+
+// one sample point: the element offsets of its four corner pixels (top
+// left, top right, bottom left, bottom right), -1 for a corner which reads
+// as 0, and their weights.
+struct BilinearSample {
+  int64_t offset[4];
+  float weight[4];
+};
+
+// the sample at (y, x) of a height x width map with pixel_stride elements
+// per pixel, as mmcv's roi_align computes it: none (returns false) outside
+// [-1, height] x [-1, width], else (y, x) is clamped into the map.
+bool bilinearSampleClamped(int height, int width, int64_t pixel_stride,
+                           float y, float x, BilinearSample *sample);
+// the sample as ms_deform_attn computes it: corners at floor and floor + 1,
+// the ones outside the map read as 0.
+void bilinearSampleZeroPad(int height, int width, int64_t pixel_stride,
+                           float y, float x, BilinearSample *sample);
+
+// value[c] = w1 * v1[c] + w2 * v2[c] + w3 * v3[c] + w4 * v4[c], for the
+// channels elements after each corner offset of data.
+void bilinearGather(const float *data, const BilinearSample &sample,
+                    int64_t channels, float *value);
+// out[c] += (w1 * v1[c] + ... + w4 * v4[c]) * scale.
+void bilinearGatherAdd(const float *data, const BilinearSample &sample,
+                       int64_t channels, float scale, float *out);
+// data[offset_i + c] += grad[c] * w_i / divisor, corner after corner.
+void bilinearScatterAdd(float *data, const BilinearSample &sample,
+                        int64_t channels, const float *grad, float divisor);
+// out[c] += in[c] * weight, a single tap.
+void weightedAdd(const float *in, float weight, int64_t channels, float *out);
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_BILINEAR_SAMPLE_H_
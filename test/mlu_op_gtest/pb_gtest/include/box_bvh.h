@@ -0,0 +1,70 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_BOX_BVH_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_BOX_BVH_H_
+
+#include <vector>
+
+namespace mluoptest {
+
+// bounding volume hierarchy over a set of axis-aligned 3-d boxes, for the
+// cpu baselines of ops testing many points against a few hundred (rotated)
+// boxes: a point only runs the exact test on the boxes whose bounds hold it.
+// lo and hi are num x 3, bounds may be infinite, and a box with a nan bound
+// holds no point. Built once, query() may run concurrently.
+class BoxBvh {
+ public:
+  BoxBvh(const float *lo, const float *hi, int num);
+
+  // the boxes with lo <= point <= hi on every axis, in no particular order.
+  void query(const float *point, std::vector<int> *ids) const;
+  // the candidate points of every box, each list ascending: the points of
+  // xyz (num_points x 3) within its bounds, and the points with a non-finite
+  // coordinate, which no bounds hold but which may pass a containment test
+  // through nan compares. Points run in parallel.
+  void pointsPerBox(const float *xyz, int num_points,
+                    std::vector<std::vector<int>> *box_points) const;
+
+ private:
+  struct Node {
+    float lo[3], hi[3];
+    int begin, end;   // range of ids_
+    int left, right;  // children, -1 for a leaf
+  };
+  int build(const std::vector<float> &centers, int begin, int end);
+
+  std::vector<float> lo_, hi_;
+  std::vector<int> ids_;
+  std::vector<Node> nodes_;
+};
+
+// padded axis-aligned bounds of the box centered at (cx, cy, cz) with sizes
+// (dx, dy, dz), rotated by rz about z, for float containment tests allowing
+// up to margin past the half sizes. The padding covers their rounding, and
+// a box with a non-finite parameter gets infinite bounds.
+void rotatedBoxBounds(float cx, float cy, float cz, float dx, float dy,
+                      float dz, float rz, float margin, float *lo, float *hi);
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_BOX_BVH_H_
@@ -0,0 +1,64 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_BOX_GRID_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_BOX_GRID_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace mluoptest {
+
+// uniform grid over the axis-aligned bounds of a set of boxes, for the cpu
+// baselines of nms-like ops that only need to compare boxes which overlap.
+// Boxes are given up front by their bounds [x1, x2] x [y1, y2]; the grid
+// covers them all with cells about the median box size, and boxes are
+// inserted by id later, e.g. as nms keeps them.
+// The bounds are padded by a relative 1e-5, so a pair whose overlap test
+// passes only through rounding is still found. Boxes with non-finite bounds
+// or spanning too many cells are kept aside and returned by every query.
+class BoxGrid {
+ public:
+  BoxGrid(const float *x1, const float *y1, const float *x2, const float *y2,
+          int num);
+
+  void insert(int id);
+  // the inserted ids whose cells overlap the box id, each once, in no
+  // particular order.
+  void query(int id, std::vector<int> *ids);
+
+ private:
+  bool cellRange(int id, int *cx1, int *cy1, int *cx2, int *cy2) const;
+
+  std::vector<float> x1_, y1_, x2_, y2_;
+  float origin_x_ = 0, origin_y_ = 0;
+  float inv_cell_w_ = 1, inv_cell_h_ = 1;
+  int nx_ = 1, ny_ = 1;
+  std::vector<std::vector<int>> cells_;
+  std::vector<int> large_;  // not binned, returned by every query
+  std::vector<uint32_t> stamp_;  // last query that returned the id
+  uint32_t query_count_ = 0;
+};
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_BOX_GRID_H_
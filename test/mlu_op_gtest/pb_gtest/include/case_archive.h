@@ -0,0 +1,111 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_CASE_ARCHIVE_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_CASE_ARCHIVE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mluoptest {
+
+// single-file case archive, written by tools/case_pack.cpp.
+//
+// layout: [member]...[index][footer]
+//   member: bytes of a case (binary Node) or of an external data file
+//           referenced by Tensor.path, raw or zlib compressed.
+//   index:  per member kind, codec, name, op name, offset and sizes.
+//   footer: magic, index offset/size, member number, index checksum.
+//
+// a member is addressed like a file under the archive, e.g.
+// suite.pbpack/add/case_0.pb, so relative Tensor.path resolves as usual,
+// and "/<op>/" filters on case paths keep working.
+struct CaseArchiveEntry {
+  enum Kind : uint8_t { CASE = 0, DATA = 1 };
+  enum Codec : uint8_t { RAW = 0, ZLIB = 1 };
+  std::string name;
+  std::string op_name;  // CASE only
+  Kind kind = CASE;
+  Codec codec = RAW;
+  uint64_t offset = 0;
+  uint64_t stored_size = 0;
+  uint64_t raw_size = 0;
+};
+
+class CaseArchive {
+ public:
+  static const char *const SUFFIX;  // ".pbpack"
+
+  ~CaseArchive();
+  // open an archive file, archives are cached and shared by all threads.
+  static std::shared_ptr<CaseArchive> open(const std::string &path,
+                                           std::string *error = nullptr);
+  // archive containing path (<archive>.pbpack/<member>) and the member
+  // name, nullptr if path is not inside an archive.
+  static std::shared_ptr<CaseArchive> openContaining(const std::string &path,
+                                                     std::string *member);
+  // "a/./b/../c" -> "a/c"
+  static std::string normalizeName(const std::string &name);
+
+  const std::string &path() const { return path_; }
+  const std::vector<CaseArchiveEntry> &entries() const { return entries_; }
+  const CaseArchiveEntry *find(const std::string &member) const;
+  // read and decompress a member, thread safe.
+  bool read(const CaseArchiveEntry &entry, std::string *data,
+            std::string *error = nullptr) const;
+
+ private:
+  CaseArchive() {}
+  bool load(const std::string &path, std::string *error);
+
+  std::string path_;
+  int fd_ = -1;
+  std::vector<CaseArchiveEntry> entries_;
+  std::unordered_map<std::string, size_t> name_index_;
+};
+
+class CaseArchiveWriter {
+ public:
+  ~CaseArchiveWriter();
+  bool open(const std::string &path, std::string *error = nullptr);
+  // name is normalized, a duplicated name is an error.
+  bool add(const std::string &name, CaseArchiveEntry::Kind kind,
+           const std::string &op_name, const std::string &data,
+           bool compress, std::string *error = nullptr);
+  bool contains(const std::string &name) const;
+  // write index and footer, the archive is valid only after finish().
+  bool finish(std::string *error = nullptr);
+
+ private:
+  std::string path_;
+  int fd_ = -1;
+  uint64_t offset_ = 0;
+  std::vector<CaseArchiveEntry> entries_;
+  std::unordered_map<std::string, size_t> name_index_;
+};
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_CASE_ARCHIVE_H_
@@ -32,6 +32,7 @@
 #include <vector>
 #include "tools.h"
 #include "variable.h"
+#include "case_archive.h"
 #include "gtest/gtest.h"
 
 #define RETURN_IF_PATH_INVALID() \
@@ -59,6 +60,7 @@ class Collector {
 
   std::vector<std::string> list_by_case_list(std::string);
   std::vector<std::string> list_by_case_dir(std::string);
+  std::vector<std::string> list_by_case_archive(std::string);
   std::vector<std::string> list_by_case_path(std::string);
 
   void assertPath(std::string &, caseType, std::string, int);
@@ -0,0 +1,94 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_CASE_MINIMIZER_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_CASE_MINIMIZER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "mlu_op_test.pb.h"
+#include "executor.h"
+#include "tools.h"
+
+namespace mluoptest {
+
+// Shrinks a case which fails accuracy to a smaller case which still fails
+// (--minimize=<dir>). Greedy delta debugging on the Node, until no step
+// helps or MLUOP_GTEST_MINIMIZE_MAX_TRIALS candidates have run:
+//   1. each dim value is shrunk (to 1, then halved) in all tensors at once,
+//      which keeps e.g. the batch of input and output equal, then each dim
+//      of each tensor alone;
+//   2. integer fields of op params are shrunk (to 0, halved, or by 1);
+//   3. regions of input data are zeroed, coarse to fine.
+// Every candidate runs through the whole executor: param check, mlu compute,
+// cpuCompute() and diff. Candidates which throw or raise gtest failures
+// (rejected by param check) and candidates which pass are dropped. Input
+// data is cut to the new shape instead of regenerated, so the failing values
+// of the original case are kept. Tensors with stride are not reshaped.
+class CaseMinimizer {
+ public:
+  using ExecutorFactory = std::function<std::shared_ptr<Executor>()>;
+
+  CaseMinimizer(const std::string &op_name, ExecutorFactory factory,
+                std::shared_ptr<ExecuteContext> ectx,
+                const std::shared_ptr<ExecuteConfig> &ecfg);
+
+  // write the smallest failing case of case_path into dir, and return its
+  // path. return "" if case_path does not fail accuracy against cpuCompute().
+  std::string run(const std::string &case_path, const std::string &dir);
+
+ private:
+  // the case being shrunk, raw[i] is the data of input i if it is saved in
+  // a data file, and empty else.
+  struct Candidate {
+    Node node;
+    std::vector<std::string> raw;
+  };
+  enum Outcome { FAIL, PASS, REJECT };
+
+  bool load(const std::string &case_path, Candidate *c);
+  // save c as dir/name.pb or dir/name.prototxt, return the path.
+  std::string save(const Candidate &c, const std::string &name, bool text);
+  Outcome check(const Candidate &c);
+  // check c, and keep it as best_ if it still fails.
+  bool tryCandidate(Candidate *c, const std::string &what);
+
+  bool shrinkDims();
+  bool shrinkParams();
+  bool zeroInputs();
+
+  std::string op_name_;
+  ExecutorFactory factory_;
+  std::shared_ptr<ExecuteContext> ectx_;
+  std::shared_ptr<ExecuteConfig> ecfg_;
+  std::string dir_;
+  std::string stem_;
+  Candidate best_;
+  int trials_ = 0;
+  int max_trials_ = getEnvInt("MLUOP_GTEST_MINIMIZE_MAX_TRIALS", 500);
+};
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_CASE_MINIMIZER_H_
@@ -0,0 +1,69 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_CASE_SCHEDULER_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_CASE_SCHEDULER_H_
+
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+namespace mluoptest {
+
+// Orders the cases of one op for multi-thread mode, longest first (LPT).
+// The cost of a case is its busy time (setup + teardown) of past runs saved
+// in the history file (--case_history / MLUOP_GTEST_CASE_HISTORY). Cases
+// without history are estimated from the tensor shapes in the case header
+// plus the file size, scaled to seconds by the cases that have history.
+// Finished cases are recorded, and the history file is rewritten by
+// report(), which also prints the makespan against the ideal one.
+// MLUOP_GTEST_LPT_SCHEDULE=OFF keeps the case list order.
+class CaseScheduler {
+ public:
+  CaseScheduler(const std::string &op_name,
+                const std::vector<std::string> &case_paths);
+
+  // case indices in dispatch order.
+  const std::vector<size_t> &order() const { return order_; }
+  // estimated seconds, or estimated units if no case has history.
+  double cost(size_t case_idx) const { return cost_[case_idx]; }
+
+  // thread-safe, seconds the threads spent on this case.
+  void record(size_t case_idx, double busy_seconds);
+  // print makespan of this op, and save history if enabled.
+  void report(double makespan_seconds, size_t thread_num);
+
+  // element count of all tensors in case header, -1 if unreadable.
+  static double estimateCaseSize(const std::string &case_path);
+
+ private:
+  std::string op_name_;
+  std::vector<std::string> case_paths_;
+  std::vector<size_t> order_;
+  std::vector<double> cost_;
+  std::mutex mtx_;
+  std::vector<double> busy_;  // measured, -1 if not finished
+};
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_CASE_SCHEDULER_H_
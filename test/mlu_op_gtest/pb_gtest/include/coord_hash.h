@@ -0,0 +1,68 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_COORD_HASH_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_COORD_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mluoptest {
+
+// open-addressing hash map from non-negative int64 keys to int32 values, for
+// the cpu baselines of sparse and voxel ops which would otherwise index a
+// dense grid as large as the whole (batch, z, y, x) space. The key is usually
+// the packed coordinate ((b * D + z) * H + y) * W + x.
+// Linear probing on a power-of-two table that grows when half full. insert()
+// and set() are not thread-safe, find() may run concurrently once the table
+// is built, and values found may be written concurrently for distinct keys.
+class CoordHash {
+ public:
+  explicit CoordHash(size_t expected = 0);
+
+  // insert key with value, returns false (and keeps the old value) if key is
+  // already present.
+  bool insert(int64_t key, int32_t value);
+  // insert key with value, or overwrite its value.
+  void set(int64_t key, int32_t value);
+  // value of key, nullptr if absent.
+  int32_t *find(int64_t key);
+  const int32_t *find(int64_t key) const;
+
+  size_t size() const { return size_; }
+  // the keys present, in no particular order.
+  std::vector<int64_t> keys() const;
+
+ private:
+  size_t slot(int64_t key) const;
+  void grow();
+
+  std::vector<int64_t> keys_;  // -1 marks an empty slot
+  std::vector<int32_t> values_;
+  size_t mask_ = 0;
+  size_t size_ = 0;
+};
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_COORD_HASH_H_
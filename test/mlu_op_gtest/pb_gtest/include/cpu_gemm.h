@@ -0,0 +1,61 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_CPU_GEMM_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_CPU_GEMM_H_
+
+#include <cstdint>
+
+// cache-blocked gemm for the cpu baselines of zoo ops, so large matmuls don't
+// need openblas. Matrices are row-major like cblas CblasRowMajor:
+//   C = alpha * op(A) * op(B) + beta * C,
+// op(A) is m x k, op(B) is k x n, op(X) is X^T if trans_x, and lda/ldb/ldc
+// are the row strides of A/B/C as stored. beta == 0 ignores the old C.
+
+namespace mluoptest {
+
+void cpuGemm(bool trans_a, bool trans_b, int64_t m, int64_t n, int64_t k,
+             float alpha, const float *a, int64_t lda, const float *b,
+             int64_t ldb, float beta, float *c, int64_t ldc);
+
+void cpuGemm(bool trans_a, bool trans_b, int64_t m, int64_t n, int64_t k,
+             double alpha, const double *a, int64_t lda, const double *b,
+             int64_t ldb, double beta, double *c, int64_t ldc);
+
+// batch gemms, the i-th A/B/C start at a + i * stride_a, b + i * stride_b
+// and c + i * stride_c.
+void cpuGemmStridedBatched(bool trans_a, bool trans_b, int64_t m, int64_t n,
+                           int64_t k, float alpha, const float *a, int64_t lda,
+                           int64_t stride_a, const float *b, int64_t ldb,
+                           int64_t stride_b, float beta, float *c, int64_t ldc,
+                           int64_t stride_c, int64_t batch);
+
+void cpuGemmStridedBatched(bool trans_a, bool trans_b, int64_t m, int64_t n,
+                           int64_t k, double alpha, const double *a,
+                           int64_t lda, int64_t stride_a, const double *b,
+                           int64_t ldb, int64_t stride_b, double beta,
+                           double *c, int64_t ldc, int64_t stride_c,
+                           int64_t batch);
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_CPU_GEMM_H_
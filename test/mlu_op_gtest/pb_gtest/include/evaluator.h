@@ -28,14 +28,17 @@
 #include <limits>
 #endif
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <list>
 #include <sstream>
 #include <vector>
 #include <tuple>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <map>
 #include <set>
@@ -287,6 +290,21 @@ class Evaluator {
                    const std::set<Criterion> criterions,
                    const std::string &name, const mluOpDataType_t dtype);
 
+  // streaming mode of computeDiff(), for outputs that are too large to keep
+  // another full copy on host. call beginDiff() once, then feed baseline and
+  // mlu results chunk by chunk in order, and call endDiff() after the last
+  // chunk. the errors are the same as computing them in one shot, but for
+  // the rounding of the DIFF1 / DIFF2 sums, which already depends on the omp
+  // thread count. DIFF_KL needs the whole output as one chunk.
+  void beginDiff(const size_t count, const std::set<Criterion> criterions,
+                 const std::string &name, const mluOpDataType_t dtype);
+  // count is the element count of this chunk, complex counts as one element.
+  void computeDiffChunk(void *baseline_chunk, void *mlu_chunk,
+                        const size_t count);
+  void endDiff();
+  // false if a criterion needs the whole output as one chunk (DIFF_KL).
+  static bool canStream(const std::set<Criterion> &criterions);
+
   // compute efficiency by formula:
   // theory_ops / latency / peak_compute_force
   // theory_io / latency / io_bandwidth
@@ -303,6 +321,8 @@ class Evaluator {
   double getMluWorkspaceSize() { return workspace_size_; }
 
  private:
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
   // distinguish_nan_inf
   template <typename T>
   bool compareNanInfStrict(T mlu_out[], T baseline_out[], size_t index) {
@@ -323,7 +343,7 @@ class Evaluator {
       if (std::isnan(baseline)) {
         return true;
       } else if (std::isinf(baseline)) {
-        nan_inf_neq_pos_.emplace_back(index);
+        recordFirstPos(&nan_inf_neq_pos_, index);
         return true;
       } else {
         return false;
@@ -333,7 +353,7 @@ class Evaluator {
       if (mlu == baseline) {
         return true;
       } else if (std::isnan(baseline)) {
-        nan_inf_neq_pos_.emplace_back(index);
+        recordFirstPos(&nan_inf_neq_pos_, index);
         return true;
       } else {
         return false;
@@ -342,25 +362,31 @@ class Evaluator {
     return true;
   }
 
+  // chunks are fed in order, so the first recorded position is the smallest.
+  inline void recordFirstPos(size_t *pos, size_t index) {
+    if (*pos == npos) {
+      *pos = chunk_offset_ + index;
+    }
+  }
+
   // if forst level accuracy(wiki:52441150), only compare nan/inf, skip other
-  // position
+  // position.
+  // only deal with current chunk here, result is reported in finishNanInf().
   template <typename T>
   void dealNanInf() {
-    skip_compute_diff_ = false;
-    bool has_nan_inf = false;
     T *a = reinterpret_cast<T *>(base_array_);
     T *b = reinterpret_cast<T *>(mlu_array_);
     if (threshold_l1_) {
-      resetNanOrInfAsZero(a, b, count_total_);
+      resetNanOrInfAsZero(a, b, chunk_total_);
       nanInfRemain<T>();
       return;
     }
     // TODO(None): have vector.push_back() in for loop, open it after
     // modify code logic #pragma omp parallel for schedule(guided)
-    for (size_t i = 0; i < count_total_; ++i) {
+    for (size_t i = 0; i < chunk_total_; ++i) {
       if (isNanOrInf(a[i]) || isNanOrInf(b[i])) {
         skip_compute_diff_ = true;
-        has_nan_inf = true;
+        has_nan_inf_ = true;
         bool res = false;
         if (true == global_var.loose_check_nan_inf_) {
           res = compareNanInfLoose(a, b, i);
@@ -368,31 +394,10 @@ class Evaluator {
           res = compareNanInfStrict(a, b, i);
         }
         if (false == res) {
-          nan_inf_wrong_pos_.emplace_back(i);
-          nan_inf_pass_ = false;
+          recordFirstPos(&nan_inf_wrong_pos_, i);
         }
       }
     }
-    if (!nan_inf_wrong_pos_.empty()) {
-      auto first_pos = *std::min_element(std::begin(nan_inf_wrong_pos_),
-                                         std::end(nan_inf_wrong_pos_));
-      LOG(ERROR) << "Found NaN or Inf, but mlu is not equal to baseline,"
-                 << " return DBL_MAX instead."
-                 << "The first wrong position is " << first_pos;
-      return;
-    }
-    if (has_nan_inf) {
-      nan_inf_pass_ = true;
-      if (!nan_inf_neq_pos_.empty()) {
-        auto first_pos = *std::min_element(std::begin(nan_inf_neq_pos_),
-                                           std::end(nan_inf_neq_pos_));
-        LOG(WARNING) << "The results of baseline and mlu are not equal, "
-                     << "one of them is nan and the other is inf, "
-                     << "the current mode will not distinguish nan and inf, "
-                     << "this case will pass. The first position is "
-                     << first_pos;
-      }
-    }
   }
 
   template <typename T>
@@ -427,6 +432,109 @@ class Evaluator {
     }
   }
 
+  // diff4 is not used if there are less than DIFF4_MIN_UNIQUE_COUNT different
+  // (mlu, baseline) pairs, so it is enough to track that many unique pairs.
+  static constexpr size_t DIFF4_MIN_UNIQUE_COUNT = 100;
+  // the first DIFF4_REPORT_POS_NUM mismatch positions are kept for log.
+  static constexpr size_t DIFF4_REPORT_POS_NUM = 8;
+
+  // key of one value in diff4 pairs, equal keys iff equal values.
+  template <typename T>
+  static uint64_t diff4Key(const T &value) {
+    if constexpr (std::is_integral<T>::value) {
+      return static_cast<uint64_t>(value);
+    } else {
+      // + 0.0 maps -0.0 to 0.0
+      double d = double(value) + 0.0;
+      uint64_t key = 0;
+      memcpy(&key, &d, sizeof(d));
+      return key;
+    }
+  }
+
+  // fixed size open addressing set of (mlu, baseline) pairs, stop inserting
+  // once DIFF4_MIN_UNIQUE_COUNT pairs are found, so memory is constant.
+  struct Diff4UniquePairs {
+    static constexpr size_t capacity = 256;  // power of 2, load factor < 0.5
+    std::array<std::pair<uint64_t, uint64_t>, capacity> pairs;
+    std::array<bool, capacity> used{};
+    size_t size = 0;
+
+    inline bool full() const { return size >= DIFF4_MIN_UNIQUE_COUNT; }
+    void insert(uint64_t mlu, uint64_t base) {
+      if (full()) {
+        return;
+      }
+      size_t seed = 0;
+      hash_combine(seed, mlu);
+      hash_combine(seed, base);
+      size_t pos = seed & (capacity - 1);
+      while (used[pos]) {
+        if (pairs[pos].first == mlu && pairs[pos].second == base) {
+          return;
+        }
+        pos = (pos + 1) & (capacity - 1);
+      }
+      used[pos] = true;
+      pairs[pos] = std::make_pair(mlu, base);
+      ++size;
+    }
+    void merge(const Diff4UniquePairs &other) {
+      for (size_t i = 0; i < capacity && !full(); ++i) {
+        if (other.used[i]) {
+          insert(other.pairs[i].first, other.pairs[i].second);
+        }
+      }
+    }
+  };
+
+  // bias direction counters of one thread's chunk
+  struct Diff4Partial {
+    size_t lower_count = 0;  // mlu < baseline
+    size_t num_count = 0;    // mlu != baseline
+    std::array<size_t, DIFF4_REPORT_POS_NUM> first_pos{};
+    Diff4UniquePairs unique;
+
+    template <typename T>
+    inline void count(const T &mlu, const T &base, size_t pos) {
+      if (mlu != base) {
+        lower_count += mlu < base;
+        if (num_count < DIFF4_REPORT_POS_NUM) {
+          first_pos[num_count] = pos;
+        }
+        ++num_count;
+        unique.insert(diff4Key(mlu), diff4Key(base));
+      }
+    }
+    // other must come from the chunk right after this one.
+    void merge(const Diff4Partial &other) {
+      size_t pos_num = std::min(other.num_count, DIFF4_REPORT_POS_NUM);
+      for (size_t i = 0; i < pos_num && num_count + i < DIFF4_REPORT_POS_NUM;
+           ++i) {
+        first_pos[num_count + i] = other.first_pos[i];
+      }
+      lower_count += other.lower_count;
+      num_count += other.num_count;
+      unique.merge(other.unique);
+    }
+    // -1 means diff4 is not used.
+    double error() const {
+      return unique.full() ? double(lower_count) / double(num_count) : -1;
+    }
+  };
+
+  // partial result of one criterion, every chunk is merged into it, and error
+  // is computed from it after the last chunk.
+  struct DiffPartial {
+    double numerator_sum = 0.0;    // diff1, diff2
+    double denominator_sum = 0.0;  // diff1, diff2
+    double max_ratio = 0.0;        // diff3, diff3_2
+    // diff_kl normalizes by the sums of the whole output first, so it is
+    // computed from a single chunk.
+    double entropy = 0.0;
+    Diff4Partial diff4;
+  };
+
   template <typename T>
   void computeDiff1() {
     double numerator_sum = 0.0;
@@ -438,7 +546,7 @@ class Evaluator {
 #pragma omp parallel for reduction \
         (+:numerator_sum, denominator_sum, numerator_sum_imag, \
          denominator_sum_imag) schedule(guided)
-    for (size_t i = 0; i < count_total_; i += stride_) {
+    for (size_t i = 0; i < chunk_total_; i += stride_) {
       numerator_sum += std::abs(double(mlu_array[i]) - double(base_array[i]));
       denominator_sum += std::abs(double(base_array[i]));
       if (is_complex_) {
@@ -447,10 +555,10 @@ class Evaluator {
         denominator_sum_imag += std::abs(double(base_array[i + 1]));
       }
     }  // end omp parallel block
-    error_ = numerator_sum / (denominator_sum + EPSILON);
-    if (is_complex_) {
-      error_imag_ = numerator_sum_imag / (denominator_sum_imag + EPSILON);
-    }
+    partials_[func_].numerator_sum += numerator_sum;
+    partials_[func_].denominator_sum += denominator_sum;
+    partials_imag_[func_].numerator_sum += numerator_sum_imag;
+    partials_imag_[func_].denominator_sum += denominator_sum_imag;
   }
 
   template <typename T>
@@ -464,7 +572,7 @@ class Evaluator {
 #pragma omp parallel for reduction \
         (+:numerator_sum, denominator_sum, numerator_sum_imag, \
         denominator_sum_imag) schedule(guided)
-    for (size_t i = 0; i < count_total_; i += stride_) {
+    for (size_t i = 0; i < chunk_total_; i += stride_) {
       numerator_sum +=
           std::pow(double(mlu_array[i]) - double(base_array[i]), 2);
       denominator_sum += std::pow(double(base_array[i]), 2);
@@ -474,11 +582,10 @@ class Evaluator {
         denominator_sum_imag += std::pow(double(base_array[i + 1]), 2);
       }
     }  // end omp parallel block
-    error_ = std::sqrt(numerator_sum / (denominator_sum + EPSILON));
-    if (is_complex_) {
-      error_imag_ =
-          std::sqrt(numerator_sum_imag / (denominator_sum_imag + EPSILON));
-    }
+    partials_[func_].numerator_sum += numerator_sum;
+    partials_[func_].denominator_sum += denominator_sum;
+    partials_imag_[func_].numerator_sum += numerator_sum_imag;
+    partials_imag_[func_].denominator_sum += denominator_sum_imag;
   }
 
   template <typename T>
@@ -497,7 +604,7 @@ class Evaluator {
 #pragma omp parallel for reduction(max                          \
                                    : max_ratio, max_ratio_imag) \
     schedule(guided)
-    for (size_t i = 0; i < count_total_; i += stride_) {
+    for (size_t i = 0; i < chunk_total_; i += stride_) {
       double numerator = std::abs(double(mlu_array[i]) - double(base_array[i]));
       double denominator = std::abs(double(base_array[i]));
       double ratio =
@@ -512,10 +619,10 @@ class Evaluator {
         max_ratio_imag = (ratio > max_ratio_imag) ? ratio : max_ratio_imag;
       }
     }  // end omp parallel block
-    error_ = max_ratio;
-    if (is_complex_) {
-      error_imag_ = max_ratio_imag;
-    }
+    partials_[func_].max_ratio =
+        std::max(partials_[func_].max_ratio, max_ratio);
+    partials_imag_[func_].max_ratio =
+        std::max(partials_imag_[func_].max_ratio, max_ratio_imag);
   }
 
   template <typename T>
@@ -527,7 +634,7 @@ class Evaluator {
 #pragma omp parallel for reduction(max                          \
                                    : max_ratio, max_ratio_imag) \
     schedule(guided)
-    for (size_t i = 0; i < count_total_; i += stride_) {
+    for (size_t i = 0; i < chunk_total_; i += stride_) {
       double ratio = std::abs(double(mlu_array[i]) - double(base_array[i]));
       max_ratio = (ratio > max_ratio) ? ratio : max_ratio;
       if (is_complex_) {
@@ -535,22 +642,12 @@ class Evaluator {
         max_ratio_imag = (ratio > max_ratio_imag) ? ratio : max_ratio_imag;
       }
     }  // end omp parallel block
-    error_ = max_ratio;
-    if (is_complex_) {
-      error_imag_ = max_ratio_imag;
-    }
+    partials_[func_].max_ratio =
+        std::max(partials_[func_].max_ratio, max_ratio);
+    partials_imag_[func_].max_ratio =
+        std::max(partials_imag_[func_].max_ratio, max_ratio_imag);
   }
 
-  template <typename T>
-  struct TupleHash {
-    size_t operator()(const std::tuple<T, T> &t) const {
-      size_t seed;
-      hash_combine(seed, (T)std::get<0>(t));
-      hash_combine(seed, (T)std::get<1>(t));
-      return seed;
-    }
-  };
-
 #ifndef KL_EPSILON
 #define KL_EPSILON (1e-10)
   template <typename T>
@@ -576,76 +673,93 @@ class Evaluator {
   }
 #endif
 
+  // each thread counts the bias direction of its own chunk, then partials are
+  // merged in chunk order. the ratio is computed over all mismatch elements,
+  // while the number of unique (mlu, baseline) pairs still decides whether
+  // diff4 is used, so the pass/fail result is the same as counting unique
+  // pairs only.
   template <typename T>
   void computeDiff4() {
     T *base_array = reinterpret_cast<T *>(base_array_);
     T *mlu_array = reinterpret_cast<T *>(mlu_array_);
-    double max_count = 0;
-    double num_count = 0;
-    double max_count_imag = 0;
-    double num_count_imag = 0;
-    std::unordered_set<std::tuple<T, T>, TupleHash<T>> unrepeat_res;
-    std::unordered_set<std::tuple<T, T>, TupleHash<T>> unrepeat_res_imag;
-    for (size_t i = 0; i < count_total_; i += stride_) {
-      if (is_complex_) {
-        if (mlu_array[i + 1] != base_array[i + 1]) {
-          auto unrepeat_tuple =
-              std::make_tuple(mlu_array[i + 1], base_array[i + 1]);
-          if (unrepeat_res_imag.end() ==
-              unrepeat_res_imag.find(unrepeat_tuple)) {
-            max_count_imag += mlu_array[i + 1] < base_array[i + 1];
-            num_count_imag++;
-            unrepeat_res_imag.emplace(unrepeat_tuple);
-          }
+    int thread_num = 1;
+#ifdef _OPENMP
+    thread_num = omp_get_max_threads();
+#endif
+    std::vector<Diff4Partial> partials(thread_num);
+    std::vector<Diff4Partial> partials_imag(is_complex_ ? thread_num : 0);
+#pragma omp parallel num_threads(thread_num)
+    {
+      int thread_id = 0;
+#ifdef _OPENMP
+      thread_id = omp_get_thread_num();
+#endif
+      Diff4Partial local;
+      Diff4Partial local_imag;
+      // static schedule: thread i handles the i-th contiguous chunk
+#pragma omp for schedule(static)
+      for (size_t i = 0; i < chunk_total_; i += stride_) {
+        if (is_complex_) {
+          local_imag.count(mlu_array[i + 1], base_array[i + 1],
+                           chunk_offset_ + i + 1);
         }
+        local.count(mlu_array[i], base_array[i], chunk_offset_ + i);
       }
-      if (mlu_array[i] != base_array[i]) {
-        auto unrepeat_tuple = std::make_tuple(mlu_array[i], base_array[i]);
-        if (unrepeat_res.end() == unrepeat_res.find(unrepeat_tuple)) {
-          max_count += mlu_array[i] < base_array[i];
-          num_count++;
-          unrepeat_res.emplace(unrepeat_tuple);
-        }
+      partials[thread_id] = local;
+      if (is_complex_) {
+        partials_imag[thread_id] = local_imag;
       }
+    }  // end omp parallel block
+    for (size_t i = 0; i < partials.size(); ++i) {
+      partials_[func_].diff4.merge(partials[i]);
     }
-    error_ = (num_count < 100) ? -1 : max_count / num_count;
-    if (is_complex_) {
-      error_imag_ =
-          (num_count_imag < 100) ? -1 : max_count_imag / num_count_imag;
+    for (size_t i = 0; i < partials_imag.size(); ++i) {
+      partials_imag_[func_].diff4.merge(partials_imag[i]);
     }
   }
 
+  // all mismatch elements are biased to one side, print where they are.
+  void logDiff4Pos(const Diff4Partial &res, double error,
+                   const std::string &part) {
+    if (!cur_criterion_.enable || !(error == 0.0 || error == 1.0)) {
+      return;
+    }
+    std::ostringstream oss;
+    size_t pos_num = std::min(res.num_count, DIFF4_REPORT_POS_NUM);
+    for (size_t i = 0; i < pos_num; ++i) {
+      oss << (i == 0 ? "" : ", ") << res.first_pos[i];
+    }
+    LOG(WARNING) << "DIFF4 of [" << name_ << "]" << part << ": all "
+                 << res.num_count << " mismatch elements are "
+                 << (error == 0.0 ? "greater" : "less")
+                 << " than baseline, the first positions are " << oss.str();
+  }
+
   template <typename T>
   void computeDiffKl() {
     T *base_array = reinterpret_cast<T *>(base_array_);
     T *mlu_array = reinterpret_cast<T *>(mlu_array_);
-    // diff_kl needs count_total_ <= INT64_MAX because of the length in python
-    // func is int64 diff_kl skips the data with too less quantity
-    if (count_total_ < (size_t)1000 || count_total_ > (size_t)INT64_MAX) {
-      error_ = -1;
-    } else {
-      error_ = diff_kl(base_array, mlu_array, count_total_);
-    }
+    GTEST_CHECK(chunk_offset_ == 0 && chunk_total_ == count_total_,
+                "Evaluator: DIFF_KL can't be computed chunk by chunk.");
+    partials_[func_].entropy = diff_kl(base_array, mlu_array, chunk_total_);
   }
 
   template <typename T>
   void check_nan_inf() {
-    skip_compute_diff_ = false;
     // if diff is LEVEL 1, return. Else only compute where is nan/inf.
     dealNanInf<T>();
-    if (skip_compute_diff_) {
-      setErrorWrap();
-    }
   }
 
   template <typename T>
   void nanInfRemain() {
     T *base_array = reinterpret_cast<T *>(base_array_);
     T *mlu_array = reinterpret_cast<T *>(mlu_array_);
-    if (hasNanOrInf(base_array, count_total_) ||
-        hasNanOrInf(mlu_array, count_total_)) {
-      LOG(ERROR)
-          << "Found NaN or Inf when compute diff, return DBL_MAX instead.";
+    if (hasNanOrInf(base_array, chunk_total_) ||
+        hasNanOrInf(mlu_array, chunk_total_)) {
+      if (!skip_compute_diff_) {
+        LOG(ERROR)
+            << "Found NaN or Inf when compute diff, return DBL_MAX instead.";
+      }
       skip_compute_diff_ = true;
       nan_inf_pass_ = false;
     }
@@ -656,6 +770,8 @@ class Evaluator {
             const mluOpDataType_t dtype);
 
   void computeDiffForOneCriterion();
+  void finishDiffForOneCriterion();
+  void finishNanInf();
   void computeDiffFloatAndDouble();
   void computeDiffByDtype();
   void thresholdLevel1();
@@ -677,6 +793,7 @@ class Evaluator {
     }
   }
 
+  // current chunk
   void *base_array_ = nullptr;
   void *mlu_array_ = nullptr;
   mluOpDataType_t dtype_;
@@ -684,11 +801,15 @@ class Evaluator {
   size_t count_ = -1;
   // count with complex
   size_t count_total_ = -1;
+  // count with complex of current chunk, and where it begins
+  size_t chunk_total_ = 0;
+  size_t chunk_offset_ = 0;
   double error_ = -1;
   double error_imag_ = -1;
   bool skip_compute_diff_ = false;
   bool is_complex_ = false;
   bool threshold_l1_ = false;
+  bool has_nan_inf_ = false;
   bool nan_inf_pass_ = false;
   bool criterion_matching_ = true;
   Criterion cur_criterion_;
@@ -699,11 +820,13 @@ class Evaluator {
   std::vector<Criterion>
       criterion_vec_;  // vector of (diff1+thresdhold) /(diff2 + threshold)
   std::vector<ErrorWrap> error_vec_;  // vetor output's error
-  // record the position where nan/inf output is wrong
-  std::vector<size_t> nan_inf_wrong_pos_;
-  // used for LOOSE_CHECK_NAN_INF mode, record the position where one is inf the
-  // other is nan
-  std::vector<size_t> nan_inf_neq_pos_;
+  std::map<Formula, DiffPartial> partials_;
+  std::map<Formula, DiffPartial> partials_imag_;
+  // record the first position where nan/inf output is wrong
+  size_t nan_inf_wrong_pos_ = npos;
+  // used for LOOSE_CHECK_NAN_INF mode, record the first position where one is
+  // inf the other is nan
+  size_t nan_inf_neq_pos_ = npos;
 
   double workspace_size_ = -1;  // for -1
 };
@@ -718,7 +841,7 @@ struct PerfInfo {  // perf info for certain device (mlu or gpu)
   // memcpy host to device time (mlu only
   double h2d_time = -1;
   double d2h_time = -1;
-  // hardware time of mlu or gpu
+  // hardware time of mlu or gpu, outliers excluded in robust perf mode
   double hardware_time = -1;  // us
   // hardware time baseline that output to log
   double baseline_mlu_hw_time = -1;
@@ -726,6 +849,14 @@ struct PerfInfo {  // perf info for certain device (mlu or gpu)
   double thistime_mlu_hw_time = -1;
   // mlu hardware time coefficient of variantion
   double hardware_time_cv = -1;
+  // robust perf mode only (MLUOP_GTEST_PERF_ROBUST), see PerfStats
+  double hardware_time_median = -1;
+  double hardware_time_trimmed_mean = -1;
+  double hardware_time_mad = -1;
+  double hardware_time_ci_low = -1;
+  double hardware_time_ci_high = -1;
+  int perf_samples = -1;
+  int perf_outliers = -1;
   double hardware_time_layer = -1;  // us
   // compute efficiency of mlu or gpu
   double compute_efficiency = -1;
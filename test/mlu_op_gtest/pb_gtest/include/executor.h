@@ -50,6 +50,7 @@
 #include "evaluator.h"
 #include "runtime.h"
 #include "memory_pool.h"
+#include "baseline_cache.h"
 #include "variable.h"
 #include "stride.h"
 #include "test_env.h"
@@ -124,6 +125,12 @@ struct ExecuteConfig {
               << "\n";
     std::cout << std::left << std::setw(25)
               << "check perf baseline: " << perf_baseline << "\n";
+    std::cout << std::left << std::setw(25) << "stream diff: " << stream_diff
+              << "\n";
+    std::cout << std::left << std::setw(25) << "perf warmup: " << perf_warmup
+              << "\n";
+    std::cout << std::left << std::setw(25) << "robust perf: " << perf_robust
+              << "\n";
   }
 
   bool mlu_only = false;
@@ -140,6 +147,24 @@ struct ExecuteConfig {
   bool enable_const_dram = false;
   bool auto_tuning = false;
   bool enable_lite_interface = getEnv("MLUOP_GTEST_INTERFACE_MODE", 0) == 1;
+  // cast mlu output and compute diff chunk by chunk, instead of holding a
+  // whole fp32 copy of every mlu output on host.
+  bool stream_diff = getEnv("MLUOP_GTEST_STREAM_DIFF", false);
+  // elements per chunk, see Executor::streamDiff()
+  size_t stream_diff_chunk =
+      (size_t)getEnvInt("MLUOP_GTEST_STREAM_DIFF_CHUNK", 1 << 22);
+  // perf repeat: warm-up launches not timed.
+  int perf_warmup = getEnvInt("MLUOP_GTEST_PERF_WARMUP", 0);
+  // robust perf mode, see Executor::launchAndGetTime().
+  // perf_repeat is the min launch count, then repeat until the 95% ci of
+  // hardware time is narrow enough, or max repeat/time budget is reached.
+  bool perf_robust = getEnv("MLUOP_GTEST_PERF_ROBUST", false);
+  int perf_max_repeat = getEnvInt("MLUOP_GTEST_PERF_MAX_REPEAT", 1000);
+  // target ci half width relative to mean, in permille.
+  int perf_ci_permille = getEnvInt("MLUOP_GTEST_PERF_CI_PERMILLE", 10);
+  int perf_time_budget_ms = getEnvInt("MLUOP_GTEST_PERF_TIME_BUDGET_MS", 2000);
+  // reject samples beyond k * sigma (estimated by MAD), 0 for no rejection.
+  int perf_outlier_mad = getEnvInt("MLUOP_GTEST_PERF_OUTLIER_MAD", 5);
 // #if GTEST_ENABLE_GPERFTOOLS
 //   // TODO(None) move into global_var
 //   bool gtest_internal_cpu_profile =
@@ -188,8 +213,8 @@ struct ExecuteContext {
     hw_notifier = std::make_shared<HardwareTimeNotifier>();
     hw_notifier_layer = std::make_shared<HardwareTimeNotifier>();
   }
-  // reserve for memory pool
-  std::shared_ptr<CPUMemoryPool> cmp = nullptr;
+  // memory pool
+  std::shared_ptr<CPUMemoryPool> cmp = std::make_shared<CPUMemoryPool>();
   std::shared_ptr<MLUMemoryPool> mmp = std::make_shared<MLUMemoryPool>();
   void destroy() {
     hw_notifier->destroy();
@@ -456,6 +481,16 @@ class Executor {
   virtual void castIn();
   virtual void castOut();
   virtual void diffPreprocess() {}
+  // return true if diffPreprocess() reads or writes mlu_fp32_output_,
+  // then the whole mlu output is cast before diff even if stream diff is on.
+  virtual bool needFullMluOutput() { return false; }
+  // cpu baseline cache, see cpuComputeWithCache().
+  // return false if cpuCompute() leaves state beyond the outputs (e.g. used
+  // by diffPreprocess()), or its result is not a function of the inputs.
+  virtual bool baselineCacheable() { return !flag_input_reuse_; }
+  // the key already has a hash of the op's reference sources, bump this only
+  // if results change without touching them (e.g. through executor.cpp).
+  virtual uint32_t baselineCacheVersion() { return 0; }
   virtual void hostMalloc();
   virtual void hostReorder() {}
   virtual void searchAlgo() {}
@@ -569,12 +604,17 @@ class Executor {
   bool opParamSupportTf32();
   void dumpOutputData();
   void postProcessAfterLaunch();
+  void cpuComputeWithCache();
+  BaselineCacheKey baselineCacheKey();
+  std::vector<BaselineBuffer> baselineOutputBuffers();
 
   bool checkBaseline();
   bool checkAccuracyBaseline();
   bool checkMluOverWritten();
   bool checkMluMemoryLeak();
   bool checkDiff();
+  bool useStreamDiff();
+  void streamDiff(int index, const std::set<Evaluator::Criterion> &criterions);
   void getAllTestResult();
 
   void setStorageFuncPtr();
@@ -135,13 +135,32 @@ class MemoryPool {
   std::list<MemoryPool::Chunk>::iterator getOnlyOneBigChunk() const;
 };
 
+// Host buffers come from a size-class arena shared by all CPUMemoryPool
+// objects (one per execute context). A freed buffer goes to a cache of the
+// freeing thread first, then to a global cache, and is reused by later cases
+// instead of being returned to os. New buffers are pre-faulted. Buffers are
+// not zeroed, like malloc.
+// env:
+//   MLUOP_GTEST_CPU_MEMORY_POOL: use the arena in CPURuntime (default ON).
+//   MLUOP_GTEST_CPU_POOL_CACHE_MB: max size of the global cache (256).
+//   MLUOP_GTEST_CPU_POOL_THP: back buffers >= 2MB by transparent huge pages.
 class CPUMemoryPool : public MemoryPool {
  public:
   ~CPUMemoryPool() { destroy(); }
+  // 64 bytes aligned, throw if out of memory.
   void *allocate(size_t num_bytes, const std::string &name = "");
   void deallocate(void *ptr);
-  void destroy();
+  // free buffers are kept by the arena for later test suites.
+  void destroy() {}
   void clear() {}  // free all obj of 1 thread.
+  // give ptr back to the arena, can be used as a free() function pointer.
+  static void release(void *ptr);
+  // at the end of a case: move the buffers cached by the calling thread to
+  // the global cache, freeing what is over its limit.
+  static void trim();
+  // bytes of free buffers cached by the calling thread and globally.
+  static size_t cachedBytes();
+  static bool enabled();
 };
 
 class MLUMemoryPool : public MemoryPool {
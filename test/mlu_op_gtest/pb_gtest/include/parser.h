@@ -141,6 +141,9 @@ class Parser {
   void getInputTensorValue(size_t index, void *data, size_t count);
   void getOutputTensorValue(size_t index, void *data, size_t count);
 
+  // read *pb/*prototxt (or member of *pbpack) into proto, without checks.
+  bool readMessageFromFile(const std::string &filename, Node *proto);
+
   // op params
   inline Node *node() { return proto_node_; }
   inline std::string getOpName() { return proto_node_->op_name(); }
@@ -302,7 +305,7 @@ class Parser {
 
   Evaluator::Formula cvtProtoEvaluationCriterion(EvaluationCriterion c);
   Evaluator::Formula cvtProtoEvaluationCriterion(int c);
-  bool readMessageFromFile(const std::string &filename, Node *proto);
+  bool readMessageFromArchive(const std::string &filename, Node *proto);
   size_t getTensorSize(Tensor *pt);
   void setCurPbPath(const std::string &file);
   void isSupportTF32(Node *protoNode);
@@ -0,0 +1,59 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_PERF_STATS_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_PERF_STATS_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace mluoptest {
+
+// robust statistics of hardware time samples (us).
+struct PerfStats {
+  size_t samples = 0;   // samples kept after outlier rejection
+  size_t outliers = 0;  // samples rejected
+  double mean = -1;
+  double median = -1;
+  double trimmed_mean = -1;  // mean of the middle 80%
+  double mad = -1;           // median absolute deviation from median
+  double stddev = -1;
+  // 95% confidence interval of mean, t-distribution.
+  double ci_low = -1;
+  double ci_high = -1;
+
+  // half width of ci relative to mean.
+  double ciRelativeHalfWidth() const {
+    return mean > 0 ? (ci_high - ci_low) / 2 / mean : 0;
+  }
+};
+
+// samples farther than outlier_mad * 1.4826 * MAD from the median are
+// dropped before mean/stddev/ci, 0 keeps all. median and MAD use all samples.
+PerfStats computePerfStats(std::vector<double> samples, double outlier_mad);
+
+// two-sided 95% critical value of Student's t with degrees of freedom df.
+double studentT95(size_t df);
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_PERF_STATS_H_
@@ -0,0 +1,91 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_POINT_INDEX_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_POINT_INDEX_H_
+
+#include <vector>
+
+namespace mluoptest {
+
+// squared distance from query to point, in float and in the order the
+// brute-force baselines of point-cloud ops compute it.
+inline float pointDistance2(const float *query, const float *point) {
+  float dx = query[0] - point[0];
+  float dy = query[1] - point[1];
+  float dz = query[2] - point[2];
+  return dx * dx + dy * dy + dz * dz;
+}
+
+// spatial indexes over a set of num 3-d points (xyz is num x 3), built once
+// per batch by the cpu baselines of point-cloud ops and then queried in
+// parallel. Points with non-finite coordinates are left out: their distance
+// to any query is inf or nan, so no radius or nearest test ever takes them.
+// Both indexes bound distances with a relative slack of about 1e-5, so they
+// never miss a point that pointDistance2 puts in range through rounding.
+
+// uniform grid for radius queries, cells no smaller than cell_size when the
+// point count allows.
+class PointGrid {
+ public:
+  PointGrid(const float *xyz, int num, float cell_size);
+
+  // the points which may lie within radius of query, in ascending order.
+  // Every point whose pointDistance2 is 0 or at most radius * radius is
+  // there.
+  void query(const float *query, float radius, std::vector<int> *ids) const;
+
+ private:
+  double origin_[3] = {0, 0, 0};
+  double inv_cell_[3] = {0, 0, 0};
+  int n_[3] = {1, 1, 1};
+  std::vector<int> cell_start_;  // ids_ of cell c are [start[c], start[c+1])
+  std::vector<int> ids_;         // by cell, then by index
+};
+
+// kd-tree for k-nearest queries.
+class PointKdTree {
+ public:
+  PointKdTree(const float *xyz, int num);
+
+  // the k points nearest to query, ascending by pointDistance2 and by index
+  // on ties, as a brute-force scan keeping the first of equal distances
+  // finds them. Points at inf or nan distance are never taken. Returns how
+  // many were found, at most k, into dist2 and ids.
+  int nearest(const float *query, int k, float *dist2, int *ids) const;
+
+ private:
+  struct Node {
+    float lo[3], hi[3];
+    int begin, end;   // range of points_ and ids_
+    int left, right;  // children, -1 for a leaf
+  };
+  int build(const float *xyz, int begin, int end);
+
+  std::vector<float> points_;  // in leaf order
+  std::vector<int> ids_;
+  std::vector<Node> nodes_;
+};
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_POINT_INDEX_H_
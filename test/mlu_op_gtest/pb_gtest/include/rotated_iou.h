@@ -0,0 +1,83 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_ROTATED_IOU_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_ROTATED_IOU_H_
+
+#include <vector>
+
+namespace mluoptest {
+
+// iou of rotated boxes for the cpu baselines of box_iou_rotated and
+// nms_rotated, which port mmcv's convex clip with slightly different
+// arithmetic. Both variants are kept bit for bit.
+struct RotatedIouArith {
+  bool float_trig;  // cosf / sinf of the angle, else cos / sin in double
+  bool reciprocal;  // a * (1.0f / b) for divisions, else a / b
+};
+
+// a set of boxes (x_ctr, y_ctr, w, h, angle in radians), stride floats
+// apart. The corner terms of every box are worked out once, along with
+// axis-aligned bounds padded by a relative 1e-5, far more than the
+// rounding of the corners. Boxes with a non-finite parameter, or too thin
+// for the coordinates of the set to clip reliably, get infinite bounds.
+class RotatedBoxes {
+ public:
+  RotatedBoxes(const float *boxes, int num, int stride, RotatedIouArith arith);
+
+  int size() const { return (int)x_.size(); }
+  const float *x1() const { return x1_.data(); }
+  const float *y1() const { return y1_.data(); }
+  const float *x2() const { return x2_.data(); }
+  const float *y2() const { return y2_.data(); }
+
+  // iou (mode 0) or iof (otherwise) of box i with box j of other, in the
+  // arithmetic of this set; other should share it. Boxes whose bounds are
+  // apart, and which are not too thin for the coordinates of the pair, give
+  // 0 without the clip.
+  float iou(int i, const RotatedBoxes &other, int j, int mode) const;
+
+ private:
+  float intersection(float x1, float y1, int i, const RotatedBoxes &other,
+                     float x2, float y2, int j) const;
+
+  RotatedIouArith arith_;
+  // center, area and the rotated half sizes sin * h, cos * w, cos * h and
+  // sin * w of every box
+  std::vector<float> x_, y_, area_, sh_, cw_, ch_, sw_;
+  std::vector<float> x1_, y1_, x2_, y2_;
+  std::vector<float> magnitude_, short_side_;
+};
+
+// ious[i * boxes2.size() + j] = boxes1.iou(i, boxes2, j, mode), in
+// parallel tiles of the pair matrix.
+void rotatedIouMatrix(const RotatedBoxes &boxes1, const RotatedBoxes &boxes2,
+                      int mode, float *ious);
+
+// axis-aligned bounds of the polygon of n points xy (x0, y0, x1, y1, ...),
+// as lo (min x, min y) and hi (max x, max y); infinite if a coordinate is
+// not finite.
+void polygonBounds(const float *xy, int n, float *lo, float *hi);
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_ROTATED_IOU_H_
@@ -65,7 +65,7 @@ class CPURuntime : public Runtime {
  public:
   CPURuntime();
   virtual ~CPURuntime();
-  void init(std::shared_ptr<CPUMemoryPool> cmp) {}
+  void init(std::shared_ptr<CPUMemoryPool> cmp);
 
   // allocate(mluOpCreate(), mluOpDestroy());
   // this function will throw exception
@@ -180,6 +180,8 @@ class CPURuntime : public Runtime {
     std::string name;
   };
   std::vector<std::shared_ptr<MemBlockBase>> memory_blocks_;
+  // if set, allocate(size_in_bytes) takes buffers from it.
+  std::shared_ptr<CPUMemoryPool> cmp_ = nullptr;
 };
 
 class MLURuntime : public Runtime {
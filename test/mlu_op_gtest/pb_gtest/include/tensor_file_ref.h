@@ -0,0 +1,89 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_INCLUDE_TENSOR_FILE_REF_H_
+#define TEST_MLU_OP_GTEST_INCLUDE_TENSOR_FILE_REF_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace mluoptest {
+
+// external tensor reference saved in Tensor.path, so tensors too large for
+// a 2GB protobuf message live out of band:
+//   <file>[?offset=<bytes>&length=<bytes>&crc32=<hex>]
+// file is relative to the case file, every key is optional. dtype is the
+// dtype of the Tensor. length and crc32 are checked while streaming the
+// payload into host memory, see Parser::getTensorValueByFile().
+struct TensorFileRef {
+  std::string file;
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  bool has_length = false;
+  uint32_t crc32 = 0;
+  bool has_crc32 = false;
+
+  // false if the query part is malformed.
+  bool parse(const std::string &path) {
+    size_t query = path.find('?');
+    file = path.substr(0, query);
+    if (query == std::string::npos) {
+      return true;
+    }
+    size_t begin = query + 1;
+    while (begin < path.size()) {
+      size_t end = path.find('&', begin);
+      if (end == std::string::npos) {
+        end = path.size();
+      }
+      std::string item = path.substr(begin, end - begin);
+      size_t eq = item.find('=');
+      if (eq == std::string::npos || eq + 1 == item.size()) {
+        return false;
+      }
+      std::string key = item.substr(0, eq);
+      const char *value = item.c_str() + eq + 1;
+      char *value_end = nullptr;
+      if (key == "offset") {
+        offset = strtoull(value, &value_end, 10);
+      } else if (key == "length") {
+        length = strtoull(value, &value_end, 10);
+        has_length = true;
+      } else if (key == "crc32") {
+        crc32 = (uint32_t)strtoul(value, &value_end, 16);
+        has_crc32 = true;
+      } else {
+        return false;
+      }
+      if (*value_end != '\0') {
+        return false;
+      }
+      begin = end + 1;
+    }
+    return true;
+  }
+};
+
+}  // namespace mluoptest
+
+#endif  // TEST_MLU_OP_GTEST_INCLUDE_TENSOR_FILE_REF_H_
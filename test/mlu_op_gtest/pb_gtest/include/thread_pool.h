@@ -25,12 +25,16 @@
 
 #include <mutex>               // NOLINT
 #include <condition_variable>  // NOLINT
-#include <future>              // NOLINT
 #include <thread>              // NOLINT
 #include <utility>             // NOLINT
 #include <functional>
-#include <queue>
+#include <cstddef>
+#include <deque>
+#include <exception>
 #include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 #include <iostream>
 #include <atomic>
@@ -38,35 +42,192 @@
 
 namespace mluoptest {
 
+// move-only void() callable. callables up to INLINE_BYTES are stored in
+// place, so wrapping a task doesn't allocate.
+class Task {
+ public:
+  static constexpr size_t INLINE_BYTES = 112;
+
+  Task() = default;
+  template <typename F,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<F>::type, Task>::value>::type>
+  Task(F &&f) {  // NOLINT
+    using Fn = typename std::decay<F>::type;
+    if constexpr (sizeof(Fn) <= INLINE_BYTES &&
+                  alignof(Fn) <= alignof(std::max_align_t) &&
+                  std::is_nothrow_move_constructible<Fn>::value) {
+      new (buf_) Fn(std::forward<F>(f));
+      ops_ = &InlineOps<Fn>::ops;
+    } else {
+      *reinterpret_cast<Fn **>(buf_) = new Fn(std::forward<F>(f));
+      ops_ = &HeapOps<Fn>::ops;
+    }
+  }
+  Task(Task &&other) noexcept { moveFrom(other); }
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      reset();
+      moveFrom(other);
+    }
+    return *this;
+  }
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+  ~Task() { reset(); }
+
+  void operator()() { ops_->call(buf_); }
+  explicit operator bool() const { return ops_ != nullptr; }
+
+ private:
+  struct Ops {
+    void (*call)(void *);
+    void (*move)(void *dst, void *src);  // move construct and destroy src
+    void (*destroy)(void *);
+  };
+  template <typename Fn>
+  struct InlineOps {
+    static void call(void *p) { (*static_cast<Fn *>(p))(); }
+    static void move(void *dst, void *src) {
+      new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+      static_cast<Fn *>(src)->~Fn();
+    }
+    static void destroy(void *p) { static_cast<Fn *>(p)->~Fn(); }
+    static constexpr Ops ops = {call, move, destroy};
+  };
+  template <typename Fn>
+  struct HeapOps {
+    static void call(void *p) { (**static_cast<Fn **>(p))(); }
+    static void move(void *dst, void *src) {
+      *static_cast<Fn **>(dst) = *static_cast<Fn **>(src);
+    }
+    static void destroy(void *p) { delete *static_cast<Fn **>(p); }
+    static constexpr Ops ops = {call, move, destroy};
+  };
+
+  void moveFrom(Task &other) {
+    if (other.ops_ != nullptr) {
+      other.ops_->move(buf_, other.buf_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+  }
+  void reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy(buf_);
+      ops_ = nullptr;
+    }
+  }
+
+  alignas(std::max_align_t) unsigned char buf_[INLINE_BYTES];
+  const Ops *ops_ = nullptr;
+};
+
+// Chase-Lev deque. the owner thread pushes and pops at the bottom, other
+// threads steal from the top. the ring grows on demand, retired rings are
+// kept until the deque is destroyed since a thief may still read them.
+class WorkStealingDeque {
+ public:
+  explicit WorkStealingDeque(int64_t capacity = 256);
+  ~WorkStealingDeque();
+  WorkStealingDeque(const WorkStealingDeque &) = delete;
+  WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  void push(Task *task);  // owner only
+  Task *pop();            // owner only, nullptr if empty
+  Task *steal();          // any thread, nullptr if empty or lost the race
+  bool empty() const {
+    return bottom_.load(std::memory_order_relaxed) <=
+           top_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Ring {
+    explicit Ring(int64_t cap)
+        : capacity(cap), slots(new std::atomic<Task *>[cap]) {}
+    Task *get(int64_t i) const {
+      return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+    void put(int64_t i, Task *t) {
+      slots[i & (capacity - 1)].store(t, std::memory_order_relaxed);
+    }
+    int64_t capacity;  // power of 2
+    std::unique_ptr<std::atomic<Task *>[]> slots;
+  };
+  Ring *grow(Ring *ring, int64_t bottom, int64_t top);
+
+  alignas(64) std::atomic<int64_t> top_{0};
+  alignas(64) std::atomic<int64_t> bottom_{0};
+  std::atomic<Ring *> ring_;
+  std::vector<std::unique_ptr<Ring>> rings_;  // current and retired rings
+};
+
+// Work-stealing thread pool. each worker owns a deque: tasks enqueued by a
+// worker go to its own deque, tasks enqueued by other threads go to a shared
+// injection queue, and idle workers steal from each other before sleeping.
+// tasks left in the pool are still run on destruction. an exception thrown
+// by a task is kept for wait(), it doesn't take the worker down.
 class ThreadPool {
  public:
   ThreadPool() = default;
-  ThreadPool(ThreadPool &&) = default;
+  ThreadPool(ThreadPool &&other) noexcept;
   explicit ThreadPool(size_t thread_num);
   ~ThreadPool();
 
   template <typename F, typename... Args>
   void enqueue(F &&f, Args &&... args) {
-    auto task = std::make_shared<std::packaged_task<void()>>(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-    {
-      std::lock_guard<std::mutex> lk(ctx_->mtx);
-      ctx_->tasks.emplace([task]() { (*task)(); });
-    }
-    ctx_->cond.notify_all();
+    auto bound = std::make_tuple(std::forward<Args>(args)...);
+    submit(Task([fn = std::forward<F>(f), bound = std::move(bound)]() mutable {
+      std::apply(fn, bound);
+    }));
   }
 
+  size_t size() const { return ctx_ == nullptr ? 0 : ctx_->workers.size(); }
+
+  // block until every task enqueued so far is done, then rethrow the first
+  // exception thrown by a task since the last wait(). not on a worker.
+  void wait();
+
+  // pool of the calling worker thread, nullptr if not a worker.
+  static ThreadPool *current();
+
  private:
+  struct Worker {
+    WorkStealingDeque deque;
+    std::thread thread;
+  };
   struct Context {
-    std::mutex mtx;
+    std::mutex mtx;  // guards injection, sleeping and error
     std::condition_variable cond;
-    bool is_shutdown = false;
-    std::queue<std::function<void()>> tasks;
-    std::vector<std::thread> workers;
+    std::deque<Task *> injection;
+    std::atomic<int64_t> pending{0};  // tasks enqueued but not taken yet
+    std::atomic<int64_t> unfinished{0};  // tasks enqueued but not done yet
+    std::condition_variable done;        // unfinished reached 0
+    std::exception_ptr error = nullptr;  // first exception of a task
+    std::atomic<int64_t> sleepers{0};
+    std::atomic<bool> is_shutdown{false};
+    std::vector<std::unique_ptr<Worker>> workers;
+    ThreadPool *owner = nullptr;
   };
+
+  void submit(Task &&task);
+  static Task *takeTask(Context *ctx, int64_t self);
+  static void runTask(Context *ctx, Task *task);
+  static void workerLoop(std::shared_ptr<Context> ctx, int64_t self);
+
   std::shared_ptr<Context> ctx_ = nullptr;
 };
 
+// call func(begin, end) on sub ranges of [begin, end) of about grain items.
+// on a pool worker the ranges are spread over that pool: idle workers pick
+// them up, the caller works on them too, then waits for the ones still
+// running elsewhere. the caller never runs other tasks of the pool, so a
+// loop inside a case doesn't run another case. elsewhere it runs serially.
+// the first exception thrown by func is rethrown on the caller.
+void parallelFor(size_t begin, size_t end, size_t grain,
+                 const std::function<void(size_t, size_t)> &func,
+                 ThreadPool *pool = ThreadPool::current());
+
 }  // namespace mluoptest
 
 #endif  // TEST_MLU_OP_GTEST_INCLUDE_THREAD_POOL_H_
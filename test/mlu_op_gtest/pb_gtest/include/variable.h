@@ -44,6 +44,9 @@ class GlobalVar {
   std::string cases_list_ = "";
   std::string case_path_ = "";
   std::string get_vmpeak_ = "";
+  std::string case_history_ = "";  // busy time of cases, for scheduling.
+  std::string minimize_dir_ = "";  // shrink failing cases into this dir.
+  std::string stream_result_ = "";  // append results here as tests end.
   TestSummary summary_;
   TestInternalInfo internal_info_;
 
@@ -54,6 +57,7 @@ class GlobalVar {
                      // ave hw_time
   int thread_num_ = 1;    // thread num
   bool shuffle_ = false;  // shuffle cases.
+  bool resume_ = false;   // skip tests already in stream_result_.
   unsigned int half2float_algo_ = getEnvInt(
       "MLUOP_GTEST_EXPERIMENT_HALF2FLOAT_ALGO",
       AlgoHalfToFloat::CPU_INTRINSIC);  // half2float algorithm selection
@@ -0,0 +1,380 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "baseline_cache.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "tools.h"
+
+namespace mluoptest {
+
+namespace {
+const uint64_t PRIME1 = 11400714785074694791ULL;
+const uint64_t PRIME2 = 14029467366897019727ULL;
+const uint64_t PRIME3 = 1609587929392839161ULL;
+const uint64_t PRIME4 = 9650029242287828579ULL;
+const uint64_t PRIME5 = 2870177450012600261ULL;
+const char ENTRY_MAGIC[8] = {'M', 'L', 'U', 'O', 'P', 'B', 'C', '1'};
+// evict down to this ratio of capacity, so one store does not trigger
+// a directory scan every time.
+const double EVICT_LOW_WATER = 0.9;
+
+struct EntryHeader {
+  char magic[8];
+  uint64_t key_hi;
+  uint64_t key_lo;
+  uint64_t output_num;
+};
+
+struct EntryFile {
+  std::string path;
+  int64_t mtime_ns;
+  size_t size;
+};
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t round64(uint64_t acc, uint64_t input) {
+  acc += input * PRIME2;
+  acc = rotl(acc, 31);
+  return acc * PRIME1;
+}
+
+inline uint64_t avalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= PRIME2;
+  h ^= h >> 29;
+  h *= PRIME3;
+  h ^= h >> 32;
+  return h;
+}
+
+bool endsWith(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::vector<std::string> listDir(const std::string &dir) {
+  std::vector<std::string> names;
+  DIR *d = opendir(dir.c_str());
+  if (d == nullptr) {
+    return names;
+  }
+  struct dirent *ent = nullptr;
+  while ((ent = readdir(d)) != nullptr) {
+    std::string name = ent->d_name;
+    if (name != "." && name != "..") {
+      names.push_back(name);
+    }
+  }
+  closedir(d);
+  return names;
+}
+
+std::vector<EntryFile> listEntries(const std::string &dir) {
+  std::vector<EntryFile> entries;
+  for (const auto &sub : listDir(dir)) {
+    std::string sub_dir = dir + "/" + sub;
+    for (const auto &name : listDir(sub_dir)) {
+      if (!endsWith(name, ".bin")) {
+        continue;
+      }
+      std::string path = sub_dir + "/" + name;
+      struct stat st;
+      if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        int64_t mtime_ns =
+            (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        entries.push_back({path, mtime_ns, (size_t)st.st_size});
+      }
+    }
+  }
+  return entries;
+}
+
+bool makeDir(const std::string &dir) {
+  return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+}
+}  // namespace
+
+std::string BaselineCacheKey::hex() const {
+  char buf[33];
+  snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)hi,
+           (unsigned long long)lo);
+  return std::string(buf);
+}
+
+BaselineHasher::BaselineHasher(uint64_t seed) {
+  lane_[0] = seed + PRIME1 + PRIME2;
+  lane_[1] = seed + PRIME2;
+  lane_[2] = seed;
+  lane_[3] = seed - PRIME1;
+}
+
+void BaselineHasher::consumeStripe(const unsigned char *stripe) {
+  for (int i = 0; i < 4; ++i) {
+    uint64_t v;
+    memcpy(&v, stripe + i * 8, sizeof(v));
+    lane_[i] = round64(lane_[i], v);
+  }
+}
+
+void BaselineHasher::update(const void *data, size_t size) {
+  const unsigned char *p = (const unsigned char *)data;
+  total_size_ += size;
+  if (tail_size_ > 0) {
+    size_t fill = std::min(size, sizeof(tail_) - tail_size_);
+    memcpy(tail_ + tail_size_, p, fill);
+    tail_size_ += fill;
+    p += fill;
+    size -= fill;
+    if (tail_size_ < sizeof(tail_)) {
+      return;
+    }
+    consumeStripe(tail_);
+    tail_size_ = 0;
+  }
+  for (; size >= sizeof(tail_); p += sizeof(tail_), size -= sizeof(tail_)) {
+    consumeStripe(p);
+  }
+  memcpy(tail_, p, size);
+  tail_size_ = size;
+}
+
+BaselineCacheKey BaselineHasher::digest() const {
+  BaselineHasher h = *this;
+  if (h.tail_size_ > 0) {
+    memset(h.tail_ + h.tail_size_, 0, sizeof(h.tail_) - h.tail_size_);
+    h.consumeStripe(h.tail_);
+  }
+  const uint64_t *v = h.lane_;
+  BaselineCacheKey key;
+  key.hi = avalanche((rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) +
+                      rotl(v[3], 18)) ^
+                     (total_size_ * PRIME5));
+  key.lo = avalanche((rotl(v[0], 18) ^ rotl(v[1], 12)) +
+                     (rotl(v[2], 7) ^ rotl(v[3], 1)) + total_size_ * PRIME4);
+  return key;
+}
+
+BaselineCache::BaselineCache(const std::string &dir, size_t capacity_bytes,
+                             int verify_percent)
+    : dir_(dir),
+      capacity_bytes_(capacity_bytes),
+      verify_percent_(verify_percent) {}
+
+BaselineCache *BaselineCache::instance() {
+  static BaselineCache *cache = []() -> BaselineCache * {
+    const char *dir = std::getenv("MLUOP_GTEST_BASELINE_CACHE_DIR");
+    if (dir == nullptr || dir[0] == '\0') {
+      return nullptr;
+    }
+    if (!makeDir(dir)) {
+      LOG(WARNING) << "BaselineCache: failed to create " << dir
+                   << ", baseline cache disabled.";
+      return nullptr;
+    }
+    size_t capacity_mb =
+        (size_t)std::max(getEnvInt("MLUOP_GTEST_BASELINE_CACHE_MB", 10240), 0);
+    int verify = getEnvInt("MLUOP_GTEST_BASELINE_CACHE_VERIFY", 0);
+    return new BaselineCache(dir, capacity_mb << 20, verify);
+  }();
+  return cache;
+}
+
+std::string BaselineCache::entryPath(const BaselineCacheKey &key) const {
+  std::string hex = key.hex();
+  return dir_ + "/" + hex.substr(0, 2) + "/" + hex + ".bin";
+}
+
+bool BaselineCache::needVerify(const BaselineCacheKey &key) const {
+  return verify_percent_ > 0 && (int)(key.lo % 100) < verify_percent_;
+}
+
+bool BaselineCache::load(const BaselineCacheKey &key,
+                         const std::vector<BaselineBuffer> &outputs) {
+  std::string path = entryPath(key);
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool ok = true;
+  EntryHeader header;
+  ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+       memcmp(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) == 0 &&
+       header.key_hi == key.hi && header.key_lo == key.lo &&
+       header.output_num == outputs.size();
+  for (size_t i = 0; ok && i < outputs.size(); ++i) {
+    uint64_t size = 0;
+    ok = fread(&size, sizeof(size), 1, fp) == 1 && size == outputs[i].size;
+  }
+  BaselineHasher checksum;
+  for (size_t i = 0; ok && i < outputs.size(); ++i) {
+    if (outputs[i].size == 0) {
+      continue;
+    }
+    ok = fread(outputs[i].ptr, 1, outputs[i].size, fp) == outputs[i].size;
+    checksum.update(outputs[i].ptr, outputs[i].size);
+  }
+  BaselineCacheKey expect;
+  ok = ok && fread(&expect.hi, sizeof(expect.hi), 1, fp) == 1 &&
+       fread(&expect.lo, sizeof(expect.lo), 1, fp) == 1 &&
+       expect == checksum.digest();
+  fclose(fp);
+  if (!ok) {
+    // key collision with a different output layout, or a truncated entry.
+    LOG(WARNING) << "BaselineCache: drop invalid entry " << path;
+    drop(key);
+    return false;
+  }
+  utime(path.c_str(), nullptr);  // mark as recently used
+  return true;
+}
+
+void BaselineCache::store(const BaselineCacheKey &key,
+                          const std::vector<BaselineBuffer> &outputs) {
+  static std::atomic<uint64_t> tmp_seq(0);
+  std::string path = entryPath(key);
+  std::string sub_dir = path.substr(0, path.rfind('/'));
+  if (!makeDir(sub_dir)) {
+    LOG(WARNING) << "BaselineCache: failed to create " << sub_dir;
+    return;
+  }
+  std::string tmp = path + ".tmp." + std::to_string(getpid()) + "." +
+                    std::to_string(tmp_seq++);
+  FILE *fp = fopen(tmp.c_str(), "wb");
+  if (fp == nullptr) {
+    LOG(WARNING) << "BaselineCache: failed to write " << tmp;
+    return;
+  }
+  EntryHeader header;
+  memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+  header.key_hi = key.hi;
+  header.key_lo = key.lo;
+  header.output_num = outputs.size();
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  for (const auto &out : outputs) {
+    uint64_t size = out.size;
+    ok = ok && fwrite(&size, sizeof(size), 1, fp) == 1;
+  }
+  BaselineHasher checksum;
+  for (const auto &out : outputs) {
+    if (out.size == 0) {
+      continue;
+    }
+    ok = ok && fwrite(out.ptr, 1, out.size, fp) == out.size;
+    checksum.update(out.ptr, out.size);
+  }
+  BaselineCacheKey sum = checksum.digest();
+  ok = ok && fwrite(&sum.hi, sizeof(sum.hi), 1, fp) == 1 &&
+       fwrite(&sum.lo, sizeof(sum.lo), 1, fp) == 1;
+  ok = (fclose(fp) == 0) && ok;
+  struct stat st;
+  ok = ok && stat(tmp.c_str(), &st) == 0;
+  if (!ok) {
+    LOG(WARNING) << "BaselineCache: failed to write " << tmp;
+    std::remove(tmp.c_str());
+    return;
+  }
+
+  std::lock_guard<std::mutex> lk(mtx_);
+  scanLocked();
+  struct stat old_st;
+  if (stat(path.c_str(), &old_st) == 0) {
+    total_bytes_ -= std::min(total_bytes_, (size_t)old_st.st_size);
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "BaselineCache: failed to save " << path;
+    std::remove(tmp.c_str());
+    return;
+  }
+  total_bytes_ += st.st_size;
+  if (total_bytes_ > capacity_bytes_) {
+    evictLocked(path);
+  }
+}
+
+void BaselineCache::drop(const BaselineCacheKey &key) {
+  std::string path = entryPath(key);
+  std::lock_guard<std::mutex> lk(mtx_);
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0 && std::remove(path.c_str()) == 0 &&
+      scanned_) {
+    total_bytes_ -= std::min(total_bytes_, (size_t)st.st_size);
+  }
+}
+
+size_t BaselineCache::totalBytes() {
+  std::lock_guard<std::mutex> lk(mtx_);
+  scanLocked();
+  return total_bytes_;
+}
+
+// the size of entries written by other processes sharing this dir is only
+// picked up by the next eviction scan.
+void BaselineCache::scanLocked() {
+  if (scanned_) {
+    return;
+  }
+  total_bytes_ = 0;
+  for (const auto &entry : listEntries(dir_)) {
+    total_bytes_ += entry.size;
+  }
+  scanned_ = true;
+}
+
+void BaselineCache::evictLocked(const std::string &keep) {
+  std::vector<EntryFile> entries = listEntries(dir_);
+  std::sort(entries.begin(), entries.end(),
+            [](const EntryFile &a, const EntryFile &b) {
+              return a.mtime_ns < b.mtime_ns;
+            });
+  size_t total = 0;
+  for (const auto &entry : entries) {
+    total += entry.size;
+  }
+  size_t low_water = (size_t)(capacity_bytes_ * EVICT_LOW_WATER);
+  size_t evicted = 0;
+  for (const auto &entry : entries) {
+    if (total <= low_water) {
+      break;
+    }
+    if (entry.path != keep && std::remove(entry.path.c_str()) == 0) {
+      total -= entry.size;
+      evicted++;
+    }
+  }
+  total_bytes_ = total;
+  VLOG(4) << "BaselineCache: evicted " << evicted << " entries, "
+          << total_bytes_ << " bytes left.";
+}
+
+}  // namespace mluoptest
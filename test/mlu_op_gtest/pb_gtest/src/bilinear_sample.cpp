@@ -0,0 +1,227 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "bilinear_sample.h"
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#include <cmath>
+
+namespace mluoptest {
+
+namespace {
+
+// one simd register of floats. There is no fma on purpose: a fused
+// multiply-add rounds once where the scalar formulas round twice.
+struct Simd {
+  typedef float reg;
+  static const int lanes = 1;
+  static reg load(const float *p) { return *p; }
+  static void store(float *p, reg v) { *p = v; }
+  static reg set1(float v) { return v; }
+  static reg zero() { return 0.0f; }
+  static reg mul(reg a, reg b) { return a * b; }
+  static reg div(reg a, reg b) { return a / b; }
+  static reg add(reg a, reg b) { return a + b; }
+};
+
+#if defined(__AVX512F__)
+struct SimdVec {
+  typedef __m512 reg;
+  static const int lanes = 16;
+  static reg load(const float *p) { return _mm512_loadu_ps(p); }
+  static void store(float *p, reg v) { _mm512_storeu_ps(p, v); }
+  static reg set1(float v) { return _mm512_set1_ps(v); }
+  static reg zero() { return _mm512_setzero_ps(); }
+  static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+  static reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+  static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+};
+#elif defined(__AVX2__)
+struct SimdVec {
+  typedef __m256 reg;
+  static const int lanes = 8;
+  static reg load(const float *p) { return _mm256_loadu_ps(p); }
+  static void store(float *p, reg v) { _mm256_storeu_ps(p, v); }
+  static reg set1(float v) { return _mm256_set1_ps(v); }
+  static reg zero() { return _mm256_setzero_ps(); }
+  static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+  static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+  static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+};
+#else
+typedef Simd SimdVec;
+#endif
+
+// w1 * v1 + w2 * v2 + w3 * v3 + w4 * v4 of the lanes at channel c.
+template <typename S>
+inline typename S::reg interpolate(const float *data,
+                                   const BilinearSample &sample,
+                                   const typename S::reg *w, int64_t c) {
+  typename S::reg sum = S::zero();
+  for (int i = 0; i < 4; ++i) {
+    typename S::reg v =
+        sample.offset[i] >= 0 ? S::load(data + sample.offset[i] + c)
+                              : S::zero();
+    v = S::mul(w[i], v);
+    sum = i == 0 ? v : S::add(sum, v);
+  }
+  return sum;
+}
+
+// runs the channels [begin, end) of a gather, lanes at a time, and returns
+// where it stopped.
+template <typename S>
+int64_t gather(const float *data, const BilinearSample &sample, int64_t begin,
+               int64_t end, bool accumulate, float scale, float *out) {
+  typename S::reg w[4];
+  for (int i = 0; i < 4; ++i) w[i] = S::set1(sample.weight[i]);
+  const typename S::reg s = S::set1(scale);
+  int64_t c = begin;
+  for (; c + S::lanes <= end; c += S::lanes) {
+    typename S::reg value = interpolate<S>(data, sample, w, c);
+    if (accumulate) {
+      value = S::add(S::load(out + c), S::mul(value, s));
+    }
+    S::store(out + c, value);
+  }
+  return c;
+}
+
+template <typename S>
+int64_t scatter(float *data, int64_t offset, float weight, int64_t begin,
+                int64_t end, const float *grad, float divisor) {
+  const typename S::reg w = S::set1(weight);
+  const typename S::reg d = S::set1(divisor);
+  int64_t c = begin;
+  for (; c + S::lanes <= end; c += S::lanes) {
+    float *p = data + offset + c;
+    S::store(p, S::add(S::load(p), S::div(S::mul(S::load(grad + c), w), d)));
+  }
+  return c;
+}
+
+template <typename S>
+int64_t axpy(const float *in, float weight, int64_t begin, int64_t end,
+             float *out) {
+  const typename S::reg w = S::set1(weight);
+  int64_t c = begin;
+  for (; c + S::lanes <= end; c += S::lanes) {
+    S::store(out + c, S::add(S::load(out + c), S::mul(S::load(in + c), w)));
+  }
+  return c;
+}
+
+}  // namespace
+
+bool bilinearSampleClamped(int height, int width, int64_t pixel_stride,
+                           float y, float x, BilinearSample *sample) {
+  if (y < -1.0 || y > height || x < -1.0 || x > width) {
+    return false;
+  }
+  if (y <= 0) y = 0;
+  if (x <= 0) x = 0;
+  int y_low = (int)y;
+  int x_low = (int)x;
+  int y_high, x_high;
+  if (y_low >= height - 1) {
+    y_high = y_low = height - 1;
+    y = (float)y_low;
+  } else {
+    y_high = y_low + 1;
+  }
+  if (x_low >= width - 1) {
+    x_high = x_low = width - 1;
+    x = (float)x_low;
+  } else {
+    x_high = x_low + 1;
+  }
+  float ly = y - y_low, lx = x - x_low;
+  float hy = 1. - ly, hx = 1. - lx;
+  sample->offset[0] = ((int64_t)y_low * width + x_low) * pixel_stride;
+  sample->offset[1] = ((int64_t)y_low * width + x_high) * pixel_stride;
+  sample->offset[2] = ((int64_t)y_high * width + x_low) * pixel_stride;
+  sample->offset[3] = ((int64_t)y_high * width + x_high) * pixel_stride;
+  sample->weight[0] = hy * hx;
+  sample->weight[1] = hy * lx;
+  sample->weight[2] = ly * hx;
+  sample->weight[3] = ly * lx;
+  return true;
+}
+
+void bilinearSampleZeroPad(int height, int width, int64_t pixel_stride,
+                           float y, float x, BilinearSample *sample) {
+  const int y_low = floorf(y);
+  const int x_low = floorf(x);
+  const int y_high = y_low + 1;
+  const int x_high = x_low + 1;
+  const float ly = y - y_low;
+  const float lx = x - x_low;
+  const float hy = 1 - ly, hx = 1 - lx;
+  const bool top = y_low >= 0 && y_low <= height - 1;
+  const bool bottom = y_high >= 0 && y_high <= height - 1;
+  const bool left = x_low >= 0 && x_low <= width - 1;
+  const bool right = x_high >= 0 && x_high <= width - 1;
+  sample->offset[0] =
+      top && left ? ((int64_t)y_low * width + x_low) * pixel_stride : -1;
+  sample->offset[1] =
+      top && right ? ((int64_t)y_low * width + x_high) * pixel_stride : -1;
+  sample->offset[2] =
+      bottom && left ? ((int64_t)y_high * width + x_low) * pixel_stride : -1;
+  sample->offset[3] =
+      bottom && right ? ((int64_t)y_high * width + x_high) * pixel_stride : -1;
+  sample->weight[0] = hy * hx;
+  sample->weight[1] = hy * lx;
+  sample->weight[2] = ly * hx;
+  sample->weight[3] = ly * lx;
+}
+
+void bilinearGather(const float *data, const BilinearSample &sample,
+                    int64_t channels, float *value) {
+  int64_t c = gather<SimdVec>(data, sample, 0, channels, false, 1, value);
+  gather<Simd>(data, sample, c, channels, false, 1, value);
+}
+
+void bilinearGatherAdd(const float *data, const BilinearSample &sample,
+                       int64_t channels, float scale, float *out) {
+  int64_t c = gather<SimdVec>(data, sample, 0, channels, true, scale, out);
+  gather<Simd>(data, sample, c, channels, true, scale, out);
+}
+
+void bilinearScatterAdd(float *data, const BilinearSample &sample,
+                        int64_t channels, const float *grad, float divisor) {
+  // corner after corner, for corners may fall on the same pixel.
+  for (int i = 0; i < 4; ++i) {
+    if (sample.offset[i] < 0) continue;
+    int64_t c = scatter<SimdVec>(data, sample.offset[i], sample.weight[i], 0,
+                                 channels, grad, divisor);
+    scatter<Simd>(data, sample.offset[i], sample.weight[i], c, channels, grad,
+                  divisor);
+  }
+}
+
+void weightedAdd(const float *in, float weight, int64_t channels, float *out) {
+  int64_t c = axpy<SimdVec>(in, weight, 0, channels, out);
+  axpy<Simd>(in, weight, c, channels, out);
+}
+
+}  // namespace mluoptest
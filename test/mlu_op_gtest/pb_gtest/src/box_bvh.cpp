@@ -0,0 +1,208 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "box_bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace mluoptest {
+
+namespace {
+
+const int BVH_LEAF_SIZE = 4;
+
+// points bucketed by one task of pointsPerBox.
+const int BUCKET_CHUNK = 4096;
+
+inline bool finitePoint(const float *p) {
+  return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+}
+
+}  // namespace
+
+BoxBvh::BoxBvh(const float *lo, const float *hi, int num)
+    : lo_(lo, lo + num * 3), hi_(hi, hi + num * 3), ids_(num) {
+  // split by box centers, a box unbounded on both sides sorts at 0.
+  std::vector<float> centers(num * 3);
+  for (int i = 0; i < num * 3; ++i) {
+    float center = lo[i] / 2 + hi[i] / 2;
+    centers[i] = std::isnan(center) ? 0 : center;
+  }
+  for (int i = 0; i < num; ++i) {
+    ids_[i] = i;
+  }
+  if (num > 0) {
+    nodes_.reserve(2 * num / BVH_LEAF_SIZE + 1);
+    build(centers, 0, num);
+  }
+}
+
+int BoxBvh::build(const std::vector<float> &centers, int begin, int end) {
+  Node node;
+  node.begin = begin;
+  node.end = end;
+  node.left = node.right = -1;
+  float center_lo[3], center_hi[3];
+  for (int a = 0; a < 3; ++a) {
+    node.lo[a] = center_lo[a] = INFINITY;
+    node.hi[a] = center_hi[a] = -INFINITY;
+  }
+  for (int i = begin; i < end; ++i) {
+    const int id = ids_[i];
+    for (int a = 0; a < 3; ++a) {
+      // std::min keeps the first argument against a nan bound.
+      node.lo[a] = std::min(node.lo[a], lo_[id * 3 + a]);
+      node.hi[a] = std::max(node.hi[a], hi_[id * 3 + a]);
+      center_lo[a] = std::min(center_lo[a], centers[id * 3 + a]);
+      center_hi[a] = std::max(center_hi[a], centers[id * 3 + a]);
+    }
+  }
+  const int index = nodes_.size();
+  nodes_.push_back(node);
+  if (end - begin > BVH_LEAF_SIZE) {
+    // split at the median center of the axis where centers spread most.
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) {
+      if (center_hi[a] - center_lo[a] > center_hi[axis] - center_lo[axis]) {
+        axis = a;
+      }
+    }
+    const int mid = begin + (end - begin) / 2;
+    std::nth_element(ids_.begin() + begin, ids_.begin() + mid,
+                     ids_.begin() + end, [&](int x, int y) {
+                       return centers[x * 3 + axis] < centers[y * 3 + axis];
+                     });
+    const int left = build(centers, begin, mid);
+    const int right = build(centers, mid, end);
+    nodes_[index].left = left;
+    nodes_[index].right = right;
+  }
+  return index;
+}
+
+void BoxBvh::query(const float *point, std::vector<int> *ids) const {
+  ids->clear();
+  if (nodes_.empty()) {
+    return;
+  }
+  auto holds = [&](const float *lo, const float *hi) {
+    return lo[0] <= point[0] && point[0] <= hi[0] && lo[1] <= point[1] &&
+           point[1] <= hi[1] && lo[2] <= point[2] && point[2] <= hi[2];
+  };
+  int stack[128];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node &node = nodes_[stack[--top]];
+    if (!holds(node.lo, node.hi)) {
+      continue;
+    }
+    if (node.left >= 0) {
+      stack[top++] = node.right;
+      stack[top++] = node.left;
+      continue;
+    }
+    for (int i = node.begin; i < node.end; ++i) {
+      const int id = ids_[i];
+      if (holds(&lo_[id * 3], &hi_[id * 3])) {
+        ids->push_back(id);
+      }
+    }
+  }
+}
+
+void BoxBvh::pointsPerBox(const float *xyz, int num_points,
+                          std::vector<std::vector<int>> *box_points) const {
+  const int num_boxes = lo_.size() / 3;
+  const int chunks = (num_points + BUCKET_CHUNK - 1) / BUCKET_CHUNK;
+  // (box, point) pairs of each chunk, merged in chunk order so the lists
+  // stay ascending.
+  std::vector<std::vector<std::pair<int, int>>> pairs(chunks);
+#pragma omp parallel
+  {
+    std::vector<int> ids;
+#pragma omp for schedule(dynamic)
+    for (int c = 0; c < chunks; ++c) {
+      const int end = std::min(num_points, (c + 1) * BUCKET_CHUNK);
+      for (int i = c * BUCKET_CHUNK; i < end; ++i) {
+        if (finitePoint(xyz + i * 3)) {
+          query(xyz + i * 3, &ids);
+          for (int id : ids) {
+            pairs[c].emplace_back(id, i);
+          }
+        } else {
+          for (int id = 0; id < num_boxes; ++id) {
+            pairs[c].emplace_back(id, i);
+          }
+        }
+      }
+    }
+  }
+  std::vector<int> counts(num_boxes, 0);
+  for (const auto &chunk : pairs) {
+    for (const auto &pair : chunk) {
+      ++counts[pair.first];
+    }
+  }
+  box_points->assign(num_boxes, std::vector<int>());
+  for (int id = 0; id < num_boxes; ++id) {
+    (*box_points)[id].reserve(counts[id]);
+  }
+  for (const auto &chunk : pairs) {
+    for (const auto &pair : chunk) {
+      (*box_points)[pair.first].push_back(pair.second);
+    }
+  }
+}
+
+void rotatedBoxBounds(float cx, float cy, float cz, float dx, float dy,
+                      float dz, float rz, float margin, float *lo,
+                      float *hi) {
+  const float params[] = {cx, cy, cz, dx, dy, dz, rz, margin};
+  if (!std::all_of(params, params + 8,
+                   [](float v) { return std::isfinite(v); })) {
+    std::fill(lo, lo + 3, -INFINITY);
+    std::fill(hi, hi + 3, INFINITY);
+    return;
+  }
+  const double half_x = std::fabs(dx) / 2.0 + std::fabs(margin);
+  const double half_y = std::fabs(dy) / 2.0 + std::fabs(margin);
+  const double half_z = std::fabs(dz) / 2.0 + std::fabs(margin);
+  const double cosa = std::fabs(std::cos((double)rz));
+  const double sina = std::fabs(std::sin((double)rz));
+  const double extent[] = {cosa * half_x + sina * half_y,
+                           sina * half_x + cosa * half_y, half_z};
+  const double center[] = {cx, cy, cz};
+  // the tests round the shift from the center and the rotation in float,
+  // and the bounds are stored in float.
+  const double pad = 1e-4 * (extent[0] + extent[1] + extent[2]) +
+                     1e-5 * (std::fabs(center[0]) + std::fabs(center[1]) +
+                             std::fabs(center[2])) +
+                     1e-5;
+  for (int a = 0; a < 3; ++a) {
+    lo[a] = center[a] - extent[a] - pad;
+    hi[a] = center[a] + extent[a] + pad;
+  }
+}
+
+}  // namespace mluoptest
@@ -0,0 +1,157 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "box_grid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace mluoptest {
+
+namespace {
+
+// a box covering more cells than this goes to the large list.
+const int64_t MAX_CELLS_PER_BOX = 64;
+
+inline float padded(float v, float sign) {
+  return v + sign * 1e-5f * std::fabs(v);
+}
+
+// median of v, v is reordered.
+float median(std::vector<float> *v) {
+  auto mid = v->begin() + v->size() / 2;
+  std::nth_element(v->begin(), mid, v->end());
+  return *mid;
+}
+
+}  // namespace
+
+BoxGrid::BoxGrid(const float *x1, const float *y1, const float *x2,
+                 const float *y2, int num)
+    : x1_(num), y1_(num), x2_(num), y2_(num), stamp_(num, 0) {
+  float min_x = INFINITY, min_y = INFINITY;
+  float max_x = -INFINITY, max_y = -INFINITY;
+  std::vector<float> widths, heights;
+  widths.reserve(num);
+  heights.reserve(num);
+  for (int i = 0; i < num; ++i) {
+    x1_[i] = padded(std::min(x1[i], x2[i]), -1);
+    y1_[i] = padded(std::min(y1[i], y2[i]), -1);
+    x2_[i] = padded(std::max(x1[i], x2[i]), 1);
+    y2_[i] = padded(std::max(y1[i], y2[i]), 1);
+    if (std::isfinite(x1_[i]) && std::isfinite(y1_[i]) &&
+        std::isfinite(x2_[i]) && std::isfinite(y2_[i])) {
+      min_x = std::min(min_x, x1_[i]);
+      min_y = std::min(min_y, y1_[i]);
+      max_x = std::max(max_x, x2_[i]);
+      max_y = std::max(max_y, y2_[i]);
+      widths.push_back(x2_[i] - x1_[i]);
+      heights.push_back(y2_[i] - y1_[i]);
+    }
+  }
+  if (widths.empty()) {
+    return;
+  }
+  // about one cell per box, and cells no smaller than the median box, so a
+  // typical box lands in at most 4 cells.
+  const float span_x = max_x - min_x, span_y = max_y - min_y;
+  const int64_t max_cells = 4 * (int64_t)widths.size() + 16;
+  float cell_w = std::max(median(&widths), span_x / 1024);
+  float cell_h = std::max(median(&heights), span_y / 1024);
+  nx_ = cell_w > 0 ? std::min(1024, (int)std::ceil(span_x / cell_w)) : 1;
+  ny_ = cell_h > 0 ? std::min(1024, (int)std::ceil(span_y / cell_h)) : 1;
+  nx_ = std::max(nx_, 1);
+  ny_ = std::max(ny_, 1);
+  while ((int64_t)nx_ * ny_ > max_cells) {
+    if (nx_ >= ny_) {
+      nx_ = (nx_ + 1) / 2;
+    } else {
+      ny_ = (ny_ + 1) / 2;
+    }
+  }
+  origin_x_ = min_x;
+  origin_y_ = min_y;
+  inv_cell_w_ = span_x > 0 ? nx_ / span_x : 0;
+  inv_cell_h_ = span_y > 0 ? ny_ / span_y : 0;
+  cells_.resize((size_t)nx_ * ny_);
+}
+
+bool BoxGrid::cellRange(int id, int *cx1, int *cy1, int *cx2,
+                        int *cy2) const {
+  if (!(std::isfinite(x1_[id]) && std::isfinite(y1_[id]) &&
+        std::isfinite(x2_[id]) && std::isfinite(y2_[id])) ||
+      cells_.empty()) {
+    return false;
+  }
+  auto cell = [](float v, float origin, float inv, int n) {
+    float c = (v - origin) * inv;
+    return (int)std::min(std::max(c, 0.0f), n - 1.0f);
+  };
+  *cx1 = cell(x1_[id], origin_x_, inv_cell_w_, nx_);
+  *cx2 = cell(x2_[id], origin_x_, inv_cell_w_, nx_);
+  *cy1 = cell(y1_[id], origin_y_, inv_cell_h_, ny_);
+  *cy2 = cell(y2_[id], origin_y_, inv_cell_h_, ny_);
+  return (int64_t)(*cx2 - *cx1 + 1) * (*cy2 - *cy1 + 1) <= MAX_CELLS_PER_BOX;
+}
+
+void BoxGrid::insert(int id) {
+  int cx1, cy1, cx2, cy2;
+  if (!cellRange(id, &cx1, &cy1, &cx2, &cy2)) {
+    large_.push_back(id);
+    return;
+  }
+  for (int cy = cy1; cy <= cy2; ++cy) {
+    for (int cx = cx1; cx <= cx2; ++cx) {
+      cells_[(size_t)cy * nx_ + cx].push_back(id);
+    }
+  }
+}
+
+void BoxGrid::query(int id, std::vector<int> *ids) {
+  ids->clear();
+  if (++query_count_ == 0) {
+    std::fill(stamp_.begin(), stamp_.end(), 0);
+    query_count_ = 1;
+  }
+  ids->insert(ids->end(), large_.begin(), large_.end());
+  int cx1, cy1, cx2, cy2;
+  if (!cellRange(id, &cx1, &cy1, &cx2, &cy2)) {
+    // a box with non-finite or huge bounds is compared with everything.
+    cx1 = cy1 = 0;
+    cx2 = nx_ - 1;
+    cy2 = ny_ - 1;
+    if (cells_.empty()) {
+      return;
+    }
+  }
+  for (int cy = cy1; cy <= cy2; ++cy) {
+    for (int cx = cx1; cx <= cx2; ++cx) {
+      for (int other : cells_[(size_t)cy * nx_ + cx]) {
+        if (stamp_[other] != query_count_) {
+          stamp_[other] = query_count_;
+          ids->push_back(other);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace mluoptest
@@ -0,0 +1,392 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "case_archive.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <google/protobuf/io/gzip_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+namespace mluoptest {
+
+const char *const CaseArchive::SUFFIX = ".pbpack";
+
+namespace {
+const char FOOTER_MAGIC[8] = {'M', 'L', 'U', 'O', 'P', 'P', 'K', '1'};
+
+struct Footer {
+  char magic[8];
+  uint64_t index_offset;
+  uint64_t index_size;
+  uint64_t entry_num;
+  uint64_t index_checksum;
+};
+
+inline void setError(std::string *error, const std::string &msg) {
+  if (error != nullptr) {
+    *error = msg;
+  }
+}
+
+uint64_t fnv1a(const std::string &data) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : data) {
+    hash = (hash ^ c) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool writeAll(int fd, const void *data, size_t size) {
+  const char *p = (const char *)data;
+  while (size > 0) {
+    ssize_t n = ::write(fd, p, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool preadAll(int fd, void *data, size_t size, uint64_t offset) {
+  char *p = (char *)data;
+  while (size > 0) {
+    ssize_t n = ::pread(fd, p, size, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+template <typename T>
+void putPod(std::string *out, T value) {
+  out->append((const char *)&value, sizeof(value));
+}
+
+void putString(std::string *out, const std::string &value) {
+  putPod<uint32_t>(out, value.size());
+  out->append(value);
+}
+
+// sequential reader of the index blob.
+class IndexReader {
+ public:
+  explicit IndexReader(const std::string &data) : data_(data) {}
+  template <typename T>
+  bool get(T *value) {
+    if (pos_ + sizeof(T) > data_.size()) {
+      return false;
+    }
+    memcpy(value, data_.data() + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+  bool getString(std::string *value) {
+    uint32_t size = 0;
+    if (!get(&size) || pos_ + size > data_.size()) {
+      return false;
+    }
+    value->assign(data_.data() + pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+ private:
+  const std::string &data_;
+  size_t pos_ = 0;
+};
+
+bool zlibCompress(const std::string &in, std::string *out) {
+  out->clear();
+  google::protobuf::io::StringOutputStream sos(out);
+  google::protobuf::io::GzipOutputStream::Options options;
+  options.format = google::protobuf::io::GzipOutputStream::ZLIB;
+  google::protobuf::io::GzipOutputStream gzip(&sos, options);
+  size_t pos = 0;
+  while (pos < in.size()) {
+    void *buf = nullptr;
+    int size = 0;
+    if (!gzip.Next(&buf, &size)) {
+      return false;
+    }
+    size_t n = std::min((size_t)size, in.size() - pos);
+    memcpy(buf, in.data() + pos, n);
+    pos += n;
+    if (n < (size_t)size) {
+      gzip.BackUp(size - n);
+    }
+  }
+  return gzip.Close();
+}
+
+bool zlibDecompress(const std::string &in, size_t raw_size, std::string *out) {
+  out->clear();
+  out->reserve(raw_size);
+  google::protobuf::io::ArrayInputStream ais(in.data(), in.size());
+  google::protobuf::io::GzipInputStream gzip(
+      &ais, google::protobuf::io::GzipInputStream::ZLIB);
+  const void *buf = nullptr;
+  int size = 0;
+  while (gzip.Next(&buf, &size)) {
+    out->append((const char *)buf, size);
+  }
+  return out->size() == raw_size;
+}
+}  // namespace
+
+std::string CaseArchive::normalizeName(const std::string &name) {
+  std::vector<std::string> parts;
+  size_t begin = 0;
+  while (begin <= name.size()) {
+    size_t end = name.find('/', begin);
+    if (end == std::string::npos) {
+      end = name.size();
+    }
+    std::string part = name.substr(begin, end - begin);
+    if (part == "..") {
+      if (!parts.empty() && parts.back() != "..") {
+        parts.pop_back();
+      } else {
+        parts.push_back(part);
+      }
+    } else if (!part.empty() && part != ".") {
+      parts.push_back(part);
+    }
+    begin = end + 1;
+  }
+  std::string res;
+  for (const auto &part : parts) {
+    res += (res.empty() ? "" : "/") + part;
+  }
+  return res;
+}
+
+CaseArchive::~CaseArchive() {
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+std::shared_ptr<CaseArchive> CaseArchive::open(const std::string &path,
+                                               std::string *error) {
+  static std::mutex mtx;
+  static std::unordered_map<std::string, std::shared_ptr<CaseArchive>> opened;
+  std::lock_guard<std::mutex> lk(mtx);
+  auto it = opened.find(path);
+  if (it != opened.end()) {
+    return it->second;
+  }
+  std::shared_ptr<CaseArchive> archive(new CaseArchive);
+  if (!archive->load(path, error)) {
+    return nullptr;
+  }
+  opened[path] = archive;
+  return archive;
+}
+
+std::shared_ptr<CaseArchive> CaseArchive::openContaining(
+    const std::string &path, std::string *member) {
+  std::string mark = std::string(SUFFIX) + "/";
+  size_t pos = path.find(mark);
+  if (pos == std::string::npos) {
+    return nullptr;
+  }
+  size_t archive_end = pos + strlen(SUFFIX);
+  auto archive = open(path.substr(0, archive_end));
+  if (archive != nullptr && member != nullptr) {
+    *member = normalizeName(path.substr(archive_end + 1));
+  }
+  return archive;
+}
+
+bool CaseArchive::load(const std::string &path, std::string *error) {
+  path_ = path;
+  fd_ = ::open(path.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    setError(error, "open " + path + " failed: " + strerror(errno));
+    return false;
+  }
+  struct stat st;
+  Footer footer;
+  if (fstat(fd_, &st) != 0 || (uint64_t)st.st_size < sizeof(Footer) ||
+      !preadAll(fd_, &footer, sizeof(footer), st.st_size - sizeof(Footer)) ||
+      memcmp(footer.magic, FOOTER_MAGIC, sizeof(FOOTER_MAGIC)) != 0 ||
+      footer.index_offset + footer.index_size + sizeof(Footer) !=
+          (uint64_t)st.st_size) {
+    setError(error, path + " is not a case archive or is truncated.");
+    return false;
+  }
+  std::string index(footer.index_size, '\0');
+  if (!preadAll(fd_, &index[0], index.size(), footer.index_offset) ||
+      fnv1a(index) != footer.index_checksum) {
+    setError(error, path + ": corrupted index.");
+    return false;
+  }
+  IndexReader reader(index);
+  entries_.resize(footer.entry_num);
+  for (auto &entry : entries_) {
+    if (!reader.get(&entry.kind) || !reader.get(&entry.codec) ||
+        !reader.getString(&entry.name) || !reader.getString(&entry.op_name) ||
+        !reader.get(&entry.offset) || !reader.get(&entry.stored_size) ||
+        !reader.get(&entry.raw_size) ||
+        entry.offset + entry.stored_size > footer.index_offset) {
+      setError(error, path + ": corrupted index.");
+      return false;
+    }
+  }
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    name_index_[entries_[i].name] = i;
+  }
+  return true;
+}
+
+const CaseArchiveEntry *CaseArchive::find(const std::string &member) const {
+  auto it = name_index_.find(member);
+  if (it == name_index_.end()) {
+    it = name_index_.find(normalizeName(member));
+  }
+  return it == name_index_.end() ? nullptr : &entries_[it->second];
+}
+
+bool CaseArchive::read(const CaseArchiveEntry &entry, std::string *data,
+                       std::string *error) const {
+  std::string stored(entry.stored_size, '\0');
+  if (!preadAll(fd_, &stored[0], stored.size(), entry.offset)) {
+    setError(error, path_ + ": read " + entry.name + " failed.");
+    return false;
+  }
+  if (entry.codec == CaseArchiveEntry::RAW) {
+    data->swap(stored);
+    return true;
+  }
+  if (!zlibDecompress(stored, entry.raw_size, data)) {
+    setError(error, path_ + ": decompress " + entry.name + " failed.");
+    return false;
+  }
+  return true;
+}
+
+CaseArchiveWriter::~CaseArchiveWriter() {
+  if (fd_ != -1) {
+    close(fd_);
+    std::remove((path_ + ".tmp").c_str());
+  }
+}
+
+bool CaseArchiveWriter::open(const std::string &path, std::string *error) {
+  path_ = path;
+  fd_ = ::open((path + ".tmp").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ == -1) {
+    setError(error, "open " + path + ".tmp failed: " + strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool CaseArchiveWriter::contains(const std::string &name) const {
+  return name_index_.count(CaseArchive::normalizeName(name)) != 0;
+}
+
+bool CaseArchiveWriter::add(const std::string &name,
+                            CaseArchiveEntry::Kind kind,
+                            const std::string &op_name,
+                            const std::string &data, bool compress,
+                            std::string *error) {
+  CaseArchiveEntry entry;
+  entry.name = CaseArchive::normalizeName(name);
+  entry.op_name = op_name;
+  entry.kind = kind;
+  entry.offset = offset_;
+  entry.raw_size = data.size();
+  if (name_index_.count(entry.name)) {
+    setError(error, "duplicated member " + entry.name);
+    return false;
+  }
+  std::string compressed;
+  // zero copy streams take int sizes.
+  bool use_zlib = compress && data.size() < INT_MAX &&
+                  zlibCompress(data, &compressed) &&
+                  compressed.size() < data.size();
+  const std::string &stored = use_zlib ? compressed : data;
+  entry.codec = use_zlib ? CaseArchiveEntry::ZLIB : CaseArchiveEntry::RAW;
+  entry.stored_size = stored.size();
+  if (!writeAll(fd_, stored.data(), stored.size())) {
+    setError(error, "write " + path_ + ".tmp failed: " + strerror(errno));
+    return false;
+  }
+  offset_ += stored.size();
+  name_index_[entry.name] = entries_.size();
+  entries_.push_back(entry);
+  return true;
+}
+
+bool CaseArchiveWriter::finish(std::string *error) {
+  std::string index;
+  for (const auto &entry : entries_) {
+    putPod(&index, entry.kind);
+    putPod(&index, entry.codec);
+    putString(&index, entry.name);
+    putString(&index, entry.op_name);
+    putPod(&index, entry.offset);
+    putPod(&index, entry.stored_size);
+    putPod(&index, entry.raw_size);
+  }
+  Footer footer;
+  memcpy(footer.magic, FOOTER_MAGIC, sizeof(FOOTER_MAGIC));
+  footer.index_offset = offset_;
+  footer.index_size = index.size();
+  footer.entry_num = entries_.size();
+  footer.index_checksum = fnv1a(index);
+  bool ok = writeAll(fd_, index.data(), index.size()) &&
+            writeAll(fd_, &footer, sizeof(footer));
+  ok = (close(fd_) == 0) && ok;
+  fd_ = -1;
+  std::string tmp = path_ + ".tmp";
+  if (!ok || std::rename(tmp.c_str(), path_.c_str()) != 0) {
+    setError(error, "write " + path_ + " failed: " + strerror(errno));
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace mluoptest
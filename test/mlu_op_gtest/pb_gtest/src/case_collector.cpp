@@ -147,6 +147,21 @@ std::vector<std::string> Collector::list_by_case_list(std::string list_file) {
 
 void Collector::assertPath(std::string &case_path, caseType case_type,
                            std::string file, int line_num) {
+  // case inside a case archive, e.g. --case_path=suite.pbpack/add/case_0.pb
+  std::string member;
+  std::shared_ptr<mluoptest::CaseArchive> archive;
+  if (case_type == caseType::CASE_FILE) {
+    archive = mluoptest::CaseArchive::openContaining(case_path, &member);
+  }
+  if (archive != nullptr) {
+    if (archive->find(member) == nullptr) {
+      LOG(ERROR) << file << ":" << line_num << ":: "
+                 << "Can not find case_path " << case_path;
+      exit(EXIT_FAILURE_MLUOP);
+    }
+    path_exist = true;
+    return;
+  }
   // error message is not displayed like a normal FAILED test would be, so use
   // LOG(ERROR) to highlight it
   switch (case_type) {
@@ -175,7 +190,34 @@ void Collector::assertPath(std::string &case_path, caseType case_type,
   }
 }
 
+// cases of this op in a case archive, filtered by the op name in its index.
+std::vector<std::string> Collector::list_by_case_archive(
+    std::string archive_path) {
+  std::string error;
+  auto archive = mluoptest::CaseArchive::open(archive_path, &error);
+  if (archive == nullptr) {
+    LOG(ERROR) << __FILE__ << ":" << __LINE__ << ":: "
+               << "Can not open cases archive " << error;
+    exit(EXIT_FAILURE_MLUOP);
+  }
+  std::vector<std::string> res;
+  for (const auto &entry : archive->entries()) {
+    if (entry.kind == mluoptest::CaseArchiveEntry::CASE &&
+        entry.op_name == op_name_ &&
+        entry.name.find("invalid") == std::string::npos) {
+      res.push_back(archive_path + "/" + entry.name);
+    }
+  }
+  return res;
+}
+
 std::vector<std::string> Collector::list_by_case_dir(std::string case_dir) {
+  std::string suffix_archive = mluoptest::CaseArchive::SUFFIX;
+  if (case_dir.size() > suffix_archive.size() &&
+      case_dir.substr(case_dir.size() - suffix_archive.size()) ==
+          suffix_archive) {
+    return list_by_case_archive(case_dir);
+  }
   assertPath(case_dir, caseType::CASE_DIR, __FILE__, __LINE__);
   RETURN_IF_PATH_INVALID();
   std::vector<std::string> res;
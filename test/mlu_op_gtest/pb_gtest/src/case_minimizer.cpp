@@ -0,0 +1,679 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "case_minimizer.h"
+#include <google/protobuf/text_format.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "gtest/gtest.h"
+#include "gtest/gtest-spi.h"
+#include "core/logging.h"
+#include "core/tool.h"
+#include "case_archive.h"
+#include "parser.h"
+#include "tensor_file_ref.h"
+
+namespace mluoptest {
+
+namespace {
+
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+using google::protobuf::Reflection;
+
+size_t tensorNum(const Node &node) {
+  return node.input_size() + node.output_size();
+}
+
+// inputs first, then outputs.
+Tensor *tensorAt(Node *node, size_t i) {
+  size_t input_num = node->input_size();
+  return i < input_num ? node->mutable_input(i)
+                       : node->mutable_output(i - input_num);
+}
+
+// shape of a tensor which can be reshaped, false for tensors without shape
+// or with stride.
+bool reshapeable(const Tensor &t, std::vector<int64_t> *shape) {
+  if (!t.has_shape() || t.shape().dim_stride_size() > 0) {
+    return false;
+  }
+  shape->assign(t.shape().dims().begin(), t.shape().dims().end());
+  return true;
+}
+
+size_t elementCount(const std::vector<int64_t> &shape) {
+  size_t count = 1;
+  for (auto dim : shape) {
+    count *= dim;
+  }
+  return count;
+}
+
+size_t totalElements(Node *node) {
+  size_t total = 0;
+  for (size_t i = 0; i < tensorNum(*node); ++i) {
+    Tensor *t = tensorAt(node, i);
+    total += t->has_shape() ? shapeElementCount(&t->shape()) : 0;
+  }
+  return total;
+}
+
+// repeated value_* fields of tensor, e.g. value_f, value_h.
+std::vector<const FieldDescriptor *> valueFields(const Tensor &t) {
+  std::vector<const FieldDescriptor *> res;
+  const auto *desc = t.GetDescriptor();
+  for (int i = 0; i < desc->field_count(); ++i) {
+    const FieldDescriptor *f = desc->field(i);
+    if (f->is_repeated() && f->name().compare(0, 6, "value_") == 0) {
+      res.push_back(f);
+    }
+  }
+  return res;
+}
+
+// linear indices in old_shape of the elements kept in new_shape, row major.
+std::vector<size_t> keptIndices(const std::vector<int64_t> &old_shape,
+                                const std::vector<int64_t> &new_shape) {
+  std::vector<size_t> res(elementCount(new_shape));
+  std::vector<int64_t> pos(new_shape.size(), 0);
+  for (size_t k = 0; k < res.size(); ++k) {
+    size_t linear = 0;
+    for (size_t d = 0; d < old_shape.size(); ++d) {
+      linear = linear * old_shape[d] + pos[d];
+    }
+    res[k] = linear;
+    for (int d = (int)new_shape.size() - 1; d >= 0; --d) {
+      if (++pos[d] < new_shape[d]) {
+        break;
+      }
+      pos[d] = 0;
+    }
+  }
+  return res;
+}
+
+// keep elements idx (width values each) of repeated field f, in place.
+void keepValues(Message *msg, const FieldDescriptor *f,
+                const std::vector<size_t> &idx, size_t width) {
+  const Reflection *r = msg->GetReflection();
+  // idx is increasing, so values before k * width are final and values after
+  // idx[k] * width are untouched.
+  for (size_t k = 0; k < idx.size(); ++k) {
+    for (size_t j = 0; j < width; ++j) {
+      size_t from = idx[k] * width + j;
+      size_t to = k * width + j;
+      if (from != to) {
+        r->SwapElements(msg, f, from, to);
+      }
+    }
+  }
+  while ((size_t)r->FieldSize(*msg, f) > idx.size() * width) {
+    r->RemoveLast(msg, f);
+  }
+}
+
+// set values [begin, end) of repeated field f to 0, false if all of them
+// are 0 already.
+bool zeroValues(Message *msg, const FieldDescriptor *f, size_t begin,
+                size_t end) {
+  const Reflection *r = msg->GetReflection();
+  bool changed = false;
+  for (size_t i = begin; i < end; ++i) {
+    switch (f->cpp_type()) {
+#define ZERO_VALUE(CPPTYPE, TYPE)                \
+  case FieldDescriptor::CPPTYPE:                 \
+    if (r->GetRepeated##TYPE(*msg, f, i) != 0) { \
+      r->SetRepeated##TYPE(msg, f, i, 0);        \
+      changed = true;                            \
+    }                                            \
+    break;
+      ZERO_VALUE(CPPTYPE_INT32, Int32)
+      ZERO_VALUE(CPPTYPE_INT64, Int64)
+      ZERO_VALUE(CPPTYPE_UINT32, UInt32)
+      ZERO_VALUE(CPPTYPE_UINT64, UInt64)
+      ZERO_VALUE(CPPTYPE_FLOAT, Float)
+      ZERO_VALUE(CPPTYPE_DOUBLE, Double)
+#undef ZERO_VALUE
+      case FieldDescriptor::CPPTYPE_STRING:  // value_h, hex of the bits.
+        if (r->GetRepeatedString(*msg, f, i).find_first_not_of('0') !=
+            std::string::npos) {
+          r->SetRepeatedString(msg, f, i, "0");
+          changed = true;
+        }
+        break;
+      default:
+        return false;
+    }
+  }
+  return changed;
+}
+
+// reshape tensor t, its data (value_* or raw file data) is cut to new_shape.
+// false if the data size does not match old_shape.
+bool reshapeTensor(Tensor *t, std::string *raw,
+                   const std::vector<int64_t> &old_shape,
+                   const std::vector<int64_t> &new_shape) {
+  size_t old_count = elementCount(old_shape);
+  auto idx = keptIndices(old_shape, new_shape);
+  for (auto f : valueFields(*t)) {
+    size_t size = t->GetReflection()->FieldSize(*t, f);
+    if (size == 0) {
+      continue;
+    }
+    if (old_count == 0 || size % old_count != 0) {
+      return false;
+    }
+    keepValues(t, f, idx, size / old_count);
+  }
+  if (raw != nullptr && !raw->empty()) {
+    if (old_count == 0 || raw->size() % old_count != 0) {
+      return false;
+    }
+    size_t width = raw->size() / old_count;
+    std::string cut;
+    cut.reserve(idx.size() * width);
+    for (auto k : idx) {
+      cut.append(*raw, k * width, width);
+    }
+    raw->swap(cut);
+  }
+  for (size_t d = 0; d < new_shape.size(); ++d) {
+    t->mutable_shape()->set_dims(d, new_shape[d]);
+  }
+  return true;
+}
+
+// zero elements [begin, end) of tensor t, false if they are 0 already.
+bool zeroElements(Tensor *t, std::string *raw, size_t count, size_t begin,
+                  size_t end) {
+  bool changed = false;
+  for (auto f : valueFields(*t)) {
+    size_t size = t->GetReflection()->FieldSize(*t, f);
+    if (size == 0 || size % count != 0) {
+      continue;
+    }
+    size_t width = size / count;
+    changed |= zeroValues(t, f, begin * width, end * width);
+  }
+  if (raw != nullptr && !raw->empty() && raw->size() % count == 0) {
+    size_t width = raw->size() / count;
+    auto first = raw->begin() + begin * width;
+    auto last = raw->begin() + end * width;
+    if (std::any_of(first, last, [](char byte) { return byte != 0; })) {
+      std::fill(first, last, 0);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+// an integer field of op param, index is -1 for singular field.
+struct ParamField {
+  const FieldDescriptor *param;
+  const FieldDescriptor *field;
+  int index;
+};
+
+bool isInteger(const FieldDescriptor *f) {
+  switch (f->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+    case FieldDescriptor::CPPTYPE_INT64:
+    case FieldDescriptor::CPPTYPE_UINT32:
+    case FieldDescriptor::CPPTYPE_UINT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// integer fields set in the *_param messages of node.
+std::vector<ParamField> paramFields(const Node &node) {
+  std::vector<ParamField> res;
+  std::vector<const FieldDescriptor *> params;
+  node.GetReflection()->ListFields(node, &params);
+  const std::string suffix = "_param";
+  for (auto p : params) {
+    const std::string &name = p->name();
+    if (p->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE || p->is_repeated() ||
+        name == "test_param" || name.size() < suffix.size() ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix)) {
+      continue;
+    }
+    const Message &param = node.GetReflection()->GetMessage(node, p);
+    std::vector<const FieldDescriptor *> fields;
+    param.GetReflection()->ListFields(param, &fields);
+    for (auto f : fields) {
+      if (!isInteger(f)) {
+        continue;
+      }
+      if (!f->is_repeated()) {
+        res.push_back({p, f, -1});
+        continue;
+      }
+      int size = param.GetReflection()->FieldSize(param, f);
+      for (int i = 0; i < size; ++i) {
+        res.push_back({p, f, i});
+      }
+    }
+  }
+  return res;
+}
+
+int64_t getParamValue(const Node &node, const ParamField &pf) {
+  const Message &m = node.GetReflection()->GetMessage(node, pf.param);
+  const Reflection *r = m.GetReflection();
+  bool one = pf.index < 0;
+  switch (pf.field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+      return one ? r->GetInt32(m, pf.field)
+                 : r->GetRepeatedInt32(m, pf.field, pf.index);
+    case FieldDescriptor::CPPTYPE_INT64:
+      return one ? r->GetInt64(m, pf.field)
+                 : r->GetRepeatedInt64(m, pf.field, pf.index);
+    case FieldDescriptor::CPPTYPE_UINT32:
+      return one ? r->GetUInt32(m, pf.field)
+                 : r->GetRepeatedUInt32(m, pf.field, pf.index);
+    default:
+      return one ? r->GetUInt64(m, pf.field)
+                 : r->GetRepeatedUInt64(m, pf.field, pf.index);
+  }
+}
+
+void setParamValue(Node *node, const ParamField &pf, int64_t value) {
+  Message *m = node->GetReflection()->MutableMessage(node, pf.param);
+  const Reflection *r = m->GetReflection();
+  bool one = pf.index < 0;
+  switch (pf.field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+      if (one) {
+        r->SetInt32(m, pf.field, value);
+      } else {
+        r->SetRepeatedInt32(m, pf.field, pf.index, value);
+      }
+      break;
+    case FieldDescriptor::CPPTYPE_INT64:
+      if (one) {
+        r->SetInt64(m, pf.field, value);
+      } else {
+        r->SetRepeatedInt64(m, pf.field, pf.index, value);
+      }
+      break;
+    case FieldDescriptor::CPPTYPE_UINT32:
+      if (one) {
+        r->SetUInt32(m, pf.field, value);
+      } else {
+        r->SetRepeatedUInt32(m, pf.field, pf.index, value);
+      }
+      break;
+    default:
+      if (one) {
+        r->SetUInt64(m, pf.field, value);
+      } else {
+        r->SetRepeatedUInt64(m, pf.field, pf.index, value);
+      }
+  }
+}
+
+// smaller values to try for dim v: 1 first, then v / 2.
+std::vector<int64_t> smallerDims(int64_t v) {
+  std::vector<int64_t> res;
+  if (v > 1) {
+    res.push_back(1);
+  }
+  if (v / 2 > 1) {
+    res.push_back(v / 2);
+  }
+  return res;
+}
+
+}  // namespace
+
+CaseMinimizer::CaseMinimizer(const std::string &op_name,
+                             ExecutorFactory factory,
+                             std::shared_ptr<ExecuteContext> ectx,
+                             const std::shared_ptr<ExecuteConfig> &ecfg)
+    : op_name_(op_name), factory_(factory), ectx_(ectx) {
+  // 1 launch is enough, and only the diff decides whether it fails.
+  ecfg_ = std::make_shared<ExecuteConfig>(*ecfg);
+  ecfg_->mlu_only = false;
+  ecfg_->perf_repeat = 1;
+  ecfg_->perf_robust = false;
+  ecfg_->perf_baseline = false;
+  ecfg_->acc_baseline = false;
+  ecfg_->dump_data = false;
+}
+
+bool CaseMinimizer::load(const std::string &case_path, Candidate *c) {
+  Parser parser;
+  if (!parser.readMessageFromFile(case_path, &c->node)) {
+    return false;
+  }
+  Node &node = c->node;
+  // shrunk cases have no baseline output, compare them to cpuCompute().
+  node.set_device(Device::CPU);
+  if (node.has_test_param()) {
+    node.mutable_test_param()->set_baseline_device(Device::CPU);
+  }
+  for (int i = 0; i < node.output_size(); ++i) {
+    Tensor *t = node.mutable_output(i);
+    for (auto f : valueFields(*t)) {
+      t->GetReflection()->ClearField(t, f);
+    }
+    t->clear_path();
+  }
+  // data files are kept in memory, to be cut with the shape.
+  std::string case_dir = case_path.substr(0, case_path.find_last_of('/') + 1);
+  c->raw.assign(node.input_size(), "");
+  for (int i = 0; i < node.input_size(); ++i) {
+    Tensor *t = node.mutable_input(i);
+    TensorFileRef ref;
+    if (!t->has_path()) {
+      continue;
+    } else if (!ref.parse(t->path())) {
+      return false;
+    }
+    std::string file = case_dir + ref.file, member, data;
+    auto archive = CaseArchive::openContaining(file, &member);
+    if (archive != nullptr) {
+      const CaseArchiveEntry *entry = archive->find(member);
+      if (entry == nullptr || !archive->read(*entry, &data)) {
+        return false;
+      }
+    } else {
+      std::ifstream fin(file, std::ios::in | std::ios::binary);
+      std::ostringstream oss;
+      if (!(oss << fin.rdbuf())) {
+        return false;
+      }
+      data = oss.str();
+    }
+    size_t length = ref.has_length ? ref.length : data.size() - ref.offset;
+    if (ref.offset > data.size() || length > data.size() - ref.offset) {
+      return false;
+    }
+    c->raw[i] = data.substr(ref.offset, length);
+    t->clear_path();
+  }
+  return true;
+}
+
+std::string CaseMinimizer::save(const Candidate &c, const std::string &name,
+                                bool text) {
+  Node node = c.node;
+  for (size_t i = 0; i < c.raw.size(); ++i) {
+    if (c.raw[i].empty()) {
+      continue;
+    }
+    std::string file = name + "_input" + std::to_string(i) + ".bin";
+    std::ofstream fout(dir_ + "/" + file, std::ios::binary | std::ios::trunc);
+    if (!fout.write(c.raw[i].data(), c.raw[i].size())) {
+      LOG(ERROR) << "CaseMinimizer: write " << dir_ << "/" << file
+                 << " failed.";
+      return "";
+    }
+    node.mutable_input(i)->set_path(file);
+  }
+  std::string path = dir_ + "/" + name + (text ? ".prototxt" : ".pb");
+  std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+  bool ok = false;
+  if (text) {
+    std::string str;
+    ok = google::protobuf::TextFormat::PrintToString(node, &str) &&
+         (fout << str);
+  } else {
+    ok = node.SerializeToOstream(&fout);
+  }
+  if (!ok) {
+    LOG(ERROR) << "CaseMinimizer: write " << path << " failed.";
+    return "";
+  }
+  return path;
+}
+
+CaseMinimizer::Outcome CaseMinimizer::check(const Candidate &c) {
+  std::string path = save(c, stem_ + "_try", false);
+  if (path.empty()) {
+    return REJECT;
+  }
+  trials_++;
+  ::testing::TestPartResultArray failures;
+  bool failed = false;
+  {
+    // failures of candidates must not fail the current test.
+    ::testing::ScopedFakeTestPartResultReporter reporter(
+        ::testing::ScopedFakeTestPartResultReporter::
+            INTERCEPT_ONLY_CURRENT_THREAD,
+        &failures);
+    try {
+      auto exe = factory_();
+      exe->result()->op_name = op_name_;
+      exe->init(ectx_);
+      exe->setup(path, ecfg_);
+      exe->launch();
+      auto res = exe->teardown();
+      // what is filled by diff check only, as accuracy baseline is off.
+      failed = !res.is_passed && !res.what.empty();
+    } catch (std::exception &e) {
+      VLOG(4) << "CaseMinimizer: candidate rejected, " << e.what();
+      ectx_->reset();
+      return REJECT;
+    }
+  }
+  if (failures.size() > 0) {
+    VLOG(4) << "CaseMinimizer: candidate rejected, "
+            << failures.GetTestPartResult(0).message();
+    return REJECT;
+  }
+  return failed ? FAIL : PASS;
+}
+
+bool CaseMinimizer::tryCandidate(Candidate *c, const std::string &what) {
+  if (trials_ >= max_trials_ || check(*c) != FAIL) {
+    return false;
+  }
+  best_ = std::move(*c);
+  LOG(INFO) << "CaseMinimizer: " << what << ", still fails ("
+            << totalElements(&best_.node) << " elements).";
+  return true;
+}
+
+bool CaseMinimizer::shrinkDims() {
+  bool progress = false;
+  std::vector<int64_t> shape;
+  auto raw = [](Candidate *c, size_t i) {
+    return i < c->raw.size() ? &c->raw[i] : nullptr;
+  };
+
+  // each dim value in all tensors at once, largest first.
+  std::set<int64_t, std::greater<int64_t>> values;
+  for (size_t i = 0; i < tensorNum(best_.node); ++i) {
+    if (reshapeable(*tensorAt(&best_.node, i), &shape)) {
+      values.insert(shape.begin(), shape.end());
+    }
+  }
+  for (int64_t v : values) {
+    for (int64_t to : smallerDims(v)) {
+      Candidate c = best_;
+      bool changed = false, ok = true;
+      for (size_t i = 0; ok && i < tensorNum(c.node); ++i) {
+        Tensor *t = tensorAt(&c.node, i);
+        if (!reshapeable(*t, &shape)) {
+          continue;
+        }
+        auto new_shape = shape;
+        std::replace(new_shape.begin(), new_shape.end(), v, to);
+        if (new_shape != shape) {
+          changed = true;
+          ok = reshapeTensor(t, raw(&c, i), shape, new_shape);
+        }
+      }
+      if (changed && ok &&
+          tryCandidate(&c, "dim " + std::to_string(v) + " -> " +
+                               std::to_string(to) + " in all tensors")) {
+        progress = true;
+        break;
+      }
+    }
+  }
+
+  // each dim of each tensor alone.
+  for (size_t i = 0; i < tensorNum(best_.node); ++i) {
+    for (size_t d = 0;
+         reshapeable(*tensorAt(&best_.node, i), &shape) && d < shape.size();
+         ++d) {
+      for (int64_t to : smallerDims(shape[d])) {
+        Candidate c = best_;
+        Tensor *t = tensorAt(&c.node, i);
+        auto new_shape = shape;
+        new_shape[d] = to;
+        if (reshapeTensor(t, raw(&c, i), shape, new_shape) &&
+            tryCandidate(&c, t->id() + " dim " + std::to_string(d) + " " +
+                                 std::to_string(shape[d]) + " -> " +
+                                 std::to_string(to))) {
+          progress = true;
+          break;
+        }
+      }
+    }
+  }
+  return progress;
+}
+
+bool CaseMinimizer::shrinkParams() {
+  bool progress = false;
+  for (const auto &pf : paramFields(best_.node)) {
+    // 0, then halved, then 1 closer to 0.
+    int64_t v = getParamValue(best_.node, pf);
+    if (v == 0) {
+      continue;
+    }
+    std::vector<int64_t> smaller = {0};
+    if (v / 2 != 0) {
+      smaller.push_back(v / 2);
+    }
+    int64_t closer = v > 0 ? v - 1 : v + 1;
+    if (closer != 0 && closer != v / 2) {
+      smaller.push_back(closer);
+    }
+    for (int64_t to : smaller) {
+      Candidate c = best_;
+      setParamValue(&c.node, pf, to);
+      std::string name = pf.param->name() + "." + pf.field->name();
+      if (pf.index >= 0) {
+        name += "[" + std::to_string(pf.index) + "]";
+      }
+      if (tryCandidate(&c, name + " " + std::to_string(v) + " -> " +
+                               std::to_string(to))) {
+        progress = true;
+        break;
+      }
+    }
+  }
+  return progress;
+}
+
+bool CaseMinimizer::zeroInputs() {
+  bool progress = false;
+  std::vector<int64_t> shape;
+  for (int i = 0; i < best_.node.input_size(); ++i) {
+    if (!reshapeable(best_.node.input(i), &shape)) {
+      continue;
+    }
+    // halves first, then smaller regions, down to 1/64 or 1 element.
+    size_t count = elementCount(shape);
+    for (size_t level = 2; level <= 64 && level / 2 < count; level *= 2) {
+      size_t parts = std::min(level, count);
+      for (size_t k = 0; k < parts; ++k) {
+        size_t begin = count * k / parts;
+        size_t end = count * (k + 1) / parts;
+        Candidate c = best_;
+        Tensor *t = c.node.mutable_input(i);
+        if (zeroElements(t, &c.raw[i], count, begin, end) &&
+            tryCandidate(&c, t->id() + " [" + std::to_string(begin) + ", " +
+                                 std::to_string(end) + ") -> 0")) {
+          progress = true;
+        }
+      }
+    }
+  }
+  return progress;
+}
+
+std::string CaseMinimizer::run(const std::string &case_path,
+                               const std::string &dir) {
+  dir_ = dir;
+  stem_ = case_path.substr(case_path.find_last_of('/') + 1);
+  stem_ = stem_.substr(0, stem_.find_last_of('.'));
+  trials_ = 0;
+  Candidate origin;
+  if (mluop::mkdirRecursive(dir_.c_str()) != 0 || !load(case_path, &origin)) {
+    LOG(ERROR) << "CaseMinimizer: failed to load " << case_path
+               << " into " << dir_ << ".";
+    return "";
+  }
+  auto remove_try = [&]() {
+    std::remove((dir_ + "/" + stem_ + "_try.pb").c_str());
+    for (size_t i = 0; i < origin.raw.size(); ++i) {
+      std::remove((dir_ + "/" + stem_ + "_try_input" + std::to_string(i) +
+                   ".bin")
+                      .c_str());
+    }
+  };
+  size_t origin_elements = totalElements(&origin.node);
+  if (check(origin) != FAIL) {
+    LOG(WARNING) << "CaseMinimizer: " << case_path
+                 << " does not fail accuracy against cpu compute, skip it.";
+    remove_try();
+    return "";
+  }
+  best_ = origin;
+
+  // shapes and params first, zero data once they are stuck.
+  while (trials_ < max_trials_) {
+    bool dims = shrinkDims();
+    bool params = shrinkParams();
+    if (!dims && !params && !zeroInputs()) {
+      break;
+    }
+  }
+  remove_try();
+
+  std::string path = save(best_, stem_ + "_min", true);
+  if (!path.empty()) {
+    LOG(INFO) << "CaseMinimizer: " << case_path << " (" << origin_elements
+              << " elements) -> " << path << " ("
+              << totalElements(&best_.node) << " elements) in " << trials_
+              << " trials.";
+  }
+  return path;
+}
+
+}  // namespace mluoptest
@@ -0,0 +1,395 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "case_scheduler.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "mlu_op_test.pb.h"
+#include "case_archive.h"
+#include "tools.h"
+#include "variable.h"
+
+namespace mluoptest {
+
+namespace {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+// only the head of a *prototxt is scanned, shapes are written before values.
+const size_t PROTOTXT_SCAN_BYTES = 1 << 20;
+// weight of one file byte against one tensor element, parse cost is linear
+// in the file size and compute cost in the element count.
+const double FILE_BYTE_WEIGHT = 0.25;
+
+// busy seconds of past runs, "seconds\top_name\tcase_path" per line.
+class CaseHistory {
+ public:
+  static CaseHistory &get() {
+    static CaseHistory history;
+    return history;
+  }
+  bool enabled() const { return !path_.empty(); }
+  bool find(const std::string &key, double *seconds) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = seconds_.find(key);
+    if (it == seconds_.end()) {
+      return false;
+    }
+    *seconds = it->second;
+    return true;
+  }
+  // smooth over runs, busy time of a case jitters with machine load.
+  void update(const std::string &key, double seconds) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = seconds_.find(key);
+    if (it == seconds_.end()) {
+      seconds_[key] = seconds;
+    } else {
+      it->second = 0.5 * it->second + 0.5 * seconds;
+    }
+  }
+  void save() {
+    if (!enabled()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lk(mtx_);
+    std::string tmp = path_ + ".tmp";
+    std::ofstream out(tmp, std::ios::trunc);
+    if (!out) {
+      LOG(WARNING) << "CaseScheduler: failed to write case history " << tmp;
+      return;
+    }
+    for (const auto &kv : seconds_) {
+      out << kv.second << "\t" << kv.first << "\n";
+    }
+    out.close();
+    if (std::rename(tmp.c_str(), path_.c_str()) != 0) {
+      LOG(WARNING) << "CaseScheduler: failed to save case history " << path_;
+    }
+  }
+
+ private:
+  CaseHistory() : path_(global_var.case_history_) {
+    if (!enabled()) {
+      return;
+    }
+    std::ifstream in(path_);
+    std::string line;
+    while (std::getline(in, line)) {
+      auto tab = line.find('\t');
+      if (tab == std::string::npos) {
+        continue;
+      }
+      double seconds = std::atof(line.substr(0, tab).c_str());
+      if (seconds > 0) {
+        seconds_[line.substr(tab + 1)] = seconds;
+      }
+    }
+    VLOG(4) << "CaseScheduler: loaded " << seconds_.size()
+            << " cases from history " << path_;
+  }
+
+  std::string path_;
+  std::mutex mtx_;
+  std::map<std::string, double> seconds_;  // ordered, stable file diff
+};
+
+bool strEndsWith(const std::string &self, const std::string &pattern) {
+  if (self.size() < pattern.size()) return false;
+  return (self.compare(self.size() - pattern.size(), pattern.size(), pattern) ==
+          0);
+}
+
+std::string historyKey(const std::string &op_name,
+                       const std::string &case_path) {
+  return op_name + "\t" + case_path;
+}
+
+// product of dims in one Shape message.
+double skimShape(CodedInputStream *input, int dims_no) {
+  double count = 1;
+  uint32_t tag;
+  while ((tag = input->ReadTag()) != 0) {
+    if (WireFormatLite::GetTagFieldNumber(tag) != dims_no) {
+      if (!WireFormatLite::SkipField(input, tag)) {
+        return -1;
+      }
+      continue;
+    }
+    uint64_t dim = 0;
+    if (WireFormatLite::GetTagWireType(tag) ==
+        WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {  // packed dims
+      uint32_t len = 0;
+      if (!input->ReadVarint32(&len)) {
+        return -1;
+      }
+      auto limit = input->PushLimit(len);
+      while (input->BytesUntilLimit() > 0 && input->ReadVarint64(&dim)) {
+        count *= (double)(int64_t)dim;
+      }
+      input->PopLimit(limit);
+    } else if (input->ReadVarint64(&dim)) {
+      count *= (double)(int64_t)dim;
+    } else {
+      return -1;
+    }
+  }
+  return count;
+}
+
+// element count of one Tensor message, values are skipped, not parsed.
+double skimTensor(CodedInputStream *input, int shape_no, int dims_no) {
+  double count = 0;
+  uint32_t tag;
+  while ((tag = input->ReadTag()) != 0) {
+    if (WireFormatLite::GetTagFieldNumber(tag) == shape_no &&
+        WireFormatLite::GetTagWireType(tag) ==
+            WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      uint32_t len = 0;
+      if (!input->ReadVarint32(&len)) {
+        return -1;
+      }
+      auto limit = input->PushLimit(len);
+      count = skimShape(input, dims_no);
+      input->PopLimit(limit);
+    } else if (!WireFormatLite::SkipField(input, tag)) {
+      return -1;
+    }
+  }
+  return count;
+}
+
+// field numbers come from the descriptor, the skim follows mlu_op_test.proto.
+double estimatePbSize(const std::string &case_path) {
+  const auto *node_desc = Node::descriptor();
+  const auto *input_field = node_desc->FindFieldByName("input");
+  const auto *output_field = node_desc->FindFieldByName("output");
+  if (input_field == nullptr || output_field == nullptr) {
+    return -1;
+  }
+  const auto *shape_field =
+      input_field->message_type()->FindFieldByName("shape");
+  if (shape_field == nullptr) {
+    return -1;
+  }
+  const auto *dims_field = shape_field->message_type()->FindFieldByName("dims");
+  if (dims_field == nullptr) {
+    return -1;
+  }
+
+  int fd = open(case_path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return -1;
+  }
+  double count = 0;
+  {
+    google::protobuf::io::FileInputStream file(fd);
+    CodedInputStream input(&file);
+#if GOOGLE_PROTOBUF_VERSION > 3005000
+    input.SetTotalBytesLimit(INT_MAX);
+#elif GOOGLE_PROTOBUF_VERSION
+    input.SetTotalBytesLimit(INT_MAX, INT_MAX - 1);
+#endif
+    uint32_t tag;
+    while (count >= 0 && (tag = input.ReadTag()) != 0) {
+      int field_no = WireFormatLite::GetTagFieldNumber(tag);
+      if ((field_no == input_field->number() ||
+           field_no == output_field->number()) &&
+          WireFormatLite::GetTagWireType(tag) ==
+              WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+        uint32_t len = 0;
+        if (!input.ReadVarint32(&len)) {
+          count = -1;
+          break;
+        }
+        auto limit = input.PushLimit(len);
+        double tensor_count =
+            skimTensor(&input, shape_field->number(), dims_field->number());
+        count = tensor_count < 0 ? -1 : count + tensor_count;
+        input.PopLimit(limit);
+      } else if (!WireFormatLite::SkipField(&input, tag)) {
+        count = -1;
+      }
+    }
+  }
+  close(fd);
+  return count;
+}
+
+// sums the dims of every "shape { dims: ... }" block in the head of the file.
+double estimatePrototxtSize(const std::string &case_path) {
+  std::ifstream in(case_path, std::ios::binary);
+  if (!in) {
+    return -1;
+  }
+  std::string text(PROTOTXT_SCAN_BYTES, '\0');
+  in.read(&text[0], text.size());
+  text.resize(in.gcount());
+
+  double count = 0;
+  size_t pos = 0;
+  while ((pos = text.find("shape", pos)) != std::string::npos) {
+    pos += 5;
+    size_t open = text.find_first_not_of(" \t\r\n", pos);
+    if (open == std::string::npos || text[open] != '{') {
+      continue;
+    }
+    size_t close = text.find('}', open);
+    if (close == std::string::npos) {
+      break;  // cut by the scan limit
+    }
+    double shape_count = 1;
+    size_t dims = open;
+    while ((dims = text.find("dims", dims)) != std::string::npos &&
+           dims < close) {
+      dims += 4;
+      size_t num = text.find_first_not_of(" \t:", dims);
+      if (num < close && (std::isdigit(text[num]) || text[num] == '-')) {
+        shape_count *= std::atof(text.c_str() + num);
+      }
+    }
+    count += shape_count;
+    pos = close;
+  }
+  return count;
+}
+
+}  // namespace
+
+double CaseScheduler::estimateCaseSize(const std::string &case_path) {
+  std::string member;
+  auto archive = CaseArchive::openContaining(case_path, &member);
+  if (archive != nullptr) {
+    // packed case, only the index is read here.
+    const CaseArchiveEntry *entry = archive->find(member);
+    return entry == nullptr ? -1 : FILE_BYTE_WEIGHT * entry->raw_size;
+  }
+  struct stat file_stat;
+  if (stat(case_path.c_str(), &file_stat) != 0) {
+    return -1;
+  }
+  double count = -1;
+  if (strEndsWith(case_path, ".pb")) {
+    count = estimatePbSize(case_path);
+  } else if (strEndsWith(case_path, ".prototxt")) {
+    count = estimatePrototxtSize(case_path);
+  }
+  return std::max(count, 0.0) + FILE_BYTE_WEIGHT * file_stat.st_size;
+}
+
+CaseScheduler::CaseScheduler(const std::string &op_name,
+                             const std::vector<std::string> &case_paths)
+    : op_name_(op_name), case_paths_(case_paths) {
+  size_t case_num = case_paths_.size();
+  order_.resize(case_num);
+  std::iota(order_.begin(), order_.end(), 0);
+  cost_.assign(case_num, 0);
+  busy_.assign(case_num, -1);
+  if (!getEnv("MLUOP_GTEST_LPT_SCHEDULE", true)) {
+    return;
+  }
+
+  auto &history = CaseHistory::get();
+  std::vector<double> size(case_num, -1);
+  std::vector<bool> known(case_num, false);
+  size_t known_num = 0;
+  for (size_t i = 0; i < case_num; ++i) {
+    double seconds = 0;
+    if (history.find(historyKey(op_name_, case_paths_[i]), &seconds)) {
+      cost_[i] = seconds;
+      known[i] = true;
+      known_num++;
+    }
+  }
+  if (known_num < case_num) {
+    // seconds per size unit, fitted on the cases with history.
+    double known_size = 0, known_seconds = 0;
+    for (size_t i = 0; i < case_num; ++i) {
+      if (!known[i] || known_num > 0) {
+        size[i] = estimateCaseSize(case_paths_[i]);
+      }
+      if (known[i] && size[i] > 0) {
+        known_size += size[i];
+        known_seconds += cost_[i];
+      }
+    }
+    double scale = known_size > 0 ? known_seconds / known_size : 1.0;
+    for (size_t i = 0; i < case_num; ++i) {
+      if (!known[i]) {
+        cost_[i] = std::max(size[i], 0.0) * scale;
+      }
+    }
+  }
+
+  // stable, cases of same cost keep the list order.
+  std::stable_sort(order_.begin(), order_.end(), [this](size_t a, size_t b) {
+    return cost_[a] > cost_[b];
+  });
+  VLOG(4) << "CaseScheduler: " << op_name_ << " " << known_num << "/"
+          << case_num << " cases from history.";
+}
+
+void CaseScheduler::record(size_t case_idx, double busy_seconds) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  busy_[case_idx] = busy_seconds;
+}
+
+void CaseScheduler::report(double makespan_seconds, size_t thread_num) {
+  double total = 0, longest = 0;
+  auto &history = CaseHistory::get();
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (size_t i = 0; i < busy_.size(); ++i) {
+      if (busy_[i] < 0) {
+        continue;
+      }
+      total += busy_[i];
+      longest = std::max(longest, busy_[i]);
+      history.update(historyKey(op_name_, case_paths_[i]), busy_[i]);
+    }
+  }
+  history.save();
+
+  // no schedule beats both the longest case and perfectly even threads.
+  double ideal = std::max(longest, total / std::max<size_t>(thread_num, 1));
+  printf("[ SCHEDULE ]: %s makespan %.3f s, ideal %.3f s (%.1f%%), %zu "
+         "threads, busy %.3f s.\n",
+         op_name_.c_str(), makespan_seconds, ideal,
+         makespan_seconds > 0 ? 100.0 * ideal / makespan_seconds : 100.0,
+         thread_num, total);
+}
+
+}  // namespace mluoptest
@@ -0,0 +1,124 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "coord_hash.h"
+#include <stdexcept>
+#include <string>
+#include "gtest/gtest.h"
+#include "check_tools.h"
+
+namespace mluoptest {
+
+namespace {
+
+const int64_t EMPTY_KEY = -1;
+
+// splitmix64 finalizer, packed coordinates of neighbouring voxels differ only
+// in the low bits and would cluster without it.
+inline uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+}  // namespace
+
+CoordHash::CoordHash(size_t expected) {
+  size_t capacity = 16;
+  while (capacity < expected * 2) {
+    capacity <<= 1;
+  }
+  keys_.assign(capacity, EMPTY_KEY);
+  values_.assign(capacity, 0);
+  mask_ = capacity - 1;
+}
+
+size_t CoordHash::slot(int64_t key) const {
+  size_t i = mix((uint64_t)key) & mask_;
+  while (keys_[i] != EMPTY_KEY && keys_[i] != key) {
+    i = (i + 1) & mask_;
+  }
+  return i;
+}
+
+void CoordHash::grow() {
+  std::vector<int64_t> keys(keys_.size() * 2, EMPTY_KEY);
+  std::vector<int32_t> values(keys.size(), 0);
+  keys_.swap(keys);
+  values_.swap(values);
+  mask_ = keys_.size() - 1;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i] != EMPTY_KEY) {
+      size_t s = slot(keys[i]);
+      keys_[s] = keys[i];
+      values_[s] = values[i];
+    }
+  }
+}
+
+bool CoordHash::insert(int64_t key, int32_t value) {
+  GTEST_CHECK(key >= 0, "CoordHash: key should be non-negative.");
+  size_t s = slot(key);
+  if (keys_[s] == key) {
+    return false;
+  }
+  if ((size_ + 1) * 2 > keys_.size()) {
+    grow();
+    s = slot(key);
+  }
+  keys_[s] = key;
+  values_[s] = value;
+  size_++;
+  return true;
+}
+
+void CoordHash::set(int64_t key, int32_t value) {
+  if (!insert(key, value)) {
+    values_[slot(key)] = value;
+  }
+}
+
+int32_t *CoordHash::find(int64_t key) {
+  size_t s = slot(key);
+  return keys_[s] == key ? &values_[s] : nullptr;
+}
+
+const int32_t *CoordHash::find(int64_t key) const {
+  size_t s = slot(key);
+  return keys_[s] == key ? &values_[s] : nullptr;
+}
+
+std::vector<int64_t> CoordHash::keys() const {
+  std::vector<int64_t> keys;
+  keys.reserve(size_);
+  for (auto key : keys_) {
+    if (key != EMPTY_KEY) {
+      keys.push_back(key);
+    }
+  }
+  return keys;
+}
+
+}  // namespace mluoptest
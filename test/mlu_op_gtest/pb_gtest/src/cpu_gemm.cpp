@@ -0,0 +1,367 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "cpu_gemm.h"
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <algorithm>
+#include <vector>
+
+namespace mluoptest {
+
+namespace {
+
+// the usual goto/blis scheme: C is computed in mc x nc blocks, for each
+// kc slice a block of op(A) and a block of op(B) are packed into panels that
+// the micro kernel streams through, and the micro kernel keeps an MR x NR
+// tile of C in registers.
+const int64_t GEMM_KC = 256;   // packed A block stays in L2
+const int64_t GEMM_NC = 2048;  // packed B block stays in L3
+// below this many multiply-adds a gemm runs in one thread.
+const int64_t GEMM_PARALLEL_WORK = 1 << 18;
+
+// one simd register of T, and the few ops the micro kernel needs.
+template <typename T>
+struct Simd {
+  typedef T reg;
+  static const int lanes = 1;
+  static reg load(const T *p) { return *p; }
+  static void store(T *p, reg v) { *p = v; }
+  static reg set1(T v) { return v; }
+  static reg fma(reg a, reg b, reg c) { return a * b + c; }
+  static reg add(reg a, reg b) { return a + b; }
+};
+
+#if defined(__AVX512F__)
+template <>
+struct Simd<float> {
+  typedef __m512 reg;
+  static const int lanes = 16;
+  static reg load(const float *p) { return _mm512_loadu_ps(p); }
+  static void store(float *p, reg v) { _mm512_storeu_ps(p, v); }
+  static reg set1(float v) { return _mm512_set1_ps(v); }
+  static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+  static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+};
+
+template <>
+struct Simd<double> {
+  typedef __m512d reg;
+  static const int lanes = 8;
+  static reg load(const double *p) { return _mm512_loadu_pd(p); }
+  static void store(double *p, reg v) { _mm512_storeu_pd(p, v); }
+  static reg set1(double v) { return _mm512_set1_pd(v); }
+  static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+  static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+};
+#elif defined(__AVX2__)
+template <>
+struct Simd<float> {
+  typedef __m256 reg;
+  static const int lanes = 8;
+  static reg load(const float *p) { return _mm256_loadu_ps(p); }
+  static void store(float *p, reg v) { _mm256_storeu_ps(p, v); }
+  static reg set1(float v) { return _mm256_set1_ps(v); }
+#ifdef __FMA__
+  static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+  static reg fma(reg a, reg b, reg c) {
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+  }
+#endif
+  static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+};
+
+template <>
+struct Simd<double> {
+  typedef __m256d reg;
+  static const int lanes = 4;
+  static reg load(const double *p) { return _mm256_loadu_pd(p); }
+  static void store(double *p, reg v) { _mm256_storeu_pd(p, v); }
+  static reg set1(double v) { return _mm256_set1_pd(v); }
+#ifdef __FMA__
+  static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+#else
+  static reg fma(reg a, reg b, reg c) {
+    return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+  }
+#endif
+  static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+};
+#endif
+
+// register tile of the micro kernel: MR rows of NV registers, 12
+// accumulators with simd (fits the 16 ymm of avx2), 16 scalars without.
+template <typename T>
+struct Tile {
+  static const int nv = Simd<T>::lanes == 1 ? 4 : 2;
+  static const int mr = Simd<T>::lanes == 1 ? 4 : 6;
+  static const int nr = nv * Simd<T>::lanes;
+  static const int64_t mc = 16 * mr;
+};
+
+inline int64_t roundUp(int64_t x, int64_t align) {
+  return (x + align - 1) / align * align;
+}
+
+inline int maxThreads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// c[rows x cols] += pa^T * pb, pa is a packed kc x MR panel of A, pb a packed
+// kc x NR panel of B. Partial tiles at the edges of C go through a buffer.
+template <typename T>
+void microKernel(int64_t kc, const T *pa, const T *pb, T *c, int64_t ldc,
+                 int rows, int cols) {
+  typedef Simd<T> S;
+  const int MR = Tile<T>::mr;
+  const int NV = Tile<T>::nv;
+  const int NR = Tile<T>::nr;
+  // the tile loops must be unrolled for acc to live in registers, -O2 does
+  // not do it by itself.
+  typename S::reg acc[MR][NV];
+#pragma GCC unroll 8
+  for (int i = 0; i < MR; ++i) {
+#pragma GCC unroll 4
+    for (int v = 0; v < NV; ++v) {
+      acc[i][v] = S::set1(T(0));
+    }
+  }
+  for (int64_t p = 0; p < kc; ++p, pa += MR, pb += NR) {
+    typename S::reg b[NV];
+#pragma GCC unroll 4
+    for (int v = 0; v < NV; ++v) {
+      b[v] = S::load(pb + v * S::lanes);
+    }
+#pragma GCC unroll 8
+    for (int i = 0; i < MR; ++i) {
+      typename S::reg a = S::set1(pa[i]);
+#pragma GCC unroll 4
+      for (int v = 0; v < NV; ++v) {
+        acc[i][v] = S::fma(a, b[v], acc[i][v]);
+      }
+    }
+  }
+  if (rows == MR && cols == NR) {
+#pragma GCC unroll 8
+    for (int i = 0; i < MR; ++i) {
+#pragma GCC unroll 4
+      for (int v = 0; v < NV; ++v) {
+        T *dst = c + i * ldc + v * S::lanes;
+        S::store(dst, S::add(S::load(dst), acc[i][v]));
+      }
+    }
+    return;
+  }
+  T tile[MR * NR];
+#pragma GCC unroll 8
+  for (int i = 0; i < MR; ++i) {
+#pragma GCC unroll 4
+    for (int v = 0; v < NV; ++v) {
+      S::store(tile + i * NR + v * S::lanes, acc[i][v]);
+    }
+  }
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      c[i * ldc + j] += tile[i * NR + j];
+    }
+  }
+}
+
+// pack alpha * op(A)[0:mc, 0:kc] into panels of MR rows, each stored as
+// kc x MR and zero padded. a points at op(A)[0][0].
+template <typename T>
+void packA(bool trans, const T *a, int64_t lda, int64_t mc, int64_t kc,
+           T alpha, T *pa) {
+  const int MR = Tile<T>::mr;
+  for (int64_t ir = 0; ir < mc; ir += MR, pa += MR * kc) {
+    const int rows = (int)std::min<int64_t>(MR, mc - ir);
+    if (rows < MR) {
+      std::fill(pa, pa + MR * kc, T(0));
+    }
+    for (int i = 0; i < rows; ++i) {
+      if (trans) {
+        for (int64_t p = 0; p < kc; ++p) {
+          pa[p * MR + i] = alpha * a[p * lda + ir + i];
+        }
+      } else {
+        const T *row = a + (ir + i) * lda;
+        for (int64_t p = 0; p < kc; ++p) {
+          pa[p * MR + i] = alpha * row[p];
+        }
+      }
+    }
+  }
+}
+
+// pack op(B)[0:kc, 0:nc] into panels of NR columns, each stored as kc x NR
+// and zero padded. b points at op(B)[0][0].
+template <typename T>
+void packB(bool trans, const T *b, int64_t ldb, int64_t kc, int64_t nc,
+           T *pb, bool parallel) {
+  const int NR = Tile<T>::nr;
+  const int64_t panels = (nc + NR - 1) / NR;
+#pragma omp parallel for schedule(static) if (parallel && panels > 1)
+  for (int64_t jp = 0; jp < panels; ++jp) {
+    const int64_t jr = jp * NR;
+    const int cols = (int)std::min<int64_t>(NR, nc - jr);
+    T *panel = pb + jr * kc;
+    if (cols < NR) {
+      std::fill(panel, panel + NR * kc, T(0));
+    }
+    if (trans) {
+      for (int j = 0; j < cols; ++j) {
+        const T *col = b + (jr + j) * ldb;
+        for (int64_t p = 0; p < kc; ++p) {
+          panel[p * NR + j] = col[p];
+        }
+      }
+    } else {
+      for (int64_t p = 0; p < kc; ++p) {
+        std::copy(b + p * ldb + jr, b + p * ldb + jr + cols, panel + p * NR);
+      }
+    }
+  }
+}
+
+template <typename T>
+void gemm(bool trans_a, bool trans_b, int64_t m, int64_t n, int64_t k,
+          T alpha, const T *a, int64_t lda, const T *b, int64_t ldb, T beta,
+          T *c, int64_t ldc, bool parallel) {
+  if (m <= 0 || n <= 0) {
+    return;
+  }
+  // the blocks below only accumulate into C.
+  if (beta != T(1)) {
+    for (int64_t i = 0; i < m; ++i) {
+      T *row = c + i * ldc;
+      if (beta == T(0)) {
+        std::fill(row, row + n, T(0));
+      } else {
+        for (int64_t j = 0; j < n; ++j) {
+          row[j] *= beta;
+        }
+      }
+    }
+  }
+  if (k <= 0 || alpha == T(0)) {
+    return;
+  }
+
+  const int MR = Tile<T>::mr;
+  const int NR = Tile<T>::nr;
+  parallel = parallel && m * n * k >= GEMM_PARALLEL_WORK;
+  // split the rows finer when there are few, so that all threads get a block.
+  int64_t mc = Tile<T>::mc;
+  const int threads = parallel ? maxThreads() : 1;
+  if (threads > 1) {
+    mc = std::min(mc, roundUp((m + threads - 1) / threads, MR));
+  }
+  const int64_t blocks = (m + mc - 1) / mc;
+
+  std::vector<T> pb(std::min(k, GEMM_KC) *
+                    roundUp(std::min(n, GEMM_NC), NR));
+  for (int64_t jc = 0; jc < n; jc += GEMM_NC) {
+    const int64_t nc = std::min(GEMM_NC, n - jc);
+    for (int64_t pc = 0; pc < k; pc += GEMM_KC) {
+      const int64_t kc = std::min(GEMM_KC, k - pc);
+      packB(trans_b, b + (trans_b ? jc * ldb + pc : pc * ldb + jc), ldb, kc,
+            nc, pb.data(), parallel);
+#pragma omp parallel for schedule(dynamic) if (parallel && blocks > 1)
+      for (int64_t blk = 0; blk < blocks; ++blk) {
+        const int64_t ic = blk * mc;
+        const int64_t rows = std::min(mc, m - ic);
+        std::vector<T> pa(roundUp(rows, MR) * kc);
+        packA(trans_a, a + (trans_a ? pc * lda + ic : ic * lda + pc), lda,
+              rows, kc, alpha, pa.data());
+        for (int64_t jr = 0; jr < nc; jr += NR) {
+          for (int64_t ir = 0; ir < rows; ir += MR) {
+            microKernel(kc, pa.data() + ir * kc, pb.data() + jr * kc,
+                        c + (ic + ir) * ldc + jc + jr, ldc,
+                        (int)std::min<int64_t>(MR, rows - ir),
+                        (int)std::min<int64_t>(NR, nc - jr));
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename T>
+void gemmStridedBatched(bool trans_a, bool trans_b, int64_t m, int64_t n,
+                        int64_t k, T alpha, const T *a, int64_t lda,
+                        int64_t stride_a, const T *b, int64_t ldb,
+                        int64_t stride_b, T beta, T *c, int64_t ldc,
+                        int64_t stride_c, int64_t batch) {
+  // one gemm per thread when there are enough of them or they are small,
+  // otherwise one gemm after another, each using all threads.
+  const bool across = batch > 1 && (batch >= maxThreads() ||
+                                    m * n * k < GEMM_PARALLEL_WORK);
+#pragma omp parallel for schedule(dynamic) if (across)
+  for (int64_t i = 0; i < batch; ++i) {
+    gemm(trans_a, trans_b, m, n, k, alpha, a + i * stride_a, lda,
+         b + i * stride_b, ldb, beta, c + i * stride_c, ldc, !across);
+  }
+}
+
+}  // namespace
+
+void cpuGemm(bool trans_a, bool trans_b, int64_t m, int64_t n, int64_t k,
+             float alpha, const float *a, int64_t lda, const float *b,
+             int64_t ldb, float beta, float *c, int64_t ldc) {
+  gemm(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, true);
+}
+
+void cpuGemm(bool trans_a, bool trans_b, int64_t m, int64_t n, int64_t k,
+             double alpha, const double *a, int64_t lda, const double *b,
+             int64_t ldb, double beta, double *c, int64_t ldc) {
+  gemm(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, true);
+}
+
+void cpuGemmStridedBatched(bool trans_a, bool trans_b, int64_t m, int64_t n,
+                           int64_t k, float alpha, const float *a, int64_t lda,
+                           int64_t stride_a, const float *b, int64_t ldb,
+                           int64_t stride_b, float beta, float *c, int64_t ldc,
+                           int64_t stride_c, int64_t batch) {
+  gemmStridedBatched(trans_a, trans_b, m, n, k, alpha, a, lda, stride_a, b, ldb,
+                     stride_b, beta, c, ldc, stride_c, batch);
+}
+
+void cpuGemmStridedBatched(bool trans_a, bool trans_b, int64_t m, int64_t n,
+                           int64_t k, double alpha, const double *a,
+                           int64_t lda, int64_t stride_a, const double *b,
+                           int64_t ldb, int64_t stride_b, double beta,
+                           double *c, int64_t ldc, int64_t stride_c,
+                           int64_t batch) {
+  gemmStridedBatched(trans_a, trans_b, m, n, k, alpha, a, lda, stride_a, b, ldb,
+                     stride_b, beta, c, ldc, stride_c, batch);
+}
+
+}  // namespace mluoptest
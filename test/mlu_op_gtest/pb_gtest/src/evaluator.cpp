@@ -54,6 +54,14 @@ void Evaluator::init(void *baseline_result, void *mlu_result,
   }
   stride_ = is_complex_ ? 2 : 1;
   count_total_ = is_complex_ ? count_ * 2 : count_;
+  chunk_total_ = 0;
+  chunk_offset_ = 0;
+  skip_compute_diff_ = false;
+  has_nan_inf_ = false;
+  nan_inf_wrong_pos_ = npos;
+  nan_inf_neq_pos_ = npos;
+  partials_.clear();
+  partials_imag_.clear();
   thresholdLevel1();
 }
 
@@ -105,6 +113,54 @@ void Evaluator::computeDiffForOneCriterion() {
   }
   func_ = cur_criterion_.formula;
   computeDiffFunc(this);
+}
+
+void Evaluator::finishDiffForOneCriterion() {
+  const DiffPartial &res = partials_[cur_criterion_.formula];
+  const DiffPartial &res_imag = partials_imag_[cur_criterion_.formula];
+  switch (cur_criterion_.formula) {
+    case DIFF1: {
+      error_ = res.numerator_sum / (res.denominator_sum + EPSILON);
+      if (is_complex_) {
+        error_imag_ =
+            res_imag.numerator_sum / (res_imag.denominator_sum + EPSILON);
+      }
+    } break;
+    case DIFF2: {
+      error_ = std::sqrt(res.numerator_sum / (res.denominator_sum + EPSILON));
+      if (is_complex_) {
+        error_imag_ = std::sqrt(res_imag.numerator_sum /
+                                (res_imag.denominator_sum + EPSILON));
+      }
+    } break;
+    case DIFF3:
+    case DIFF3_2: {
+      error_ = res.max_ratio;
+      if (is_complex_) {
+        error_imag_ = res_imag.max_ratio;
+      }
+    } break;
+    case DIFF4: {
+      error_ = res.diff4.error();
+      logDiff4Pos(res.diff4, error_, "");
+      if (is_complex_) {
+        error_imag_ = res_imag.diff4.error();
+        logDiff4Pos(res_imag.diff4, error_imag_, " imag");
+      }
+    } break;
+    case DIFF_KL: {
+      // diff_kl needs count_total_ <= INT64_MAX because of the length in
+      // python func is int64 diff_kl skips the data with too less quantity
+      if (count_total_ < (size_t)1000 || count_total_ > (size_t)INT64_MAX) {
+        error_ = -1;
+      } else {
+        error_ = res.entropy;
+      }
+    } break;
+    default: {
+      GTEST_CHECK(false, "Evaluator: got an unsupported criterion formula.");
+    }
+  }
   error_vec_.push_back(
       ErrorWrap(name_, cur_criterion_, error_, error_imag_, dtype_));
 }
@@ -178,13 +234,32 @@ void Evaluator::computeDiff(void *baseline_result, void *mlu_result,
                             const std::set<Criterion> criterions,
                             const std::string &name,
                             const mluOpDataType_t dtype) {
+  beginDiff(count, criterions, name, dtype);
+  computeDiffChunk(baseline_result, mlu_result, count);
+  endDiff();
+}
+
+void Evaluator::beginDiff(const size_t count,
+                          const std::set<Criterion> criterions,
+                          const std::string &name,
+                          const mluOpDataType_t dtype) {
   if (0 == criterions.size()) {
     criterion_matching_ = false;
     LOG(ERROR) << "Error func in mluop_gtest and pb/pt may mismatch,"
                << " now no error func is used, please check.";
   }
-  init(baseline_result, mlu_result, count, criterions, name, dtype);
+  init(nullptr, nullptr, count, criterions, name, dtype);
   selectFuncPtr();
+}
+
+void Evaluator::computeDiffChunk(void *baseline_chunk, void *mlu_chunk,
+                                 const size_t count) {
+  base_array_ = baseline_chunk;
+  mlu_array_ = mlu_chunk;
+  chunk_offset_ += chunk_total_;
+  chunk_total_ = is_complex_ ? count * 2 : count;
+  GTEST_CHECK(chunk_offset_ + chunk_total_ <= count_total_,
+              "Evaluator: chunks are more than the count of output.");
   checkNanInfFunc(this);
   for (auto &it : criterions_) {
     cur_criterion_ = it;
@@ -192,6 +267,51 @@ void Evaluator::computeDiff(void *baseline_result, void *mlu_result,
   }
 }
 
+void Evaluator::endDiff() {
+  GTEST_CHECK(chunk_offset_ + chunk_total_ == count_total_,
+              "Evaluator: chunks are less than the count of output.");
+  finishNanInf();
+  if (skip_compute_diff_) {
+    setErrorWrap();
+    return;
+  }
+  for (auto &it : criterions_) {
+    cur_criterion_ = it;
+    finishDiffForOneCriterion();
+  }
+}
+
+bool Evaluator::canStream(const std::set<Criterion> &criterions) {
+  for (const auto &it : criterions) {
+    if (it.formula == DIFF_KL) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Evaluator::finishNanInf() {
+  if (threshold_l1_ || !has_nan_inf_) {
+    // nan_inf_pass_ is set by nanInfRemain() for level 1.
+    return;
+  }
+  if (nan_inf_wrong_pos_ != npos) {
+    nan_inf_pass_ = false;
+    LOG(ERROR) << "Found NaN or Inf, but mlu is not equal to baseline,"
+               << " return DBL_MAX instead."
+               << "The first wrong position is " << nan_inf_wrong_pos_;
+    return;
+  }
+  nan_inf_pass_ = true;
+  if (nan_inf_neq_pos_ != npos) {
+    LOG(WARNING) << "The results of baseline and mlu are not equal, "
+                 << "one of them is nan and the other is inf, "
+                 << "the current mode will not distinguish nan and inf, "
+                 << "this case will pass. The first position is "
+                 << nan_inf_neq_pos_;
+  }
+}
+
 bool Evaluator::isPassed() {
   if (!criterion_matching_) {
     return false;
@@ -24,8 +24,11 @@
 
 #include <time.h>
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <cmath>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <set>
@@ -44,6 +47,7 @@
 #include "internal_kernel/fill_ram/fill_ram.h"  // mluOpFillRam
 #include "kernel_tracing.h"
 #include "hardware_monitor.h"
+#include "perf_stats.h"
 
 // #if GTEST_ENABLE_GPERFTOOLS
 // #include "gperftools/profiler.h"
@@ -490,7 +494,20 @@ void Executor::launchAndGetTime(ComputeMode compute_mode, int repeat) {
   Func compute_by_layer_ptr = std::bind(&Executor::computeByLayer, this);
   std::vector<double> hw_time_vec;
   int i_start = 0;
-  for (int i = i_start; i < repeat; ++i) {
+  // warm-up and robust mode only apply to perf repeat, the very first launch
+  // gives the output to check.
+  bool is_perf = repeat != repeat_val_1;
+  int warmup = is_perf ? std::max(exe_config_->perf_warmup, 0) : 0;
+  bool robust = is_perf && compute_mode == NORMAL && exe_config_->perf_robust;
+  int max_repeat =
+      robust ? std::max(repeat, exe_config_->perf_max_repeat) : repeat;
+  double ci_target = exe_config_->perf_ci_permille / 1000.0;
+  auto budget_end =
+      std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(exe_config_->perf_time_budget_ms);
+  mluoptest::PerfStats stats;
+  int measured = 0;
+  for (int i = i_start; i < warmup + max_repeat; ++i) {
     fillLLC();
     setupForPerfIter(repeat, i, i_start);
 
@@ -500,28 +517,62 @@ void Executor::launchAndGetTime(ComputeMode compute_mode, int repeat) {
     } else {
       std::tie(time_point, hw_time) =
           callBackKernelSyncAndGetTime(compute_ptr, exe_context_->hw_notifier);
+    }
+
+    teardownForPerfIter(repeat, i);
+    if (i < warmup) {
+      VLOG(4) << "warm-up iter = " << i << ", hardware time = " << hw_time;
+      continue;
+    }
+    if (compute_mode == NORMAL) {
       eva_res_.mlu.raw_hwtime_list.push_back(
           std::make_tuple(time_point, hw_time));
     }
     hw_time_vec.push_back(hw_time);
-
-    teardownForPerfIter(repeat, i);
     VLOG(4) << "repeat iter = " << i << ", hardware time = " << hw_time;
     hw_time_total += hw_time;
     hw_time_sum_of_square += hw_time * hw_time;
     hw_time_layer_total += hw_time_layer;
+    measured++;
+
+    if (robust && measured >= repeat) {
+      stats = mluoptest::computePerfStats(hw_time_vec,
+                                          exe_config_->perf_outlier_mad);
+      if (stats.ciRelativeHalfWidth() <= ci_target) {
+        break;
+      }
+      if (std::chrono::steady_clock::now() >= budget_end) {
+        VLOG(4) << "perf time budget is used up, ci half width is "
+                << stats.ciRelativeHalfWidth() * 100 << "% of mean.";
+        break;
+      }
+    }
   }
 
   if (compute_mode == BY_LAYER) {
-    eva_res_.mlu.hardware_time_layer = hw_time_layer_total / repeat;
+    eva_res_.mlu.hardware_time_layer = hw_time_layer_total / measured;
   } else {
-    eva_res_.mlu.hardware_time = hw_time_total / repeat;
+    eva_res_.mlu.hardware_time = hw_time_total / measured;
     const double hardware_time_variance =
-        hw_time_sum_of_square / repeat -
+        hw_time_sum_of_square / measured -
         eva_res_.mlu.hardware_time * eva_res_.mlu.hardware_time;
     eva_res_.mlu.hardware_time_cv =
         sqrt(hardware_time_variance) / eva_res_.mlu.hardware_time;
   }
+  if (robust) {
+    // same samples as the ci used by checkBaseline, outliers excluded.
+    stats = mluoptest::computePerfStats(hw_time_vec,
+                                        exe_config_->perf_outlier_mad);
+    eva_res_.mlu.hardware_time = stats.mean;
+    eva_res_.mlu.hardware_time_cv = stats.stddev / stats.mean;
+    eva_res_.mlu.hardware_time_median = stats.median;
+    eva_res_.mlu.hardware_time_trimmed_mean = stats.trimmed_mean;
+    eva_res_.mlu.hardware_time_mad = stats.mad;
+    eva_res_.mlu.hardware_time_ci_low = stats.ci_low;
+    eva_res_.mlu.hardware_time_ci_high = stats.ci_high;
+    eva_res_.mlu.perf_samples = stats.samples;
+    eva_res_.mlu.perf_outliers = stats.outliers;
+  }
 }
 
 std::tuple<size_t, float> Executor::callBackKernelSyncAndGetTime(
@@ -622,7 +673,7 @@ void Executor::postProcessAfterLaunch() {
   baselineOutputMallocFunc(this);
   if (parser_->device() == CPU) {
     VLOG(4) << "Begin cpu compute.";
-    cpuCompute();
+    cpuComputeWithCache();
     // if out dtype is half, cast cpu data from float to half to float,
     // consistent with mlu.
     castHalfOuput();
@@ -634,12 +685,19 @@ void Executor::postProcessAfterLaunch() {
     recordGtestTimePoint("after_get_baseline_output");
   }
 
-  VLOG(4) << "Host malloc (for mlu output, fp32).";
-  mluOutputMallocFunc(this);
-  recordGtestTimePoint("after_mlu_output_malloc");
+  if (useStreamDiff()) {
+    // mlu output will be cast chunk by chunk in checkDiff(),
+    // see streamDiff().
+    VLOG(4) << "Skip host malloc and cast out for mlu output (stream diff).";
+    mlu_fp32_output_.resize(parser_->outputs().size(), nullptr);
+  } else {
+    VLOG(4) << "Host malloc (for mlu output, fp32).";
+    mluOutputMallocFunc(this);
+    recordGtestTimePoint("after_mlu_output_malloc");
 
-  castOutFunc(this);
-  recordGtestTimePoint("after_cast_out");
+    castOutFunc(this);
+    recordGtestTimePoint("after_cast_out");
+  }
 
   diffPreprocess();
 
@@ -697,6 +755,140 @@ EvaluateResult Executor::teardown() {
   return eva_res_;
 }
 
+// cpu baseline cache, enabled by MLUOP_GTEST_BASELINE_CACHE_DIR.
+// the key covers everything cpuCompute() reads: op name and version, proto
+// params, tensor descs and the actual cpu input data (so random inputs hit
+// only if the random spec and seed reproduce the same data).
+void Executor::cpuComputeWithCache() {
+  BaselineCache *cache = BaselineCache::instance();
+  if (cache == nullptr || !baselineCacheable()) {
+    cpuCompute();
+    return;
+  }
+  BaselineCacheKey key = baselineCacheKey();
+  std::vector<BaselineBuffer> outputs = baselineOutputBuffers();
+  bool hit = cache->load(key, outputs);
+  if (hit && !cache->needVerify(key)) {
+    VLOG(4) << "Skip cpu compute, baseline cache hit " << key.hex();
+    return;
+  }
+  std::vector<std::vector<char>> cached;
+  if (hit) {
+    for (const auto &out : outputs) {
+      const char *ptr = (const char *)out.ptr;
+      cached.emplace_back(ptr, ptr + out.size);
+    }
+  }
+  // outputs are zero before cpuCompute(), restore it after (partial) load.
+  for (const auto &out : outputs) {
+    if (out.size != 0) {
+      memset(out.ptr, 0x0, out.size);
+    }
+  }
+  cpuCompute();
+  outputs = baselineOutputBuffers();
+  if (!hit) {
+    cache->store(key, outputs);
+    return;
+  }
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    if (outputs[i].size != cached[i].size() ||
+        memcmp(outputs[i].ptr, cached[i].data(), cached[i].size()) != 0) {
+      LOG(ERROR) << "Baseline cache entry " << key.hex() << " of "
+                 << parser_->getOpName()
+                 << " differs from cpuCompute(), drop it.";
+      cache->drop(key);
+      break;
+    }
+  }
+}
+
+BaselineCacheKey Executor::baselineCacheKey() {
+  const uint64_t format_version = 1;
+  BaselineHasher hasher;
+  hasher.update(format_version);
+  // salt to invalidate all entries, e.g. after a compiler or libm change.
+  const char *salt = std::getenv("MLUOP_GTEST_BASELINE_CACHE_SALT");
+  hasher.update(std::string(salt == NULL ? "" : salt));
+  hasher.update((uint64_t)baselineCacheVersion());
+  hasher.update(baselineCacheSourceHash(eva_res_.op_name));
+  hasher.update((uint64_t)test_version_);
+  hasher.update((uint64_t)storage_dtype_);
+  hasher.update(parser_->getOpName());
+
+  // params, without tensor data which is hashed below as cpu input.
+  Node *node = parser_->getProtoNode();
+  google::protobuf::RepeatedPtrField<Tensor> inputs, outputs;
+  inputs.Swap(node->mutable_input());
+  outputs.Swap(node->mutable_output());
+  std::string param;
+  {
+    google::protobuf::io::StringOutputStream sos(&param);
+    google::protobuf::io::CodedOutputStream cos(&sos);
+    cos.SetSerializationDeterministic(true);
+    node->SerializeToCodedStream(&cos);
+  }
+  inputs.Swap(node->mutable_input());
+  outputs.Swap(node->mutable_output());
+  hasher.update(param);
+
+  auto hash_desc = [&hasher](const MetaTensor *ts) {
+    hasher.update(ts->name);
+    hasher.update((uint64_t)ts->is_null);
+    hasher.update((uint64_t)ts->is_cpu_scalar);
+    hasher.update((uint64_t)ts->dtype);
+    hasher.update((uint64_t)ts->oc_dt);
+    hasher.update((uint64_t)ts->layout);
+    hasher.update((uint64_t)ts->position);
+    hasher.update(&ts->scale, sizeof(ts->scale));
+    hasher.update((uint64_t)ts->offset);
+    hasher.update((uint64_t)ts->shape.size());
+    hasher.update(ts->shape.data(), ts->shape.size() * sizeof(int64_t));
+    hasher.update((uint64_t)ts->stride.size());
+    hasher.update(ts->stride.data(), ts->stride.size() * sizeof(int64_t));
+  };
+  for (size_t i = 0; i < parser_->inputs().size(); ++i) {
+    MetaTensor *ts = parser_->input(i);
+    hash_desc(ts);
+    if (ts->empty() || cpu_fp32_input_[i] == nullptr) {
+      hasher.update((uint64_t)0);
+      continue;
+    }
+    size_t cpu_dtype_size;
+    MLUOP_CHECK(
+        mluOpGetSizeOfDataType(getCpuDtype(ts->dtype), &cpu_dtype_size));
+    size_t size = ts->total_count * cpu_dtype_size;
+    hasher.update((uint64_t)size);
+    hasher.update(cpu_fp32_input_[i], size);
+  }
+  for (size_t i = 0; i < parser_->outputs().size(); ++i) {
+    hash_desc(parser_->output(i));
+  }
+  return hasher.digest();
+}
+
+// host buffers cpuCompute() writes, depends on storage dtype.
+std::vector<BaselineBuffer> Executor::baselineOutputBuffers() {
+  std::vector<BaselineBuffer> buffers(parser_->outputs().size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    MetaTensor *ts = parser_->output(i);
+    if (ts->empty()) {
+      continue;
+    }
+    size_t dtype_size;
+    if (FLOAT == storage_dtype_) {
+      MLUOP_CHECK(
+          mluOpGetSizeOfDataType(getCpuDtype(ts->dtype), &dtype_size));
+      buffers[i].ptr = cpu_fp32_output_[i];
+    } else {
+      MLUOP_CHECK(mluOpGetSizeOfDataType(ts->dtype, &dtype_size));
+      buffers[i].ptr = cpu_output_[i];
+    }
+    buffers[i].size = buffers[i].ptr ? ts->shape_count * dtype_size : 0;
+  }
+  return buffers;
+}
+
 size_t Executor::getProtoApiVersion() { return parser_->getProtoApiVersion(); }
 
 void Executor::selectApiVersion() {
@@ -880,6 +1072,22 @@ bool Executor::checkBaseline() {
       baseline_check =
           updateBaselineStrategy(hw_time_mean, scale_bound, threshold_absolute,
                                  threshold_relative, &hw_time_base);
+      if (!baseline_check && eva_res_.mlu.hardware_time_ci_low > 0) {
+        // robust perf mode: not a regression if the ci still reaches the
+        // allowed range, the mean is off by noise. baseline is kept.
+        double hw_time_base_kept = hw_time_base;
+        baseline_check = updateBaselineStrategy(
+            eva_res_.mlu.hardware_time_ci_low, scale_bound,
+            threshold_absolute, threshold_relative, &hw_time_base_kept);
+        if (baseline_check) {
+          LOG(INFO) << "[Baseline:" << case_name
+                    << "]:hardware time " << hw_time_mean
+                    << " (us) exceeds threshold, but 95% ci ["
+                    << eva_res_.mlu.hardware_time_ci_low << ", "
+                    << eva_res_.mlu.hardware_time_ci_high
+                    << "] (us) does not, treat as noise.";
+        }
+      }
       if (!baseline_check) {
         LOG(ERROR) << "[Baseline:" << case_name
                    << "]:scale_bound:" << scale_bound
@@ -2598,6 +2806,15 @@ bool Executor::checkDiff() {
     }
     MetaTensor *ts = parser_->output(i);
 
+    if (!common_threshold) {
+      criterions = parser_->criterions(i, criterions_use);
+    }
+
+    if (useStreamDiff()) {
+      streamDiff(i, criterions);
+      continue;
+    }
+
     void *baseline_output;
     void *mlu_output;
     if (VOID == storage_dtype_) {
@@ -2608,10 +2825,6 @@ bool Executor::checkDiff() {
       mlu_output = reinterpret_cast<void *>(mlu_fp32_output_[i]);
     }
 
-    if (!common_threshold) {
-      criterions = parser_->criterions(i, criterions_use);
-    }
-
     eva_->computeDiff(baseline_output, mlu_output, ts->total_count, criterions,
                       ts->name, ts->dtype);
   }
@@ -2619,4 +2832,67 @@ bool Executor::checkDiff() {
   eva_res_.what = std::move(eva_->what());
   return eva_->isPassed();
 }
+
+// stream diff only works on the fp32 storage path, where mlu output is cast
+// element-wise. dump data, ops which touch mlu_fp32_output_ in
+// diffPreprocess() and DIFF_KL, which normalizes by the sums of the whole
+// output, still need the whole cast mlu output.
+bool Executor::useStreamDiff() {
+  if (!exe_config_->stream_diff || exe_config_->dump_data ||
+      storage_dtype_ != FLOAT || needFullMluOutput()) {
+    return false;
+  }
+  const auto &criterions_use = getCriterionsUse();
+  const bool common_threshold = parser_->common_threshold();
+  for (size_t i = 0; i < parser_->outputs().size(); ++i) {
+    // int31 is saved as two int16 halves, can't be cast by slice.
+    if (parser_->output(i)->dtype == MLUOP_DTYPE_INT31) {
+      return false;
+    }
+    if (!Evaluator::canStream(
+            parser_->criterions(common_threshold ? -1 : i, criterions_use))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// cast the i-th mlu output into a chunk-sized buffer and feed evaluator
+// chunk by chunk. host still holds the baseline output and the raw mlu
+// output copied from device, but not an fp32 copy of the mlu output.
+void Executor::streamDiff(int index,
+                          const std::set<Evaluator::Criterion> &criterions) {
+  MetaTensor *ts = parser_->output(index);
+  auto output_blocks = getOutputBlocks(true);
+  void *src_data = output_blocks[index]->host_ptr;
+  float *baseline_output = cpu_fp32_output_[index];
+  mluOpDataType_t cpu_dtype = getCpuDtype(ts->dtype);
+  size_t cpu_dtype_size;
+  MLUOP_CHECK(mluOpGetSizeOfDataType(cpu_dtype, &cpu_dtype_size));
+
+  int pos = 0, offset = 0;
+  float scale = 1.0f;
+  if (parser_->device() == CPU) {
+    getQuantizedParam(cpu_fp32_output_[index], ts->shape_count, ts->dtype,
+                      flag_quant_mode_, &pos, &scale, &offset);
+  }
+
+  // keep chunk offset aligned for the avx loads in evaluator.
+  size_t chunk = exe_config_->stream_diff_chunk / 64 * 64;
+  chunk = std::max(chunk, (size_t)64);
+  chunk = std::min(chunk, ts->total_count);
+  void *mlu_chunk = cpu_runtime_.allocate(chunk * cpu_dtype_size);
+
+  eva_->beginDiff(ts->total_count, criterions, ts->name, ts->dtype);
+  for (size_t begin = 0; begin < ts->total_count; begin += chunk) {
+    size_t count = std::min(chunk, ts->total_count - begin);
+    castDataOut((char *)src_data + begin * ts->sizeof_dtype, ts->dtype,
+                (float *)mlu_chunk, cpu_dtype, count, flag_quant_mode_, pos,
+                scale, offset);
+    eva_->computeDiffChunk((char *)baseline_output + begin * cpu_dtype_size,
+                           mlu_chunk, count);
+  }
+  eva_->endDiff();
+  cpu_runtime_.deallocate(mlu_chunk);
+}
 }  // namespace mluoptest
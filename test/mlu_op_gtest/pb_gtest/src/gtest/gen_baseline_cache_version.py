@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+
+# generate baseline_cache_version.cpp: a hash of the cpu reference sources of
+# every op in zoo/, which is part of the baseline cache key (see
+# Executor::baselineCacheKey()), so editing a reference invalidates its
+# cached results.
+#
+# sources of an op: every c++ file in zoo/<op>/, plus the headers they include
+# from pb_gtest/include, pb_gtest/src and mlu_op_gtest/include (recursively),
+# plus the .cpp with the same name as such a header. executor.h is not
+# followed: framework changes that alter results need
+# MLUOP_GTEST_BASELINE_CACHE_SALT or Executor::baselineCacheVersion().
+
+import hashlib
+import os
+import re
+import sys
+
+INCLUDE_RE = re.compile(r'^\s*#\s*include\s+"([^"]+)"', re.M)
+NOT_FOLLOWED = set(["executor.h"])
+SOURCE_EXTS = set([".h", ".hpp", ".cpp", ".cc", ".inc"])
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def resolve(name, from_dir, search_dirs):
+    for d in [from_dir] + search_dirs:
+        path = os.path.normpath(os.path.join(d, name))
+        if os.path.isfile(path):
+            return path
+    return None
+
+
+def op_sources(op_dir, search_dirs, src_dirs, root):
+    files = set()
+    for dirpath, _, names in os.walk(op_dir):
+        for name in names:
+            # test_case/ holds inputs, which are hashed as data anyway.
+            if os.path.splitext(name)[1] in SOURCE_EXTS:
+                files.add(os.path.join(dirpath, name))
+    pending = sorted(files)
+    while pending:
+        path = pending.pop()
+        text = read(path).decode("utf-8", "ignore")
+        for name in INCLUDE_RE.findall(text):
+            if os.path.basename(name) in NOT_FOLLOWED:
+                continue
+            header = resolve(name, os.path.dirname(path), search_dirs)
+            # only sources of mlu_op_gtest, not mlu_op.h or core/.
+            if header is None or not header.startswith(root):
+                continue
+            found = [header]
+            stem = os.path.splitext(os.path.basename(header))[0]
+            for d in src_dirs:
+                found.append(os.path.join(d, stem + ".cpp"))
+            for f in found:
+                if os.path.isfile(f) and f not in files:
+                    files.add(f)
+                    pending.append(f)
+    return sorted(files)
+
+
+def op_hash(files, root):
+    sha = hashlib.sha256()
+    for path in files:
+        rel = os.path.relpath(path, root).encode("utf-8")
+        data = read(path)
+        sha.update(b"%d:%s%d:" % (len(rel), rel, len(data)))
+        sha.update(data)
+    return sha.hexdigest()[:16]
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        print("usage: %s <output.cpp>" % sys.argv[0])
+        exit(1)
+    gtest_dir = os.path.dirname(os.path.abspath(__file__))
+    pb_gtest = os.path.normpath(os.path.join(gtest_dir, "../.."))
+    root = os.path.dirname(pb_gtest)  # test/mlu_op_gtest
+    zoo_path = os.path.join(pb_gtest, "src/zoo")
+    src_dirs = [os.path.join(pb_gtest, "src")]
+    search_dirs = [os.path.join(pb_gtest, "include"),
+                   os.path.join(pb_gtest, "src"),
+                   os.path.join(root, "include"),
+                   os.path.normpath(os.path.join(root, "../.."))]
+    lines = []
+    for op in sorted(os.listdir(zoo_path)):
+        op_dir = os.path.join(zoo_path, op)
+        if not os.path.isdir(op_dir):
+            continue
+        files = op_sources(op_dir, search_dirs, src_dirs, root + os.sep)
+        lines.append("      {\"%s\", 0x%sULL},\n" % (op, op_hash(files, root)))
+
+    content = ("// generated by gen_baseline_cache_version.py, do not edit.\n"
+               "#include <string>\n"
+               "#include <unordered_map>\n"
+               "#include \"baseline_cache.h\"\n"
+               "\n"
+               "namespace mluoptest {\n"
+               "\n"
+               "uint64_t baselineCacheSourceHash(const std::string &op_name) {\n"
+               "  static const std::unordered_map<std::string, uint64_t> "
+               "table = {\n" + "".join(lines) +
+               "  };\n"
+               "  auto it = table.find(op_name);\n"
+               "  return it == table.end() ? 0 : it->second;\n"
+               "}\n"
+               "\n"
+               "}  // namespace mluoptest\n")
+    with open(sys.argv[1], "w") as f:
+        f.write(content)
@@ -23,6 +23,7 @@
 #include <malloc.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <chrono>  // NOLINT
 #include <iterator>
 #include <functional>
 #include <queue>
@@ -32,6 +33,9 @@
 #include <utility>
 #include "mlu_op_gtest.h"
 #include "op_register.h"
+#include "case_minimizer.h"
+#include "mlu_op_test_result_printer.h"
+#include "case_scheduler.h"
 #include "internal_perf.h"
 #include "gtest/mlu_op_test_case.h"
 
@@ -125,6 +129,13 @@ void TestSuite::Thread1() {
       get_vmpeak_oss.close();
     }
     exe = nullptr;
+
+    // shrink the failing case, see CaseMinimizer.
+    if (!global_var.minimize_dir_.empty() && !res.is_passed) {
+      mluoptest::CaseMinimizer minimizer(
+          op_name_, []() { return getOpExecutor(op_name_); }, ectx_, ecfg_);
+      minimizer.run(case_path, global_var.minimize_dir_);
+    }
   } catch (std::exception &e) {
     ectx_->reset();
 
@@ -138,6 +149,8 @@ void TestSuite::Thread1() {
     ADD_FAILURE() << "MLUOPGTEST: catched " << e.what()
                   << " in single thread mode. (of " << case_path << ")";
   }
+  exe = nullptr;
+  mluoptest::CPUMemoryPool::trim();
 }
 
 // wrap a executor and it status flag
@@ -157,13 +170,23 @@ struct ExecutorWrap {
   // flag for setup
   // if 1 thread choose this exe, other thread shouldn't choose it.
   bool in_used = false;
+  // case of exe, and seconds spent in its setup, for CaseScheduler.
+  size_t case_idx = 0;
+  double setup_seconds = 0;
 
   void used() { in_used = true; }
-  void set(std::shared_ptr<mluoptest::Executor> e) { exe = e; }
+  void set(std::shared_ptr<mluoptest::Executor> e, size_t idx = 0,
+           double seconds = 0) {
+    exe = e;
+    case_idx = idx;
+    setup_seconds = seconds;
+  }
   void reset() {
     been_chosen = false;
     in_used = false;
     exe = nullptr;
+    case_idx = 0;
+    setup_seconds = 0;
   }
   bool is_free() { return !in_used; }
   // ready means ready to teardown:
@@ -239,6 +262,8 @@ struct Context {
   std::vector<std::shared_ptr<ExecutorWrap>> exe_vec;
 
   std::list<mluoptest::EvaluateResult> results;
+  // dispatch order and cost record of cases.
+  std::shared_ptr<mluoptest::CaseScheduler> scheduler = nullptr;
   // set current device for all thread.
   std::set<std::thread::id, std::greater<std::thread::id>> been_initialized;
 };
@@ -255,6 +280,14 @@ void TestSuite::ThreadX() {
   size_t max_exe_vec_num = thread_num * 1.5;
   auto thread_pool = std::make_shared<mluoptest::ThreadPool>(thread_num);
   auto context = std::make_shared<Context>(max_exe_vec_num);
+  context->scheduler =
+      std::make_shared<mluoptest::CaseScheduler>(op_name_, case_path_vec_);
+  const auto &case_order = context->scheduler->order();
+  auto elapsed = [](std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    return seconds.count();
+  };
 
   // set device for each thread.
   auto set_device = [](std::shared_ptr<Context> ctx) {
@@ -295,9 +328,12 @@ void TestSuite::ThreadX() {
     }
   };
 
-  auto teardown = [](size_t id, std::shared_ptr<Context> ctx) {
+  auto teardown = [=](size_t id, std::shared_ptr<Context> ctx) {
+    auto start = std::chrono::steady_clock::now();
     mluoptest::EvaluateResult res;
     auto exe = ctx->exe_vec[id]->exe;
+    size_t case_idx = ctx->exe_vec[id]->case_idx;
+    double setup_seconds = ctx->exe_vec[id]->setup_seconds;
     try {
       if (!global_var.use_default_queue_) {
         // when we use default cnrt queue, sync has been called in setup phase
@@ -317,6 +353,8 @@ void TestSuite::ThreadX() {
     printf("[ TEARDOWN ]: %s\n",
            res.case_path.c_str());  // printf is thread-safe
     exe.reset();                    // free this exe.
+    mluoptest::CPUMemoryPool::trim();
+    ctx->scheduler->record(case_idx, setup_seconds + elapsed(start));
     {
       std::lock_guard<std::mutex> lk(ctx->mtx);
       ctx->exe_vec[id]->reset();  // reset this position as idle.
@@ -326,8 +364,9 @@ void TestSuite::ThreadX() {
     ctx->cond.notify_all();
   };
 
-  auto setup = [](std::string op_name, std::string case_path,
-                  std::shared_ptr<Context> ctx, size_t pos) {
+  auto setup = [=](std::string op_name, std::string case_path,
+                   std::shared_ptr<Context> ctx, size_t pos, size_t case_idx) {
+    auto start = std::chrono::steady_clock::now();
     printf("[ SETUP    ]: %s\n", case_path.c_str());  // printf is thread-safe
     // get corresponding executor context which saved handle queue ...
     auto ecw = ctx->ecw_vec[pos];
@@ -349,7 +388,8 @@ void TestSuite::ThreadX() {
       }
       {
         std::lock_guard<std::mutex> lk(ctx->mtx);
-        ctx->exe_vec[pos]->set(exe);  // push exe into task queue.
+        // push exe into task queue.
+        ctx->exe_vec[pos]->set(exe, case_idx, elapsed(start));
       }
       exe = nullptr;
     } catch (std::exception &e) {
@@ -362,6 +402,7 @@ void TestSuite::ThreadX() {
       res.case_path = case_path;
       res.what.emplace_back(
           "Unknown error: maybe exception raised, other info is lost.");
+      ctx->scheduler->record(case_idx, elapsed(start));
       {
         std::lock_guard<std::mutex> lk(ctx->mtx);
         ctx->results.emplace_back(res);
@@ -371,6 +412,7 @@ void TestSuite::ThreadX() {
     }
   };
 
+  auto makespan_start = std::chrono::steady_clock::now();
   // set current device for each thread.
   while (context->been_initialized.size() < thread_num) {
     thread_pool->enqueue(set_device, context);
@@ -388,8 +430,10 @@ void TestSuite::ThreadX() {
       if (it != context->exe_vec.end() && i < case_path_vec_.size()) {
         (*it)->used();  // occupy this position
         auto setup_pos = std::distance(context->exe_vec.begin(), it);
-        thread_pool->enqueue(setup, op_name_, case_path_vec_[i], context,
-                             setup_pos);
+        // longest case first, see CaseScheduler.
+        size_t case_idx = case_order[i];
+        thread_pool->enqueue(setup, op_name_, case_path_vec_[case_idx],
+                             context, setup_pos, case_idx);
         i++;
       } else {
         // task is full, just wait.
@@ -412,8 +456,10 @@ void TestSuite::ThreadX() {
     }
   }
 
-  // join thread pool
+  // join thread pool, an exception escaped from a task fails the suite.
+  thread_pool->wait();
   thread_pool.reset();
+  context->scheduler->report(elapsed(makespan_start), thread_num);
 
   // get results.
   res_ = context->results;
@@ -426,6 +472,13 @@ void TestSuite::ThreadX() {
 }
 
 void TestSuite::Run() {
+  // finished by the run being resumed, see StreamPrinter.
+  const ::testing::TestInfo *info =
+      ::testing::UnitTest::GetInstance()->current_test_info();
+  if (StreamPrinter::isRecorded(std::string(info->test_case_name()) + "." +
+                                info->name())) {
+    return;
+  }
   if (global_var.thread_num_ == 1) {
     Thread1();
   } else {
@@ -605,6 +658,19 @@ static std::ostringstream print_log(const mluoptest::EvaluateResult &eva,
         << "\n"
         << "[Average MLU Workspace Size    ]: " << eva.mlu.workspace_size
         << " (Bytes)\n";
+    if (eva.mlu.perf_samples >= 0) {
+      out << "[MLU Hardware Time Median      ]: "
+          << eva.mlu.hardware_time_median << " (us)\n"
+          << "[MLU Hardware Time Trimmed Mean]: "
+          << eva.mlu.hardware_time_trimmed_mean << " (us)\n"
+          << "[MLU Hardware Time MAD         ]: " << eva.mlu.hardware_time_mad
+          << " (us)\n"
+          << "[MLU Hardware Time 95% CI      ]: ["
+          << eva.mlu.hardware_time_ci_low << ", "
+          << eva.mlu.hardware_time_ci_high << "] (us)\n"
+          << "[MLU Perf Samples (Outliers)   ]: " << eva.mlu.perf_samples
+          << " (" << eva.mlu.perf_outliers << ")\n";
+    }
   } else {
     out << "[MLU Hardware Time      ]: " << eva.mlu.hardware_time << " (us)\n"
         << "[MLU Interface Time     ]: " << eva.mlu.interface_time << " (us)\n"
@@ -737,6 +803,23 @@ void TestSuite::recordXml(mluoptest::EvaluateResult &er) {
   mhw_cv_oss << std::setprecision(10) << er.mlu.hardware_time_cv;
   this->RecordProperty("hardware_time_cv_mlu", mhw_cv_oss.str());
 
+  // robust perf mode only
+  if (er.mlu.perf_samples >= 0) {
+    auto record_time = [this](const std::string &key, double value) {
+      std::ostringstream oss;
+      oss << std::setprecision(10) << value;
+      this->RecordProperty(key, oss.str());
+    };
+    record_time("hardware_time_median_mlu", er.mlu.hardware_time_median);
+    record_time("hardware_time_trimmed_mean_mlu",
+                er.mlu.hardware_time_trimmed_mean);
+    record_time("hardware_time_mad_mlu", er.mlu.hardware_time_mad);
+    record_time("hardware_time_ci_low_mlu", er.mlu.hardware_time_ci_low);
+    record_time("hardware_time_ci_high_mlu", er.mlu.hardware_time_ci_high);
+    this->RecordProperty("perf_samples_mlu", er.mlu.perf_samples);
+    this->RecordProperty("perf_outliers_mlu", er.mlu.perf_outliers);
+  }
+
   if (0 != er.mlu.hardware_time_layer) {
     std::ostringstream mhwl_oss;
     mhwl_oss << std::setprecision(10) << er.mlu.hardware_time_layer;
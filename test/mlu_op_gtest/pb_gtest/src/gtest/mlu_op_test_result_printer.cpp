@@ -28,7 +28,9 @@
 #include <wctype.h>
 
 #include <algorithm>
+#include <cerrno>
 #include <cmath>
+#include <fstream>
 #include <iomanip>
 #include <sstream>
 
@@ -123,6 +125,7 @@
 
 #include "mlu_op_test_result_printer.h"
 #include "gtest/internal/gtest-filepath.h"
+#include "tools.h"
 
 static const char kUniversalFilter[] = "*";
 static const char *GetDefaultFilter() {
@@ -828,3 +831,211 @@ std::string JsonPrinter::TestPropertiesAsJson(const testing::TestResult &result,
 }
 
 // End JsonPrinter
+
+std::unordered_set<std::string> StreamPrinter::recorded_;
+
+StreamPrinter::StreamPrinter(const char *output_file, bool resume)
+    : output_file_(output_file) {
+  if (output_file_.empty()) {
+    GTEST_LOG_(FATAL) << "Stream output file may not be null";
+  }
+  fsync_interval_ =
+      mluoptest::getEnvInt("MLUOP_GTEST_STREAM_FSYNC_INTERVAL", 5);
+  testing::internal::FilePath output_dir(
+      testing::internal::FilePath(output_file_).RemoveFileName());
+  if (!output_dir.CreateDirectoriesRecursively()) {
+    GTEST_LOG_(FATAL) << "Unable to create directory \""
+                      << output_dir.string() << "\"";
+  }
+  if (resume) {
+    LoadRecords();
+  }
+  fd_ = open(output_file_.c_str(),
+             O_WRONLY | O_CREAT | O_APPEND | (resume ? 0 : O_TRUNC), 0644);
+  if (fd_ < 0) {
+    GTEST_LOG_(FATAL) << "Unable to open file \"" << output_file_ << "\"";
+  }
+  last_sync_ = testing::internal::GetTimeInMillis();
+}
+
+StreamPrinter::~StreamPrinter() {
+  if (fd_ >= 0) {
+    Sync();
+    close(fd_);
+  }
+}
+
+bool StreamPrinter::isRecorded(const std::string &full_name) {
+  return recorded_.find(full_name) != recorded_.end();
+}
+
+void StreamPrinter::OnTestEnd(const testing::TestInfo &test_info) {
+  if (isRecorded(std::string(test_info.test_case_name()) + "." +
+                 test_info.name())) {
+    return;  // skipped, keep the resumed record.
+  }
+  // a whole line per write(), so a crash leaves at most one partial line.
+  const std::string line = TestInfoAsJsonLine(test_info);
+  const char *data = line.c_str();
+  size_t left = line.size();
+  while (left > 0) {
+    ssize_t n = write(fd_, data, left);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      GTEST_LOG_(FATAL) << "Unable to write file \"" << output_file_ << "\"";
+    }
+    data += n;
+    left -= n;
+  }
+  if (testing::internal::GetTimeInMillis() - last_sync_ >=
+      fsync_interval_ * 1000) {
+    Sync();
+  }
+}
+
+void StreamPrinter::OnTestProgramEnd(const testing::UnitTest &unit_test) {
+  Sync();
+}
+
+void StreamPrinter::Sync() {
+  fsync(fd_);
+  last_sync_ = testing::internal::GetTimeInMillis();
+}
+
+// One line per test: testsuite and name come first, then the keys of a
+// JsonPrinter testcase, with the properties nested in "properties".
+std::string StreamPrinter::TestInfoAsJsonLine(
+    const testing::TestInfo &test_info) {
+  const testing::TestResult &result = *test_info.result();
+  std::stringstream stream;
+  auto key = [&stream](const std::string &name, const std::string &value) {
+    stream << "\"" << name << "\": \"" << JsonPrinter::EscapeJson(value)
+           << "\"";
+  };
+  stream << "{";
+  key("testsuite", test_info.test_case_name());
+  stream << ", ";
+  key("name", test_info.name());
+  if (test_info.value_param() != NULL) {
+    stream << ", ";
+    key("value_param", test_info.value_param());
+  }
+  if (test_info.type_param() != NULL) {
+    stream << ", ";
+    key("type_param", test_info.type_param());
+  }
+  stream << ", ";
+  key("status", test_info.should_run() ? "RUN" : "NOTRUN");
+  stream << ", ";
+  key("time", FormatTimeInMillisAsDuration(result.elapsed_time()));
+  stream << ", ";
+  key("classname", test_info.test_case_name());
+
+  stream << ", \"properties\": {";
+  for (int i = 0; i < result.test_property_count(); ++i) {
+    const testing::TestProperty &property = result.GetTestProperty(i);
+    stream << (i == 0 ? "" : ", ");
+    key(property.key(), property.value());
+  }
+  stream << "}";
+
+  int failures = 0;
+  for (int i = 0; i < result.total_part_count(); ++i) {
+    const testing::TestPartResult &part = result.GetTestPartResult(i);
+    if (part.failed()) {
+      stream << (++failures == 1 ? ", \"failures\": [{" : ", {");
+      const std::string location =
+          testing::internal::FormatCompilerIndependentFileLocation(
+              part.file_name(), part.line_number());
+      key("failure", location + "\n" + part.message());
+      stream << ", ";
+      key("message", location + "\n" + part.summary());
+      stream << ", ";
+      key("type", "");
+      stream << "}";
+    }
+  }
+  if (failures > 0) stream << "]";
+  stream << "}\n";
+  return stream.str();
+}
+
+bool StreamPrinter::ReadJsonLineKey(const std::string &line,
+                                    const std::string &key,
+                                    std::string *value) {
+  const std::string pattern = "\"" + key + "\": \"";
+  size_t pos = line.find(pattern);
+  if (pos == std::string::npos) {
+    return false;
+  }
+  value->clear();
+  for (pos += pattern.size(); pos < line.size(); ++pos) {
+    char ch = line[pos];
+    if (ch == '"') {
+      return true;
+    }
+    if (ch != '\\') {
+      value->push_back(ch);
+      continue;
+    }
+    if (++pos >= line.size()) {
+      return false;
+    }
+    switch (line[pos]) {
+      case 'b':
+        value->push_back('\b');
+        break;
+      case 't':
+        value->push_back('\t');
+        break;
+      case 'n':
+        value->push_back('\n');
+        break;
+      case 'f':
+        value->push_back('\f');
+        break;
+      case 'r':
+        value->push_back('\r');
+        break;
+      case 'u':  // EscapeJson only writes \u00XX
+        if (pos + 4 >= line.size()) {
+          return false;
+        }
+        value->push_back(static_cast<char>(
+            std::stoi(line.substr(pos + 3, 2), nullptr, 16)));
+        pos += 4;
+        break;
+      default:
+        value->push_back(line[pos]);
+        break;
+    }
+  }
+  return false;
+}
+
+void StreamPrinter::LoadRecords() {
+  std::ifstream in(output_file_);
+  if (!in) {
+    return;  // nothing to resume.
+  }
+  std::string line;
+  off_t complete = 0;  // size of the complete lines.
+  while (std::getline(in, line) && !in.eof()) {
+    complete += line.size() + 1;
+    std::string test_case_name, name;
+    if (ReadJsonLineKey(line, "testsuite", &test_case_name) &&
+        ReadJsonLineKey(line, "name", &name)) {
+      recorded_.insert(test_case_name + "." + name);
+    }
+  }
+  in.close();
+  if (truncate(output_file_.c_str(), complete) != 0) {
+    GTEST_LOG_(FATAL) << "Unable to truncate file \"" << output_file_ << "\"";
+  }
+  GTEST_LOG_(INFO) << "Resume " << output_file_ << ", skip " << recorded_.size()
+                   << " recorded tests.";
+}
+
+// End StreamPrinter
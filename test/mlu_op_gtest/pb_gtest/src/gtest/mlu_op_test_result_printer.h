@@ -26,6 +26,7 @@
 #include <limits>
 #include <ostream>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "gtest/internal/gtest-internal.h"
@@ -159,6 +160,50 @@ class JsonPrinter : public testing::EmptyTestEventListener {
   // The output file.
   const std::string output_file_;
 
+  friend class StreamPrinter;
   GTEST_DISALLOW_COPY_AND_ASSIGN_(JsonPrinter);
 };
+
+// Appends one JSON line per test to the output file as soon as the test ends,
+// instead of printing all the results at the end of the run like xmlPrinter
+// and JsonPrinter do. A crash loses at most the running test. The file is
+// fsync'ed every MLUOP_GTEST_STREAM_FSYNC_INTERVAL seconds (0 for every
+// line), and tools/merge_result.py merges such files into a xml/json report.
+class StreamPrinter : public testing::EmptyTestEventListener {
+ public:
+  // If resume, the lines already in output_file are kept, and the tests they
+  // record are reported by isRecorded() and are not printed again.
+  StreamPrinter(const char *output_file, bool resume);
+  virtual ~StreamPrinter();
+
+  virtual void OnTestEnd(const testing::TestInfo &test_info);
+  virtual void OnTestProgramEnd(const testing::UnitTest &unit_test);
+
+  // Whether the test "test_case_name.name" is recorded in the resumed file.
+  static bool isRecorded(const std::string &full_name);
+
+ private:
+  // Returns the record of a finished test as one line of JSON.
+  static std::string TestInfoAsJsonLine(const testing::TestInfo &test_info);
+
+  // Reads the value of key from a line written by TestInfoAsJsonLine.
+  static bool ReadJsonLineKey(const std::string &line, const std::string &key,
+                              std::string *value);
+
+  // Collects the recorded tests, and drops the partial last line a crash
+  // may have left.
+  void LoadRecords();
+
+  void Sync();
+
+  // The output file.
+  const std::string output_file_;
+  int fd_ = -1;
+  int fsync_interval_;  // in seconds
+  testing::internal::TimeInMillis last_sync_ = 0;
+
+  static std::unordered_set<std::string> recorded_;
+
+  GTEST_DISALLOW_COPY_AND_ASSIGN_(StreamPrinter);
+};
 #endif  // TEST_MLU_OP_GTEST_SRC_GTEST_TEST_RESULT_PRINTER_H_
@@ -20,7 +20,18 @@
  * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *************************************************************************/
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "perf_test.h"
 #include "core/logging.h"
 #include "json.h"
@@ -30,6 +41,277 @@
 #define DEFAULT_THRESHOLD_ABSOLUTE (5)
 #define DEFAULT_THRESHOLD_RELATIVE (0.04f)
 
+namespace {
+
+struct TxtBaseline {
+  double hw_time = 0;
+  double workspace_size = 0;
+};
+
+// sorted binary index of a baseline txt, mmap'ed read-only:
+// header, records sorted by (hash, txt order), then the case names.
+struct TxtIndexHeader {
+  char magic[8];
+  uint64_t count;
+  // index is rebuilt when txt size or content changes, not on mtime:
+  // convertBaselineXml2Txt() rewrites the same txt every run.
+  uint64_t txt_size;
+  uint64_t txt_hash;
+};
+struct TxtIndexRecord {
+  uint64_t hash;
+  uint64_t name_offset;  // from the start of index file
+  uint64_t name_len;
+  double hw_time;
+  double workspace_size;
+};
+const char TXT_INDEX_MAGIC[8] = {'M', 'L', 'U', 'O', 'P', 'B', 'I', '2'};
+// txt bigger than this is looked up through the index by default.
+const size_t TXT_INDEX_AUTO_BYTES = 64 << 20;
+
+uint64_t fnv1a(const char *str, size_t len) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ (unsigned char)str[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// fnv1a on 8 bytes words of the whole file, ~0.4s for a 1GB txt.
+bool hashFile(const std::string &file_name, uint64_t *hash) {
+  std::ifstream file(file_name.c_str(), std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  uint64_t h = 14695981039346656037ULL;
+  std::vector<uint64_t> buf(1 << 17);
+  while (file) {
+    file.read((char *)buf.data(), buf.size() * sizeof(uint64_t));
+    size_t bytes = file.gcount();
+    // zero the tail word, file size is checked separately.
+    memset((char *)buf.data() + bytes, 0, (-bytes) & 7);
+    for (size_t i = 0; i < (bytes + 7) / 8; ++i) {
+      h = (h ^ buf[i]) * 1099511628211ULL;
+    }
+  }
+  *hash = h;
+  return !file.bad();
+}
+
+// "<name value=xxx/>" -> name and xxx.
+bool parseTxtLine(const std::string &line, std::string *name, double *value) {
+  auto start = line.find('<');
+  auto mid = line.find(" value=");
+  auto end = line.rfind("/>");
+  if (start == std::string::npos || mid == std::string::npos ||
+      end == std::string::npos || mid < start || end < mid) {
+    return false;
+  }
+  *name = line.substr(start + 1, mid - start - 1);
+  *value = atof(line.substr(mid + 7, end - mid - 7).c_str());
+  return true;
+}
+
+// the txt written by convertBaselineXml2Txt(), 2 lines per case:
+//   <case_file_name value=hardware_time_base/>
+//   <workspace_size_mlu value=workspace_size/>
+// func is called per case in file order.
+bool readTxtBaseline(
+    const std::string &txt_file,
+    const std::function<void(const std::string &, const TxtBaseline &)>
+        &func) {
+  std::ifstream file(txt_file.c_str(), std::fstream::in);
+  if (!file.is_open()) {
+    LOG(ERROR) << "getTxtData: failed to open file " << txt_file << "\n";
+    return false;
+  }
+  std::string line, name, pending_name;
+  double value = 0;
+  TxtBaseline pending;
+  bool has_pending = false;
+  while (getline(file, line)) {
+    if (!parseTxtLine(line, &name, &value)) {
+      continue;
+    }
+    if (name == "workspace_size_mlu") {
+      if (has_pending) {
+        pending.workspace_size = value;
+        func(pending_name, pending);
+        has_pending = false;
+      }
+      continue;
+    }
+    if (has_pending) {  // no workspace line
+      func(pending_name, pending);
+    }
+    pending_name = name;
+    pending.hw_time = value;
+    pending.workspace_size = 0;
+    has_pending = true;
+  }
+  if (has_pending) {
+    func(pending_name, pending);
+  }
+  return true;
+}
+
+// baseline of all cases, loaded once and shared read-only by all threads.
+// small txt goes to a hash map; big txt (or MLUOP_GTEST_PERF_BASELINE_INDEX
+// =ON) goes to <txt>.idx, which is built once and then mmap'ed.
+class TxtBaselineStore {
+ public:
+  static TxtBaselineStore &get(const std::string &txt_file) {
+    static TxtBaselineStore store(txt_file);
+    return store;
+  }
+  ~TxtBaselineStore() {
+    if (index_ != nullptr) {
+      munmap((void *)index_, index_bytes_);
+    }
+  }
+
+  bool find(const std::string &case_name, TxtBaseline *res) const {
+    if (index_ != nullptr) {
+      return findInIndex(case_name, res);
+    }
+    auto it = map_.find(case_name);
+    if (it == map_.end()) {
+      return false;
+    }
+    *res = it->second;
+    return true;
+  }
+
+ private:
+  explicit TxtBaselineStore(const std::string &txt_file) {
+    struct stat txt_stat;
+    if (stat(txt_file.c_str(), &txt_stat) != 0) {
+      LOG(ERROR) << "getTxtData: failed to open file " << txt_file << "\n";
+      return;
+    }
+    const char *index_env = std::getenv("MLUOP_GTEST_PERF_BASELINE_INDEX");
+    bool use_index = index_env != NULL
+                         ? std::string(index_env).compare("ON") == 0
+                         : (size_t)txt_stat.st_size >= TXT_INDEX_AUTO_BYTES;
+    uint64_t txt_hash = 0;
+    if (use_index && hashFile(txt_file, &txt_hash)) {
+      std::string index_file = txt_file + ".idx";
+      if (openIndex(index_file, txt_stat, txt_hash) ||
+          (buildIndex(txt_file, index_file, txt_stat, txt_hash) &&
+           openIndex(index_file, txt_stat, txt_hash))) {
+        return;
+      }
+      LOG(WARNING) << "getTxtData: failed to use index " << index_file
+                   << ", load " << txt_file << " to memory.";
+    }
+    // keep the first one if a case appears twice, as the linear scan did.
+    readTxtBaseline(txt_file,
+                    [this](const std::string &name, const TxtBaseline &base) {
+                      map_.emplace(name, base);
+                    });
+  }
+
+  bool openIndex(const std::string &index_file, const struct stat &txt_stat,
+                 uint64_t txt_hash) {
+    int fd = open(index_file.c_str(), O_RDONLY);
+    if (fd == -1) {
+      return false;
+    }
+    struct stat index_stat;
+    void *addr = MAP_FAILED;
+    if (fstat(fd, &index_stat) == 0 &&
+        (size_t)index_stat.st_size >= sizeof(TxtIndexHeader)) {
+      addr = mmap(nullptr, index_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (addr == MAP_FAILED) {
+      return false;
+    }
+    auto header = (const TxtIndexHeader *)addr;
+    if (memcmp(header->magic, TXT_INDEX_MAGIC, sizeof(TXT_INDEX_MAGIC)) != 0 ||
+        header->txt_size != (uint64_t)txt_stat.st_size ||
+        header->txt_hash != txt_hash ||
+        sizeof(TxtIndexHeader) + header->count * sizeof(TxtIndexRecord) >
+            (size_t)index_stat.st_size) {
+      munmap(addr, index_stat.st_size);
+      return false;  // stale, rebuild it.
+    }
+    index_ = (const char *)addr;
+    index_bytes_ = index_stat.st_size;
+    return true;
+  }
+
+  bool buildIndex(const std::string &txt_file, const std::string &index_file,
+                  const struct stat &txt_stat, uint64_t txt_hash) {
+    std::vector<TxtIndexRecord> records;
+    std::string names;
+    bool read_ok = readTxtBaseline(
+        txt_file, [&](const std::string &name, const TxtBaseline &base) {
+          records.push_back({fnv1a(name.data(), name.size()), names.size(),
+                             name.size(), base.hw_time, base.workspace_size});
+          names += name;
+        });
+    if (!read_ok) {
+      return false;
+    }
+    std::stable_sort(records.begin(), records.end(),
+                     [](const TxtIndexRecord &a, const TxtIndexRecord &b) {
+                       return a.hash < b.hash;
+                     });
+    uint64_t names_offset =
+        sizeof(TxtIndexHeader) + records.size() * sizeof(TxtIndexRecord);
+    for (auto &record : records) {
+      record.name_offset += names_offset;
+    }
+    TxtIndexHeader header;
+    memcpy(header.magic, TXT_INDEX_MAGIC, sizeof(TXT_INDEX_MAGIC));
+    header.count = records.size();
+    header.txt_size = txt_stat.st_size;
+    header.txt_hash = txt_hash;
+
+    // other processes may read the same index, publish it by rename.
+    std::string tmp_file =
+        index_file + ".tmp." + std::to_string((int64_t)getpid());
+    std::ofstream out(tmp_file, std::ios::binary | std::ios::trunc);
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)records.data(),
+              records.size() * sizeof(TxtIndexRecord));
+    out.write(names.data(), names.size());
+    out.close();
+    if (!out || rename(tmp_file.c_str(), index_file.c_str()) != 0) {
+      remove(tmp_file.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  bool findInIndex(const std::string &case_name, TxtBaseline *res) const {
+    auto header = (const TxtIndexHeader *)index_;
+    auto begin = (const TxtIndexRecord *)(index_ + sizeof(TxtIndexHeader));
+    auto end = begin + header->count;
+    uint64_t hash = fnv1a(case_name.data(), case_name.size());
+    auto it = std::lower_bound(
+        begin, end, hash,
+        [](const TxtIndexRecord &r, uint64_t h) { return r.hash < h; });
+    for (; it != end && it->hash == hash; ++it) {
+      if (it->name_offset + it->name_len <= index_bytes_ &&
+          case_name.compare(0, std::string::npos, index_ + it->name_offset,
+                            it->name_len) == 0) {
+        res->hw_time = it->hw_time;
+        res->workspace_size = it->workspace_size;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::unordered_map<std::string, TxtBaseline> map_;
+  const char *index_ = nullptr;
+  size_t index_bytes_ = 0;
+};
+
+}  // namespace
+
 // get hardware_time and workspace_size from txt file for better perfermance
 bool getTxtData(std::string case_name, double *txt_time,
                 double *workspace_size) {
@@ -49,30 +331,12 @@ bool getTxtData(std::string case_name, double *txt_time,
     return is_get;
   }
 
-  std::ifstream file(txt_file.c_str(), std::fstream::in);
-  if (!file.is_open()) {
-    LOG(ERROR) << "getTxtData: failed to open file " << txt_file << "\n";
-    return is_get;
-  }
-  std::string hw_input, ws_input, result;
-  std::string::size_type start, end;
-  while (getline(file, hw_input)) {
-    if (hw_input.find(case_name.c_str()) != std::string::npos) {
-      // get hard_time_base
-      start = hw_input.find_last_of("value=");
-      end = hw_input.find_last_of("/");
-      result = hw_input.substr(start + 1, end - start - 1);
-      *txt_time = atof(result.c_str());
-
-      // get workspace_size_base
-      getline(file, ws_input);
-      start = ws_input.find_last_of("value=");
-      end = ws_input.find_last_of("/");
-      result = ws_input.substr(start + 1, end - start - 1);
-      *workspace_size = atof(result.c_str());
-      is_get = true;
-      break;
-    }
+  // keyed by exact case file name.
+  TxtBaseline base;
+  if (TxtBaselineStore::get(txt_file).find(case_name, &base)) {
+    *txt_time = base.hw_time;
+    *workspace_size = base.workspace_size;
+    is_get = true;
   }
 
   return is_get;
@@ -91,73 +355,89 @@ std::string getTestCaseName(std::string str) {
   return result;
 }
 
-// get threshold from json config file
-bool getThreshold(std::string op_name, double *scale_bound,
-                  double *threshold_absolute, double *threshold_relative) {
-  // init for default config
+namespace {
+
+struct PerfThreshold {
   bool in_white_list = false;
-  *scale_bound = DEFAULT_SCALE_BOUND;
-  *threshold_absolute = DEFAULT_THRESHOLD_ABSOLUTE;
-  *threshold_relative = DEFAULT_THRESHOLD_RELATIVE;
+  double scale_bound = DEFAULT_SCALE_BOUND;
+  double threshold_absolute = DEFAULT_THRESHOLD_ABSOLUTE;
+  double threshold_relative = DEFAULT_THRESHOLD_RELATIVE;
+};
 
-  std::string file_path;
-  if (getenv("MLUOP_GTEST_THRESHOLD_FILE") != NULL) {
-    file_path = getenv("MLUOP_GTEST_THRESHOLD_FILE");
-  } else {
-    LOG(INFO) << "getThreshold:The env of MLUOP_GTEST_THERSHOLD_FILE is NULL";
-    LOG(INFO) << "getThreshold:Use default threshold set";
-    return in_white_list;
-  }
-
-  Json::Value root;
-  Json::CharReaderBuilder build;
-  std::string errs;
-  std::fstream f;
-  f.open(file_path, std::ios::in);
-  if (!f.is_open()) {
-    LOG(INFO) << "getThreshold:Open json file error!";
-    LOG(INFO) << "getThreshold:Use default threshold set";
-    return in_white_list;
-  }
-
-  bool parse_ok = Json::parseFromStream(build, f, &root, &errs);
-  if (!parse_ok) {
-    LOG(INFO) << "getThreshold:Parse json file error!";
-    LOG(INFO) << "getThreshold:Use default threshold set";
+// threshold json parsed once, root[0] is the default of ops not listed.
+class PerfThresholdStore {
+ public:
+  static const PerfThresholdStore &get() {
+    static PerfThresholdStore store;
+    return store;
+  }
+  const PerfThreshold &find(const std::string &op_name) const {
+    auto it = ops_.find(op_name);
+    return it == ops_.end() ? default_ : it->second;
+  }
+
+ private:
+  PerfThresholdStore() {
+    std::string file_path;
+    if (getenv("MLUOP_GTEST_THRESHOLD_FILE") != NULL) {
+      file_path = getenv("MLUOP_GTEST_THRESHOLD_FILE");
+    } else {
+      LOG(INFO) << "getThreshold:The env of MLUOP_GTEST_THERSHOLD_FILE is NULL";
+      LOG(INFO) << "getThreshold:Use default threshold set";
+      return;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder build;
+    std::string errs;
+    std::fstream f;
+    f.open(file_path, std::ios::in);
+    if (!f.is_open()) {
+      LOG(INFO) << "getThreshold:Open json file error!";
+      LOG(INFO) << "getThreshold:Use default threshold set";
+      return;
+    }
+
+    bool parse_ok = Json::parseFromStream(build, f, &root, &errs);
     f.close();
-    return in_white_list;
-  }
-
-  // get default threshold from json file
-  in_white_list = root[0]["in_white_list"].asBool();
-  double scale_bound_temp =
-      root[0]["threshold_attrs"]["scale_bound"].asDouble();
-  double threshold_absolute_temp =
-      root[0]["threshold_attrs"]["threshold_absolute"].asDouble();
-  double threshold_relative_temp =
-      root[0]["threshold_attrs"]["threshold_relative"].asDouble();
-  int i = 0;
-  while (i < root.size()) {
-    std::string name = root[i]["op_name"].asString();
-    if (strcmp(op_name.c_str(), name.c_str()) == 0) {
-      in_white_list = root[i]["in_white_list"].asBool();
-      scale_bound_temp = root[i]["threshold_attrs"]["scale_bound"].asDouble();
-      threshold_absolute_temp =
-          root[i]["threshold_attrs"]["threshold_absolute"].asDouble();
-      threshold_relative_temp =
-          root[i]["threshold_attrs"]["threshold_relative"].asDouble();
-      break;
-    }
-    ++i;
-  }
-
-  *scale_bound = scale_bound_temp;
-  *threshold_absolute = threshold_absolute_temp;
-  *threshold_relative = threshold_relative_temp;
-
-  f.close();
-
-  return in_white_list;
+    if (!parse_ok) {
+      LOG(INFO) << "getThreshold:Parse json file error!";
+      LOG(INFO) << "getThreshold:Use default threshold set";
+      return;
+    }
+
+    auto to_threshold = [](const Json::Value &item) {
+      PerfThreshold res;
+      res.in_white_list = item["in_white_list"].asBool();
+      res.scale_bound = item["threshold_attrs"]["scale_bound"].asDouble();
+      res.threshold_absolute =
+          item["threshold_attrs"]["threshold_absolute"].asDouble();
+      res.threshold_relative =
+          item["threshold_attrs"]["threshold_relative"].asDouble();
+      return res;
+    };
+    // get default threshold from json file
+    default_ = to_threshold(root[0]);
+    for (int i = 0; i < root.size(); ++i) {
+      // the first entry of an op wins.
+      ops_.emplace(root[i]["op_name"].asString(), to_threshold(root[i]));
+    }
+  }
+
+  PerfThreshold default_;
+  std::unordered_map<std::string, PerfThreshold> ops_;
+};
+
+}  // namespace
+
+// get threshold from json config file
+bool getThreshold(std::string op_name, double *scale_bound,
+                  double *threshold_absolute, double *threshold_relative) {
+  const PerfThreshold &threshold = PerfThresholdStore::get().find(op_name);
+  *scale_bound = threshold.scale_bound;
+  *threshold_absolute = threshold.threshold_absolute;
+  *threshold_relative = threshold.threshold_relative;
+  return threshold.in_white_list;
 }
 
 // update baseline hardware_time_base
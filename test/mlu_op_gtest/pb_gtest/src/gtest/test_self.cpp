@@ -21,13 +21,23 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *************************************************************************/
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cfloat>
+#include <climits>
+#include <cstdlib>
 #include <cstdint>
 #include <cstring>
 #include <cmath>
 #include <random>
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
+#include <thread>  // NOLINT
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "cnrt.h"
@@ -36,6 +46,35 @@
 #include "tools.h"
 #include "variable.h"
 #include "math_half.h"
+#include "math_cast.h"
+#include "evaluator.h"
+#include "thread_pool.h"
+#include "baseline_cache.h"
+#include "case_archive.h"
+#include "tensor_file_ref.h"
+#include "stride.h"
+#include "cpu_gemm.h"
+#include "perf_stats.h"
+#include "coord_hash.h"
+#include "get_indice_pairs/get_indice_pairs_impl.h"
+#include "generate_proposals_v2/generate_proposals_v2_impl.h"
+#include "nms/nms_impl.h"
+#include "nms/nms3D_utils.h"
+#include "nms_rotated/nms_rotated_impl.h"
+#include "voxelization/voxelization_impl.h"
+#include "box_grid.h"
+#include "box_bvh.h"
+#include "point_index.h"
+#include "bilinear_sample.h"
+#include "border_align_forward/border_align_forward_impl.h"
+#include "ms_deform_attn_forward/ms_deform_attn_forward_impl.h"
+#include "roialign_forward/roialign_forward_impl.h"
+#include "roiaware_pool3d_forward/roiaware_pool3d_forward_impl.h"
+#include "roipoint_pool3d/roipoint_pool3d_impl.h"
+#include "rotated_iou.h"
+#include "poly_nms/pnms_impl.h"
+#include "internal_kernel/transpose_cpu/transpose_cpu.h"
+#include "core/tool.h"
 
 template <typename T>
 std::string to_hex_str(T input) {
@@ -135,4 +174,2580 @@ TEST(DISABLED_ArrayCastHalfToFloatSelfTest, TEST) {
   // delete [] dst_base;
   // delete [] dst_compare;
 }
+
+// simd float -> half in math_cast.h should give the same bits as cnrt,
+// set MLUOP_GTEST_CAST_ISA=avx2/scalar to check the other code path.
+TEST(DISABLED_ArrayCastFloatToHalfSelfTest, TEST) {
+  std::cout << "cast isa: " << mluoptest::castIsaName() << "\n";
+  // every float whose low 12 bits are a few rounding patterns, covering
+  // all exponents, subnormal, overflow, inf and nan.
+  const std::array<uint32_t, 6> lows = {0x000, 0x001, 0x7ff,
+                                        0x800, 0x801, 0xfff};
+  std::vector<float> src;
+  for (uint64_t high = 0; high < (1ull << 32); high += 0x1000) {
+    for (auto low : lows) {
+      uint32_t bits = (uint32_t)high | low;
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      src.push_back(value);
+    }
+  }
+  const size_t len = src.size();
+  std::vector<uint16_t> dst_base(len);
+  std::vector<int16_t> dst_compare(len);
+  for (size_t begin = 0; begin < len; begin += INT_MAX) {
+    int count = (int)std::min(len - begin, (size_t)INT_MAX);
+    ASSERT_EQ(cnrtSuccess,
+              cnrtCastDataType_V2(src.data() + begin, cnrtFloat,
+                                  dst_base.data() + begin, cnrtHalf, count,
+                                  NULL, cnrtRounding_rm));
+  }
+  // odd offset to cover the scalar tail.
+  mluoptest::arrayCastFloatToHalf(dst_compare.data() + 3, src.data() + 3,
+                                  len - 3);
+  mluoptest::arrayCastFloatToHalf(dst_compare.data(), src.data(), 3);
+  size_t mismatch = 0;
+  for (size_t i = 0; i < len; i++) {
+    uint16_t compare = (uint16_t)dst_compare[i];
+    // nan payload is not compared, same as ArrayCastHalfToFloatSelfTest
+    bool both_nan =
+        (dst_base[i] & 0x7fff) > 0x7c00 && (compare & 0x7fff) > 0x7c00;
+    if (compare != dst_base[i] && !both_nan && mismatch++ < 16) {
+      ADD_FAILURE() << "src=" << to_hex_str(src[i]) << " conversion failed. "
+                    << "should be " << to_hex_str(dst_base[i]) << ", not "
+                    << to_hex_str(compare);
+    }
+  }
+  EXPECT_EQ(0, mismatch);
+}
+
+// plain integer float -> half, round to nearest even, overflow to inf, nan
+// keeps sign and high payload bits with quiet bit set, as vcvtps2ph does.
+uint16_t refFloatToHalf(uint32_t bits) {
+  const uint16_t sign = (bits >> 16) & 0x8000;
+  const int exp = (bits >> 23) & 0xff;
+  const uint32_t mant = bits & 0x7fffff;
+  if (exp == 0xff) {
+    return sign | (mant != 0 ? 0x7e00 | (mant >> 13) : 0x7c00);
+  }
+  if (exp == 0) {  // float subnormal is far below half of 2^-24
+    return sign;
+  }
+  // value = m * 2^(e - 23), keep 11 bits for normal half, less for subnormal
+  const int e = exp - 127;
+  const uint32_t m = mant | 0x800000;
+  const int shift = e >= -14 ? 13 : 13 - 14 - e;
+  if (shift > 24) {  // m < 2^24 is below half of the last kept bit
+    return sign;
+  }
+  uint32_t q = m >> shift;
+  const uint32_t rem = m & ((1u << shift) - 1);
+  const uint32_t half = 1u << (shift - 1);
+  if (rem > half || (rem == half && (q & 1))) {
+    q++;
+  }
+  // for normal half q has the implicit bit, a carry bumps the exponent
+  uint32_t h = e >= -14 ? ((uint32_t)(e + 14) << 10) + q : q;
+  return sign | (uint16_t)std::min(h, (uint32_t)0x7c00);
+}
+
+// arrayCastFloatToHalf vs refFloatToHalf on every float, cnrt free.
+// set MLUOP_GTEST_CAST_ISA=avx2/scalar to check the other code path.
+TEST(ArrayCastFloatToHalfSelfTest, MATCH_SOFTWARE) {
+  std::cout << "cast isa: " << mluoptest::castIsaName() << "\n";
+  constexpr size_t block = 1 << 24;
+  std::vector<float> src(block);
+  std::vector<int16_t> dst(block);
+  std::vector<uint16_t> expect(block);
+  size_t mismatch = 0;
+  for (uint64_t begin = 0; begin < (1ull << 32); begin += block) {
+#pragma omp parallel for
+    for (size_t i = 0; i < block; i++) {
+      uint32_t bits = (uint32_t)(begin + i);
+      memcpy(&src[i], &bits, sizeof(bits));
+      expect[i] = refFloatToHalf(bits);
+    }
+    // odd offset to cover the scalar tail.
+    mluoptest::arrayCastFloatToHalf(dst.data() + 3, src.data() + 3,
+                                    block - 3);
+    mluoptest::arrayCastFloatToHalf(dst.data(), src.data(), 3);
+    for (size_t i = 0; i < block; i++) {
+      if ((uint16_t)dst[i] != expect[i] && mismatch++ < 16) {
+        ADD_FAILURE() << "src=" << to_hex_str(src[i]) << " conversion failed. "
+                      << "should be " << to_hex_str(expect[i]) << ", not "
+                      << to_hex_str(dst[i]);
+      }
+    }
+  }
+  EXPECT_EQ(0, mismatch);
+}
+
+// DIFF4 on 1e8 elements, memory used by DIFF4 should not grow with count.
+TEST(DISABLED_EvaluatorDiff4SelfTest, BENCHMARK) {
+  constexpr size_t len = 100000000;
+  std::vector<float> base(len);
+  std::vector<float> mlu(len);
+  std::mt19937 gen(23);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (size_t i = 0; i < len; i++) {
+    base[i] = dist(gen);
+    mlu[i] = base[i] + ((i % 3 == 0) ? 1e-3f : ((i % 3 == 1) ? -1e-3f : 0));
+  }
+  std::set<mluoptest::Evaluator::Criterion> criterions = {
+      mluoptest::Evaluator::Criterion(mluoptest::Evaluator::DIFF4, 0)};
+
+  auto eva_unbiased = std::make_shared<mluoptest::Evaluator>();
+  eva_unbiased->setStorageDtype(mluoptest::VOID);
+  auto start = std::chrono::steady_clock::now();
+  eva_unbiased->computeDiff(base.data(), mlu.data(), len, criterions,
+                            "unbiased", MLUOP_DTYPE_FLOAT);
+  auto end = std::chrono::steady_clock::now();
+  EXPECT_TRUE(eva_unbiased->isPassed());
+  EXPECT_NEAR(eva_unbiased->errors()[0].error, 0.5, 1e-3);
+  std::cout << "DIFF4 of " << len << " elements costs "
+            << std::chrono::duration<double, std::milli>(end - start).count()
+            << " ms.\n";
+
+  for (size_t i = 0; i < len; i++) {
+    mlu[i] = base[i] + ((i % 2 == 0) ? 1e-3f : 0);
+  }
+  auto eva_biased = std::make_shared<mluoptest::Evaluator>();
+  eva_biased->setStorageDtype(mluoptest::VOID);
+  eva_biased->computeDiff(base.data(), mlu.data(), len, criterions, "biased",
+                          MLUOP_DTYPE_FLOAT);
+  EXPECT_FALSE(eva_biased->isPassed());
+  EXPECT_EQ(eva_biased->errors()[0].error, 0.0);
+}
+
+// diffs fed in chunks match computeDiff(): max based ones bit for bit, sums
+// up to rounding. DIFF_KL is never streamed: Executor::useStreamDiff() falls
+// back to the whole output.
+TEST(EvaluatorSelfTest, STREAM_CHUNKS) {
+  constexpr size_t len = 1000;
+  std::vector<float> base(len), mlu(len);
+  std::mt19937 gen(5);
+  std::uniform_real_distribution<float> dist(0.1f, 1.0f);
+  for (size_t i = 0; i < len; i++) {
+    base[i] = dist(gen);
+    mlu[i] = base[i] * (1 + (dist(gen) - 0.5f) * 1e-3f);
+  }
+  using mluoptest::Evaluator;
+  const std::set<Evaluator::Criterion> streamable = {
+      Evaluator::Criterion(Evaluator::DIFF1, 1e-2),
+      Evaluator::Criterion(Evaluator::DIFF2, 1e-2),
+      Evaluator::Criterion(Evaluator::DIFF3, 1e-2),
+      Evaluator::Criterion(Evaluator::DIFF4, 1)};
+  std::set<Evaluator::Criterion> with_kl = streamable;
+  with_kl.insert(Evaluator::Criterion(Evaluator::DIFF_KL, 1e-2, false));
+  EXPECT_TRUE(Evaluator::canStream(streamable));
+  EXPECT_FALSE(Evaluator::canStream(with_kl));
+  EXPECT_FALSE(Evaluator::canStream(
+      {Evaluator::Criterion(Evaluator::DIFF_KL, 0.5)}));
+
+  Evaluator whole, chunked;
+  whole.setStorageDtype(mluoptest::VOID);
+  chunked.setStorageDtype(mluoptest::VOID);
+  whole.computeDiff(base.data(), mlu.data(), len, streamable, "out",
+                    MLUOP_DTYPE_FLOAT);
+  chunked.beginDiff(len, streamable, "out", MLUOP_DTYPE_FLOAT);
+  for (size_t begin = 0; begin < len; begin += 64) {
+    chunked.computeDiffChunk(base.data() + begin, mlu.data() + begin,
+                             std::min((size_t)64, len - begin));
+  }
+  chunked.endDiff();
+  ASSERT_EQ(whole.errors().size(), chunked.errors().size());
+  for (size_t i = 0; i < whole.errors().size(); i++) {
+    const double error = whole.errors()[i].error;
+    EXPECT_NEAR(error, chunked.errors()[i].error, error * 1e-12);
+  }
+  EXPECT_EQ(whole.isPassed(), chunked.isPassed());
+
+  // the fallback: DIFF_KL over the whole output in one call
+  Evaluator kl;
+  kl.setStorageDtype(mluoptest::VOID);
+  kl.computeDiff(base.data(), mlu.data(), len, with_kl, "out",
+                 MLUOP_DTYPE_FLOAT);
+  ASSERT_EQ(with_kl.size(), kl.errors().size());
+  EXPECT_TRUE(kl.isPassed());
+}
+
+// stride_map before dims were collapsed: one element at a time, recursing
+// per dim. it names dst_stride the strides of src and the other way around,
+// tensor_stride_in and tensor_stride_out passed them accordingly.
+void oldStrideMap(void *dst, void *src, const std::vector<size_t> &shape,
+                  const std::vector<size_t> &dst_stride,
+                  const std::vector<size_t> &src_stride, size_t dst_offset,
+                  size_t src_offset, size_t d, size_t sizeof_dtype) {
+  if (d == shape.size() - 1) {
+    for (size_t i = 0; i < shape[d]; ++i) {
+      size_t dst_idx = src_offset + i * src_stride[d];
+      size_t src_idx = dst_offset + i * dst_stride[d];
+      memcpy((char *)dst + dst_idx * sizeof_dtype,
+             (char *)src + src_idx * sizeof_dtype, sizeof_dtype);
+    }
+  } else {
+    for (size_t i = 0; i < shape[d]; ++i) {
+      oldStrideMap(dst, src, shape, dst_stride, src_stride,
+                   dst_offset + i * dst_stride[d],
+                   src_offset + i * src_stride[d], d + 1, sizeof_dtype);
+    }
+  }
+}
+
+void oldTensorStride(void *dst, void *src, const std::vector<size_t> &shape,
+                     const std::vector<size_t> &stride, size_t sizeof_dtype,
+                     bool stride_in) {
+  std::vector<size_t> shape_stride(shape.size());
+  size_t stride_base = 1;
+  for (ssize_t i = shape.size() - 1; i >= 0; --i) {
+    shape_stride[i] = stride_base;
+    stride_base *= shape[i];
+  }
+  if (stride_in) {
+    oldStrideMap(dst, src, shape, stride, shape_stride, 0, 0, 0, sizeof_dtype);
+  } else {
+    oldStrideMap(dst, src, shape, shape_stride, stride, 0, 0, 0, sizeof_dtype);
+  }
+}
+
+// dense, padded, permuted, broadcast (stride 0) and overlapped layouts of
+// every dtype size, in and out. an overlapped dst keeps the last write.
+TEST(StrideSelfTest, MATCH_ELEMENTWISE) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> byte(0, 255), percent(0, 99);
+  const size_t dtype_sizes[] = {1, 2, 3, 4, 8, 16};
+  for (int round = 0; round < 600; ++round) {
+    // a few shapes of more than one parallel block
+    const bool big = round % 47 == 0;
+    const int dims = big ? 3 : std::uniform_int_distribution<int>(1, 5)(gen);
+    std::vector<size_t> shape(dims);
+    for (auto &n : shape) {
+      n = big ? std::uniform_int_distribution<int>(40, 80)(gen)
+              : std::uniform_int_distribution<int>(percent(gen) < 5 ? 0 : 1,
+                                                   9)(gen);
+    }
+    // strides of a dense layout, then padded, permuted, zeroed or
+    // overlapped.
+    std::vector<size_t> stride(dims);
+    std::vector<int> perm(dims);
+    for (int i = 0; i < dims; ++i) {
+      perm[i] = i;
+    }
+    const int layout = round % 5;
+    if (layout == 2) {
+      std::shuffle(perm.begin(), perm.end(), gen);
+    }
+    size_t base = 1;
+    for (int i = dims - 1; i >= 0; --i) {
+      const int d = perm[i];
+      stride[d] = base;
+      base *= shape[d] + (layout == 1 ? percent(gen) % 3 : 0);
+    }
+    for (int d = 0; d < dims; ++d) {
+      if (layout == 3 && percent(gen) < 40) {
+        stride[d] = 0;
+      } else if (layout == 4) {
+        stride[d] = percent(gen) % 4;
+      } else if (percent(gen) < 10) {
+        stride[d] *= 2;  // gaps, and a strided last dim for the gathers
+      }
+    }
+    const size_t size = dtype_sizes[percent(gen) % 6];
+    size_t shape_count = 1, stride_count = 1;
+    for (int d = 0; d < dims; ++d) {
+      shape_count *= shape[d];
+      stride_count += shape[d] == 0 ? 0 : (shape[d] - 1) * stride[d];
+    }
+    if (shape_count == 0) {
+      stride_count = 0;
+    }
+    const bool stride_in = round % 2;
+    const size_t src_count = stride_in ? stride_count : shape_count;
+    const size_t dst_count = stride_in ? shape_count : stride_count;
+    std::vector<char> src(src_count * size), dst(dst_count * size);
+    for (auto &v : src) {
+      v = byte(gen);
+    }
+    for (auto &v : dst) {
+      v = byte(gen);  // elements no index maps to stay as they are
+    }
+    std::vector<char> expect(dst);
+    if (shape_count > 0) {
+      oldTensorStride(expect.data(), src.data(), shape, stride, size,
+                      stride_in);
+    }
+    if (stride_in) {
+      mluoptest::tensor_stride_in(dst.data(), src.data(), shape, stride, size);
+    } else {
+      mluoptest::tensor_stride_out(dst.data(), src.data(), shape, stride,
+                                   size);
+    }
+    ASSERT_EQ(expect, dst) << "round " << round;
+  }
+}
+
+// transposeCpuNd before tiling: the linear input and output index of every
+// element over TRANSPOSE_MAX_DIM loops, DIM padded with 1 and permute with
+// TRANSPOSE_MAX_DIM.
+template <typename T>
+void oldTransposeCpuNd(int loop_d, const T *x, T *y, uint64_t sum,
+                       const uint64_t *DIM, const uint64_t *permute) {
+  for (int loop_t = 0; loop_t < loop_d; loop_t++) {
+    uint64_t dim[TRANSPOSE_MAX_DIM + 1] = {0};
+    for (uint64_t i = 0; i < sum; ++i) {
+      uint64_t rest = i;
+      for (int d = TRANSPOSE_MAX_DIM - 1; d >= 0; --d) {
+        dim[d] = rest % DIM[d];
+        rest /= DIM[d];
+      }
+      uint64_t in_index = 0, out_index = 0;
+      for (int d = 0; d < TRANSPOSE_MAX_DIM; ++d) {
+        in_index = in_index * DIM[d] + dim[d];
+        out_index = out_index * DIM[permute[d]] + dim[permute[d]];
+      }
+      y[sum * loop_t + out_index] = x[sum * loop_t + in_index];
+    }
+  }
+}
+
+// 1 to 8 dims of random permutations, size-1 dims, tile and simd edges, and
+// a few shapes large enough for openmp, in each element size.
+TEST(TransposeCpuSelfTest, MATCH_INDEX_LOOP) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> byte(0, 255), percent(0, 99);
+  const mluOpDataType_t dtypes[] = {MLUOP_DTYPE_FLOAT, MLUOP_DTYPE_INT31,
+                                    MLUOP_DTYPE_COMPLEX_FLOAT};
+  mluOpTensorDescriptor_t x_desc, y_desc;
+  MLUOP_CHECK(mluOpCreateTensorDescriptor(&x_desc));
+  MLUOP_CHECK(mluOpCreateTensorDescriptor(&y_desc));
+  for (int round = 0; round < 800; ++round) {
+    const int dims = std::uniform_int_distribution<int>(1, 8)(gen);
+    const uint64_t limit = round % 40 == 0 ? 300000 : 5000;
+    std::vector<int> shape(dims), permute(dims);
+    uint64_t sum = 1;
+    for (int d = 0; d < dims; ++d) {
+      const int p = percent(gen);
+      shape[d] = p < 20 ? 1 : p < 60 ? 1 + p % 8 : 1 + p % 3 * 16 + p % 5;
+      sum *= shape[d];
+      permute[d] = d;
+    }
+    while (sum > limit) {
+      int &n = *std::max_element(shape.begin(), shape.end());
+      sum = sum / n * (n / 2);
+      n /= 2;
+    }
+    while (round % 40 == 0 && sum * 2 <= limit) {
+      int &n = *std::min_element(shape.begin(), shape.end());
+      sum = sum / n * (n * 2);
+      n *= 2;
+    }
+    if (round % 7 != 0) {
+      std::shuffle(permute.begin(), permute.end(), gen);
+    }
+    std::vector<int> out_shape(dims);
+    for (int d = 0; d < dims; ++d) {
+      out_shape[d] = shape[permute[d]];
+    }
+    const mluOpDataType_t dtype = dtypes[percent(gen) % 3];
+    const size_t size = dtype == MLUOP_DTYPE_COMPLEX_FLOAT ? 8 : 4;
+    MLUOP_CHECK(mluOpSetTensorDescriptor(x_desc, MLUOP_LAYOUT_ARRAY, dtype,
+                                         dims, shape.data()));
+    MLUOP_CHECK(mluOpSetTensorDescriptor(y_desc, MLUOP_LAYOUT_ARRAY, dtype,
+                                         dims, out_shape.data()));
+    std::vector<char> x(sum * size), y(sum * size), expect(sum * size);
+    for (auto &v : x) {
+      v = byte(gen);
+    }
+    uint64_t DIM[TRANSPOSE_MAX_DIM + 1] = {1, 1, 1, 1, 1, 1, 1, 1, 1};
+    uint64_t perm[TRANSPOSE_MAX_DIM] = {8, 8, 8, 8, 8, 8, 8, 8};
+    for (int d = 0; d < dims; ++d) {
+      DIM[d] = shape[d];
+      perm[d] = permute[d];
+    }
+    if (dtype == MLUOP_DTYPE_INT31) {
+      oldTransposeCpuNd(2, (const int16_t *)x.data(), (int16_t *)expect.data(),
+                        sum, DIM, perm);
+    } else if (dtype == MLUOP_DTYPE_COMPLEX_FLOAT) {
+      oldTransposeCpuNd(1, (const double *)x.data(), (double *)expect.data(),
+                        sum, DIM, perm);
+    } else {
+      oldTransposeCpuNd(1, (const float *)x.data(), (float *)expect.data(),
+                        sum, DIM, perm);
+    }
+    ASSERT_EQ(MLUOP_STATUS_SUCCESS,
+              mluOpTransposeCpu(dims, permute, x_desc, x.data(), y_desc,
+                                y.data()));
+    ASSERT_EQ(expect, y) << "round " << round;
+  }
+  MLUOP_CHECK(mluOpDestroyTensorDescriptor(x_desc));
+  MLUOP_CHECK(mluOpDestroyTensorDescriptor(y_desc));
+}
+
+// nested parallelFor inside pool tasks, every element is visited once.
+TEST(ThreadPoolSelfTest, PARALLEL_FOR) {
+  constexpr size_t task_num = 64;
+  constexpr size_t len = 100000;
+  std::vector<std::atomic<int>> visited(task_num * len);
+  std::atomic<size_t> done(0);
+  {
+    mluoptest::ThreadPool pool(4);
+    for (size_t t = 0; t < task_num; t++) {
+      pool.enqueue(
+          [&](size_t offset) {
+            mluoptest::parallelFor(0, len, 1024, [&](size_t b, size_t e) {
+              for (size_t i = b; i < e; i++) {
+                visited[offset + i]++;
+              }
+            });
+            done++;
+          },
+          t * len);
+    }
+  }  // join, remaining tasks run before workers exit.
+  EXPECT_EQ(task_num, done.load());
+  size_t mismatch = 0;
+  for (auto &v : visited) {
+    mismatch += v.load() != 1;
+  }
+  EXPECT_EQ(0, mismatch);
+}
+
+thread_local bool in_parallel_for = false;
+
+// a task waiting for a chunk of its loop on another worker doesn't pick up a
+// task enqueued meanwhile. the caller holds its chunk until the helper has
+// the other one, the helper holds it until the second task is queued.
+TEST(ThreadPoolSelfTest, CALLER_OWN_CHUNKS) {
+  using clock = std::chrono::steady_clock;
+  auto spinUntil = [](const std::atomic<bool> &flag) {
+    auto deadline = clock::now() + std::chrono::seconds(1);
+    while (!flag.load() && clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+  };
+  std::atomic<bool> helped(false), queued(false);
+  std::atomic<int> nested(0), done(0);
+  mluoptest::ThreadPool pool(2);
+  pool.enqueue([&]() {
+    auto caller = std::this_thread::get_id();
+    in_parallel_for = true;
+    mluoptest::parallelFor(0, 2, 1, [&](size_t, size_t) {
+      if (std::this_thread::get_id() == caller) {
+        spinUntil(helped);
+      } else {
+        helped = true;
+        spinUntil(queued);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      }
+    });
+    in_parallel_for = false;
+    done++;
+  });
+  spinUntil(helped);
+  pool.enqueue([&]() {
+    nested += in_parallel_for;
+    done++;
+  });
+  queued = true;
+  pool.wait();
+  EXPECT_TRUE(helped.load());
+  EXPECT_EQ(2, done.load());
+  EXPECT_EQ(0, nested.load());
+}
+
+// exceptions of tasks reach wait(), those of parallelFor its caller.
+TEST(ThreadPoolSelfTest, EXCEPTIONS) {
+  mluoptest::ThreadPool pool(3);
+  std::atomic<int> done(0);
+  for (int i = 0; i < 20; i++) {
+    pool.enqueue(
+        [&](int k) {
+          if (k % 7 == 3) {
+            throw std::runtime_error("task");
+          }
+          done++;
+        },
+        i);
+  }
+  EXPECT_THROW(pool.wait(), std::runtime_error);
+  EXPECT_EQ(17, done.load());  // the pool keeps running
+  EXPECT_NO_THROW(pool.wait());
+
+  std::atomic<int> caught(0);
+  pool.enqueue([&]() {
+    try {
+      mluoptest::parallelFor(0, 1000, 10, [](size_t b, size_t e) {
+        if (b <= 500 && 500 < e) {
+          throw std::out_of_range("chunk");
+        }
+      });
+    } catch (std::out_of_range &) {
+      caught++;
+    }
+  });
+  EXPECT_NO_THROW(pool.wait());
+  EXPECT_EQ(1, caught.load());
+}
+
+// a freed buffer is reused by its thread, and by other threads once the
+// case is trimmed; the global cache stays under its limit.
+TEST(CPUMemoryPoolSelfTest, REUSE_TRIM) {
+  using mluoptest::CPUMemoryPool;
+  CPUMemoryPool pool;
+  CPUMemoryPool::trim();
+  const size_t bytes = (3 << 20) + 4096;
+  char *a = (char *)pool.allocate(bytes);
+  ASSERT_EQ(0, (uintptr_t)a % 64);
+  memset(a, 1, bytes);
+  const size_t cached = CPUMemoryPool::cachedBytes();
+  pool.deallocate(a);
+  EXPECT_LT(cached, CPUMemoryPool::cachedBytes());
+  char *b = (char *)pool.allocate(bytes - 1000);  // same size class
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(1, b[bytes - 1001]);  // not zeroed, like malloc
+  EXPECT_EQ(cached, CPUMemoryPool::cachedBytes());
+  pool.deallocate(b);
+
+  // still in the cache of this thread
+  void *other = nullptr;
+  std::thread([&]() {
+    other = pool.allocate(bytes);
+    CPUMemoryPool::release(other);
+    CPUMemoryPool::trim();
+  }).join();
+  EXPECT_NE(a, other);
+  // the end of a case: a goes to the global cache, the last one in
+  CPUMemoryPool::trim();
+  std::thread([&]() { other = pool.allocate(bytes); }).join();
+  EXPECT_EQ(a, other);
+  pool.deallocate(other);
+
+  // more than the limit of the global cache: the rest is freed
+  const size_t limit =
+      (size_t)mluoptest::getEnvInt("MLUOP_GTEST_CPU_POOL_CACHE_MB", 256) << 20;
+  std::vector<void *> blocks;
+  for (int i = 0; i < 5; ++i) {
+    blocks.push_back(pool.allocate(limit / 4));
+  }
+  for (void *p : blocks) {
+    pool.deallocate(p);
+  }
+  CPUMemoryPool::trim();
+  EXPECT_LE(CPUMemoryPool::cachedBytes(), limit);
+}
+
+// split updates hash the same, lru eviction keeps the newest entries.
+TEST(PerfStatsSelfTest, KNOWN_SAMPLES) {
+  // sorted 10 11 12 13 100: median 12, deviations 0 1 1 2 88, MAD 1. 100 is
+  // farther than 5 * 1.4826 from the median, the rest have variance 5 / 3.
+  mluoptest::PerfStats stats =
+      mluoptest::computePerfStats({13, 100, 10, 12, 11}, 5);
+  EXPECT_EQ(4, stats.samples);
+  EXPECT_EQ(1, stats.outliers);
+  EXPECT_DOUBLE_EQ(12, stats.median);
+  EXPECT_DOUBLE_EQ(1, stats.mad);
+  EXPECT_DOUBLE_EQ(29.2, stats.trimmed_mean);  // 10% of 5 trims nothing
+  EXPECT_DOUBLE_EQ(11.5, stats.mean);
+  EXPECT_DOUBLE_EQ(std::sqrt(5.0 / 3), stats.stddev);
+  const double half = 3.182 * std::sqrt(5.0 / 3) / 2;
+  EXPECT_DOUBLE_EQ(11.5 - half, stats.ci_low);
+  EXPECT_DOUBLE_EQ(11.5 + half, stats.ci_high);
+  EXPECT_DOUBLE_EQ(half / 11.5, stats.ciRelativeHalfWidth());
+
+  // 0 keeps every sample.
+  stats = mluoptest::computePerfStats({13, 100, 10, 12, 11}, 0);
+  EXPECT_EQ(5, stats.samples);
+  EXPECT_EQ(0, stats.outliers);
+  EXPECT_DOUBLE_EQ(29.2, stats.mean);
+
+  // 1..10: one sample trimmed per side, MAD of 0.5 0.5 1.5 1.5 ... is 2.5.
+  stats = mluoptest::computePerfStats({10, 9, 8, 7, 6, 5, 4, 3, 2, 1}, 5);
+  EXPECT_EQ(10, stats.samples);
+  EXPECT_DOUBLE_EQ(5.5, stats.median);
+  EXPECT_DOUBLE_EQ(2.5, stats.mad);
+  EXPECT_DOUBLE_EQ(5.5, stats.trimmed_mean);
+  EXPECT_DOUBLE_EQ(std::sqrt(55.0 / 6), stats.stddev);
+
+  // MAD 0 rejects nothing, else every sample off the median would go.
+  stats = mluoptest::computePerfStats({5, 5, 5, 9}, 5);
+  EXPECT_DOUBLE_EQ(0, stats.mad);
+  EXPECT_EQ(4, stats.samples);
+  EXPECT_DOUBLE_EQ(6, stats.mean);
+
+  // a single sample has no spread and an unbounded ci, so it never meets a
+  // ci target.
+  stats = mluoptest::computePerfStats({7}, 5);
+  EXPECT_EQ(1, stats.samples);
+  EXPECT_EQ(0, stats.outliers);
+  EXPECT_DOUBLE_EQ(7, stats.median);
+  EXPECT_DOUBLE_EQ(0, stats.mad);
+  EXPECT_DOUBLE_EQ(7, stats.trimmed_mean);
+  EXPECT_DOUBLE_EQ(7, stats.mean);
+  EXPECT_DOUBLE_EQ(0, stats.stddev);
+  EXPECT_EQ(-INFINITY, stats.ci_low);
+  EXPECT_EQ(INFINITY, stats.ci_high);
+  EXPECT_EQ(INFINITY, stats.ciRelativeHalfWidth());
+
+  stats = mluoptest::computePerfStats({}, 5);
+  EXPECT_EQ(0, stats.samples);
+  EXPECT_EQ(-1, stats.mean);
+  EXPECT_EQ(0, stats.ciRelativeHalfWidth());
+
+  EXPECT_EQ(INFINITY, mluoptest::studentT95(0));
+  EXPECT_DOUBLE_EQ(12.706, mluoptest::studentT95(1));
+  EXPECT_DOUBLE_EQ(2.042, mluoptest::studentT95(30));
+  EXPECT_NEAR(2.0395, mluoptest::studentT95(31), 1e-4);
+  EXPECT_NEAR(1.9840, mluoptest::studentT95(100), 1e-4);
+  EXPECT_NEAR(1.96, mluoptest::studentT95(1000000), 1e-4);
+}
+
+TEST(BaselineCacheSelfTest, STORE_LOAD) {
+  std::vector<char> data(4096);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = (char)(i * 131 + 7);
+  }
+  mluoptest::BaselineHasher whole;
+  whole.update(data.data(), data.size());
+  mluoptest::BaselineHasher split;
+  split.update(data.data(), 33);
+  split.update(data.data() + 33, data.size() - 33);
+  EXPECT_TRUE(whole.digest() == split.digest());
+
+  char dir[] = "/tmp/mluop_baseline_cache_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  const size_t entry_num = 16;
+  mluoptest::BaselineCache cache(dir, 8 * data.size(), 0);
+  std::vector<mluoptest::BaselineCacheKey> keys;
+  for (size_t i = 0; i < entry_num; i++) {
+    mluoptest::BaselineHasher hasher;
+    hasher.update((uint64_t)i);
+    keys.push_back(hasher.digest());
+    data[0] = (char)i;
+    cache.store(keys.back(), {{data.data(), data.size()}, {nullptr, 0}});
+    EXPECT_LE(cache.totalBytes(), 8 * data.size());
+  }
+  std::vector<char> out(data.size());
+  EXPECT_TRUE(
+      cache.load(keys.back(), {{out.data(), out.size()}, {nullptr, 0}}));
+  EXPECT_TRUE(out == data);
+  EXPECT_FALSE(cache.load(keys.back(), {{out.data(), out.size() - 1}}));
+  EXPECT_FALSE(cache.load(keys.front(), {{out.data(), out.size()}}));
+  EXPECT_EQ(0, system((std::string("rm -rf ") + dir).c_str()));
+}
+
+// members are found by normalized name and read back unchanged.
+TEST(CaseArchiveSelfTest, PACK_READ) {
+  char dir[] = "/tmp/mluop_case_archive_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  std::string path = std::string(dir) + "/suite.pbpack";
+  std::string blob(100000, 'a'), small = "case";
+  mluoptest::CaseArchiveWriter writer;
+  ASSERT_TRUE(writer.open(path));
+  ASSERT_TRUE(writer.add("add/data/x.bin", mluoptest::CaseArchiveEntry::DATA,
+                         "", blob, true));
+  ASSERT_TRUE(writer.add("add/case_0.pb", mluoptest::CaseArchiveEntry::CASE,
+                         "add", small, true));
+  EXPECT_FALSE(writer.add("add/./case_0.pb", mluoptest::CaseArchiveEntry::CASE,
+                          "add", small, false));
+  ASSERT_TRUE(writer.finish());
+
+  std::string member;
+  auto archive = mluoptest::CaseArchive::openContaining(
+      path + "/add/sub/../data/x.bin", &member);
+  ASSERT_NE(nullptr, archive);
+  EXPECT_EQ("add/data/x.bin", member);
+  const mluoptest::CaseArchiveEntry *entry = archive->find(member);
+  ASSERT_NE(nullptr, entry);
+  EXPECT_EQ(mluoptest::CaseArchiveEntry::ZLIB, entry->codec);
+  std::string data;
+  ASSERT_TRUE(archive->read(*entry, &data));
+  EXPECT_EQ(blob, data);
+  entry = archive->find("add/case_0.pb");
+  ASSERT_NE(nullptr, entry);
+  EXPECT_EQ("add", entry->op_name);
+  ASSERT_TRUE(archive->read(*entry, &data));
+  EXPECT_EQ(small, data);
+  EXPECT_EQ(0, system((std::string("rm -rf ") + dir).c_str()));
+}
+
+// external tensor reference syntax and the crc32 it carries.
+TEST(TensorFileRefSelfTest, PARSE) {
+  mluoptest::TensorFileRef ref;
+  ASSERT_TRUE(ref.parse("data/x.bin"));
+  EXPECT_EQ("data/x.bin", ref.file);
+  EXPECT_FALSE(ref.has_length || ref.has_crc32);
+  ASSERT_TRUE(ref.parse("x.bin?offset=16&length=9&crc32=cbf43926"));
+  EXPECT_EQ("x.bin", ref.file);
+  EXPECT_EQ(16, ref.offset);
+  EXPECT_EQ(9, ref.length);
+  const char digits[] = "123456789";
+  EXPECT_EQ(ref.crc32, mluop::crc32(0, digits, 9));
+  EXPECT_EQ(ref.crc32, mluop::crc32(mluop::crc32(0, digits, 4), digits + 4, 5));
+  EXPECT_FALSE(ref.parse("x.bin?offset=1k"));
+  EXPECT_FALSE(ref.parse("x.bin?dtype=float"));
+  EXPECT_FALSE(ref.parse("x.bin?length="));
+}
+
+// blocked gemm against the naive triple loop, odd shapes hit the edge tiles.
+TEST(CpuGemmSelfTest, MATCH_NAIVE) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-1, 1);
+  const int m = 37, n = 53, k = 300, batch = 3;
+  for (int trans = 0; trans < 4; ++trans) {
+    const bool ta = trans & 1, tb = trans & 2;
+    std::vector<float> a(batch * m * k), b(batch * k * n), c(batch * m * n);
+    for (auto &x : a) x = dist(gen);
+    for (auto &x : b) x = dist(gen);
+    for (auto &x : c) x = dist(gen);
+    std::vector<float> expect(c);
+    for (int i = 0; i < batch * m * n; ++i) {
+      const int bi = i / (m * n), r = i / n % m, col = i % n;
+      double sum = 0;
+      for (int p = 0; p < k; ++p) {
+        sum += a[bi * m * k + (ta ? p * m + r : r * k + p)] *
+               b[bi * k * n + (tb ? col * k + p : p * n + col)];
+      }
+      expect[i] = 0.5 * expect[i] + 2 * sum;
+    }
+    mluoptest::cpuGemmStridedBatched(ta, tb, m, n, k, 2.0f, a.data(),
+                                     ta ? m : k, m * k, b.data(), tb ? k : n,
+                                     k * n, 0.5f, c.data(), n, m * n, batch);
+    for (int i = 0; i < batch * m * n; ++i) {
+      ASSERT_NEAR(expect[i], c[i], 1e-3) << "trans " << trans << " at " << i;
+    }
+  }
+}
+
+TEST(CoordHashSelfTest, MATCH_MAP) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int64_t> dist(0, 1LL << 40);
+  mluoptest::CoordHash hash(4);  // grows several times
+  std::unordered_map<int64_t, int32_t> expect;
+  for (int32_t i = 0; i < 100000; ++i) {
+    const int64_t key = i % 3 ? dist(gen) : i;
+    ASSERT_EQ(expect.count(key) == 0, hash.insert(key, i));
+    expect.emplace(key, i);
+    if (i % 7 == 0) {
+      hash.set(key, -i);
+      expect[key] = -i;
+    }
+  }
+  ASSERT_EQ(expect.size(), hash.size());
+  ASSERT_EQ(expect.size(), hash.keys().size());
+  for (auto &kv : expect) {
+    const int32_t *value = hash.find(kv.first);
+    ASSERT_NE(nullptr, value);
+    ASSERT_EQ(kv.second, *value);
+  }
+  ASSERT_EQ(nullptr, hash.find((1LL << 40) + 1));
+}
+
+// get_indice_pairs before the coordinate hash: output sites on a dense grid
+// over batch * output space, 3d.
+void getIndicePairsDense(const std::vector<int32_t> &in,
+                         const std::vector<int32_t> &kernel,
+                         const std::vector<int32_t> &pad,
+                         const std::vector<int32_t> &stride,
+                         const std::vector<int32_t> &dilation,
+                         const std::vector<int32_t> &out_shape, int sub_m,
+                         int batch, int32_t *pairs, int32_t *out,
+                         int32_t *num) {
+  const int32_t num_act_in = in.size() / 4;
+  const int32_t volume = out_shape[0] * out_shape[1] * out_shape[2];
+  const int32_t kernel_volume = kernel[0] * kernel[1] * kernel[2];
+  auto getIndex = [&](const int32_t *pos, int32_t n) {
+    return ((n * out_shape[0] + pos[0]) * out_shape[1] + pos[1]) *
+               out_shape[2] +
+           pos[2];
+  };
+  std::vector<int32_t> grid(batch * volume, -1);
+  if (sub_m) {
+    for (int32_t j = 0; j < num_act_in; ++j) {
+      grid[getIndex(&in[j * 4 + 1], in[j * 4])] = j;
+    }
+    std::copy(in.begin(), in.end(), out);
+  }
+  std::vector<int32_t> points(kernel_volume * 4);
+  for (int32_t j = 0; j < num_act_in; ++j) {
+    const int32_t valid =
+        mluoptest::getValidOutPos(&in[j * 4 + 1], kernel, pad, stride,
+                                  dilation, out_shape, points.data(), 3);
+    for (int i = 0; i < valid; ++i) {
+      const int32_t offset = points[i * 4 + 3];
+      const int32_t index = getIndex(&points[i * 4], in[j * 4]);
+      if (sub_m && grid[index] < 0) {
+        continue;
+      }
+      int32_t *pair = pairs + offset * 2 * num_act_in + num[offset]++;
+      pair[0] = j;
+      pair[num_act_in] = sub_m ? grid[index] : index;
+      if (!sub_m) {
+        grid[index] = 0;
+      }
+    }
+  }
+  if (!sub_m) {
+    int32_t num_act_out = 0;
+    for (int32_t index = 0; index < batch * volume; ++index) {
+      if (grid[index] < 0) {
+        continue;
+      }
+      grid[index] = num_act_out;
+      int32_t *site = out + num_act_out++ * 4;
+      site[0] = index / volume;
+      site[1] = index / (out_shape[1] * out_shape[2]) % out_shape[0];
+      site[2] = index / out_shape[2] % out_shape[1];
+      site[3] = index % out_shape[2];
+    }
+    for (int32_t k = 0; k < kernel_volume; ++k) {
+      for (int32_t i = 0; i < num[k]; ++i) {
+        int32_t *pair_out = pairs + k * 2 * num_act_in + num_act_in + i;
+        *pair_out = grid[*pair_out];
+      }
+    }
+  }
+}
+
+// sites clustered in a small space, so output sites are shared by many.
+TEST(GetIndicePairsSelfTest, MATCH_DENSE_GRID) {
+  std::mt19937 gen(0);
+  for (int round = 0; round < 60; ++round) {
+    const int sub_m = round % 3 == 0;
+    const int batch = 1 + round % 2;
+    std::vector<int32_t> space(3), kernel(3), pad(3), stride(3), dilation(3),
+        out_shape(3);
+    for (int d = 0; d < 3; ++d) {
+      space[d] = std::uniform_int_distribution<int>(1, 9)(gen);
+      kernel[d] = std::uniform_int_distribution<int>(1, 3)(gen);
+      dilation[d] = 1;  // getValidOutPos steps outputs by dilation
+      stride[d] = sub_m ? 1 : std::uniform_int_distribution<int>(1, 2)(gen);
+      pad[d] = sub_m ? kernel[d] / 2 : round % 2;
+      out_shape[d] = sub_m ? space[d]
+                           : (space[d] + 2 * pad[d] -
+                              dilation[d] * (kernel[d] - 1) - 1) /
+                                     stride[d] +
+                                 1;
+      if (out_shape[d] < 1) {
+        space[d] += dilation[d] * (kernel[d] - 1);
+        out_shape[d] = (space[d] + 2 * pad[d] -
+                        dilation[d] * (kernel[d] - 1) - 1) /
+                           stride[d] +
+                       1;
+      }
+    }
+    // unique sites, none (round 1), one (round 2) or up to all of them.
+    std::vector<int32_t> all;
+    for (int n = 0; n < batch; ++n) {
+      for (int z = 0; z < space[0]; ++z) {
+        for (int y = 0; y < space[1]; ++y) {
+          for (int x = 0; x < space[2]; ++x) {
+            all.insert(all.end(), {n, z, y, x});
+          }
+        }
+      }
+    }
+    const int32_t total = all.size() / 4;
+    std::vector<int32_t> order(total);
+    for (int32_t i = 0; i < total; ++i) {
+      order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), gen);
+    const int32_t num_act_in =
+        round == 1 ? 0
+                   : round == 2
+                         ? 1
+                         : std::uniform_int_distribution<int>(1, total)(gen);
+    std::vector<int32_t> in;
+    for (int32_t i = 0; i < num_act_in; ++i) {
+      in.insert(in.end(), &all[order[i] * 4], &all[order[i] * 4 + 4]);
+    }
+    const int32_t kernel_volume = kernel[0] * kernel[1] * kernel[2];
+    const int32_t max_act_out =
+        sub_m ? num_act_in : kernel_volume * num_act_in;
+    std::vector<int32_t> pairs(kernel_volume * 2 * num_act_in, -1),
+        out(max_act_out * 4, -1), num(kernel_volume, 0);
+    std::vector<int32_t> expect_pairs(pairs), expect_out(out),
+        expect_num(num);
+    getIndicePairsDense(in, kernel, pad, stride, dilation, out_shape, sub_m,
+                        batch, expect_pairs.data(), expect_out.data(),
+                        expect_num.data());
+    mluoptest::cpuGetIndicePairs(in.data(), num_act_in, pairs.data(),
+                                 out.data(), max_act_out, num.data(), kernel,
+                                 pad, stride, dilation, out_shape, 5, sub_m,
+                                 batch);
+    ASSERT_EQ(expect_num, num) << "round " << round;
+    ASSERT_EQ(expect_pairs, pairs) << "round " << round;
+    ASSERT_EQ(expect_out, out) << "round " << round;
+  }
+}
+
+// generate_proposals_v2 before topK and nmsSorted: the first max of the
+// remaining scores, picked one at a time.
+int findMaxScore(const std::vector<float> &scores) {
+  int id = 0;
+  for (int i = 1; i < (int)scores.size(); ++i) {
+    if (scores[i] > scores[id]) {
+      id = i;
+    }
+  }
+  return id;
+}
+
+float proposalIou(const float *a, const float *b, float offset) {
+  float width = std::max(std::min(a[2], b[2]) - std::max(a[0], b[0]) + offset,
+                         0.f);
+  float height = std::max(
+      std::min(a[3], b[3]) - std::max(a[1], b[1]) + offset, 0.f);
+  float inter_s = width * height;
+  float s_a = (a[2] - a[0] + offset) * (a[3] - a[1] + offset);
+  float s_b = (b[2] - b[0] + offset) * (b[3] - b[1] + offset);
+  return inter_s / (s_a + s_b - inter_s);
+}
+
+// tied scores, -FLT_MAX, -inf and nan, thin, inverted and nan boxes. the old
+// scan took a nan at index 0 first and kept it through nms, topK and
+// nmsSorted treat it as any other nan.
+TEST(GenerateProposalsV2SelfTest, MATCH_MAX_SCAN) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> pos(0, 100), size(0, 30), unit(0, 1);
+  const float specials[] = {-FLT_MAX, -INFINITY, NAN};
+  for (int round = 0; round < 300; ++round) {
+    const int num = std::uniform_int_distribution<int>(1, 200)(gen);
+    std::vector<float> scores(num), boxes(num * 4);
+    for (int i = 0; i < num; ++i) {
+      const float u = unit(gen);
+      scores[i] = i > 0 && u < 0.1f ? specials[i % 3]
+                                    : std::round(unit(gen) * 10) / 10;
+      float *box = &boxes[i * 4];
+      box[0] = pos(gen);
+      box[1] = pos(gen);
+      box[2] = box[0] + (u < 0.2f ? 0 : size(gen));
+      box[3] = box[1] + (u > 0.9f ? -1 : size(gen));
+      if (u > 0.97f) {
+        box[i % 4] = NAN;
+      }
+    }
+    if (round % 10 == 9) {
+      scores[0] = NAN;
+    }
+    if (round % 50 == 49) {
+      std::fill(scores.begin(), scores.end(), NAN);
+    }
+
+    const int k = std::uniform_int_distribution<int>(1, num)(gen);
+    std::vector<int> ids = GenerateProposalsV2::topK(scores.data(), num, k);
+    ASSERT_EQ(k, ids.size());
+    std::vector<float> remaining(scores);
+    if (std::isnan(scores[0])) {
+      ASSERT_EQ(0, findMaxScore(remaining));
+      remaining[0] = -FLT_MAX;  // topK has it after the numbers
+    }
+    int picked = 0;
+    for (; picked < k; ++picked) {
+      const int id = findMaxScore(remaining);
+      if (remaining[id] <= -FLT_MAX) {
+        break;  // the scan picks -FLT_MAX again from here on
+      }
+      ASSERT_EQ(id, ids[picked]) << "round " << round;
+      remaining[id] = -FLT_MAX;
+    }
+    for (; picked < k; ++picked) {
+      ASSERT_FALSE(scores[ids[picked]] > -FLT_MAX) << "round " << round;
+    }
+
+    // proposals in the order topK gives them, nms stops at the specials.
+    std::vector<int> order = GenerateProposalsV2::topK(scores.data(), num, num);
+    std::vector<float> sorted_scores(num), sorted_boxes(num * 4);
+    for (int i = 0; i < num; ++i) {
+      sorted_scores[i] = scores[order[i]];
+      std::copy(&boxes[order[i] * 4], &boxes[order[i] * 4 + 4],
+                &sorted_boxes[i * 4]);
+    }
+    const int max_num = std::uniform_int_distribution<int>(1, num + 5)(gen);
+    const float thresh = unit(gen);
+    const bool pixel_offset = round % 2;
+    std::vector<int> expect;
+    std::vector<float> out_scores(sorted_scores);
+    for (int nms_id = 0; nms_id < std::min(num, max_num); ++nms_id) {
+      const int id = findMaxScore(out_scores);
+      if (!(out_scores[id] > -FLT_MAX)) {
+        break;  // a nan in front only when all scores are nan
+      }
+      out_scores[id] = -FLT_MAX;
+      expect.push_back(id);
+      for (int inner_id = 0; inner_id < num; ++inner_id) {
+        if (inner_id != id &&
+            proposalIou(&sorted_boxes[id * 4], &sorted_boxes[inner_id * 4],
+                        pixel_offset) > thresh) {
+          out_scores[inner_id] = -FLT_MAX;
+        }
+      }
+    }
+    ASSERT_EQ(expect, GenerateProposalsV2::nmsSorted(
+                          sorted_scores.data(), sorted_boxes.data(), num,
+                          max_num, thresh, pixel_offset))
+        << "round " << round;
+  }
+}
+
+TEST(BoxGridSelfTest, QUERY_OVERLAPS) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> pos(0, 1000), size(0, 50);
+  const int num = 5000;
+  std::vector<float> x1(num), y1(num), x2(num), y2(num);
+  for (int i = 0; i < num; ++i) {
+    x1[i] = pos(gen);
+    y1[i] = pos(gen);
+    x2[i] = x1[i] + (i % 100 ? size(gen) : 10 * size(gen));
+    y2[i] = y1[i] + size(gen);
+  }
+  x1[6] = NAN;
+  mluoptest::BoxGrid grid(x1.data(), y1.data(), x2.data(), y2.data(), num);
+  for (int i = 0; i < num; i += 2) {
+    grid.insert(i);
+  }
+  std::vector<int> ids;
+  for (int i = 1; i < num; i += 2) {
+    grid.query(i, &ids);
+    std::vector<char> found(num, 0);
+    for (int id : ids) {
+      ASSERT_EQ(0, id % 2) << "not inserted";
+      ASSERT_FALSE(found[id]) << "returned twice";
+      found[id] = 1;
+    }
+    for (int k = 0; k < num; k += 2) {
+      if (x1[k] <= x2[i] && x1[i] <= x2[k] && y1[k] <= y2[i] &&
+          y1[i] <= y2[k]) {
+        ASSERT_TRUE(found[k]) << "box " << k << " overlaps box " << i;
+      }
+    }
+    ASSERT_TRUE(found[6]);  // in no cell for its nan bound, so in every query
+  }
+}
+
+// a box of nms_detection_cpu as x1, y1, x2, y2.
+void nmsCorners(int box_mode, float *x1, float *y1, float *x2, float *y2) {
+  if (box_mode == 0) {
+    if (*x1 > *x2) {
+      std::swap(*x1, *x2);
+    }
+    if (*y1 > *y2) {
+      std::swap(*y1, *y2);
+    }
+  } else if (box_mode == 1) {
+    *x1 = *x1 - *x2 * 0.5;
+    *x2 = *x1 + *x2;
+    *y1 = *y1 - *y2 * 0.5;
+    *y2 = *y1 + *y2;
+  }
+}
+
+// the hard nms loop of nms_detection_cpu: keep the max remaining score and
+// zero the scores of all boxes overlapping it.
+std::vector<int> nmsMaxSearch(const float *boxes, const float *input_score,
+                              int num, int keep_num, float thresh_iou,
+                              float thresh_score, int layout, int algo,
+                              float offset, int box_mode) {
+  std::vector<float> score(input_score, input_score + num);
+  auto corners = [&](int i, float *c) {
+    for (int k = 0; k < 4; ++k) {
+      c[k] = layout == 0 ? boxes[i * 4 + k] : boxes[k * num + i];
+    }
+    nmsCorners(box_mode, &c[0], &c[1], &c[2], &c[3]);
+  };
+  std::vector<int> keep;
+  while ((int)keep.size() < keep_num) {
+    int max_index = 0;
+    for (int i = 1; i < num; i++) {
+      if (score[i] > score[max_index]) {
+        max_index = i;
+      }
+    }
+    if (score[max_index] <= thresh_score) {
+      break;
+    }
+    keep.push_back(max_index);
+    score[max_index] = 0;
+    float m[4], c[4];
+    corners(max_index, m);
+    const float max_offset = algo == 0 || offset == 0.0 ? 0 : offset;
+    const float max_area =
+        (m[2] - m[0] + max_offset) * (m[3] - m[1] + max_offset);
+    const float inter_offset = algo == 1 ? offset : 0;
+    for (int i = 0; i < num; i++) {
+      corners(i, c);
+      const float area_cur =
+          (c[2] - c[0] + inter_offset) * (c[3] - c[1] + inter_offset);
+      float inter_w = (m[2] > c[2] ? c[2] : m[2]) -
+                      (m[0] > c[0] ? m[0] : c[0]) + inter_offset;
+      float inter_h = (m[3] > c[3] ? c[3] : m[3]) -
+                      (m[1] > c[1] ? m[1] : c[1]) + inter_offset;
+      inter_w = inter_w < 0 ? 0 : inter_w;
+      inter_h = inter_h < 0 ? 0 : inter_h;
+      const float area_I = inter_w * inter_h;
+      if (area_I / (max_area + area_cur - area_I) > thresh_iou) {
+        score[i] = 0;
+      }
+    }
+  }
+  return keep;
+}
+
+// tied scores, nan scores first or not, thin, inverted, huge and nan boxes.
+TEST(NmsSelfTest, MATCH_MAX_SEARCH) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> pos(0, 200), size(0, 40), unit(0, 1);
+  const float thresh_ious[] = {0, 0.3f, 0.5f, 1};
+  for (int round = 0; round < 400; ++round) {
+    const int num = std::uniform_int_distribution<int>(1, 300)(gen);
+    const int layout = round % 2, algo = round / 2 % 2,
+              box_mode = round / 4 % 2;
+    const float offset = round / 8 % 2;
+    std::vector<float> boxes(num * 4), scores(num);
+    for (int i = 0; i < num; ++i) {
+      const float u = unit(gen);
+      float box[4] = {pos(gen), pos(gen), size(gen), size(gen)};
+      if (box_mode == 0) {
+        box[2] = u < 0.1f ? box[0] : box[0] + (u < 0.2f ? -1 : 1) * box[2];
+        box[3] += box[1];
+      } else if (u < 0.1f) {
+        box[2] = 0;
+      }
+      if (u > 0.98f) {
+        box[i % 4] = u > 0.99f ? NAN : 1e6;
+      }
+      for (int k = 0; k < 4; ++k) {
+        boxes[layout == 0 ? i * 4 + k : k * num + i] = box[k];
+      }
+      scores[i] = unit(gen) < 0.03f ? NAN : std::round(unit(gen) * 8) / 8;
+    }
+    if (round % 5 == 0) {
+      scores[0] = NAN;
+    }
+    const int keep_num = std::uniform_int_distribution<int>(1, num + 2)(gen);
+    const float thresh_iou = thresh_ious[round % 4];
+    const float thresh_score = round % 3 == 0 ? 0 : 0.25f;
+    ASSERT_EQ(nmsMaxSearch(boxes.data(), scores.data(), num, keep_num,
+                           thresh_iou, thresh_score, layout, algo, offset,
+                           box_mode),
+              mluoptest::hardNmsGrid(boxes.data(), scores.data(), num,
+                                     keep_num, thresh_iou, thresh_score,
+                                     layout, (mluOpNmsAlgo_t)algo, offset,
+                                     (mluOpNmsBoxPointMode_t)box_mode))
+        << "round " << round;
+  }
+}
+
+// touching, nearly touching, thin and nan boxes for the bev iou of 3d nms.
+TEST(Nms3DSelfTest, MATCH_ALL_PAIRS) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> pos(0, 60), size(0, 8), angle(-4, 4),
+      unit(0, 1);
+  for (int round = 0; round < 40; ++round) {
+    const int num =
+        round == 0 ? 290 : std::uniform_int_distribution<int>(1, 200)(gen);
+    std::vector<float> x(num), y(num), dx(num), dy(num), theta(num);
+    for (int i = 0; i < num; ++i) {
+      const float u = unit(gen);
+      if (i > 0 && u < 0.2f) {
+        // upright, sharing an edge with the box before it or within the
+        // 1e-2 margin of check_in_box2d
+        x[i] = x[i - 1] + dx[i - 1] + (u < 0.1f ? 0.005f : 0);
+        y[i] = y[i - 1];
+        dx[i] = dx[i - 1];
+        dy[i] = dy[i - 1];
+        theta[i] = 0;
+        theta[i - 1] = 0;
+        continue;
+      }
+      x[i] = pos(gen);
+      y[i] = pos(gen);
+      dx[i] = u < 0.25f ? 0 : size(gen);
+      dy[i] = size(gen);
+      theta[i] = angle(gen);
+      if (u > 0.98f) {
+        y[i] = NAN;
+      }
+    }
+    if (round == 0) {
+      // a row of unit boxes 9e-3 apart, the cell edges drift along the row
+      // and some fall in the gaps.
+      for (int i = 0; i < num; ++i) {
+        x[i] = (i - num / 2) * 1.009f;
+        y[i] = 0;
+        dx[i] = dy[i] = 1;
+        theta[i] = 0;
+      }
+    }
+    const float thresh_iou = round % 3 * 0.25f;
+    std::vector<int> expect;
+    std::vector<char> alive(num, 1);
+    float box_a[7] = {0}, box_b[7] = {0};
+    for (int cur = 0; cur < num; ++cur) {
+      if (!alive[cur]) {
+        continue;
+      }
+      expect.push_back(cur);
+      box_a[0] = x[cur], box_a[1] = y[cur];
+      box_a[3] = dx[cur], box_a[4] = dy[cur];
+      box_a[6] = theta[cur];
+      for (int i = 0; i < num; ++i) {
+        box_b[0] = x[i], box_b[1] = y[i];
+        box_b[3] = dx[i], box_b[4] = dy[i];
+        box_b[6] = theta[i];
+        if (mluoptest::Nms3DUtils::UtilsFunctions::iou_bev(box_a, box_b) >
+            thresh_iou) {
+          alive[i] = 0;
+        }
+      }
+    }
+    ASSERT_EQ(expect, mluoptest::hardNms3DGrid(x.data(), y.data(), dx.data(),
+                                               dy.data(), theta.data(), num,
+                                               thresh_iou))
+        << "round " << round;
+  }
+}
+
+// pointToVoxelidx before the coordinate hash: each point scans the points
+// before it for its voxel.
+void pointToVoxelidxScan(const int32_t *coor, int32_t *point_to_voxelidx,
+                         int32_t *point_to_pointidx, int32_t max_points,
+                         int num_points) {
+  for (int index = 0; index < num_points; ++index) {
+    const int32_t *coor_offset = coor + index * 3;
+    if (coor_offset[0] == -1) {
+      point_to_pointidx[index] = -1;
+      point_to_voxelidx[index] = -1;
+      continue;
+    }
+    int32_t num = 0;
+    for (int i = 0; i < index; ++i) {
+      const int32_t *prev_coor = coor + i * 3;
+      if (prev_coor[0] == coor_offset[0] && prev_coor[1] == coor_offset[1] &&
+          prev_coor[2] == coor_offset[2]) {
+        num++;
+        if (num == 1) {
+          point_to_pointidx[index] = i;
+        } else if (num >= max_points) {
+          break;
+        }
+      }
+    }
+    if (num == 0) {
+      point_to_pointidx[index] = index;
+    }
+    point_to_voxelidx[index] = num < max_points ? num : -1;
+  }
+}
+
+// points outside the grid, crowded voxels, max_points from 1 on, and more
+// points than a chunk of pointToVoxelidx.
+TEST(VoxelizationSelfTest, MATCH_SCAN) {
+  std::mt19937 gen(0);
+  const int grid_x = 7, grid_y = 5, grid_z = 3;
+  std::uniform_int_distribution<int> x(0, grid_x - 1), y(0, grid_y - 1),
+      z(0, grid_z - 1), percent(0, 99);
+  const int32_t max_points[] = {1, 2, 3, 35, 2000, 35};
+  for (int round = 0; round < 6; ++round) {
+    const int num_points = round == 5 ? 40000 : 1500;
+    std::vector<int32_t> coor(num_points * 3);
+    for (int i = 0; i < num_points; ++i) {
+      const int p = percent(gen);
+      int32_t *c = &coor[i * 3];
+      if (p < 5) {
+        c[0] = c[1] = c[2] = -1;
+      } else if (p < 40) {
+        c[0] = c[1] = c[2] = 1;
+      } else {
+        c[0] = z(gen);
+        c[1] = y(gen);
+        c[2] = x(gen);
+      }
+    }
+    std::vector<int32_t> expect_voxelidx(num_points),
+        expect_pointidx(num_points);
+    pointToVoxelidxScan(coor.data(), expect_voxelidx.data(),
+                        expect_pointidx.data(), max_points[round], num_points);
+    std::vector<int32_t> voxelidx(num_points), pointidx(num_points);
+    mluoptest::pointToVoxelidx(coor.data(), voxelidx.data(), pointidx.data(),
+                               max_points[round], 20000, num_points, 3,
+                               grid_x, grid_y);
+    ASSERT_EQ(expect_voxelidx, voxelidx) << "round " << round;
+    ASSERT_EQ(expect_pointidx, pointidx) << "round " << round;
+  }
+}
+
+TEST(BoxBvhSelfTest, QUERY_CONTAINS) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> pos(0, 100), size(0, 10);
+  const int num = 500;
+  std::vector<float> lo(num * 3), hi(num * 3);
+  for (int i = 0; i < num * 3; ++i) {
+    lo[i] = pos(gen);
+    hi[i] = lo[i] + size(gen);
+  }
+  hi[3 * 3 + 1] = INFINITY;
+  lo[5 * 3 + 2] = NAN;
+  mluoptest::BoxBvh bvh(lo.data(), hi.data(), num);
+  std::vector<float> points(2000 * 3);
+  for (auto &v : points) {
+    v = pos(gen);
+  }
+  points[11 * 3 + 2] = NAN;
+  std::vector<int> ids;
+  std::vector<std::vector<int>> expect(num);
+  for (int k = 0; k < 2000; ++k) {
+    const float *point = &points[k * 3];
+    bvh.query(point, &ids);
+    std::vector<char> found(num, 0);
+    for (int id : ids) {
+      ASSERT_FALSE(found[id]) << "returned twice";
+      found[id] = 1;
+    }
+    for (int i = 0; i < num; ++i) {
+      bool holds = true;
+      for (int a = 0; a < 3; ++a) {
+        holds = holds && lo[i * 3 + a] <= point[a] && point[a] <= hi[i * 3 + a];
+      }
+      ASSERT_EQ(holds, (bool)found[i]) << "box " << i;
+      if (holds || k == 11) {
+        expect[i].push_back(k);  // a nan point is a candidate of every box
+      }
+    }
+  }
+  std::vector<std::vector<int>> box_points;
+  bvh.pointsPerBox(points.data(), 2000, &box_points);
+  ASSERT_EQ(expect, box_points);
+}
+
+// roiaware_pool3d_forward and roipoint_pool3d before the points were
+// bucketed per box: every point is tested against every box, in point order.
+int oldRoiawareInBox(const float *pt, const float *box3d, float &local_x,
+                     float &local_y) {
+  float cz = box3d[2] + box3d[5] / 2.0;
+  if (fabsf(pt[2] - cz) > box3d[5] / 2.0) return 0;
+  float cosa = cos(-box3d[6]), sina = sin(-box3d[6]);
+  float shift_x = pt[0] - box3d[0], shift_y = pt[1] - box3d[1];
+  local_x = shift_x * cosa + shift_y * (-sina);
+  local_y = shift_x * sina + shift_y * cosa;
+  return (local_x > -box3d[3] / 2.0) & (local_x < box3d[3] / 2.0) &
+         (local_y > -box3d[4] / 2.0) & (local_y < box3d[4] / 2.0);
+}
+
+void oldRoiawarePool3dForward(int boxes_num, int pts_num, int channels,
+                              int max_pts_each_voxel, int out_x, int out_y,
+                              int out_z, const float *rois, const float *pts,
+                              const float *pts_feature, int *argmax,
+                              int *pts_idx_of_voxels, float *pooled_features,
+                              int pool_method) {
+  const int voxels = out_x * out_y * out_z;
+  for (int b = 0; b < boxes_num; b++) {
+    const float *roi = rois + b * 7;
+    int *box_idx = pts_idx_of_voxels + b * voxels * max_pts_each_voxel;
+    for (int pt_idx = 0; pt_idx < pts_num; pt_idx++) {
+      const float *pt = pts + pt_idx * 3;
+      float local_x = 0, local_y = 0;
+      if (oldRoiawareInBox(pt, roi, local_x, local_y) > 0) {
+        float local_z = pt[2] - roi[2];
+        float x_res = roi[3] / out_x, y_res = roi[4] / out_y,
+              z_res = roi[5] / out_z;
+        int x_idx = int((local_x + roi[3] / 2) / x_res);
+        int y_idx = int((local_y + roi[4] / 2) / y_res);
+        int z_idx = int(local_z / z_res);
+        x_idx = std::min(std::max(x_idx, 0), out_x - 1);
+        y_idx = std::min(std::max(y_idx, 0), out_y - 1);
+        z_idx = std::min(std::max(z_idx, 0), out_z - 1);
+        int *voxel =
+            box_idx + ((x_idx * out_y + y_idx) * out_z + z_idx) *
+                          max_pts_each_voxel;
+        if (voxel[0] < max_pts_each_voxel - 1) {
+          voxel[voxel[0] + 1] = pt_idx;
+          voxel[0]++;
+        }
+      }
+    }
+  }
+  for (int v = 0; v < boxes_num * voxels; v++) {
+    const int *voxel = pts_idx_of_voxels + v * max_pts_each_voxel;
+    for (int c = 0; c < channels; c++) {
+      int argmax_idx = -1;
+      float max_val = -1e50, sum_val = 0;
+      for (int k = 1; k <= voxel[0]; k++) {
+        float f = pts_feature[voxel[k] * channels + c];
+        sum_val += f;
+        if (f > max_val) {
+          max_val = f;
+          argmax_idx = voxel[k];
+        }
+      }
+      if (pool_method == 0 && argmax_idx != -1) {
+        pooled_features[v * channels + c] = max_val;
+        argmax[v * channels + c] = argmax_idx;
+      } else if (pool_method == 1 && voxel[0] > 0) {
+        pooled_features[v * channels + c] = sum_val / voxel[0];
+      }
+    }
+  }
+}
+
+int oldRoipointInBox(const float *pt, const float *box3d) {
+  float cz = box3d[2] + box3d[5] / 2.0;
+  if ((pt[2] - cz) > (box3d[5] / 2.0) || (pt[2] - cz) < -(box3d[5] / 2.0)) {
+    return 0;
+  }
+  float cosa = std::cos(-box3d[6]), sina = std::sin(-box3d[6]);
+  float shift_x = pt[0] - box3d[0], shift_y = pt[1] - box3d[1];
+  float local_x = shift_x * cosa + shift_y * (-sina);
+  float local_y = shift_x * sina + shift_y * cosa;
+  return (local_x > -box3d[3] / 2.0) & (local_x < box3d[3] / 2.0) &
+         (local_y > -box3d[4] / 2.0) & (local_y < box3d[4] / 2.0);
+}
+
+void oldRoiPointPool3d(int batch_size, int pts_num, int boxes_num,
+                       int feature_len, int sampled_pts_num,
+                       const float *points, const float *point_features,
+                       const float *boxes3d, int *pts_idx,
+                       float *pooled_features, float *pooled_empty_flag) {
+  std::vector<int> pts_assign(batch_size * pts_num * boxes_num);
+  for (int bs = 0; bs < batch_size; bs++) {
+    for (int b = 0; b < boxes_num; b++) {
+      for (int pt = 0; pt < pts_num; pt++) {
+        pts_assign[(bs * pts_num + pt) * boxes_num + b] =
+            oldRoipointInBox(points + (bs * pts_num + pt) * 3,
+                             boxes3d + (bs * boxes_num + b) * 7);
+      }
+    }
+  }
+  for (int bs = 0; bs < batch_size; bs++) {
+    for (int b = 0; b < boxes_num; b++) {
+      int *idx = pts_idx + (bs * boxes_num + b) * sampled_pts_num;
+      int cnt = 0;
+      for (int pt = 0; pt < pts_num; pt++) {
+        if (pts_assign[(bs * pts_num + pt) * boxes_num + b]) {
+          if (cnt < sampled_pts_num) {
+            idx[cnt++] = pt;
+          } else {
+            break;
+          }
+        }
+      }
+      if (cnt == 0) {
+        pooled_empty_flag[bs * boxes_num + b] = 1;
+      } else {
+        for (int k = cnt; k < sampled_pts_num; k++) {
+          idx[k] = idx[k % cnt];
+        }
+      }
+    }
+  }
+  for (int bs = 0; bs < batch_size; bs++) {
+    for (int b = 0; b < boxes_num; b++) {
+      if (pooled_empty_flag[bs * boxes_num + b] == 1) {
+        continue;
+      }
+      for (int k = 0; k < sampled_pts_num; k++) {
+        int temp_idx = (bs * boxes_num + b) * sampled_pts_num + k;
+        int src = bs * pts_num + pts_idx[temp_idx];
+        float *dst = pooled_features + temp_idx * (3 + feature_len);
+        std::copy(points + src * 3, points + src * 3 + 3, dst);
+        std::copy(point_features + src * feature_len,
+                  point_features + (src + 1) * feature_len, dst + 3);
+      }
+    }
+  }
+}
+
+// rotated boxes of negative, zero, huge and non-finite sizes, points on box
+// corners and faces, nan and inf points, and tied features. a far offset
+// leaves fewer bits to the shift from the box center.
+void pool3dTestData(std::mt19937 &gen, int boxes_num, int pts_num,
+                    int channels, float offset, std::vector<float> *boxes,
+                    std::vector<float> *pts, std::vector<float> *feature) {
+  std::uniform_real_distribution<float> pos(-10, 10), size(0, 6), angle(-4, 4);
+  std::uniform_int_distribution<int> percent(0, 99), tie(0, 7);
+  boxes->resize(boxes_num * 7);
+  for (int b = 0; b < boxes_num; b++) {
+    float *box = &(*boxes)[b * 7];
+    box[0] = offset + pos(gen);
+    box[1] = offset + pos(gen);
+    box[2] = pos(gen) / 4;
+    box[3] = size(gen);
+    box[4] = size(gen);
+    box[5] = size(gen);
+    box[6] = angle(gen);
+    const int p = percent(gen);
+    if (p < 5) {
+      box[3 + p % 3] = -box[3 + p % 3];
+    } else if (p < 8) {
+      box[3 + p % 3] = 0;
+    } else if (p < 10) {
+      box[3] = box[4] = 30;
+    } else if (p == 10) {
+      box[3 + b % 3] = INFINITY;
+    } else if (p == 11) {
+      box[b % 7] = NAN;
+    }
+  }
+  pts->resize(pts_num * 3);
+  for (int i = 0; i < pts_num; i++) {
+    float *pt = &(*pts)[i * 3];
+    const int p = percent(gen);
+    const float *box = &(*boxes)[(i % boxes_num) * 7];
+    if (p < 30) {
+      // a corner or the middle of a face, on the z faces too, give or take
+      // a few ulps.
+      const float nudge = 1 + (tie(gen) - 4) * FLT_EPSILON;
+      float lx = box[3] / 2 * (tie(gen) % 3 - 1) * nudge;
+      float ly = box[4] / 2 * (tie(gen) % 3 - 1) * nudge;
+      float cosa = std::cos(box[6]), sina = std::sin(box[6]);
+      pt[0] = box[0] + lx * cosa - ly * sina;
+      pt[1] = box[1] + lx * sina + ly * cosa;
+      pt[2] = box[2] + box[5] / 2 * (tie(gen) % 3);
+    } else {
+      pt[0] = offset + pos(gen);
+      pt[1] = offset + pos(gen);
+      pt[2] = pos(gen) / 4;
+    }
+    if (p == 99) {
+      pt[i % 3] = NAN;
+    } else if (p == 98) {
+      pt[i % 3] = i % 2 ? INFINITY : -INFINITY;
+    }
+  }
+  feature->resize(pts_num * channels);
+  for (auto &v : *feature) {
+    v = tie(gen) - 3.5f;
+  }
+}
+
+TEST(RoiawarePool3dSelfTest, MATCH_ALL_POINTS) {
+  std::mt19937 gen(0);
+  const int out_x = 3, out_y = 2, out_z = 4, channels = 3;
+  const int voxels = out_x * out_y * out_z;
+  for (int round = 0; round < 12; ++round) {
+    const int boxes_num = 1 + round * 5, pts_num = 300 + round * 150;
+    const int max_pts_each_voxel = round % 3 == 0 ? 2 : 1 + round * 20;
+    const int pool_method = round % 2;
+    std::vector<float> rois, pts, feature;
+    pool3dTestData(gen, boxes_num, pts_num, channels, round % 4 == 3 ? 3e4 : 0,
+                   &rois, &pts, &feature);
+    std::vector<int> expect_idx(boxes_num * voxels * max_pts_each_voxel, 0),
+        expect_argmax(boxes_num * voxels * channels, -1);
+    std::vector<float> expect_pooled(boxes_num * voxels * channels, 0);
+    oldRoiawarePool3dForward(boxes_num, pts_num, channels, max_pts_each_voxel,
+                             out_x, out_y, out_z, rois.data(), pts.data(),
+                             feature.data(), expect_argmax.data(),
+                             expect_idx.data(), expect_pooled.data(),
+                             pool_method);
+    std::vector<int> idx(expect_idx.size(), 0),
+        argmax(expect_argmax.size(), -1);
+    std::vector<float> pooled(expect_pooled.size(), 0);
+    mluoptest::cpuRoiawarePool3dForward(
+        boxes_num, pts_num, channels, max_pts_each_voxel, out_x, out_y, out_z,
+        rois.data(), pts.data(), feature.data(), argmax.data(), idx.data(),
+        pooled.data(), pool_method);
+    ASSERT_EQ(expect_idx, idx) << "round " << round;
+    ASSERT_EQ(expect_argmax, argmax) << "round " << round;
+    ASSERT_EQ(0, memcmp(expect_pooled.data(), pooled.data(),
+                        pooled.size() * sizeof(float)))
+        << "round " << round;
+  }
+}
+
+TEST(RoipointPool3dSelfTest, MATCH_ALL_POINTS) {
+  std::mt19937 gen(0);
+  const int feature_len = 2;
+  for (int round = 0; round < 12; ++round) {
+    const int batch_size = 1 + round % 2, boxes_num = 1 + round * 4,
+              pts_num = 200 + round * 100;
+    const int sampled_pts_num = round % 3 == 0 ? 1 : round * 10;
+    std::vector<float> points, features, boxes;
+    std::vector<float> batch_pts, batch_feature, batch_boxes;
+    for (int bs = 0; bs < batch_size; bs++) {
+      pool3dTestData(gen, boxes_num, pts_num, feature_len,
+                     round % 4 == 3 ? 3e4 : 0, &batch_boxes, &batch_pts,
+                     &batch_feature);
+      points.insert(points.end(), batch_pts.begin(), batch_pts.end());
+      features.insert(features.end(), batch_feature.begin(),
+                      batch_feature.end());
+      boxes.insert(boxes.end(), batch_boxes.begin(), batch_boxes.end());
+    }
+    const int num = batch_size * boxes_num;
+    std::vector<int> expect_idx(num * sampled_pts_num, -1);
+    std::vector<float> expect_pooled(
+        num * sampled_pts_num * (3 + feature_len), -1),
+        expect_empty(num, 0);
+    oldRoiPointPool3d(batch_size, pts_num, boxes_num, feature_len,
+                      sampled_pts_num, points.data(), features.data(),
+                      boxes.data(), expect_idx.data(), expect_pooled.data(),
+                      expect_empty.data());
+    std::vector<int> idx(expect_idx.size(), -1);
+    std::vector<float> pooled(expect_pooled.size(), -1), empty(num, 0);
+    mluoptest::cpuRoiPointPool3d(batch_size, pts_num, boxes_num, feature_len,
+                                 sampled_pts_num, points.data(),
+                                 features.data(), boxes.data(), idx.data(),
+                                 pooled.data(), empty.data());
+    ASSERT_EQ(expect_idx, idx) << "round " << round;
+    ASSERT_EQ(expect_empty, empty) << "round " << round;
+    ASSERT_EQ(0, memcmp(expect_pooled.data(), pooled.data(),
+                        pooled.size() * sizeof(float)))
+        << "round " << round;
+  }
+}
+
+TEST(PointIndexSelfTest, MATCH_BRUTE_FORCE) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> pos(-1, 1);
+  const int num = 3000;
+  std::vector<float> xyz(num * 3), queries(300 * 3);
+  for (auto &v : xyz) {
+    v = std::round(pos(gen) * 20) / 20;  // many equal distances
+  }
+  for (auto &v : queries) {
+    v = std::round(pos(gen) * 20) / 20;
+  }
+  xyz[7 * 3] = NAN;
+  const float radius = 0.15;
+  mluoptest::PointGrid grid(xyz.data(), num, radius);
+  mluoptest::PointKdTree tree(xyz.data(), num);
+  std::vector<int> ids;
+  for (size_t q = 0; q < queries.size(); q += 3) {
+    const float *query = &queries[q];
+    std::vector<std::pair<float, int>> dist(num);
+    for (int i = 0; i < num; ++i) {
+      dist[i] = {mluoptest::pointDistance2(query, &xyz[i * 3]), i};
+    }
+    grid.query(query, radius, &ids);
+    ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+    std::vector<char> found(num, 0);
+    for (int id : ids) {
+      found[id] = 1;
+    }
+    for (int i = 0; i < num; ++i) {
+      if (dist[i].first <= radius * radius) {
+        ASSERT_TRUE(found[i]) << "point " << i << " is within radius";
+      }
+    }
+    ASSERT_FALSE(found[7]);
+
+    float dist2[5];
+    int nearest[5];
+    ASSERT_EQ(5, tree.nearest(query, 5, dist2, nearest));
+    dist.erase(dist.begin() + 7);
+    std::partial_sort(dist.begin(), dist.begin() + 5, dist.end());
+    for (int k = 0; k < 5; ++k) {
+      ASSERT_EQ(dist[k].first, dist2[k]);
+      ASSERT_EQ(dist[k].second, nearest[k]);
+    }
+  }
+}
+
+TEST(BilinearSampleSelfTest, MATCH_SCALAR) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> value(-1, 1), pos(-2, 8);
+  const int height = 5, width = 6, channels = 37;  // a simd tail
+  const int64_t stride = 2 * channels;  // channels of a pixel are a slice
+  std::vector<float> data(height * width * stride);
+  for (auto &v : data) {
+    v = value(gen);
+  }
+  std::vector<float> grad(channels), out(channels), expect(channels);
+  for (auto &v : grad) {
+    v = value(gen);
+  }
+  for (int i = 0; i < 500; ++i) {
+    const float y = pos(gen), x = pos(gen);
+    mluoptest::BilinearSample sample;
+    if (i % 2 == 0) {
+      const bool inside = y >= -1 && y <= height && x >= -1 && x <= width;
+      ASSERT_EQ(inside, mluoptest::bilinearSampleClamped(height, width, stride,
+                                                         y, x, &sample));
+      if (!inside) {
+        continue;
+      }
+    } else {
+      mluoptest::bilinearSampleZeroPad(height, width, stride, y, x, &sample);
+      const float y_low = std::floor(y), x_low = std::floor(x);
+      ASSERT_EQ(sample.offset[0] < 0, y_low < 0 || y_low > height - 1 ||
+                                          x_low < 0 || x_low > width - 1);
+    }
+    const float scale = value(gen);
+    for (int c = 0; c < channels; ++c) {
+      float v[4];
+      for (int k = 0; k < 4; ++k) {
+        v[k] = sample.offset[k] < 0 ? 0 : data[sample.offset[k] + c];
+      }
+      const float *w = sample.weight;
+      expect[c] = w[0] * v[0] + w[1] * v[1] + w[2] * v[2] + w[3] * v[3];
+    }
+    mluoptest::bilinearGather(data.data(), sample, channels, out.data());
+    ASSERT_EQ(0, memcmp(expect.data(), out.data(), channels * sizeof(float)));
+    for (int c = 0; c < channels; ++c) {
+      expect[c] = out[c] + expect[c] * scale;
+    }
+    mluoptest::bilinearGatherAdd(data.data(), sample, channels, scale,
+                                 out.data());
+    ASSERT_EQ(0, memcmp(expect.data(), out.data(), channels * sizeof(float)));
+
+    std::vector<float> scattered = data, expect_scattered = data;
+    for (int k = 0; k < 4; ++k) {
+      for (int c = 0; c < channels && sample.offset[k] >= 0; ++c) {
+        expect_scattered[sample.offset[k] + c] +=
+            grad[c] * sample.weight[k] / 3.0f;
+      }
+    }
+    mluoptest::bilinearScatterAdd(scattered.data(), sample, channels,
+                                  grad.data(), 3.0f);
+    ASSERT_EQ(0, memcmp(expect_scattered.data(), scattered.data(),
+                        data.size() * sizeof(float)));
+  }
+  for (int c = 0; c < channels; ++c) {
+    expect[c] = out[c] + grad[c] * 0.5f;
+  }
+  mluoptest::weightedAdd(grad.data(), 0.5f, channels, out.data());
+  ASSERT_EQ(0, memcmp(expect.data(), out.data(), channels * sizeof(float)));
+}
+
+// the per-op formulas bilinear_sample.h replaced. roialign's:
+// empty outside [-1, height] x [-1, width], else (y, x) clamped.
+void oldRoialignBilinear(int height, int width, float y, float x, float &w1,
+                         float &w2, float &w3, float &w4, int &x_low,
+                         int &x_high, int &y_low, int &y_high, int &empty) {
+  if (y < -1.0 || y > height || x < -1.0 || x > width) {
+    empty = 1;
+    return;
+  }
+  if (y <= 0) y = 0;
+  if (x <= 0) x = 0;
+  y_low = (int)y;
+  x_low = (int)x;
+  if (y_low >= height - 1) {
+    y_high = y_low = height - 1;
+    y = (float)y_low;
+  } else {
+    y_high = y_low + 1;
+  }
+  if (x_low >= width - 1) {
+    x_high = x_low = width - 1;
+    x = (float)x_low;
+  } else {
+    x_high = x_low + 1;
+  }
+  float ly = y - y_low, lx = x - x_low;
+  float hy = 1. - ly, hx = 1. - lx;
+  w1 = hy * hx, w2 = hy * lx, w3 = ly * hx, w4 = ly * lx;
+}
+
+// border_align's: the same clamp, a single channel of a (H, W, C * 4) map.
+float oldBorderAlignBilinear(const float *input, int H, int W, int C, float y,
+                             float x) {
+  if (y < -1.0 || y > H || x < -1.0 || x > W) return 0;
+  if (y <= 0) y = 0;
+  if (x <= 0) x = 0;
+  int y_low = (int)y, x_low = (int)x, y_high, x_high;
+  if (y_low >= H - 1) {
+    y_high = y_low = H - 1;
+    y = (float)y_low;
+  } else {
+    y_high = y_low + 1;
+  }
+  if (x_low >= W - 1) {
+    x_high = x_low = W - 1;
+    x = (float)x_low;
+  } else {
+    x_high = x_low + 1;
+  }
+  float ly = y - y_low, lx = x - x_low;
+  float hy = 1. - ly, hx = 1. - lx;
+  int v1_pos = y_low * W + x_low, v2_pos = y_low * W + x_high;
+  int v3_pos = y_high * W + x_low, v4_pos = y_high * W + x_high;
+  float v1 = input[v1_pos / W * W * C * 4 + v1_pos % W * C * 4];
+  float v2 = input[v2_pos / W * W * C * 4 + v2_pos % W * C * 4];
+  float v3 = input[v3_pos / W * W * C * 4 + v3_pos % W * C * 4];
+  float v4 = input[v4_pos / W * W * C * 4 + v4_pos % W * C * 4];
+  float w1 = hy * hx, w2 = hy * lx, w3 = ly * hx, w4 = ly * lx;
+  return (w1 * v1 + w2 * v2 + w3 * v3 + w4 * v4);
+}
+
+// ms_deform_attn's: corners outside the map read as 0. called only for
+// -1 < h < height and -1 < w < width.
+float oldMsDeformAttnBilinear(const float *bottom_data, int height, int width,
+                              int nheads, int channels, float h, float w,
+                              int m, int c) {
+  const int h_low = floorf(h);
+  const int w_low = floorf(w);
+  const int h_high = h_low + 1;
+  const int w_high = w_low + 1;
+  const float lh = h - h_low;
+  const float lw = w - w_low;
+  const float hh = 1 - lh, hw = 1 - lw;
+  const int w_stride = nheads * channels;
+  const int h_stride = width * w_stride;
+  const int h_low_ptr_offset = h_low * h_stride;
+  const int h_high_ptr_offset = h_low_ptr_offset + h_stride;
+  const int w_low_ptr_offset = w_low * w_stride;
+  const int w_high_ptr_offset = w_low_ptr_offset + w_stride;
+  const int base_ptr = m * channels + c;
+  float v1 = 0;
+  if (h_low >= 0 && w_low >= 0) {
+    v1 = bottom_data[h_low_ptr_offset + w_low_ptr_offset + base_ptr];
+  }
+  float v2 = 0;
+  if (h_low >= 0 && w_high <= width - 1) {
+    v2 = bottom_data[h_low_ptr_offset + w_high_ptr_offset + base_ptr];
+  }
+  float v3 = 0;
+  if (h_high <= height - 1 && w_low >= 0) {
+    v3 = bottom_data[h_high_ptr_offset + w_low_ptr_offset + base_ptr];
+  }
+  float v4 = 0;
+  if (h_high <= height - 1 && w_high <= width - 1) {
+    v4 = bottom_data[h_high_ptr_offset + w_high_ptr_offset + base_ptr];
+  }
+  const float w1 = hh * hw, w2 = hh * lw, w3 = lh * hw, w4 = lh * lw;
+  return (w1 * v1 + w2 * v2 + w3 * v3 + w4 * v4);
+}
+
+// feature values in [-1, 1], about one in 30 nan.
+std::vector<float> bilinearTestData(std::mt19937 &gen, size_t n) {
+  std::uniform_real_distribution<float> value(-1, 1);
+  std::vector<float> data(n);
+  for (auto &v : data) {
+    v = gen() % 30 == 0 ? NAN : value(gen);
+  }
+  return data;
+}
+
+// a coordinate of a map of size pixels: inside, outside, or on one of the
+// edges the builders branch on.
+float bilinearTestPos(std::mt19937 &gen, int size) {
+  const float edges[] = {-1.5f, -1, -0.5f, 0, 0.5f, (float)size - 1,
+                         size - 0.5f, (float)size, size + 0.5f};
+  if (gen() % 3 == 0) {
+    return edges[gen() % 9];
+  }
+  return std::uniform_real_distribution<float>(-2, size + 2)(gen);
+}
+
+bool sameBits(const std::vector<float> &a, const std::vector<float> &b) {
+  return a.size() == b.size() &&
+         memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+// the sample builders give the corners and weights of the old formulas.
+TEST(BilinearSampleSelfTest, MATCH_OLD_FORMULAS) {
+  std::mt19937 gen(1);
+  const int height = 5, width = 7, heads = 2, channels = 10;
+  const int64_t stride = heads * channels;
+  const std::vector<float> data =
+      bilinearTestData(gen, height * width * stride);
+  std::vector<float> value(channels);
+  for (int i = 0; i < 3000; ++i) {
+    const float y = bilinearTestPos(gen, height);
+    const float x = bilinearTestPos(gen, width);
+    const int m = gen() % heads;
+    const float *head = data.data() + m * channels;
+    mluoptest::BilinearSample sample;
+    float w[4];
+    int x_low, x_high, y_low, y_high, empty = 0;
+    oldRoialignBilinear(height, width, y, x, w[0], w[1], w[2], w[3], x_low,
+                        x_high, y_low, y_high, empty);
+    const bool inside = mluoptest::bilinearSampleClamped(height, width,
+                                                         stride, y, x, &sample);
+    ASSERT_EQ(empty == 0, inside) << y << ", " << x;
+    if (inside) {
+      const int64_t offset[4] = {(y_low * width + x_low) * stride,
+                                 (y_low * width + x_high) * stride,
+                                 (y_high * width + x_low) * stride,
+                                 (y_high * width + x_high) * stride};
+      for (int k = 0; k < 4; ++k) {
+        ASSERT_EQ(offset[k], sample.offset[k]) << y << ", " << x;
+        ASSERT_EQ(0, memcmp(&w[k], &sample.weight[k], sizeof(float)))
+            << y << ", " << x;
+      }
+    }
+    // border_align: 0 outside, the first c4 of 4 * c4 channels a pixel
+    std::vector<float> expect(channels);
+    mluoptest::BilinearSample border;
+    const int c4 = stride / 4;
+    if (mluoptest::bilinearSampleClamped(height, width, c4 * 4, y, x,
+                                         &border)) {
+      mluoptest::bilinearGather(data.data(), border, c4, value.data());
+    } else {
+      std::fill(value.begin(), value.end(), 0.0f);
+    }
+    for (int c = 0; c < c4; ++c) {
+      const float old =
+          oldBorderAlignBilinear(data.data() + c, height, width, c4, y, x);
+      ASSERT_EQ(0, memcmp(&old, &value[c], sizeof(float))) << y << ", " << x;
+    }
+    // ms_deform_attn: the sample of head m, within its guard
+    if (y > -1 && x > -1 && y < height && x < width) {
+      mluoptest::bilinearSampleZeroPad(height, width, stride, y, x, &sample);
+      mluoptest::bilinearGather(head, sample, channels, value.data());
+      for (int c = 0; c < channels; ++c) {
+        expect[c] = oldMsDeformAttnBilinear(data.data(), height, width, heads,
+                                            channels, y, x, m, c);
+      }
+      ASSERT_EQ(0, memcmp(expect.data(), value.data(),
+                          channels * sizeof(float)))
+          << y << ", " << x;
+    }
+  }
+}
+
+// roialign forward before bilinear_sample.h, channel by channel.
+void oldRoialignForward(const float *input, const float *input_rois,
+                        int height, int width, int channels, int num_rois,
+                        int roi_offset, int pooled_height, int pooled_width,
+                        float spatial_scale, int sampling_ratio, bool aligned,
+                        int pool_mode, float *output, float *argmax_x,
+                        float *argmax_y) {
+  for (int roi_idx = 0; roi_idx < num_rois; roi_idx++) {
+    const float *roi = input_rois + roi_idx * roi_offset;
+    int batch_idx = int(roi[0]);
+    float offset = aligned ? 0.5 : 0.0;
+    float roi_start_w = roi[1] * spatial_scale - offset;
+    float roi_start_h = roi[2] * spatial_scale - offset;
+    float roi_end_w = roi[3] * spatial_scale - offset;
+    float roi_end_h = roi[4] * spatial_scale - offset;
+    float roi_width = roi_end_w - roi_start_w;
+    float roi_height = roi_end_h - roi_start_h;
+    if (!aligned) {
+      roi_width = roi_width > 1 ? roi_width : 1;
+      roi_height = roi_height > 1 ? roi_height : 1;
+    }
+    float bin_size_h = (float)roi_height / pooled_height;
+    float bin_size_w = (float)roi_width / pooled_width;
+    int roi_bin_grid_h =
+        (sampling_ratio > 0) ? sampling_ratio : ceil(bin_size_h);
+    int roi_bin_grid_w =
+        (sampling_ratio > 0) ? sampling_ratio : ceil(bin_size_w);
+    float count = (roi_bin_grid_h * roi_bin_grid_w) > 1
+                      ? roi_bin_grid_h * roi_bin_grid_w
+                      : 1;
+    float count_value = 1.0f / count;
+    const float *input_temp = input + batch_idx * width * height * channels;
+    for (int ph = 0; ph < pooled_height; ph++) {
+      for (int pw = 0; pw < pooled_width; pw++) {
+        const int64_t out = ((roi_idx * pooled_height + ph) * pooled_width +
+                             pw) * channels;
+        for (int c = 0; c < channels; c++) {
+          float pooled = pool_mode == 1 ? 0 : -FLT_MAX;
+          float arg_x = -1, arg_y = -1;
+          for (int iy = 0; iy < roi_bin_grid_h; iy++) {
+            float y = roi_start_h + ph * bin_size_h +
+                      (iy + 0.5) * bin_size_h / (roi_bin_grid_h);
+            for (int ix = 0; ix < roi_bin_grid_w; ix++) {
+              float x = roi_start_w + pw * bin_size_w +
+                        (ix + 0.5) * bin_size_w / (roi_bin_grid_w);
+              float w1, w2, w3, w4;
+              int x_low, x_high, y_low, y_high, empty = 0;
+              oldRoialignBilinear(height, width, y, x, w1, w2, w3, w4, x_low,
+                                  x_high, y_low, y_high, empty);
+              float value = 0;
+              if (empty == 0) {
+                float v1 = input_temp[(y_low * width + x_low) * channels + c];
+                float v2 = input_temp[(y_low * width + x_high) * channels + c];
+                float v3 = input_temp[(y_high * width + x_low) * channels + c];
+                float v4 =
+                    input_temp[(y_high * width + x_high) * channels + c];
+                value = w1 * v1 + w2 * v2 + w3 * v3 + w4 * v4;
+              }
+              if (pool_mode == 1) {
+                pooled += value;
+              } else if (value > pooled) {
+                pooled = value;
+                arg_x = x;
+                arg_y = y;
+              }
+            }
+          }
+          if (pool_mode == 1) {
+            output[out + c] = pooled * count_value;
+          } else {
+            output[out + c] = pooled;
+            argmax_x[out + c] = arg_x;
+            argmax_y[out + c] = arg_y;
+          }
+        }
+      }
+    }
+  }
+}
+
+// ms_deform_attn forward before bilinear_sample.h, output element by element.
+void oldMsDeformAttnForward(const float *data_value,
+                            const float *data_spatial_shapes,
+                            const float *data_level_start_index,
+                            const float *data_sampling_loc,
+                            const float *data_attn_weight, int batch_size,
+                            int num_keys, int num_heads, int channels,
+                            int num_levels, int num_query, int num_point,
+                            float *data_col) {
+  const int n = batch_size * num_query * num_heads * channels;
+  for (int index = 0; index < n; ++index) {
+    int _temp = index;
+    const int c_col = _temp % channels;
+    _temp /= channels;
+    const int sampling_index = _temp;
+    const int m_col = _temp % num_heads;
+    _temp /= num_heads;
+    _temp /= num_query;
+    const int b_col = _temp;
+    int data_weight_ptr = sampling_index * num_levels * num_point;
+    int data_loc_w_ptr = data_weight_ptr << 1;
+    const int qid_stride = num_heads * channels;
+    const int data_value_ptr_init_offset = b_col * num_keys * qid_stride;
+    float col = 0;
+    for (int l_col = 0; l_col < num_levels; ++l_col) {
+      const int level_start_id = data_level_start_index[l_col];
+      const int spatial_h = data_spatial_shapes[l_col * 2];
+      const int spatial_w = data_spatial_shapes[l_col * 2 + 1];
+      const float *data_value_ptr =
+          data_value +
+          (data_value_ptr_init_offset + level_start_id * qid_stride);
+      for (int p_col = 0; p_col < num_point; ++p_col) {
+        const float loc_w = data_sampling_loc[data_loc_w_ptr];
+        const float loc_h = data_sampling_loc[data_loc_w_ptr + 1];
+        const float weight = data_attn_weight[data_weight_ptr];
+        const float h_im = loc_h * spatial_h - 0.5;
+        const float w_im = loc_w * spatial_w - 0.5;
+        if (h_im > -1 && w_im > -1 && h_im < spatial_h && w_im < spatial_w) {
+          col += oldMsDeformAttnBilinear(data_value_ptr, spatial_h, spatial_w,
+                                         num_heads, channels, h_im, w_im,
+                                         m_col, c_col) *
+                 weight;
+        }
+        data_weight_ptr += 1;
+        data_loc_w_ptr += 2;
+      }
+    }
+    data_col[index] = col;
+  }
+}
+
+// border_align forward before bilinear_sample.h, channel by channel.
+void oldBorderAlignForward(const float *input, const float *boxes, int N,
+                           int H, int W, int C, int K, int pool_size,
+                           float *output, float *argmax_idx) {
+  int i = 0;
+  for (int n = 0; n < N; ++n) {
+    for (int k = 0; k < K; ++k) {
+      const float *box = boxes + (n * K + k) * 4;
+      float bbox_width = box[2] - box[0];
+      float bbox_height = box[3] - box[1];
+      for (int border_loop = 0; border_loop < 4; ++border_loop) {
+        for (int c = 0; c < C; ++c) {
+          float x_stride = 0, y_stride = 0;
+          if (pool_size != 0) {
+            switch (border_loop) {
+              case 0: x_stride = bbox_width / pool_size; break;
+              case 1: y_stride = bbox_height / pool_size; break;
+              case 2: x_stride = -bbox_width / pool_size; break;
+              default: y_stride = -bbox_height / pool_size; break;
+            }
+          }
+          float x = box[border_loop / 2 * 2];
+          float y = box[border_loop / 2 * 2 + 1];
+          const float *in = input + n * H * W * C * 4 + border_loop * C + c;
+          float result = oldBorderAlignBilinear(in, H, W, C, y, x);
+          int argmax = 0;
+          for (int idx = 1; idx <= pool_size; ++idx) {
+            x += x_stride;
+            y += y_stride;
+            float temp = oldBorderAlignBilinear(in, H, W, C, y, x);
+            if (temp - result > 0) {
+              result = temp;
+              argmax = idx;
+            }
+          }
+          output[i] = result;
+          argmax_idx[i] = argmax;
+          i++;
+        }
+      }
+    }
+  }
+}
+
+// the ported roialign, ms_deform_attn and border_align references give the
+// bits of their old loops: nan features, rois and boxes on and over the map
+// edges, sample points outside of it.
+TEST(BilinearSampleSelfTest, PORTED_OPS_MATCH_OLD_LOOPS) {
+  std::mt19937 gen(2);
+  std::uniform_real_distribution<float> unit(0, 1);
+  // a coordinate in pixels, scaled by 1 / scale into the roi / box
+  auto coord = [&](int size, float scale) {
+    return bilinearTestPos(gen, size) / scale;
+  };
+  {
+    const int n = 2, height = 6, width = 9, channels = 19, num_rois = 30;
+    const std::vector<float> input =
+        bilinearTestData(gen, n * height * width * channels);
+    for (int round = 0; round < 8; ++round) {
+      const float scale = round % 2 ? 0.5f : 1.0f;
+      const bool aligned = round / 2 % 2;
+      const int sampling_ratio = round / 4 ? 2 : 0;
+      std::vector<float> rois;
+      for (int r = 0; r < num_rois; ++r) {
+        rois.push_back(gen() % n);
+        const float x1 = coord(width, scale), y1 = coord(height, scale);
+        // mostly x1 <= x2, some empty and some inverted rois
+        const float x2 = r % 5 == 0 ? coord(width, scale)
+                                    : x1 + unit(gen) * width / scale;
+        const float y2 = r % 7 == 0 ? y1 : y1 + unit(gen) * height / scale;
+        rois.insert(rois.end(), {x1, y1, x2, y2});
+      }
+      const int ph = 3, pw = 2;
+      const size_t size = num_rois * ph * pw * channels;
+      for (int pool_mode : {0, 1}) {
+        std::vector<float> out(size), ax(size), ay(size);
+        std::vector<float> old_out(size), old_ax(size), old_ay(size);
+        mluoptest::roialignForwardCpu(
+            input.data(), rois.data(), height, width, channels, num_rois, 5,
+            ph, pw, scale, sampling_ratio, aligned, pool_mode, out.data(),
+            ax.data(), ay.data());
+        oldRoialignForward(input.data(), rois.data(), height, width, channels,
+                           num_rois, 5, ph, pw, scale, sampling_ratio,
+                           aligned, pool_mode, old_out.data(), old_ax.data(),
+                           old_ay.data());
+        EXPECT_TRUE(sameBits(old_out, out)) << "round " << round;
+        if (pool_mode == 0) {
+          EXPECT_TRUE(sameBits(old_ax, ax)) << "round " << round;
+          EXPECT_TRUE(sameBits(old_ay, ay)) << "round " << round;
+        }
+      }
+    }
+  }
+  {
+    const int batch = 2, heads = 3, channels = 13, levels = 2, query = 7,
+              points = 4;
+    const float shapes[] = {5, 6, 2, 3};  // (h, w) of each level
+    const float starts[] = {0, 30};
+    const int keys = 36;
+    const std::vector<float> value =
+        bilinearTestData(gen, batch * keys * heads * channels);
+    const int samples = batch * query * heads * levels * points;
+    std::vector<float> weight = bilinearTestData(gen, samples);
+    std::vector<float> loc(samples * 2);
+    for (int i = 0; i < samples; ++i) {
+      const int level = i / points % levels;
+      // in [0, 1] of the level, the pixel centers at (k + 0.5) / size
+      const int h = shapes[level * 2], w = shapes[level * 2 + 1];
+      loc[i * 2] = (bilinearTestPos(gen, w) + 0.5f) / w;
+      loc[i * 2 + 1] = (bilinearTestPos(gen, h) + 0.5f) / h;
+      if (gen() % 40 == 0) {
+        loc[i * 2 + gen() % 2] = NAN;
+      }
+    }
+    const size_t size = batch * query * heads * channels;
+    std::vector<float> col(size), old_col(size);
+    mluoptest::msDeformAttnForwardCpu(value.data(), shapes, starts, loc.data(),
+                                      weight.data(), batch, keys, heads,
+                                      channels, levels, query, points,
+                                      col.data());
+    oldMsDeformAttnForward(value.data(), shapes, starts, loc.data(),
+                           weight.data(), batch, keys, heads, channels,
+                           levels, query, points, old_col.data());
+    EXPECT_TRUE(sameBits(old_col, col));
+  }
+  {
+    const int n = 2, height = 6, width = 7, channels = 5, k = 20;
+    const std::vector<float> input =
+        bilinearTestData(gen, n * height * width * channels * 4);
+    std::vector<float> boxes;
+    for (int b = 0; b < n * k; ++b) {
+      const float x1 = coord(width, 1), y1 = coord(height, 1);
+      boxes.insert(boxes.end(), {x1, y1, x1 + unit(gen) * width,
+                                 y1 + unit(gen) * height});
+    }
+    for (int pool_size : {0, 1, 3, 10}) {
+      const size_t size = n * k * 4 * channels;
+      std::vector<float> out(size), argmax(size);
+      std::vector<float> old_out(size), old_argmax(size);
+      mluoptest::borderAlignForwardCpu(input.data(), boxes.data(), n, height,
+                                       width, channels, k, pool_size,
+                                       out.data(), argmax.data());
+      oldBorderAlignForward(input.data(), boxes.data(), n, height, width,
+                            channels, k, pool_size, old_out.data(),
+                            old_argmax.data());
+      EXPECT_TRUE(sameBits(old_out, out)) << "pool_size " << pool_size;
+      EXPECT_TRUE(sameBits(old_argmax, argmax)) << "pool_size " << pool_size;
+    }
+  }
+}
+
+TEST(RotatedIouSelfTest, MATCH_PAIRS) {
+  // x_ctr, y_ctr, w, h, angle
+  const float boxes[] = {0,  0,   2, 2, 0,    1, 0, 2, 2, 0,
+                         0,  0,   2, 2, 0.7f, 0, 0, 1, 1, 0.3f,
+                         10, -10, 2, 2, 0,    0, 0, 0, 2, 0};
+  for (bool reciprocal : {false, true}) {
+    mluoptest::RotatedBoxes set(boxes, 6, 5, {reciprocal, reciprocal});
+    EXPECT_NEAR(1.f / 3, set.iou(0, set, 1, 0), 1e-5);
+    EXPECT_NEAR(1, set.iou(2, set, 2, 0), 1e-5);
+    EXPECT_NEAR(0.25, set.iou(0, set, 3, 0), 1e-5);
+    EXPECT_NEAR(1, set.iou(3, set, 0, 1), 1e-5);  // iof, inside box 0
+    EXPECT_EQ(0, set.iou(0, set, 4, 0));  // apart
+    EXPECT_EQ(0, set.iou(5, set, 0, 0));  // no area
+  }
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> pos(0, 100), size(0, 20), angle(-4, 4);
+  const int num1 = 150, num2 = 70;  // partial tiles
+  std::vector<float> data((num1 + num2) * 5);
+  for (int i = 0; i < num1 + num2; ++i) {
+    float *box = data.data() + i * 5;
+    box[0] = offset + pos(gen);
+    box[1] = offset + pos(gen);
+    box[2] = size(gen);
+    box[3] = size(gen);
+    box[4] = angle(gen);
+  }
+  data[7 * 5 + 2] = NAN;
+  mluoptest::RotatedBoxes set1(data.data(), num1, 5, {true, true});
+  mluoptest::RotatedBoxes set2(data.data() + num1 * 5, num2, 5, {true, true});
+  std::vector<float> ious(num1 * num2);
+  mluoptest::rotatedIouMatrix(set1, set2, 0, ious.data());
+  for (int i = 0; i < num1; ++i) {
+    for (int j = 0; j < num2; ++j) {
+      const float iou = set1.iou(i, set2, j, 0);
+      ASSERT_EQ(0, memcmp(&iou, &ious[i * num2 + j], sizeof(float)));
+      const bool apart = set1.x1()[i] > set2.x2()[j] ||
+                         set2.x1()[j] > set1.x2()[i] ||
+                         set1.y1()[i] > set2.y2()[j] ||
+                         set2.y1()[j] > set1.y2()[i];
+      ASSERT_TRUE(!apart || iou == 0) << i << ", " << j;
+    }
+  }
+  ASSERT_TRUE(std::isinf(set1.x1()[7]));  // nan width, never culled
+
+  const float quad[] = {1, 2, -3, 4, 0, -1, 2, 5};
+  float lo[2], hi[2];
+  mluoptest::polygonBounds(quad, 4, lo, hi);
+  EXPECT_EQ(-3, lo[0]);
+  EXPECT_EQ(-1, lo[1]);
+  EXPECT_EQ(2, hi[0]);
+  EXPECT_EQ(5, hi[1]);
+}
+
+// box_iou_rotated (cos / sin, divisions) and nms_rotated (cosf / sinf,
+// reciprocals) before RotatedBoxes: mmcv's convex clip of every pair.
+struct OldPoint {
+  float x, y;
+};
+OldPoint operator+(OldPoint a, OldPoint b) { return {a.x + b.x, a.y + b.y}; }
+OldPoint operator-(OldPoint a, OldPoint b) { return {a.x - b.x, a.y - b.y}; }
+OldPoint operator*(OldPoint a, float k) { return {a.x * k, a.y * k}; }
+float oldDot(OldPoint a, OldPoint b) { return a.x * b.x + a.y * b.y; }
+float oldCross(OldPoint a, OldPoint b) { return a.x * b.y - a.y * b.x; }
+
+void oldVertices(float x, float y, float w, float h, float a, bool nms,
+                 OldPoint (&pts)[4]) {
+  const double theta = a;
+  const float c = (nms ? cosf(theta) : (float)cos(theta)) * 0.5f;
+  const float s = (nms ? sinf(theta) : (float)sin(theta)) * 0.5f;
+  pts[0] = {x - s * h - c * w, y + c * h - s * w};
+  pts[1] = {x + s * h - c * w, y - c * h - s * w};
+  pts[2] = {2 * x - pts[0].x, 2 * y - pts[0].y};
+  pts[3] = {2 * x - pts[1].x, 2 * y - pts[1].y};
+}
+
+// vertices of a inside b, as projections within the edges of b
+void oldInside(const OldPoint (&a)[4], const OldPoint (&b)[4],
+               const OldPoint (&vb)[4], OldPoint *out, int *num) {
+  const float ab = oldDot(vb[0], vb[0]), ad = oldDot(vb[3], vb[3]);
+  for (int i = 0; i < 4; ++i) {
+    const OldPoint ap = a[i] - b[0];
+    const float p = oldDot(ap, vb[0]), q = -oldDot(ap, vb[3]);
+    if (p >= 0 && q >= 0 && p <= ab && q <= ad) out[(*num)++] = a[i];
+  }
+}
+
+float oldIntersection(const OldPoint (&p1)[4], const OldPoint (&p2)[4],
+                      bool nms) {
+  OldPoint v1[4], v2[4], p[24], q[24];
+  for (int i = 0; i < 4; ++i) {
+    v1[i] = p1[(i + 1) % 4] - p1[i];
+    v2[i] = p2[(i + 1) % 4] - p2[i];
+  }
+  int num = 0;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      const float det = oldCross(v2[j], v1[i]);
+      if (fabs(det) <= 1e-14) continue;
+      const OldPoint v12 = p2[j] - p1[i];
+      const float t1 = nms ? oldCross(v2[j], v12) * (1.0f / det)
+                           : oldCross(v2[j], v12) / det;
+      const float t2 = nms ? oldCross(v1[i], v12) * (1.0f / det)
+                           : oldCross(v1[i], v12) / det;
+      if (t1 >= 0.0f && t1 <= 1.0f && t2 >= 0.0f && t2 <= 1.0f) {
+        p[num++] = p1[i] + v1[i] * t1;
+      }
+    }
+  }
+  oldInside(p1, p2, v2, p, &num);
+  oldInside(p2, p1, v1, p, &num);
+  if (num <= 2) return 0;
+
+  // graham scan from the lowest point, ties by angle sorted by distance
+  int t = 0;
+  for (int i = 0; i < num; ++i) {
+    if (p[i].y < p[t].y || (p[i].y == p[t].y && p[i].x < p[t].x)) t = i;
+  }
+  for (int i = 0; i < num; ++i) q[i] = p[i] - p[t];
+  std::swap(q[0], q[t]);
+  float dist[24];
+  for (int i = 0; i < num; ++i) dist[i] = oldDot(q[i], q[i]);
+  for (int i = 1; i < num - 1; ++i) {
+    for (int j = i + 1; j < num; ++j) {
+      const float c = oldCross(q[i], q[j]);
+      if (c < -1e-6 || (fabs(c) < 1e-6 && dist[i] > dist[j])) {
+        std::swap(q[i], q[j]);
+        std::swap(dist[i], dist[j]);
+      }
+    }
+  }
+  int k = 1;
+  while (k < num && !(dist[k] > 1e-8)) ++k;
+  if (k == num) return 0;
+  q[1] = q[k];
+  int m = 2;
+  for (int i = k + 1; i < num; ++i) {
+    while (m > 1 && oldCross(q[i] - q[m - 2], q[m - 1] - q[m - 2]) >= 0) --m;
+    q[m++] = q[i];
+  }
+  float area = 0;
+  for (int i = 1; i < m - 1; ++i) {
+    area += fabs(oldCross(q[i] - q[0], q[i + 1] - q[0]));
+  }
+  return area / 2.0;
+}
+
+float oldRotatedIou(const float *b1, const float *b2, int mode, bool nms) {
+  const double cx = (b1[0] + b2[0]) / 2.0, cy = (b1[1] + b2[1]) / 2.0;
+  const float x1 = b1[0] - cx, y1 = b1[1] - cy;
+  const float x2 = b2[0] - cx, y2 = b2[1] - cy;
+  const float area1 = b1[2] * b1[3], area2 = b2[2] * b2[3];
+  if (area1 < 1e-14 || area2 < 1e-14) return 0.f;
+  OldPoint p1[4], p2[4];
+  oldVertices(x1, y1, b1[2], b1[3], b1[4], nms, p1);
+  oldVertices(x2, y2, b2[2], b2[3], b2[4], nms, p2);
+  const float inter = oldIntersection(p1, p2, nms);
+  const float base = mode == 0 ? area1 + area2 - inter : area1;
+  return nms ? inter * (1.0f / base) : inter / base;
+}
+
+std::vector<int> nmsRotatedAllPairs(const float *boxes, const float *scores,
+                                    int num, float thresh, int box_dim) {
+  std::vector<int> order(num);
+  for (int i = 0; i < num; ++i) order[i] = i;
+  std::sort(order.begin(), order.end(),
+            [&](int a, int b) { return scores[a] > scores[b]; });
+  std::vector<uint8_t> suppressed(num, 0);
+  std::vector<int> keep;
+  for (int a = 0; a < num; ++a) {
+    const int i = order[a];
+    if (suppressed[i]) continue;
+    keep.push_back(i);
+    for (int b = a + 1; b < num; ++b) {
+      const int j = order[b];
+      if (!suppressed[j] &&
+          oldRotatedIou(boxes + i * box_dim, boxes + j * box_dim, 0, true) >
+              thresh) {
+        suppressed[j] = 1;
+      }
+    }
+  }
+  return keep;
+}
+
+// random boxes with the cases the bounds and the thin-box fallback must
+// get right: copies, touching, 1 ulp and just apart neighbours, thin and
+// empty boxes, nan and inf parameters.
+std::vector<float> rotatedTestBoxes(std::mt19937 *gen, int num, float range,
+                                    int box_dim) {
+  std::uniform_real_distribution<float> pos(-range, range), size(0, 20),
+      angle(-4, 4), unit(0, 1);
+  std::vector<float> boxes(num * box_dim, 0.f);
+  for (int i = 0; i < num; ++i) {
+    float *b = boxes.data() + i * box_dim;
+    b[0] = pos(*gen);
+    b[1] = pos(*gen);
+    b[2] = size(*gen);
+    b[3] = size(*gen);
+    b[4] = (*gen)() % 3 ? angle(*gen) : (float)((*gen)() % 4) * 1.5707964f;
+    if (i == 0) continue;
+    const float *prev = b - box_dim;
+    switch ((*gen)() % 10) {
+      case 0:  // copy
+        std::copy(prev, prev + 5, b);
+        break;
+      case 1: {  // upright, right of prev: touching, 1 ulp or 1e-5 apart
+        b[4] = 0;
+        b[1] = prev[1];
+        b[3] = prev[3];
+        const float edge = prev[0] + prev[2] / 2;
+        const float gaps[3] = {edge, nextafterf(edge, INFINITY),
+                               edge + 1e-5f * (fabsf(edge) + 1)};
+        b[0] = gaps[(*gen)() % 3] + b[2] / 2;
+        break;
+      }
+      case 2:  // thin
+        b[(*gen)() % 2 ? 2 : 3] = unit(*gen) * 1e-4f;
+        break;
+      case 3:  // no area
+        b[2 + (*gen)() % 2] = (*gen)() % 2 ? 0.f : -b[2];
+        break;
+      case 4: {  // non-finite
+        const float bad[3] = {NAN, INFINITY, -INFINITY};
+        b[(*gen)() % 5] = bad[(*gen)() % 3];
+        break;
+      }
+      case 5:  // the same center, turned
+        b[0] = prev[0];
+        b[1] = prev[1];
+        break;
+      default:
+        break;
+    }
+  }
+  return boxes;
+}
+
+TEST(BoxIouRotatedSelfTest, MATCH_ALL_PAIRS) {
+  std::mt19937 gen(0);
+  for (int round = 0; round < 8; ++round) {
+    const int num1 = 90 + round, num2 = 70;
+    const float range = round % 2 ? 30.f : 3000.f;
+    std::vector<float> a = rotatedTestBoxes(&gen, num1, range, 5);
+    std::vector<float> b = rotatedTestBoxes(&gen, num2, range, 5);
+    std::copy(a.begin(), a.begin() + 20 * 5, b.begin());  // shared boxes
+    mluoptest::RotatedBoxes set1(a.data(), num1, 5, {false, false});
+    mluoptest::RotatedBoxes set2(b.data(), num2, 5, {false, false});
+    for (int mode : {0, 1}) {
+      std::vector<float> ious(num1 * num2);
+      mluoptest::rotatedIouMatrix(set1, set2, mode, ious.data());
+      for (int i = 0; i < num1; ++i) {
+        for (int j = 0; j < num2; ++j) {
+          const float iou =
+              oldRotatedIou(&a[i * 5], &b[j * 5], mode, false);
+          ASSERT_EQ(0, memcmp(&iou, &ious[i * num2 + j], sizeof(float)))
+              << "round " << round << ", " << i << ", " << j << ": " << iou
+              << " vs " << ious[i * num2 + j];
+        }
+      }
+    }
+  }
+}
+
+TEST(NmsRotatedSelfTest, MATCH_ALL_PAIRS) {
+  std::mt19937 gen(1);
+  for (int round = 0; round < 12; ++round) {
+    const int num = 200 + round * 37, box_dim = round % 3 ? 5 : 6;
+    const float range = round % 2 ? 40.f : 400.f;
+    std::vector<float> boxes = rotatedTestBoxes(&gen, num, range, box_dim);
+    std::vector<float> scores(num);
+    for (int i = 0; i < num; ++i) {
+      // few distinct scores, so there are ties
+      scores[i] = (float)(gen() % 8);
+    }
+    for (float thresh : {-0.1f, 0.f, 0.2f, 0.5f, 0.9f}) {
+      EXPECT_EQ(nmsRotatedAllPairs(boxes.data(), scores.data(), num, thresh,
+                                   box_dim),
+                mluoptest::nmsRotatedGrid(boxes.data(), scores.data(), num,
+                                          thresh, box_dim))
+          << "round " << round << ", thresh " << thresh;
+    }
+  }
+}
+
+// poly_nms before PolyNmsImpl: iouPoly of the kept box and all the rest.
+std::vector<int> polyNmsAllPairs(std::vector<std::vector<float>> p,
+                                 float thresh) {
+  std::vector<std::pair<std::vector<float>, int>> vp;
+  for (int i = 0; i < (int)p.size(); i++) {
+    vp.push_back(std::make_pair(p[i], i));
+  }
+  std::sort(vp.begin(), vp.end(),
+            [](const std::pair<std::vector<float>, int> &a,
+               const std::pair<std::vector<float>, int> &b) {
+              return a.first.back() > b.first.back();
+            });
+  std::vector<int> keep;
+  while (vp.size()) {
+    keep.push_back(vp.begin()->second);
+    auto box = vp.begin()->first;
+    vp.erase(vp.begin());
+    for (int i = 0; i < (int)vp.size(); i++) {
+      if (PNMS::iouPoly(box, vp[i].first) > thresh) {
+        vp.erase(vp.begin() + i);
+        i--;
+      }
+    }
+  }
+  std::sort(keep.begin(), keep.end());
+  return keep;
+}
+
+// touching, 1 ulp apart and nearly touching quads keep the all-pairs result,
+// also thin quads around 1e5, where iouPoly finds overlaps of quads apart.
+TEST(PolyNmsSelfTest, MATCH_ALL_PAIRS) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> pos(-1000, 1000), size(1, 50),
+      angle(-4, 4), unit(0, 1);
+  for (int round = 0; round < 20; ++round) {
+    std::vector<std::vector<float>> quads;
+    auto push = [&](const float *xy) {
+      // few distinct scores, so there are ties
+      quads.emplace_back(xy, xy + 8);
+      quads.back().push_back((float)(gen() % 4));
+    };
+    for (int i = 0; i < 60; ++i) {
+      const bool far = round % 4 == 3;
+      const float cx = pos(gen) * (far ? 100 : round % 2 ? 1 : 0.1f);
+      const float cy = pos(gen) * (far ? 100 : 0.1f);
+      const float w = size(gen), h = size(gen) / (far ? 1000 : 1);
+      const float a = angle(gen);
+      const float c = cosf(a), s = sinf(a);
+      const float dx[4] = {-w, w, w, -w}, dy[4] = {-h, -h, h, h};
+      float p[8];
+      for (int k = 0; k < 4; ++k) {
+        p[k * 2] = cx + (dx[k] * c - dy[k] * s) / 2;
+        p[k * 2 + 1] = cy + (dx[k] * s + dy[k] * c) / 2;
+      }
+      push(p);
+      // the same quad moved by one of its edges: shares that edge
+      const int e = gen() % 4;
+      const float ex = p[(e * 2 + 2) % 8] - p[e * 2];
+      const float ey = p[(e * 2 + 3) % 8] - p[e * 2 + 1];
+      float q[8];
+      for (int k = 0; k < 4; ++k) {
+        q[k * 2] = p[k * 2] + ex;
+        q[k * 2 + 1] = p[k * 2 + 1] + ey;
+      }
+      push(q);
+      // an upright quad right of the bounds of p: touching them, or 1 ulp,
+      // 1e-6 or 1e-3 apart
+      float lo[2], hi[2];
+      mluoptest::polygonBounds(p, 4, lo, hi);
+      const float gaps[4] = {hi[0], nextafterf(hi[0], INFINITY),
+                             hi[0] + fabsf(hi[0]) * 1e-6f + 1e-6f,
+                             hi[0] + 1e-3f};
+      const float x0 = gaps[gen() % 4];
+      const float y0 = lo[1] + unit(gen) * (hi[1] - lo[1]);
+      const float x1 = x0 + size(gen), y1 = y0 + size(gen);
+      const float r[8] = {x0, y0, x1, y0, x1, y1, x0, y1};
+      push(r);
+    }
+    quads[5][2] = NAN;
+    for (float thresh : {-0.1f, 0.f, 0.1f, 0.3f, 0.5f, 0.7f}) {
+      std::vector<std::vector<float>> input = quads;
+      EXPECT_EQ(polyNmsAllPairs(quads, thresh),
+                PNMS::PolyNmsImpl(input, thresh))
+          << "round " << round << ", thresh " << thresh;
+    }
+  }
+}
 }  // namespace
@@ -22,60 +22,228 @@
  *************************************************************************/
 
 #include "transpose_cpu.h"
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <cstring>
 #include <vector>
 #include "core/tensor.h"
 
+// edge of the 2-D block transposed at once, 32x32 fp32 is 4KB per side.
+#define TRANSPOSE_TILE 32
+
+// drop size-1 dims, and merge input dims which are still adjacent and in the
+// same order after permute. e.g. shape (2, 3, 4, 5) with permute (2, 3, 0, 1)
+// becomes shape (6, 20) with permute (1, 0).
+static void transposeMergeDims(const int dim_num, const uint64_t *DIM,
+                               const uint64_t *permute,
+                               std::vector<uint64_t> *shape,
+                               std::vector<int> *perm) {
+  // rank of each non-unit input dim
+  std::vector<int> rank(dim_num, -1);
+  std::vector<uint64_t> kept;
+  for (int i = 0; i < dim_num; ++i) {
+    if (DIM[i] != 1) {
+      rank[i] = kept.size();
+      kept.push_back(DIM[i]);
+    }
+  }
+  // group ranks in output order, a group is a run of consecutive ranks.
+  std::vector<std::vector<int>> groups;
+  for (int k = 0; k < dim_num; ++k) {
+    int r = rank[permute[k]];
+    if (r < 0) {
+      continue;
+    }
+    if (!groups.empty() && groups.back().back() + 1 == r) {
+      groups.back().push_back(r);
+    } else {
+      groups.push_back({r});
+    }
+  }
+  // merged input dims are ordered by the first rank of each group.
+  std::vector<int> order(groups.size());
+  for (int g = 0; g < groups.size(); ++g) {
+    order[g] = g;
+  }
+  std::sort(order.begin(), order.end(), [&groups](int a, int b) {
+    return groups[a][0] < groups[b][0];
+  });
+  shape->assign(groups.size(), 1);
+  perm->assign(groups.size(), 0);
+  for (int i = 0; i < order.size(); ++i) {
+    for (int r : groups[order[i]]) {
+      (*shape)[i] *= kept[r];
+    }
+    (*perm)[order[i]] = i;
+  }
+}
+
+// dst[c * dst_ld + r] = src[r * src_ld + c], for r < rows, c < cols.
+template <typename T>
+static inline void transposeTileScalar(const T *src, const uint64_t src_ld,
+                                       T *dst, const uint64_t dst_ld,
+                                       const uint64_t rows,
+                                       const uint64_t cols) {
+  for (uint64_t c = 0; c < cols; ++c) {
+    for (uint64_t r = 0; r < rows; ++r) {
+      dst[c * dst_ld + r] = src[r * src_ld + c];
+    }
+  }
+}
+
+template <typename T>
+static inline void transposeTile(const T *src, const uint64_t src_ld, T *dst,
+                                 const uint64_t dst_ld, const uint64_t rows,
+                                 const uint64_t cols) {
+  transposeTileScalar(src, src_ld, dst, dst_ld, rows, cols);
+}
+
+#ifdef __AVX__
+template <>
+inline void transposeTile<float>(const float *src, const uint64_t src_ld,
+                                 float *dst, const uint64_t dst_ld,
+                                 const uint64_t rows, const uint64_t cols) {
+  uint64_t rows8 = rows / 8 * 8, cols8 = cols / 8 * 8;
+  for (uint64_t r = 0; r < rows8; r += 8) {
+    for (uint64_t c = 0; c < cols8; c += 8) {
+      const float *s = src + r * src_ld + c;
+      __m256 r0 = _mm256_loadu_ps(s);
+      __m256 r1 = _mm256_loadu_ps(s + src_ld);
+      __m256 r2 = _mm256_loadu_ps(s + 2 * src_ld);
+      __m256 r3 = _mm256_loadu_ps(s + 3 * src_ld);
+      __m256 r4 = _mm256_loadu_ps(s + 4 * src_ld);
+      __m256 r5 = _mm256_loadu_ps(s + 5 * src_ld);
+      __m256 r6 = _mm256_loadu_ps(s + 6 * src_ld);
+      __m256 r7 = _mm256_loadu_ps(s + 7 * src_ld);
+      __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+      __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+      __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+      __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+      __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+      __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+      __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+      __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+      r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+      r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+      r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+      r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+      r4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+      r5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+      r6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+      r7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+      float *d = dst + c * dst_ld + r;
+      _mm256_storeu_ps(d, _mm256_permute2f128_ps(r0, r4, 0x20));
+      _mm256_storeu_ps(d + dst_ld, _mm256_permute2f128_ps(r1, r5, 0x20));
+      _mm256_storeu_ps(d + 2 * dst_ld, _mm256_permute2f128_ps(r2, r6, 0x20));
+      _mm256_storeu_ps(d + 3 * dst_ld, _mm256_permute2f128_ps(r3, r7, 0x20));
+      _mm256_storeu_ps(d + 4 * dst_ld, _mm256_permute2f128_ps(r0, r4, 0x31));
+      _mm256_storeu_ps(d + 5 * dst_ld, _mm256_permute2f128_ps(r1, r5, 0x31));
+      _mm256_storeu_ps(d + 6 * dst_ld, _mm256_permute2f128_ps(r2, r6, 0x31));
+      _mm256_storeu_ps(d + 7 * dst_ld, _mm256_permute2f128_ps(r3, r7, 0x31));
+    }
+  }
+  // remainder: right columns of the full rows, then the bottom rows.
+  if (cols8 < cols) {
+    transposeTileScalar(src + cols8, src_ld, dst + cols8 * dst_ld, dst_ld,
+                        rows8, cols - cols8);
+  }
+  if (rows8 < rows) {
+    transposeTileScalar(src + rows8 * src_ld, src_ld, dst + rows8, dst_ld,
+                        rows - rows8, cols);
+  }
+}
+#endif  // __AVX__
 
 template <typename T>
 static void transposeCpuNd(const int loop_d, T *x, T *y, const uint64_t sum,
-                           uint64_t *dim, uint64_t *DIM, uint64_t *permute) {
-  for (int loop_t = 0; loop_t < loop_d; loop_t++) {
-    T *output = (T *)(y + sum * loop_t);
-    T *input = (T *)(x + sum * loop_t);
-    uint64_t in_index = 0, out_index = 0;
+                           const int dim_num, const uint64_t *DIM,
+                           const uint64_t *permute) {
+  std::vector<uint64_t> shape;
+  std::vector<int> perm;
+  transposeMergeDims(dim_num, DIM, permute, &shape, &perm);
+  const int m = shape.size();
+  if (m <= 1) {  // identity after merging
+    memcpy(y, x, loop_d * sum * sizeof(T));
+    return;
+  }
 
-    for (dim[0] = 0; dim[0] < DIM[0]; dim[0]++) {
-      for (dim[1] = 0; dim[1] < DIM[1]; dim[1]++) {
-        for (dim[2] = 0; dim[2] < DIM[2]; dim[2]++) {
-          for (dim[3] = 0; dim[3] < DIM[3]; dim[3]++) {
-            for (dim[4] = 0; dim[4] < DIM[4]; dim[4]++) {
-              for (dim[5] = 0; dim[5] < DIM[5]; dim[5]++) {
-                for (dim[6] = 0; dim[6] < DIM[6]; dim[6]++) {
-                  for (dim[7] = 0; dim[7] < DIM[7]; dim[7]++) {
-                    in_index =
-                        dim[0] * DIM[1] * DIM[2] * DIM[3] * DIM[4] * DIM[5] *
-                            DIM[6] * DIM[7] +
-                        dim[1] * DIM[2] * DIM[3] * DIM[4] * DIM[5] * DIM[6] *
-                            DIM[7] +
-                        dim[2] * DIM[3] * DIM[4] * DIM[5] * DIM[6] * DIM[7] +
-                        dim[3] * DIM[4] * DIM[5] * DIM[6] * DIM[7] +
-                        dim[4] * DIM[5] * DIM[6] * DIM[7] +
-                        dim[5] * DIM[6] * DIM[7] + dim[6] * DIM[7] + dim[7];
-                    out_index =
-                        dim[permute[0]] * DIM[permute[1]] * DIM[permute[2]] *
-                            DIM[permute[3]] * DIM[permute[4]] *
-                            DIM[permute[5]] * DIM[permute[6]] *
-                            DIM[permute[7]] +
-                        dim[permute[1]] * DIM[permute[2]] * DIM[permute[3]] *
-                            DIM[permute[4]] * DIM[permute[5]] *
-                            DIM[permute[6]] * DIM[permute[7]] +
-                        dim[permute[2]] * DIM[permute[3]] * DIM[permute[4]] *
-                            DIM[permute[5]] * DIM[permute[6]] *
-                            DIM[permute[7]] +
-                        dim[permute[3]] * DIM[permute[4]] * DIM[permute[5]] *
-                            DIM[permute[6]] * DIM[permute[7]] +
-                        dim[permute[4]] * DIM[permute[5]] * DIM[permute[6]] *
-                            DIM[permute[7]] +
-                        dim[permute[5]] * DIM[permute[6]] * DIM[permute[7]] +
-                        dim[permute[6]] * DIM[permute[7]] + dim[permute[7]];
-                    output[out_index] = input[in_index];
-                  }
-                }
-              }
-            }
-          }
+  // strides of input dims, and of output positions.
+  std::vector<uint64_t> in_stride(m, 1), out_stride(m, 1);
+  for (int i = m - 2; i >= 0; --i) {
+    in_stride[i] = in_stride[i + 1] * shape[i + 1];
+    out_stride[i] = out_stride[i + 1] * shape[perm[i + 1]];
+  }
+  if (perm[m - 1] == m - 1) {
+    // the last dim stays last, copy contiguous rows in output order.
+    const uint64_t n = shape[m - 1];
+    const uint64_t row_num = sum / n;
+    for (int loop_t = 0; loop_t < loop_d; loop_t++) {
+      const T *input = x + sum * loop_t;
+      T *output = y + sum * loop_t;
+#pragma omp parallel for schedule(static) if (sum > (1 << 16))
+      for (uint64_t row = 0; row < row_num; ++row) {
+        uint64_t rest = row, in_offset = 0;
+        for (int k = m - 2; k >= 0; --k) {
+          in_offset += rest % shape[perm[k]] * in_stride[perm[k]];
+          rest /= shape[perm[k]];
         }
+        memcpy(output + row * n, input + in_offset, n * sizeof(T));
+      }
+    }
+    return;
+  }
+
+  // output position of the last (contiguous) input dim.
+  int k0 = 0;
+  while (perm[k0] != m - 1) {
+    ++k0;
+  }
+  // the plane (output pos k0, output pos m - 1) is a 2-D transpose:
+  // rows walk output pos m - 1 (input stride in_stride[perm[m - 1]]),
+  // cols walk input dim m - 1 (output stride out_stride[k0]).
+  const uint64_t rows = shape[perm[m - 1]];
+  const uint64_t cols = shape[m - 1];
+  const uint64_t src_ld = in_stride[perm[m - 1]];
+  const uint64_t dst_ld = out_stride[k0];
+  const uint64_t row_tiles = (rows + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+  const uint64_t col_tiles = (cols + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+  // the other output positions are outer loops.
+  std::vector<uint64_t> outer_size, outer_in_stride, outer_out_stride;
+  uint64_t outer_num = 1;
+  for (int k = 0; k < m - 1; ++k) {
+    if (k == k0) {
+      continue;
+    }
+    outer_size.push_back(shape[perm[k]]);
+    outer_in_stride.push_back(in_stride[perm[k]]);
+    outer_out_stride.push_back(out_stride[k]);
+    outer_num *= shape[perm[k]];
+  }
+  const int outer_dim = outer_size.size();
+  const uint64_t task_num = outer_num * row_tiles * col_tiles;
+
+  for (int loop_t = 0; loop_t < loop_d; loop_t++) {
+    const T *input = x + sum * loop_t;
+    T *output = y + sum * loop_t;
+#pragma omp parallel for schedule(static) if (sum > (1 << 16))
+    for (uint64_t task = 0; task < task_num; ++task) {
+      uint64_t rest = task / (row_tiles * col_tiles);
+      uint64_t tile = task % (row_tiles * col_tiles);
+      uint64_t in_offset = 0, out_offset = 0;
+      for (int k = outer_dim - 1; k >= 0; --k) {
+        uint64_t idx = rest % outer_size[k];
+        rest /= outer_size[k];
+        in_offset += idx * outer_in_stride[k];
+        out_offset += idx * outer_out_stride[k];
       }
+      uint64_t r = tile / col_tiles * TRANSPOSE_TILE;
+      uint64_t c = tile % col_tiles * TRANSPOSE_TILE;
+      transposeTile<T>(input + in_offset + r * src_ld + c, src_ld,
+                       output + out_offset + c * dst_ld + r, dst_ld,
+                       std::min((uint64_t)TRANSPOSE_TILE, rows - r),
+                       std::min((uint64_t)TRANSPOSE_TILE, cols - c));
     }
   }
 }
@@ -110,7 +278,6 @@ mluOpStatus_t mluOpTransposeCpu(const int64_t dim_desc,
   // TRANSPOSE_MAX_DIM
   uint64_t permute[TRANSPOSE_MAX_DIM] = {8, 8, 8, 8, 8, 8, 8, 8};
   uint64_t DIM[TRANSPOSE_MAX_DIM + 1] = {1, 1, 1, 1, 1, 1, 1, 1, 1};
-  uint64_t dim[TRANSPOSE_MAX_DIM + 1] = {0};
 
   if (x_desc->getDim() != dim_all || y_desc->getDim() != dim_all) {
     LOG(ERROR)
@@ -125,12 +292,15 @@ mluOpStatus_t mluOpTransposeCpu(const int64_t dim_desc,
     DIM[i] = x_desc->getDimIndex(i);
   }
   if (MLUOP_DTYPE_INT31 == data_type) {
-    transposeCpuNd(loop_d, (int16_t *)x, (int16_t *)y, sum, dim, DIM, permute);
+    transposeCpuNd(loop_d, (int16_t *)x, (int16_t *)y, sum, dim_all, DIM,
+                   permute);
   } else if (MLUOP_DTYPE_COMPLEX_HALF == data_type ||
              MLUOP_DTYPE_COMPLEX_FLOAT == data_type) {
-    transposeCpuNd(loop_d, (double *)x, (double *)y, sum, dim, DIM, permute);
+    transposeCpuNd(loop_d, (double *)x, (double *)y, sum, dim_all, DIM,
+                   permute);
   } else {
-    transposeCpuNd(loop_d, (float *)x, (float *)y, sum, dim, DIM, permute);
+    transposeCpuNd(loop_d, (float *)x, (float *)y, sum, dim_all, DIM,
+                   permute);
   }
   return MLUOP_STATUS_SUCCESS;
 }
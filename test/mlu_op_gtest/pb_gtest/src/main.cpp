@@ -127,6 +127,10 @@ int main(int argc, char **argv) {
     GTEST_LOG_(WARNING) << "WARNING: unrecognized output format \""
                         << output_format << "\" ignored.";
   }
+  if (!global_var.stream_result_.empty()) {
+    listeners.Append(new StreamPrinter(global_var.stream_result_.c_str(),
+                                       global_var.resume_));
+  }
   if (global_var.enable_gtest_internal_perf) {
     testing::UnitTest::GetInstance()->listeners().Append(
         new MLUOPGtestInternalPerfEventListener);
@@ -0,0 +1,450 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "math_cast.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace mluoptest {
+
+namespace {
+
+enum CastIsa : int {
+  CAST_ISA_SCALAR = 0,
+  CAST_ISA_AVX2 = 1,
+  CAST_ISA_AVX512 = 2,
+};
+
+int detectCastIsa() {
+  int isa = CAST_ISA_SCALAR;
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c")) {
+    isa = CAST_ISA_AVX2;
+  }
+  if (isa == CAST_ISA_AVX2 && __builtin_cpu_supports("avx512f")) {
+    isa = CAST_ISA_AVX512;
+  }
+#endif
+  const char *env = std::getenv("MLUOP_GTEST_CAST_ISA");
+  if (env != nullptr) {
+    std::string want(env);
+    if (want == "scalar") {
+      isa = CAST_ISA_SCALAR;
+    } else if (want == "avx2") {
+      isa = std::min(isa, (int)CAST_ISA_AVX2);
+    }
+  }
+  return isa;
+}
+
+int castIsa() {
+  static const int isa = detectCastIsa();
+  return isa;
+}
+
+inline uint32_t floatBits(float v) {
+  uint32_t u;
+  memcpy(&u, &v, sizeof(u));
+  return u;
+}
+
+inline float bitsFloat(uint32_t u) {
+  float v;
+  memcpy(&v, &u, sizeof(v));
+  return v;
+}
+
+// scalar kernels, also used for the tail of simd loops.
+inline uint16_t scalarFloatToHalf(float v) {
+  uint32_t u = floatBits(v);
+  uint16_t sign = (u >> 16) & 0x8000;
+  u &= 0x7fffffff;
+  if (u > 0x7f800000) {  // nan, keep high payload bits and set quiet bit
+    return sign | 0x7e00 | ((u >> 13) & 0x3ff);
+  }
+  if (u >= 0x477ff000) {  // >= 65520, rounds to inf
+    return sign | 0x7c00;
+  }
+  if (u >= 0x38800000) {  // normal half, rebias exponent then round
+    uint32_t h = u - 0x38000000;
+    h += 0xfff + ((h >> 13) & 1);
+    return sign | (h >> 13);
+  }
+  // subnormal half: adding 0.5 moves the lsb to 2^-24, fpu rounds to even.
+  return sign | (floatBits(bitsFloat(u) + 0.5f) - 0x3f000000);
+}
+
+inline float scalarHalfToFloat(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1f;
+  uint32_t mant = h & 0x3ff;
+  if (exp == 0x1f) {  // inf or nan, nan is quieted
+    return bitsFloat(sign | 0x7f800000 | (mant << 13) |
+                     (mant != 0 ? 0x400000 : 0));
+  }
+  if (exp == 0) {  // zero or subnormal, mant * 2^-24 is exact in float
+    return bitsFloat(sign | floatBits((float)mant * 5.9604644775390625e-8f));
+  }
+  return bitsFloat(sign | ((exp + 112) << 23) | (mant << 13));
+}
+
+inline uint16_t scalarFloatToBF16(float v) {
+  if (std::isnan(v)) {
+    return 0x7fc0;
+  }
+  uint32_t u = floatBits(v);
+  return (uint16_t)((u + ((u >> 16) & 1) + 0x7fff) >> 16);
+}
+
+inline float scalarBF16ToFloat(uint16_t v) {
+  return bitsFloat((uint32_t)v << 16);
+}
+
+inline int32_t scalarTruncToInt32(float v) {
+#if defined(__x86_64__)
+  // 0x80000000 for nan and out of range, as cvttps2dq does.
+  return _mm_cvtt_ss2si(_mm_set_ss(v));
+#else
+  return static_cast<int32_t>(v);
+#endif
+}
+
+#if defined(__x86_64__)
+#define CAST_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#define CAST_TARGET_AVX512 __attribute__((target("avx2,f16c,avx512f")))
+#define CAST_ROUND_RN (_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+
+// ---------------------------------- avx2 ----------------------------------
+CAST_TARGET_AVX2 void avx2FloatToHalf(uint16_t *dst, const float *src,
+                                      size_t num) {
+  size_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), CAST_ROUND_RN);
+    _mm_storeu_si128((__m128i *)(dst + i), h);
+  }
+  for (; i < num; ++i) {
+    dst[i] = scalarFloatToHalf(src[i]);
+  }
+}
+
+CAST_TARGET_AVX2 void avx2HalfToFloat(float *dst, const uint16_t *src,
+                                      size_t num) {
+  size_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    __m128i h = _mm_loadu_si128((const __m128i *)(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+  }
+  for (; i < num; ++i) {
+    dst[i] = scalarHalfToFloat(src[i]);
+  }
+}
+
+// 8 floats -> 8 bf16 in the low half of each int32.
+CAST_TARGET_AVX2 inline __m256i avx2RoundBF16(const float *src) {
+  __m256 v = _mm256_loadu_ps(src);
+  __m256i u = _mm256_castps_si256(v);
+  __m256i bias = _mm256_add_epi32(
+      _mm256_and_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(1)),
+      _mm256_set1_epi32(0x7fff));
+  __m256i r = _mm256_srli_epi32(_mm256_add_epi32(u, bias), 16);
+  __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+  return _mm256_blendv_epi8(r, _mm256_set1_epi32(0x7fc0), nan);
+}
+
+CAST_TARGET_AVX2 void avx2FloatToBF16(uint16_t *dst, const float *src,
+                                      size_t num) {
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m256i packed = _mm256_packus_epi32(avx2RoundBF16(src + i),
+                                         avx2RoundBF16(src + i + 8));
+    _mm256_storeu_si256((__m256i *)(dst + i),
+                        _mm256_permute4x64_epi64(packed, 0xd8));
+  }
+  for (; i < num; ++i) {
+    dst[i] = scalarFloatToBF16(src[i]);
+  }
+}
+
+CAST_TARGET_AVX2 void avx2BF16ToFloat(float *dst, const uint16_t *src,
+                                      size_t num) {
+  size_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    __m256i u = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128((const __m128i *)(src + i)));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_slli_epi32(u, 16));
+  }
+  for (; i < num; ++i) {
+    dst[i] = scalarBF16ToFloat(src[i]);
+  }
+}
+
+// 8 floats -> int32, masked to the low bits so packus does not saturate.
+CAST_TARGET_AVX2 inline __m256i avx2TruncLow(const float *src, int mask) {
+  return _mm256_and_si256(_mm256_cvttps_epi32(_mm256_loadu_ps(src)),
+                          _mm256_set1_epi32(mask));
+}
+
+CAST_TARGET_AVX2 void avx2FloatToInt8(int8_t *dst, const float *src,
+                                      size_t num) {
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  size_t i = 0;
+  for (; i + 32 <= num; i += 32) {
+    __m256i ab = _mm256_packus_epi32(avx2TruncLow(src + i, 0xff),
+                                     avx2TruncLow(src + i + 8, 0xff));
+    __m256i cd = _mm256_packus_epi32(avx2TruncLow(src + i + 16, 0xff),
+                                     avx2TruncLow(src + i + 24, 0xff));
+    __m256i abcd = _mm256_packus_epi16(ab, cd);
+    _mm256_storeu_si256((__m256i *)(dst + i),
+                        _mm256_permutevar8x32_epi32(abcd, order));
+  }
+  for (; i < num; ++i) {
+    dst[i] = (int8_t)scalarTruncToInt32(src[i]);
+  }
+}
+
+CAST_TARGET_AVX2 void avx2FloatToInt16(int16_t *dst, const float *src,
+                                       size_t num) {
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m256i packed = _mm256_packus_epi32(avx2TruncLow(src + i, 0xffff),
+                                         avx2TruncLow(src + i + 8, 0xffff));
+    _mm256_storeu_si256((__m256i *)(dst + i),
+                        _mm256_permute4x64_epi64(packed, 0xd8));
+  }
+  for (; i < num; ++i) {
+    dst[i] = (int16_t)scalarTruncToInt32(src[i]);
+  }
+}
+
+CAST_TARGET_AVX2 void avx2Int8ToFloat(float *dst, const int8_t *src,
+                                      size_t num) {
+  size_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    __m256i v = _mm256_cvtepi8_epi32(
+        _mm_loadl_epi64((const __m128i *)(src + i)));
+    _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(v));
+  }
+  for (; i < num; ++i) {
+    dst[i] = (float)src[i];
+  }
+}
+
+CAST_TARGET_AVX2 void avx2Int16ToFloat(float *dst, const int16_t *src,
+                                       size_t num) {
+  size_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    __m256i v = _mm256_cvtepi16_epi32(
+        _mm_loadu_si128((const __m128i *)(src + i)));
+    _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(v));
+  }
+  for (; i < num; ++i) {
+    dst[i] = (float)src[i];
+  }
+}
+
+// --------------------------------- avx512 ---------------------------------
+CAST_TARGET_AVX512 void avx512FloatToHalf(uint16_t *dst, const float *src,
+                                          size_t num) {
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m256i h = _mm512_cvtps_ph(_mm512_loadu_ps(src + i), CAST_ROUND_RN);
+    _mm256_storeu_si256((__m256i *)(dst + i), h);
+  }
+  avx2FloatToHalf(dst + i, src + i, num - i);
+}
+
+CAST_TARGET_AVX512 void avx512HalfToFloat(float *dst, const uint16_t *src,
+                                          size_t num) {
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m256i h = _mm256_loadu_si256((const __m256i *)(src + i));
+    _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(h));
+  }
+  avx2HalfToFloat(dst + i, src + i, num - i);
+}
+
+CAST_TARGET_AVX512 void avx512FloatToBF16(uint16_t *dst, const float *src,
+                                          size_t num) {
+  // vcvtneps2bf16 is not used: it flushes denormals and keeps nan payload,
+  // which differs from the scalar rounding used so far.
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i half_ulp = _mm512_set1_epi32(0x7fff);
+  const __m512i qnan = _mm512_set1_epi32(0x7fc0);
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m512 v = _mm512_loadu_ps(src + i);
+    __m512i u = _mm512_castps_si512(v);
+    __m512i bias = _mm512_add_epi32(
+        _mm512_and_si512(_mm512_srli_epi32(u, 16), one), half_ulp);
+    __m512i r = _mm512_srli_epi32(_mm512_add_epi32(u, bias), 16);
+    __mmask16 nan = _mm512_cmp_ps_mask(v, v, _CMP_UNORD_Q);
+    r = _mm512_mask_blend_epi32(nan, r, qnan);
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm512_cvtepi32_epi16(r));
+  }
+  avx2FloatToBF16(dst + i, src + i, num - i);
+}
+
+CAST_TARGET_AVX512 void avx512BF16ToFloat(float *dst, const uint16_t *src,
+                                          size_t num) {
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m512i u = _mm512_cvtepu16_epi32(
+        _mm256_loadu_si256((const __m256i *)(src + i)));
+    _mm512_storeu_si512(dst + i, _mm512_slli_epi32(u, 16));
+  }
+  avx2BF16ToFloat(dst + i, src + i, num - i);
+}
+
+CAST_TARGET_AVX512 void avx512FloatToInt8(int8_t *dst, const float *src,
+                                          size_t num) {
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m512i v = _mm512_cvttps_epi32(_mm512_loadu_ps(src + i));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm512_cvtepi32_epi8(v));
+  }
+  avx2FloatToInt8(dst + i, src + i, num - i);
+}
+
+CAST_TARGET_AVX512 void avx512FloatToInt16(int16_t *dst, const float *src,
+                                           size_t num) {
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m512i v = _mm512_cvttps_epi32(_mm512_loadu_ps(src + i));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm512_cvtepi32_epi16(v));
+  }
+  avx2FloatToInt16(dst + i, src + i, num - i);
+}
+
+CAST_TARGET_AVX512 void avx512Int8ToFloat(float *dst, const int8_t *src,
+                                          size_t num) {
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m512i v = _mm512_cvtepi8_epi32(
+        _mm_loadu_si128((const __m128i *)(src + i)));
+    _mm512_storeu_ps(dst + i, _mm512_cvtepi32_ps(v));
+  }
+  avx2Int8ToFloat(dst + i, src + i, num - i);
+}
+
+CAST_TARGET_AVX512 void avx512Int16ToFloat(float *dst, const int16_t *src,
+                                           size_t num) {
+  size_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    __m512i v = _mm512_cvtepi16_epi32(
+        _mm256_loadu_si256((const __m256i *)(src + i)));
+    _mm512_storeu_ps(dst + i, _mm512_cvtepi32_ps(v));
+  }
+  avx2Int16ToFloat(dst + i, src + i, num - i);
+}
+
+#define CAST_DISPATCH_(func, dst, src, num) \
+  switch (castIsa()) {                      \
+    case CAST_ISA_AVX512:                   \
+      return avx512##func(dst, src, num);   \
+    case CAST_ISA_AVX2:                     \
+      return avx2##func(dst, src, num);     \
+    default:                                \
+      break;                                \
+  }
+#else  // !__x86_64__
+#define CAST_DISPATCH_(func, dst, src, num)
+#endif  // __x86_64__
+
+}  // namespace
+
+void castFloatToHalf(uint16_t *dst, const float *src, size_t num) {
+  CAST_DISPATCH_(FloatToHalf, dst, src, num);
+  for (size_t i = 0; i < num; ++i) {
+    dst[i] = scalarFloatToHalf(src[i]);
+  }
+}
+
+void castHalfToFloat(float *dst, const uint16_t *src, size_t num) {
+  CAST_DISPATCH_(HalfToFloat, dst, src, num);
+  for (size_t i = 0; i < num; ++i) {
+    dst[i] = scalarHalfToFloat(src[i]);
+  }
+}
+
+void castFloatToBF16(uint16_t *dst, const float *src, size_t num) {
+  CAST_DISPATCH_(FloatToBF16, dst, src, num);
+  for (size_t i = 0; i < num; ++i) {
+    dst[i] = scalarFloatToBF16(src[i]);
+  }
+}
+
+void castBF16ToFloat(float *dst, const uint16_t *src, size_t num) {
+  CAST_DISPATCH_(BF16ToFloat, dst, src, num);
+  for (size_t i = 0; i < num; ++i) {
+    dst[i] = scalarBF16ToFloat(src[i]);
+  }
+}
+
+void castFloatToInt8(int8_t *dst, const float *src, size_t num) {
+  CAST_DISPATCH_(FloatToInt8, dst, src, num);
+  for (size_t i = 0; i < num; ++i) {
+    dst[i] = (int8_t)scalarTruncToInt32(src[i]);
+  }
+}
+
+void castFloatToInt16(int16_t *dst, const float *src, size_t num) {
+  CAST_DISPATCH_(FloatToInt16, dst, src, num);
+  for (size_t i = 0; i < num; ++i) {
+    dst[i] = (int16_t)scalarTruncToInt32(src[i]);
+  }
+}
+
+void castInt8ToFloat(float *dst, const int8_t *src, size_t num) {
+  CAST_DISPATCH_(Int8ToFloat, dst, src, num);
+  for (size_t i = 0; i < num; ++i) {
+    dst[i] = (float)src[i];
+  }
+}
+
+void castInt16ToFloat(float *dst, const int16_t *src, size_t num) {
+  CAST_DISPATCH_(Int16ToFloat, dst, src, num);
+  for (size_t i = 0; i < num; ++i) {
+    dst[i] = (float)src[i];
+  }
+}
+
+const char *castIsaName() {
+  switch (castIsa()) {
+    case CAST_ISA_AVX512:
+      return "avx512";
+    case CAST_ISA_AVX2:
+      return "avx2";
+    default:
+      return "scalar";
+  }
+}
+
+}  // namespace mluoptest
@@ -20,6 +20,8 @@
  * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *************************************************************************/
+#include <sys/mman.h>
+#include <cstdlib>
 #include <string>
 #include <functional>
 #include "memory_pool.h"
@@ -211,40 +213,217 @@ std::pair<bool, void *> MemoryPool::getRandomSpaceBigChunk(
   return std::make_pair(found, (char *)big_chunk_itr->ptr + random_offset);
 }
 
-void *CPUMemoryPool::allocate(size_t num_bytes, const std::string &name) {
-  if (0 == num_bytes) {
-    return nullptr;
-  } else {
-    void *ptr = malloc(num_bytes);
-    ctx_->chunks.emplace_back(Chunk(num_bytes, num_bytes, ptr));
-    ctx_->total_allocated_size += num_bytes;
-    return ptr;
+namespace {
+
+// header in front of every arena buffer, keeps user pointer 64B aligned.
+struct CPUArenaHeader {
+  uint64_t magic;
+  uint64_t block_bytes;  // whole block, header included
+  int64_t size_class;    // -1: too big to pool, freed directly
+  char reserved[40];
+};
+static_assert(sizeof(CPUArenaHeader) == 64, "arena header should be 64B");
+
+const uint64_t CPU_ARENA_MAGIC_USED = 0x6d6c756f70757365;  // "mluopuse"
+const uint64_t CPU_ARENA_MAGIC_FREE = 0x6d6c756f70667265;  // "mluopfre"
+const size_t CPU_ARENA_HEADER = sizeof(CPUArenaHeader);
+const size_t CPU_ARENA_PAGE = 4096;
+const size_t CPU_ARENA_HUGE_PAGE = 2 << 20;
+// bigger blocks are not cached, they come from and go back to os directly.
+const size_t CPU_ARENA_MAX_POOLED = (size_t)1 << 30;
+const int CPU_ARENA_CLASS_NUM = 128;
+// limits of the per-thread cache, the rest goes to the global cache.
+const size_t CPU_ARENA_THREAD_CACHE_NUM = 4;  // per size class
+const size_t CPU_ARENA_THREAD_CACHE_BYTES = 64 << 20;
+
+// size classes: 4KB, then 4 classes per power of two (waste <= 25%).
+int cpuArenaSizeClass(size_t bytes) {
+  if (bytes <= CPU_ARENA_PAGE) {
+    return 0;
   }
+  int k = 63 - __builtin_clzll(bytes - 1);  // 2^k < bytes <= 2^(k+1)
+  int sub = ((bytes - 1) >> (k - 2)) & 3;
+  return 1 + (k - 12) * 4 + sub;
 }
 
-void CPUMemoryPool::deallocate(void *ptr) {
-  auto it = ctx_->chunks.begin();
-  for (; it != ctx_->chunks.end();) {
-    if ((*it).ptr == ptr) {
-      free(ptr);
-      ctx_->total_allocated_size -= (*it).allocated_size;
-      it = ctx_->chunks.erase(it);
-      return;
+size_t cpuArenaClassBytes(int size_class) {
+  if (size_class == 0) {
+    return CPU_ARENA_PAGE;
+  }
+  int k = 12 + (size_class - 1) / 4;
+  int sub = (size_class - 1) % 4;
+  return (size_t)(5 + sub) << (k - 2);
+}
+
+class CPUArena {
+ public:
+  // never destroyed, thread caches may flush into it at exit.
+  static CPUArena &get() {
+    static CPUArena *arena = new CPUArena();
+    return *arena;
+  }
+
+  void *allocate(size_t num_bytes);
+  void release(void *ptr);
+  void cacheGlobal(CPUArenaHeader *header);
+  size_t cachedBytes() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return cached_bytes_;
+  }
+
+ private:
+  CPUArena()
+      : max_cached_bytes_(
+            (size_t)getEnvInt("MLUOP_GTEST_CPU_POOL_CACHE_MB", 256) << 20),
+        thp_(getEnv("MLUOP_GTEST_CPU_POOL_THP", false)) {}
+  CPUArenaHeader *newBlock(size_t block_bytes, int size_class);
+  void freeBlock(CPUArenaHeader *header) { free(header); }
+
+  std::mutex mtx_;
+  std::vector<CPUArenaHeader *> bins_[CPU_ARENA_CLASS_NUM];
+  size_t cached_bytes_ = 0;
+  const size_t max_cached_bytes_;
+  const bool thp_;
+};
+
+struct CPUArenaThreadCache {
+  ~CPUArenaThreadCache() { flush(); }
+  void flush() {
+    for (auto &bin : bins) {
+      for (auto header : bin) {
+        CPUArena::get().cacheGlobal(header);
+      }
+      bin.clear();
+    }
+    bytes = 0;
+  }
+  std::vector<CPUArenaHeader *> bins[CPU_ARENA_CLASS_NUM];
+  size_t bytes = 0;
+};
+
+thread_local CPUArenaThreadCache cpu_arena_thread_cache;
+
+CPUArenaHeader *CPUArena::newBlock(size_t block_bytes, int size_class) {
+  void *base = nullptr;
+  bool huge = thp_ && block_bytes >= CPU_ARENA_HUGE_PAGE;
+  size_t align = huge ? CPU_ARENA_HUGE_PAGE : CPU_ARENA_HEADER;
+  if (posix_memalign(&base, align, block_bytes) != 0) {
+    LOG(ERROR) << "CPUMemoryPool: Failed to allocate " << block_bytes
+               << " bytes.";
+    throw std::invalid_argument(std::string(__FILE__) + " +" +
+                                std::to_string(__LINE__));
+  }
+#ifdef MADV_HUGEPAGE
+  if (huge) {
+    madvise(base, block_bytes, MADV_HUGEPAGE);
+  }
+#endif
+  if (size_class >= 0) {
+    // pre-fault, so page faults are paid once per block, not once per case.
+    for (size_t i = 0; i < block_bytes; i += CPU_ARENA_PAGE) {
+      ((volatile char *)base)[i] = 0;
+    }
+  }
+  // blocks > 1GB are not touched: faulting them all in up front may take
+  // seconds.
+  auto header = (CPUArenaHeader *)base;
+  header->block_bytes = block_bytes;
+  header->size_class = size_class;
+  return header;
+}
+
+void *CPUArena::allocate(size_t num_bytes) {
+  size_t block_bytes = num_bytes + CPU_ARENA_HEADER;
+  CPUArenaHeader *header = nullptr;
+  if (block_bytes > CPU_ARENA_MAX_POOLED) {
+    header = newBlock(block_bytes, -1);
+  } else {
+    int size_class = cpuArenaSizeClass(block_bytes);
+    auto &local = cpu_arena_thread_cache.bins[size_class];
+    if (!local.empty()) {
+      header = local.back();
+      local.pop_back();
+      cpu_arena_thread_cache.bytes -= header->block_bytes;
     } else {
-      ++it;
+      std::lock_guard<std::mutex> lk(mtx_);
+      auto &global = bins_[size_class];
+      if (!global.empty()) {
+        header = global.back();
+        global.pop_back();
+        cached_bytes_ -= header->block_bytes;
+      }
+    }
+    if (header == nullptr) {
+      header = newBlock(cpuArenaClassBytes(size_class), size_class);
     }
   }
+  header->magic = CPU_ARENA_MAGIC_USED;
+  return (char *)header + CPU_ARENA_HEADER;
 }
 
-void CPUMemoryPool::destroy() {
-  for (auto it = ctx_->chunks.begin(); it != ctx_->chunks.end(); ++it) {
-    if (it->ptr != nullptr) {
-      free(it->ptr);
-      it->ptr = nullptr;
-      ctx_->total_allocated_size -= it->allocated_size;
+void CPUArena::release(void *ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  auto header = (CPUArenaHeader *)((char *)ptr - CPU_ARENA_HEADER);
+  if (header->magic != CPU_ARENA_MAGIC_USED) {
+    // called from dtor, don't throw.
+    LOG(ERROR) << "CPUMemoryPool: Failed to deallocate " << ptr
+               << (header->magic == CPU_ARENA_MAGIC_FREE
+                       ? ", double free."
+                       : ", not allocated by CPUMemoryPool.");
+    return;
+  }
+  header->magic = CPU_ARENA_MAGIC_FREE;
+  if (header->size_class < 0) {
+    freeBlock(header);
+    return;
+  }
+  auto &cache = cpu_arena_thread_cache;
+  auto &local = cache.bins[header->size_class];
+  if (local.size() < CPU_ARENA_THREAD_CACHE_NUM &&
+      cache.bytes + header->block_bytes <= CPU_ARENA_THREAD_CACHE_BYTES) {
+    local.push_back(header);
+    cache.bytes += header->block_bytes;
+    return;
+  }
+  cacheGlobal(header);
+}
+
+void CPUArena::cacheGlobal(CPUArenaHeader *header) {
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (cached_bytes_ + header->block_bytes <= max_cached_bytes_) {
+      bins_[header->size_class].push_back(header);
+      cached_bytes_ += header->block_bytes;
+      return;
     }
   }
-  ctx_->chunks.clear();
+  freeBlock(header);
+}
+
+}  // namespace
+
+void *CPUMemoryPool::allocate(size_t num_bytes, const std::string &name) {
+  if (0 == num_bytes) {
+    return nullptr;
+  }
+  return CPUArena::get().allocate(num_bytes);
+}
+
+void CPUMemoryPool::deallocate(void *ptr) { release(ptr); }
+
+void CPUMemoryPool::release(void *ptr) { CPUArena::get().release(ptr); }
+
+void CPUMemoryPool::trim() { cpu_arena_thread_cache.flush(); }
+
+size_t CPUMemoryPool::cachedBytes() {
+  return cpu_arena_thread_cache.bytes + CPUArena::get().cachedBytes();
+}
+
+bool CPUMemoryPool::enabled() {
+  static bool enable = getEnv("MLUOP_GTEST_CPU_MEMORY_POOL", true);
+  return enable;
 }
 
 void *MLUMemoryPool::allocate(size_t num_bytes, const std::string &name) {
@@ -28,6 +28,7 @@
 
 #include <chrono>  // NOLINT
 #include <algorithm>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <set>
@@ -35,8 +36,11 @@
 #include <utility>
 #include <functional>
 
+#include "core/tool.h"
 #include "tools.h"
 #include "zero_element.h"
+#include "case_archive.h"
+#include "tensor_file_ref.h"
 
 static void zeroElementCreate(mluoptest::Node *node) {
   std::string tem_name = node->op_name();
@@ -387,8 +391,14 @@ void Parser::checkTensorValid(MetaTensor *mt, Tensor *pt) {
       break;
     case VALUE_PATH: {
       // if found path(only) in pb, but can't access this path, throw.
-      auto cur_pb_path = pb_path_ + pt->path();
-      GTEST_CHECK((access(cur_pb_path.c_str(), 4) != -1),
+      TensorFileRef ref;
+      GTEST_CHECK(ref.parse(pt->path()),
+                  "Parser: malformed tensor path saved in *prototxt.");
+      auto cur_pb_path = pb_path_ + ref.file;
+      std::string member;
+      auto archive = CaseArchive::openContaining(cur_pb_path, &member);
+      GTEST_CHECK((archive != nullptr ? archive->find(member) != nullptr
+                                      : access(cur_pb_path.c_str(), 4) != -1),
                   "Parser: open path saved in *prototxt failed.");
       break;
     }
@@ -809,21 +819,60 @@ void Parser::getTensorValueRandom(Tensor *pt, void *data, size_t count) {
 
 // get value by random data param
 void Parser::getTensorValueByFile(Tensor *pt, void *data, size_t count) {
-  auto cur_pb_path = pb_path_ + pt->path();
+  TensorFileRef ref;
+  GTEST_CHECK(ref.parse(pt->path()),
+              "Parser: malformed tensor path saved in *prototxt.");
+  auto cur_pb_path = pb_path_ + ref.file;
   size_t tensor_length = count * getTensorSize(pt);
+  GTEST_CHECK(!ref.has_length || ref.length == tensor_length,
+              "Parser: length in tensor path is not equal to tensor size.");
   auto start = std::chrono::steady_clock::now();
-  std::ifstream fin(cur_pb_path, std::ios::in | std::ios::binary);
+  std::string member, blob;
+  size_t blob_pos = ref.offset;
+  std::ifstream fin;
+  bool read_ok = true;
+  auto archive = CaseArchive::openContaining(cur_pb_path, &member);
+  if (archive != nullptr) {
+    // packed case, the data file is a member of the same archive.
+    const CaseArchiveEntry *entry = archive->find(member);
+    read_ok = entry != nullptr && archive->read(*entry, &blob) &&
+              ref.offset + tensor_length <= blob.size();
+  } else {
+    fin.open(cur_pb_path, std::ios::in | std::ios::binary);
+    fin.seekg(ref.offset);
+    read_ok = (bool)fin;
+  }
+  // stream into host memory chunk by chunk, crc32 runs on the hot chunk.
+  uint32_t crc = 0;
+  auto read_to = [&](char *dst, size_t length) {
+    const size_t chunk = 16 << 20;
+    for (size_t done = 0; read_ok && done < length;) {
+      size_t n = std::min(chunk, length - done);
+      if (archive != nullptr) {
+        memcpy(dst + done, blob.data() + blob_pos, n);
+        blob_pos += n;
+      } else {
+        read_ok = (bool)fin.read(dst + done, n);
+      }
+      if (ref.has_crc32) {
+        crc = mluop::crc32(crc, dst + done, n);
+      }
+      done += n;
+    }
+  };
   if (pt->dtype() == DTYPE_INT31) {
     auto tensor_length_int31 = tensor_length / 2;
-    fin.read((char *)data + tensor_length_int31, tensor_length_int31);
-    fin.read((char *)data, tensor_length_int31);
+    read_to((char *)data + tensor_length_int31, tensor_length_int31);
+    read_to((char *)data, tensor_length_int31);
   } else {
-    fin.read((char *)data, tensor_length);
+    read_to((char *)data, tensor_length);
   }
   auto stop = std::chrono::steady_clock::now();
   std::chrono::duration<double> cost_s = stop - start;
 
-  ASSERT_TRUE(fin) << "read data in file failed.";
+  ASSERT_TRUE(read_ok) << "read data in file failed.";
+  ASSERT_TRUE(!ref.has_crc32 || crc == ref.crc32)
+      << "crc32 of data in file " << cur_pb_path << " mismatch.";
 #if 0
   if (!fin) {
     LOG(ERROR) << "read data in file failed.";
@@ -1045,7 +1094,49 @@ const std::string &pattern) {
           0);
 }
 
+// read a case packed in a case archive, see case_archive.h.
+bool Parser::readMessageFromArchive(const std::string &filename,
+                                    Node *proto) {
+  std::string member, data, error;
+  auto archive = CaseArchive::openContaining(filename, &member);
+  const CaseArchiveEntry *entry = archive->find(member);
+  if (entry == nullptr) {
+    LOG(ERROR) << "Case not found in archive: " << filename;
+    return false;
+  }
+  auto start = std::chrono::steady_clock::now();
+  if (!archive->read(*entry, &data, &error)) {
+    LOG(ERROR) << error;
+    return false;
+  }
+  bool status = false;
+  if (strEndsWith(filename, ".pb")) {
+    google::protobuf::io::CodedInputStream coded_input(
+        (const uint8_t *)data.data(), data.size());
+#if GOOGLE_PROTOBUF_VERSION > 3005000
+    coded_input.SetTotalBytesLimit(INT_MAX);
+#elif GOOGLE_PROTOBUF_VERSION
+    coded_input.SetTotalBytesLimit(INT_MAX, INT_MAX - 1);
+#endif
+    status = proto->ParseFromCodedStream(&coded_input);
+  } else if (strEndsWith(filename, ".prototxt")) {
+    status = google::protobuf::TextFormat::ParseFromString(data, proto);
+  } else {
+    LOG(ERROR) << "Unsupported file extension";
+  }
+  auto stop = std::chrono::steady_clock::now();
+  std::chrono::duration<double> cost_s = stop - start;
+  VLOG(2) << __func__ << " " << filename << ", time cost: " << cost_s.count()
+          << " s";
+  parsed_file_size += entry->raw_size;
+  parsed_cost_seconds += cost_s.count();
+  return status;
+}
+
 bool Parser::readMessageFromFile(const std::string &filename, Node *proto) {
+  if (CaseArchive::openContaining(filename, nullptr) != nullptr) {
+    return readMessageFromArchive(filename, proto);
+  }
   struct stat file_stat;
   int fd = open(filename.c_str(), O_RDONLY);
   if (fd == -1) {
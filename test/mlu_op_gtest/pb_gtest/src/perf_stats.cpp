@@ -0,0 +1,108 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "perf_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace mluoptest {
+
+namespace {
+// scale MAD to stddev for normal distribution.
+const double MAD_TO_SIGMA = 1.4826;
+const double TRIM_RATIO = 0.1;  // each side
+
+double medianOfSorted(const std::vector<double> &sorted) {
+  size_t n = sorted.size();
+  if (n == 0) {
+    return -1;
+  }
+  return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+}  // namespace
+
+double studentT95(size_t df) {
+  static const double table[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  const size_t table_size = sizeof(table) / sizeof(table[0]);
+  if (df == 0) {
+    return INFINITY;
+  }
+  if (df <= table_size) {
+    return table[df - 1];
+  }
+  // Cornish-Fisher expansion around the normal quantile.
+  const double z = 1.959964;
+  return z + (z * z * z + z) / (4.0 * df) +
+         (5 * std::pow(z, 5) + 16 * z * z * z + 3 * z) / (96.0 * df * df);
+}
+
+PerfStats computePerfStats(std::vector<double> samples, double outlier_mad) {
+  PerfStats stats;
+  if (samples.empty()) {
+    return stats;
+  }
+  std::sort(samples.begin(), samples.end());
+  stats.median = medianOfSorted(samples);
+  std::vector<double> deviation(samples.size());
+  for (size_t i = 0; i < samples.size(); ++i) {
+    deviation[i] = std::fabs(samples[i] - stats.median);
+  }
+  std::sort(deviation.begin(), deviation.end());
+  stats.mad = medianOfSorted(deviation);
+
+  size_t trim = (size_t)(samples.size() * TRIM_RATIO);
+  double trimmed_sum = 0;
+  for (size_t i = trim; i < samples.size() - trim; ++i) {
+    trimmed_sum += samples[i];
+  }
+  stats.trimmed_mean = trimmed_sum / (samples.size() - 2 * trim);
+
+  double sum = 0, sum_of_square = 0;
+  double bound = outlier_mad * MAD_TO_SIGMA * stats.mad;
+  for (double x : samples) {
+    // with mad == 0 any sample off the median would be rejected, keep all.
+    if (outlier_mad > 0 && stats.mad > 0 &&
+        std::fabs(x - stats.median) > bound) {
+      stats.outliers++;
+      continue;
+    }
+    sum += x;
+    sum_of_square += x * x;
+    stats.samples++;
+  }
+  size_t n = stats.samples;
+  stats.mean = sum / n;
+  double variance =
+      n > 1 ? std::max(0.0, (sum_of_square - sum * stats.mean) / (n - 1)) : 0;
+  stats.stddev = std::sqrt(variance);
+  double half = n > 1 ? studentT95(n - 1) * stats.stddev / std::sqrt(n)
+                      : INFINITY;
+  stats.ci_low = stats.mean - half;
+  stats.ci_high = stats.mean + half;
+  return stats;
+}
+
+}  // namespace mluoptest
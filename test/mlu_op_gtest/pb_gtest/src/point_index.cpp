@@ -0,0 +1,252 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "point_index.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace mluoptest {
+
+namespace {
+
+// pointDistance2 differs from the exact squared distance by a few float
+// roundings, and may underflow to 0 for points a few 1e-23 apart.
+const double RELATIVE_SLACK = 1e-5;
+const double ABSOLUTE_SLACK = 1e-18;
+
+const int KD_LEAF_SIZE = 8;
+
+inline bool finitePoint(const float *p) {
+  return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+}
+
+}  // namespace
+
+PointGrid::PointGrid(const float *xyz, int num, float cell_size) {
+  double lo[3] = {INFINITY, INFINITY, INFINITY};
+  double hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+  int finite = 0;
+  for (int i = 0; i < num; ++i) {
+    if (finitePoint(xyz + i * 3)) {
+      ++finite;
+      for (int a = 0; a < 3; ++a) {
+        lo[a] = std::min(lo[a], (double)xyz[i * 3 + a]);
+        hi[a] = std::max(hi[a], (double)xyz[i * 3 + a]);
+      }
+    }
+  }
+  if (finite > 0) {
+    // cells no smaller than cell_size, and about two cells per point at most.
+    const int64_t max_cells = 2 * (int64_t)finite + 16;
+    const double cell = std::isfinite(cell_size) ? std::fabs(cell_size) : 0;
+    for (int a = 0; a < 3; ++a) {
+      const double span = hi[a] - lo[a];
+      origin_[a] = lo[a];
+      n_[a] = cell > 0 ? (int)std::min(1024.0, std::floor(span / cell)) : 1024;
+      n_[a] = span > 0 ? std::max(n_[a], 1) : 1;
+    }
+    while ((int64_t)n_[0] * n_[1] * n_[2] > max_cells) {
+      int *widest = std::max_element(n_, n_ + 3);
+      *widest = (*widest + 1) / 2;
+    }
+    for (int a = 0; a < 3; ++a) {
+      inv_cell_[a] = hi[a] > lo[a] ? n_[a] / (hi[a] - lo[a]) : 0;
+    }
+  }
+
+  // counting sort by cell keeps the ids of a cell in ascending order.
+  const size_t cells = (size_t)n_[0] * n_[1] * n_[2];
+  std::vector<int> cell_of(num, -1);
+  cell_start_.assign(cells + 1, 0);
+  for (int i = 0; i < num; ++i) {
+    if (!finitePoint(xyz + i * 3)) {
+      continue;
+    }
+    int c[3];
+    for (int a = 0; a < 3; ++a) {
+      double v = ((double)xyz[i * 3 + a] - origin_[a]) * inv_cell_[a];
+      c[a] = (int)std::min(v, n_[a] - 1.0);
+    }
+    cell_of[i] = ((size_t)c[2] * n_[1] + c[1]) * n_[0] + c[0];
+    ++cell_start_[cell_of[i] + 1];
+  }
+  for (size_t c = 0; c < cells; ++c) {
+    cell_start_[c + 1] += cell_start_[c];
+  }
+  ids_.resize(cell_start_[cells]);
+  std::vector<int> fill(cell_start_.begin(), cell_start_.end() - 1);
+  for (int i = 0; i < num; ++i) {
+    if (cell_of[i] >= 0) {
+      ids_[fill[cell_of[i]]++] = i;
+    }
+  }
+}
+
+void PointGrid::query(const float *query, float radius,
+                      std::vector<int> *ids) const {
+  ids->clear();
+  if (ids_.empty() || !finitePoint(query)) {
+    return;
+  }
+  const double r = (std::isnan(radius) ? 0 : std::fabs((double)radius)) *
+                       (1 + RELATIVE_SLACK) +
+                   ABSOLUTE_SLACK;
+  int c1[3], c2[3];
+  for (int a = 0; a < 3; ++a) {
+    // a flat axis has a single cell, and inv_cell_ 0 may give nan here.
+    double lo = ((double)query[a] - r - origin_[a]) * inv_cell_[a];
+    double hi = ((double)query[a] + r - origin_[a]) * inv_cell_[a];
+    c1[a] = lo > 0 ? (int)std::min(lo, n_[a] - 1.0) : 0;
+    c2[a] = hi > 0 ? (int)std::min(hi, n_[a] - 1.0) : 0;
+  }
+  for (int z = c1[2]; z <= c2[2]; ++z) {
+    for (int y = c1[1]; y <= c2[1]; ++y) {
+      const size_t row = ((size_t)z * n_[1] + y) * n_[0];
+      ids->insert(ids->end(), ids_.begin() + cell_start_[row + c1[0]],
+                  ids_.begin() + cell_start_[row + c2[0] + 1]);
+    }
+  }
+  std::sort(ids->begin(), ids->end());
+}
+
+PointKdTree::PointKdTree(const float *xyz, int num) {
+  for (int i = 0; i < num; ++i) {
+    if (finitePoint(xyz + i * 3)) {
+      ids_.push_back(i);
+    }
+  }
+  if (ids_.empty()) {
+    return;
+  }
+  nodes_.reserve(2 * ids_.size() / KD_LEAF_SIZE + 1);
+  build(xyz, 0, ids_.size());
+  points_.resize(ids_.size() * 3);
+  for (size_t i = 0; i < ids_.size(); ++i) {
+    std::copy_n(xyz + ids_[i] * 3, 3, &points_[i * 3]);
+  }
+}
+
+int PointKdTree::build(const float *xyz, int begin, int end) {
+  Node node;
+  node.begin = begin;
+  node.end = end;
+  node.left = node.right = -1;
+  for (int a = 0; a < 3; ++a) {
+    node.lo[a] = INFINITY;
+    node.hi[a] = -INFINITY;
+  }
+  for (int i = begin; i < end; ++i) {
+    for (int a = 0; a < 3; ++a) {
+      node.lo[a] = std::min(node.lo[a], xyz[ids_[i] * 3 + a]);
+      node.hi[a] = std::max(node.hi[a], xyz[ids_[i] * 3 + a]);
+    }
+  }
+  const int index = nodes_.size();
+  nodes_.push_back(node);
+  if (end - begin > KD_LEAF_SIZE) {
+    // split at the median of the widest axis.
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) {
+      if (node.hi[a] - node.lo[a] > node.hi[axis] - node.lo[axis]) {
+        axis = a;
+      }
+    }
+    const int mid = begin + (end - begin) / 2;
+    std::nth_element(ids_.begin() + begin, ids_.begin() + mid,
+                     ids_.begin() + end, [&](int x, int y) {
+                       return xyz[x * 3 + axis] < xyz[y * 3 + axis];
+                     });
+    const int left = build(xyz, begin, mid);
+    const int right = build(xyz, mid, end);
+    nodes_[index].left = left;
+    nodes_[index].right = right;
+  }
+  return index;
+}
+
+int PointKdTree::nearest(const float *query, int k, float *dist2,
+                         int *ids) const {
+  if (k <= 0 || nodes_.empty() || !finitePoint(query)) {
+    return 0;
+  }
+  auto lowerBound = [&](const Node &node) {
+    double d = 0;
+    for (int a = 0; a < 3; ++a) {
+      double v = std::max({(double)node.lo[a] - query[a],
+                           (double)query[a] - node.hi[a], 0.0});
+      d += v * v;
+    }
+    return d;
+  };
+  int found = 0;
+  // a node is skipped only when all its points are surely farther than the
+  // k-th found, ties may still win by a lower index.
+  auto farther = [&](double bound) {
+    return found == k &&
+           bound > dist2[k - 1] * (1 + RELATIVE_SLACK) + ABSOLUTE_SLACK;
+  };
+  int stack[128];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node &node = nodes_[stack[--top]];
+    if (farther(lowerBound(node))) {
+      continue;
+    }
+    if (node.left < 0) {
+      for (int i = node.begin; i < node.end; ++i) {
+        const float d = pointDistance2(query, &points_[i * 3]);
+        const int id = ids_[i];
+        // inf and nan never pass, as the brute force starts from 1e40.
+        if (!(d < INFINITY)) {
+          continue;
+        }
+        int j = found;
+        while (j > 0 && (d < dist2[j - 1] ||
+                         (d == dist2[j - 1] && id < ids[j - 1]))) {
+          if (j < k) {
+            dist2[j] = dist2[j - 1];
+            ids[j] = ids[j - 1];
+          }
+          --j;
+        }
+        if (j < k) {
+          dist2[j] = d;
+          ids[j] = id;
+          found = std::min(found + 1, k);
+        }
+      }
+      continue;
+    }
+    // the nearer child is searched first.
+    int near = node.left, far = node.right;
+    if (lowerBound(nodes_[far]) < lowerBound(nodes_[near])) {
+      std::swap(near, far);
+    }
+    stack[top++] = far;
+    stack[top++] = near;
+  }
+  return found;
+}
+
+}  // namespace mluoptest
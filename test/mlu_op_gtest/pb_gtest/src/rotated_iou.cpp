@@ -0,0 +1,352 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "rotated_iou.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace mluoptest {
+
+namespace {
+
+// the tiles of the iou matrix are TILE x TILE pairs.
+const int TILE = 64;
+
+// the clip of a box whose short side is under THIN times the coordinates
+// runs on corners rounded out of shape, and may find overlap with boxes
+// far apart; such pairs are never culled.
+const double THIN = 1e-4;
+
+struct Point {
+  float x, y;
+  explicit Point(float px = 0, float py = 0) : x(px), y(py) {}
+  Point operator+(const Point &p) const { return Point(x + p.x, y + p.y); }
+  Point operator-(const Point &p) const { return Point(x - p.x, y - p.y); }
+  Point operator*(float coeff) const { return Point(x * coeff, y * coeff); }
+};
+
+inline float dot2d(const Point &a, const Point &b) {
+  return a.x * b.x + a.y * b.y;
+}
+
+inline float cross2d(const Point &a, const Point &b) {
+  return a.x * b.y - a.y * b.x;
+}
+
+// rounds v to a float no larger (sign -1) or no smaller (sign 1) than v.
+float roundOutward(double v, int sign) {
+  float f = (float)v;
+  if (sign < 0 && f > v) {
+    f = std::nextafter(f, -INFINITY);
+  } else if (sign > 0 && f < v) {
+    f = std::nextafter(f, INFINITY);
+  }
+  return f;
+}
+
+// the corners of a box centered at (x, y), with the rotated half sizes of
+// RotatedBoxes, as mmcv's getRotatedVertices computes them.
+void rotatedVertices(float x, float y, float sh, float cw, float ch, float sw,
+                     Point (&pts)[4]) {
+  pts[0].x = x - sh - cw;
+  pts[0].y = y + ch - sw;
+  pts[1].x = x + sh - cw;
+  pts[1].y = y - ch - sw;
+  pts[2].x = 2 * x - pts[0].x;
+  pts[2].y = 2 * y - pts[0].y;
+  pts[3].x = 2 * x - pts[1].x;
+  pts[3].y = 2 * y - pts[1].y;
+}
+
+// appends the vertices of the quad a inside the quad b, with edges va and vb.
+void insideVertices(const Point (&a)[4], const Point (&b)[4],
+                    const Point (&vb)[4], Point (&intersections)[24],
+                    int *num) {
+  // assume ABCD is the rectangle b, P is inside ABCD iff. P's projection on
+  // AB lies within AB and P's projection on AD lies within AD
+  const Point &ab = vb[0];
+  const Point &da = vb[3];
+  float ab_dot_ab = dot2d(ab, ab);
+  float ad_dot_ad = dot2d(da, da);
+  for (int i = 0; i < 4; ++i) {
+    Point ap = a[i] - b[0];
+    float ap_dot_ab = dot2d(ap, ab);
+    float ap_dot_ad = -dot2d(ap, da);
+    if ((ap_dot_ab >= 0) && (ap_dot_ad >= 0) && (ap_dot_ab <= ab_dot_ab) &&
+        (ap_dot_ad <= ad_dot_ad)) {
+      intersections[(*num)++] = a[i];
+    }
+  }
+}
+
+// up to 4 x 4 + 4 + 4 = 24 intersections, dups included.
+int intersectionPoints(const Point (&pts1)[4], const Point (&pts2)[4],
+                       bool reciprocal, Point (&intersections)[24]) {
+  Point vec1[4], vec2[4];
+  for (int i = 0; i < 4; ++i) {
+    vec1[i] = pts1[(i + 1) % 4] - pts1[i];
+    vec2[i] = pts2[(i + 1) % 4] - pts2[i];
+  }
+
+  // edge pairs, p1 + (p2 - p1) * t with t in [0, 1] on both
+  int num = 0;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      float det = cross2d(vec2[j], vec1[i]);
+      if (std::fabs(det) <= 1e-14) {
+        continue;  // parallel
+      }
+      Point vec12 = pts2[j] - pts1[i];
+      float t1, t2;
+      if (reciprocal) {
+        t1 = cross2d(vec2[j], vec12) * (1.0f / det);
+        t2 = cross2d(vec1[i], vec12) * (1.0f / det);
+      } else {
+        t1 = cross2d(vec2[j], vec12) / det;
+        t2 = cross2d(vec1[i], vec12) / det;
+      }
+      if (t1 >= 0.0f && t1 <= 1.0f && t2 >= 0.0f && t2 <= 1.0f) {
+        intersections[num++] = pts1[i] + vec1[i] * t1;
+      }
+    }
+  }
+  insideVertices(pts1, pts2, vec2, intersections, &num);
+  insideVertices(pts2, pts1, vec1, intersections, &num);
+  return num;
+}
+
+// orders the num_in >= 2 points p into the convex hull q, returns its size.
+int convexHullGraham(const Point (&p)[24], int num_in, Point (&q)[24]) {
+  // the lowest point, the leftmost of them on a tie
+  int t = 0;
+  for (int i = 0; i < num_in; ++i) {
+    if (p[i].y < p[t].y || (p[i].y == p[t].y && p[i].x < p[t].x)) {
+      t = i;
+    }
+  }
+  const Point &start = p[t];
+  for (int i = 0; i < num_in; ++i) {
+    q[i] = p[i] - start;
+  }
+  std::swap(q[0], q[t]);
+
+  // sort the rest by angle around the start, then by distance to it
+  float dist[24];
+  for (int i = 0; i < num_in; ++i) {
+    dist[i] = dot2d(q[i], q[i]);
+  }
+  for (int i = 1; i < num_in - 1; ++i) {
+    for (int j = i + 1; j < num_in; ++j) {
+      float temp = cross2d(q[i], q[j]);
+      if ((temp < -1e-6) || ((std::fabs(temp) < 1e-6) && (dist[i] > dist[j]))) {
+        std::swap(q[i], q[j]);
+        std::swap(dist[i], dist[j]);
+      }
+    }
+  }
+
+  // a second point away from the start
+  int k;
+  for (k = 1; k < num_in; ++k) {
+    if (dist[k] > 1e-8) {
+      break;
+    }
+  }
+  if (k == num_in) {
+    q[0] = p[t];
+    return 1;
+  }
+  q[1] = q[k];
+  int m = 2;
+  // pop points until the last 3 turn convex again
+  for (int i = k + 1; i < num_in; ++i) {
+    while (m > 1 && cross2d(q[i] - q[m - 2], q[m - 1] - q[m - 2]) >= 0) {
+      m--;
+    }
+    q[m++] = q[i];
+  }
+  return m;
+}
+
+float polygonArea(const Point (&q)[24], int m) {
+  if (m <= 2) {
+    return 0;
+  }
+  float area = 0;
+  for (int i = 1; i < m - 1; ++i) {
+    area += std::fabs(cross2d(q[i] - q[0], q[i + 1] - q[0]));
+  }
+  return area / 2.0;
+}
+
+}  // namespace
+
+RotatedBoxes::RotatedBoxes(const float *boxes, int num, int stride,
+                           RotatedIouArith arith)
+    : arith_(arith),
+      x_(num),
+      y_(num),
+      area_(num),
+      sh_(num),
+      cw_(num),
+      ch_(num),
+      sw_(num),
+      x1_(num),
+      y1_(num),
+      x2_(num),
+      y2_(num),
+      magnitude_(num),
+      short_side_(num) {
+  // trig dominates, one sin / cos pair per box instead of per pair
+#pragma omp parallel for
+  for (int i = 0; i < num; ++i) {
+    const float *box = boxes + (int64_t)i * stride;
+    const float w = box[2], h = box[3];
+    const double theta = box[4];
+    float cos_theta2, sin_theta2;
+    if (arith_.float_trig) {
+      cos_theta2 = (float)cosf(theta) * 0.5f;
+      sin_theta2 = (float)sinf(theta) * 0.5f;
+    } else {
+      cos_theta2 = (float)cos(theta) * 0.5f;
+      sin_theta2 = (float)sin(theta) * 0.5f;
+    }
+    x_[i] = box[0];
+    y_[i] = box[1];
+    area_[i] = w * h;
+    sh_[i] = sin_theta2 * h;
+    cw_[i] = cos_theta2 * w;
+    ch_[i] = cos_theta2 * h;
+    sw_[i] = sin_theta2 * w;
+
+    const double ex = std::fabs((double)sh_[i]) + std::fabs((double)cw_[i]);
+    const double ey = std::fabs((double)ch_[i]) + std::fabs((double)sw_[i]);
+    const double magnitude = std::fabs(x_[i]) + std::fabs(y_[i]) + ex + ey;
+    const double pad = 1e-5 * magnitude;
+    magnitude_[i] = magnitude;
+    short_side_[i] = std::min(std::fabs(w), std::fabs(h));
+    if (std::isfinite(pad)) {
+      x1_[i] = roundOutward(x_[i] - ex - pad, -1);
+      y1_[i] = roundOutward(y_[i] - ey - pad, -1);
+      x2_[i] = roundOutward(x_[i] + ex + pad, 1);
+      y2_[i] = roundOutward(y_[i] + ey + pad, 1);
+    } else {
+      x1_[i] = y1_[i] = -INFINITY;
+      x2_[i] = y2_[i] = INFINITY;
+    }
+  }
+
+  // boxes too thin for the largest coordinates of the set are never apart
+  // from another box of it, as far as x1() ... y2() tell
+  float max_magnitude = 0;
+  for (int i = 0; i < num; ++i) {
+    if (std::isfinite(x1_[i])) {
+      max_magnitude = std::max(max_magnitude, magnitude_[i]);
+    }
+  }
+  for (int i = 0; i < num; ++i) {
+    if (!(area_[i] < 1e-14) &&
+        !(short_side_[i] >= THIN * 2 * max_magnitude)) {
+      x1_[i] = y1_[i] = -INFINITY;
+      x2_[i] = y2_[i] = INFINITY;
+    }
+  }
+}
+
+float RotatedBoxes::iou(int i, const RotatedBoxes &other, int j,
+                        int mode) const {
+  const float area1 = area_[i];
+  const float area2 = other.area_[j];
+  if (area1 < 1e-14 || area2 < 1e-14) {
+    return 0.f;
+  }
+  if (x1_[i] > other.x2_[j] || other.x1_[j] > x2_[i] ||
+      y1_[i] > other.y2_[j] || other.y1_[j] > y2_[i]) {
+    const double thin = THIN * ((double)magnitude_[i] + other.magnitude_[j]);
+    if (short_side_[i] >= thin && other.short_side_[j] >= thin) {
+      return 0.f;
+    }
+  }
+
+  // the clip runs around the middle of the two centers
+  const auto shift_x = (x_[i] + other.x_[j]) / 2.0;
+  const auto shift_y = (y_[i] + other.y_[j]) / 2.0;
+  const float inter =
+      intersection(x_[i] - shift_x, y_[i] - shift_y, i, other,
+                   other.x_[j] - shift_x, other.y_[j] - shift_y, j);
+  // mode 0 is iou, otherwise iof
+  const float base = mode == 0 ? area1 + area2 - inter : area1;
+  return arith_.reciprocal ? inter * (1.0f / base) : inter / base;
+}
+
+float RotatedBoxes::intersection(float x1, float y1, int i,
+                                 const RotatedBoxes &other, float x2,
+                                 float y2, int j) const {
+  Point pts1[4], pts2[4];
+  rotatedVertices(x1, y1, sh_[i], cw_[i], ch_[i], sw_[i], pts1);
+  rotatedVertices(x2, y2, other.sh_[j], other.cw_[j], other.ch_[j],
+                  other.sw_[j], pts2);
+
+  Point intersect_pts[24], ordered_pts[24];
+  int num = intersectionPoints(pts1, pts2, arith_.reciprocal, intersect_pts);
+  if (num <= 2) {
+    return 0.0;
+  }
+  int num_convex = convexHullGraham(intersect_pts, num, ordered_pts);
+  return polygonArea(ordered_pts, num_convex);
+}
+
+void rotatedIouMatrix(const RotatedBoxes &boxes1, const RotatedBoxes &boxes2,
+                      int mode, float *ious) {
+  const int64_t num1 = boxes1.size(), num2 = boxes2.size();
+  const int64_t tiles1 = (num1 + TILE - 1) / TILE;
+  const int64_t tiles2 = (num2 + TILE - 1) / TILE;
+  // culled pairs cost next to nothing, so tiles vary a lot in cost
+#pragma omp parallel for schedule(dynamic)
+  for (int64_t t = 0; t < tiles1 * tiles2; ++t) {
+    const int64_t i0 = t / tiles2 * TILE, j0 = t % tiles2 * TILE;
+    const int64_t i1 = std::min(i0 + TILE, num1);
+    const int64_t j1 = std::min(j0 + TILE, num2);
+    for (int64_t i = i0; i < i1; ++i) {
+      for (int64_t j = j0; j < j1; ++j) {
+        ious[i * num2 + j] = boxes1.iou(i, boxes2, j, mode);
+      }
+    }
+  }
+}
+
+void polygonBounds(const float *xy, int n, float *lo, float *hi) {
+  lo[0] = lo[1] = INFINITY;
+  hi[0] = hi[1] = -INFINITY;
+  for (int i = 0; i < 2 * n; ++i) {
+    if (!std::isfinite(xy[i])) {
+      lo[0] = lo[1] = -INFINITY;
+      hi[0] = hi[1] = INFINITY;
+      return;
+    }
+    lo[i % 2] = std::min(lo[i % 2], xy[i]);
+    hi[i % 2] = std::max(hi[i % 2], xy[i]);
+  }
+}
+
+}  // namespace mluoptest
@@ -41,6 +41,12 @@ CPURuntime::~CPURuntime() {}
 // all member variable are shared_ptr.
 cnrtRet_t CPURuntime::destroy() { return cnrtSuccess; }
 
+void CPURuntime::init(std::shared_ptr<CPUMemoryPool> cmp) {
+  if (CPUMemoryPool::enabled()) {
+    cmp_ = cmp;
+  }
+}
+
 void *CPURuntime::allocate(void *ptr, std::string name) {
   if (ptr == NULL) {
     return NULL;  // can't free NULL, don't push NULL into vector.
@@ -56,6 +62,14 @@ void *CPURuntime::allocate(size_t num_bytes, std::string name) {
     return NULL;
   }
 
+  if (cmp_ != nullptr) {
+    // aligned to 64, enough for avx
+    void *ptr = cmp_->allocate(num_bytes, name);
+    memory_blocks_.push_back(std::make_shared<MemBlock<void *>>(
+        ptr, CPUMemoryPool::release, name));
+    return ptr;
+  }
+
 #ifdef __AVX__
   void *ptr = _mm_malloc(num_bytes, AVX_ALIGN);  // avx need align to 32
 #else
@@ -21,31 +21,258 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *************************************************************************/
 #include "stride.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <climits>
+#include <utility>
 
 namespace mluoptest {
 
+namespace {
+
+// elements per parallel block, small tensors are copied in one thread.
+const size_t STRIDE_BLOCK_ELEMENTS = 1 << 16;
+
+// drop size-1 dims and merge dims which are contiguous with the next dim in
+// both dst and src, so the innermost loop is as long as possible.
+void collapse_dims(std::vector<size_t> *shape, std::vector<size_t> *dst_stride,
+                   std::vector<size_t> *src_stride) {
+  std::vector<size_t> s, ds, ss;
+  for (size_t i = 0; i < shape->size(); ++i) {
+    size_t n = (*shape)[i];
+    if (n == 1) {
+      continue;
+    }
+    if (!s.empty() && ds.back() == (*dst_stride)[i] * n &&
+        ss.back() == (*src_stride)[i] * n) {
+      s.back() *= n;
+      ds.back() = (*dst_stride)[i];
+      ss.back() = (*src_stride)[i];
+    } else {
+      s.push_back(n);
+      ds.push_back((*dst_stride)[i]);
+      ss.push_back((*src_stride)[i]);
+    }
+  }
+  if (s.empty()) {  // scalar
+    s.push_back(1);
+    ds.push_back(1);
+    ss.push_back(1);
+  }
+  shape->swap(s);
+  dst_stride->swap(ds);
+  src_stride->swap(ss);
+}
+
+// true if no two indices map to the same dst element, so scatter can be done
+// in any order. broadcast stride (0) or overlapped stride return false.
+bool is_injective(const std::vector<size_t> &shape,
+                  const std::vector<size_t> &stride) {
+  std::vector<std::pair<size_t, size_t>> dims;  // (stride, shape)
+  for (size_t i = 0; i < shape.size(); ++i) {
+    if (shape[i] > 1) {
+      dims.emplace_back(stride[i], shape[i]);
+    }
+  }
+  std::sort(dims.begin(), dims.end());
+  size_t extent = 0;  // max offset reached by inner dims
+  for (const auto &d : dims) {
+    if (d.first <= extent) {
+      return false;
+    }
+    extent += (d.second - 1) * d.first;
+  }
+  return true;
+}
+
+template <typename T>
+inline void copy_row_scalar(T *dst, const T *src, size_t n, size_t dst_stride,
+                            size_t src_stride) {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i * dst_stride] = src[i * src_stride];
+  }
+}
+
+template <typename T>
+inline void copy_row(T *dst, const T *src, size_t n, size_t dst_stride,
+                     size_t src_stride) {
+  copy_row_scalar(dst, src, n, dst_stride, src_stride);
+}
+
+#ifdef __AVX2__
+// gather a strided row into a contiguous one.
+template <>
+inline void copy_row<int32_t>(int32_t *dst, const int32_t *src, size_t n,
+                              size_t dst_stride, size_t src_stride) {
+  size_t i = 0;
+  if (dst_stride == 1 && src_stride > 1 && src_stride <= INT_MAX / 8) {
+    const int st = (int)src_stride;
+    const __m256i idx = _mm256_setr_epi32(0, st, 2 * st, 3 * st, 4 * st,
+                                          5 * st, 6 * st, 7 * st);
+    for (; i + 8 <= n; i += 8) {
+      __m256i v = _mm256_i32gather_epi32((const int *)(src + i * src_stride),
+                                         idx, 4);
+      _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+  }
+  copy_row_scalar(dst + i * dst_stride, src + i * src_stride, n - i,
+                  dst_stride, src_stride);
+}
+
+template <>
+inline void copy_row<int64_t>(int64_t *dst, const int64_t *src, size_t n,
+                              size_t dst_stride, size_t src_stride) {
+  size_t i = 0;
+  if (dst_stride == 1 && src_stride > 1 && src_stride <= INT_MAX / 4) {
+    const int st = (int)src_stride;
+    const __m128i idx = _mm_setr_epi32(0, st, 2 * st, 3 * st);
+    for (; i + 4 <= n; i += 4) {
+      __m256i v = _mm256_i32gather_epi64(
+          (const long long *)(src + i * src_stride), idx, 8);  // NOLINT
+      _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+  }
+  copy_row_scalar(dst + i * dst_stride, src + i * src_stride, n - i,
+                  dst_stride, src_stride);
+}
+#endif
+
+// copy rows [row_begin, row_end) of the collapsed layout, the last dim is
+// the row. offsets of the first row are computed once, then advanced like
+// an odometer.
+template <typename T>
+void stride_map_rows(char *dst, const char *src,
+                     const std::vector<size_t> &shape,
+                     const std::vector<size_t> &dst_stride,
+                     const std::vector<size_t> &src_stride, size_t row_begin,
+                     size_t row_end, size_t sizeof_dtype) {
+  const size_t last = shape.size() - 1;
+  const size_t n = shape[last];
+  const bool contiguous = dst_stride[last] == 1 && src_stride[last] == 1;
+  std::vector<size_t> index(shape.size(), 0);
+  size_t dst_offset = 0, src_offset = 0;
+  size_t rest = row_begin;
+  for (ssize_t d = (ssize_t)last - 1; d >= 0; --d) {
+    index[d] = rest % shape[d];
+    rest /= shape[d];
+    dst_offset += index[d] * dst_stride[d];
+    src_offset += index[d] * src_stride[d];
+  }
+  for (size_t row = row_begin; row < row_end; ++row) {
+    if (contiguous) {
+      memcpy(dst + dst_offset * sizeof_dtype, src + src_offset * sizeof_dtype,
+             n * sizeof_dtype);
+    } else {
+      copy_row<T>((T *)(dst + dst_offset * sizeof_dtype),
+                  (const T *)(src + src_offset * sizeof_dtype), n,
+                  dst_stride[last], src_stride[last]);
+    }
+    // odometer increment over the outer dims
+    for (ssize_t d = (ssize_t)last - 1; d >= 0; --d) {
+      dst_offset += dst_stride[d];
+      src_offset += src_stride[d];
+      if (++index[d] < shape[d]) {
+        break;
+      }
+      dst_offset -= shape[d] * dst_stride[d];
+      src_offset -= shape[d] * src_stride[d];
+      index[d] = 0;
+    }
+  }
+}
+
+// a row of odd-sized dtype is copied byte-wise element by element.
+template <>
+void stride_map_rows<void>(char *dst, const char *src,
+                           const std::vector<size_t> &shape,
+                           const std::vector<size_t> &dst_stride,
+                           const std::vector<size_t> &src_stride,
+                           size_t row_begin, size_t row_end,
+                           size_t sizeof_dtype) {
+  // treat every element as a row of sizeof_dtype bytes.
+  std::vector<size_t> byte_shape(shape);
+  std::vector<size_t> byte_dst_stride(dst_stride.size() + 1);
+  std::vector<size_t> byte_src_stride(src_stride.size() + 1);
+  byte_shape.push_back(sizeof_dtype);
+  for (size_t i = 0; i < shape.size(); ++i) {
+    byte_dst_stride[i] = dst_stride[i] * sizeof_dtype;
+    byte_src_stride[i] = src_stride[i] * sizeof_dtype;
+  }
+  byte_dst_stride.back() = 1;
+  byte_src_stride.back() = 1;
+  stride_map_rows<char>(dst, src, byte_shape, byte_dst_stride,
+                        byte_src_stride, row_begin * shape.back(),
+                        row_end * shape.back(), 1);
+}
+
+template <typename T>
+void stride_map_impl(void *dst, void *src, const std::vector<size_t> &shape,
+                     const std::vector<size_t> &dst_stride,
+                     const std::vector<size_t> &src_stride,
+                     size_t sizeof_dtype, bool parallel) {
+  const size_t n = shape.back();
+  size_t rows = 1;
+  for (size_t i = 0; i + 1 < shape.size(); ++i) {
+    rows *= shape[i];
+  }
+  size_t rows_per_block = std::max((size_t)1, STRIDE_BLOCK_ELEMENTS / n);
+  size_t blocks = (rows + rows_per_block - 1) / rows_per_block;
+  if (!parallel || blocks <= 1) {
+    stride_map_rows<T>((char *)dst, (const char *)src, shape, dst_stride,
+                       src_stride, 0, rows, sizeof_dtype);
+    return;
+  }
+#pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < blocks; ++b) {
+    size_t row_begin = b * rows_per_block;
+    size_t row_end = std::min(rows, row_begin + rows_per_block);
+    stride_map_rows<T>((char *)dst, (const char *)src, shape, dst_stride,
+                       src_stride, row_begin, row_end, sizeof_dtype);
+  }
+}
+
+}  // namespace
+
+// dst[offset(index, dst_stride)] = src[offset(index, src_stride)]
+// for every index in shape.
+// iterative: dims are collapsed first, the innermost dim is copied by one
+// memcpy if contiguous on both sides (or gathered by avx2), and outer dims
+// are walked by an odometer, split into blocks for openmp.
+// if dst has overlapped elements (e.g. stride 0), it is written serially
+// in row-major order, so the last write wins as before.
 void stride_map(void *dst,                              // dst ptr
                 void *src,                              // src ptr
                 const std::vector<size_t> &shape,       // shape
                 const std::vector<size_t> &dst_stride,  // stride
                 const std::vector<size_t> &src_stride,  // stride
-                size_t dst_offset, size_t src_offset, size_t d,
-                size_t sizeof_dtype, const size_t dst_max,
-                const size_t src_max) {
-  if (d == shape.size() - 1) {  // the last dim
-    for (size_t i = 0; i < shape[d]; ++i) {
-      size_t dst_idx = src_offset + i * src_stride[d];
-      size_t src_idx = dst_offset + i * dst_stride[d];
-      memcpy((char *)dst + dst_idx * sizeof_dtype,
-             (char *)src + src_idx * sizeof_dtype, sizeof_dtype);
-    }
-  } else {
-    for (size_t i = 0; i < shape[d]; ++i) {
-      stride_map(dst, src, shape, dst_stride, src_stride,
-                 dst_offset + i * dst_stride[d], src_offset + i * src_stride[d],
-                 d + 1, sizeof_dtype, dst_max, src_max);
+                size_t sizeof_dtype) {
+  for (auto n : shape) {
+    if (n == 0) {
+      return;
     }
   }
+  std::vector<size_t> s(shape), ds(dst_stride), ss(src_stride);
+  collapse_dims(&s, &ds, &ss);
+  bool parallel = is_injective(s, ds);
+  switch (sizeof_dtype) {
+    case 1:
+      stride_map_impl<int8_t>(dst, src, s, ds, ss, sizeof_dtype, parallel);
+      break;
+    case 2:
+      stride_map_impl<int16_t>(dst, src, s, ds, ss, sizeof_dtype, parallel);
+      break;
+    case 4:
+      stride_map_impl<int32_t>(dst, src, s, ds, ss, sizeof_dtype, parallel);
+      break;
+    case 8:
+      stride_map_impl<int64_t>(dst, src, s, ds, ss, sizeof_dtype, parallel);
+      break;
+    default:
+      stride_map_impl<void>(dst, src, s, ds, ss, sizeof_dtype, parallel);
+      break;
+  }
 }
 
 // src(strided) -> dst(shape)
@@ -57,21 +284,13 @@ void tensor_stride_in(void *dst, void *src, const std::vector<size_t> &shape,
   GTEST_CHECK(shape.size() == dst_stride.size(),
               "shape's size is not equal to stride's size.");
 
-  size_t shape_total = std::accumulate(shape.begin(), shape.end(), (size_t)1,
-                                       std::multiplies<size_t>());
-  size_t stride_total = 1;
-  for (size_t i = 0; i < shape.size(); ++i) {
-    stride_total += (shape[i] - 1) * dst_stride[i];
-  }
-
-  std::vector<size_t> src_stride(shape.size());
+  std::vector<size_t> shape_stride(shape.size());
   size_t stride_base = 1;
   for (ssize_t i = shape.size() - 1; i >= 0; --i) {
-    src_stride[i] = stride_base;
+    shape_stride[i] = stride_base;
     stride_base *= shape[i];
   }
-  stride_map(dst, src, shape, dst_stride, src_stride, 0, 0, 0, sizeof_dtype,
-             stride_total, shape_total);
+  stride_map(dst, src, shape, shape_stride, dst_stride, sizeof_dtype);
 }
 
 // src(shape) -> dst(strided)
@@ -83,21 +302,13 @@ void tensor_stride_out(void *dst, void *src, const std::vector<size_t> &shape,
   GTEST_CHECK(shape.size() == src_stride.size(),
               "shape's size is not equal to stride's size.");
 
-  size_t shape_total = std::accumulate(shape.begin(), shape.end(), (size_t)1,
-                                       std::multiplies<size_t>());
-  size_t stride_total = 1;
-  for (size_t i = 0; i < shape.size(); ++i) {
-    stride_total += (shape[i] - 1) * src_stride[i];
-  }
-
-  std::vector<size_t> dst_stride(shape.size());
+  std::vector<size_t> shape_stride(shape.size());
   size_t stride_base = 1;
   for (ssize_t i = shape.size() - 1; i >= 0; --i) {
-    dst_stride[i] = stride_base;
+    shape_stride[i] = stride_base;
     stride_base *= shape[i];
   }
-  stride_map(dst, src, shape, dst_stride, src_stride, 0, 0, 0, sizeof_dtype,
-             shape_total, stride_total);
+  stride_map(dst, src, shape, src_stride, shape_stride, sizeof_dtype);
 }
 
 class Stride::StrideImpl {
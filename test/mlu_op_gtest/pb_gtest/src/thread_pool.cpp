@@ -20,35 +20,112 @@
  * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *************************************************************************/
+#include <algorithm>
+#include <exception>
 #include <memory>
 #include <utility>
 #include "thread_pool.h"
 
 namespace mluoptest {
 
-ThreadPool::ThreadPool(size_t thread_num) {
-  ctx_ = std::make_shared<Context>();
+namespace {
+// the pool and deque index of a worker thread, -1 on other threads.
+thread_local void *tls_pool_ctx = nullptr;
+thread_local int64_t tls_worker_id = -1;
+// spins (with yield) before an idle worker goes to sleep.
+const int IDLE_SPIN = 64;
+}  // namespace
 
-  auto work = [=] {
-    auto ctx = ctx_;
-    std::unique_lock<std::mutex> lk(ctx->mtx);
-    for (;;) {
-      if (!ctx->tasks.empty()) {
-        auto task = std::move(ctx->tasks.front());
-        ctx->tasks.pop();
-        lk.unlock();
-        task();
-        lk.lock();
-      } else if (ctx->is_shutdown) {
-        break;
-      } else {
-        ctx->cond.wait(lk);
-      }
+WorkStealingDeque::WorkStealingDeque(int64_t capacity) {
+  int64_t cap = 1;
+  while (cap < capacity) {
+    cap <<= 1;
+  }
+  rings_.emplace_back(new Ring(cap));
+  ring_.store(rings_.back().get(), std::memory_order_relaxed);
+}
+
+WorkStealingDeque::~WorkStealingDeque() {
+  // tasks are owned by the pool, which drains the deque before this.
+}
+
+WorkStealingDeque::Ring *WorkStealingDeque::grow(Ring *ring, int64_t bottom,
+                                                 int64_t top) {
+  rings_.emplace_back(new Ring(ring->capacity * 2));
+  Ring *bigger = rings_.back().get();
+  for (int64_t i = top; i < bottom; ++i) {
+    bigger->put(i, ring->get(i));
+  }
+  ring_.store(bigger, std::memory_order_release);
+  return bigger;
+}
+
+void WorkStealingDeque::push(Task *task) {
+  int64_t b = bottom_.load(std::memory_order_relaxed);
+  int64_t t = top_.load(std::memory_order_acquire);
+  Ring *ring = ring_.load(std::memory_order_relaxed);
+  if (b - t > ring->capacity - 1) {
+    ring = grow(ring, b, t);
+  }
+  ring->put(b, task);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom_.store(b + 1, std::memory_order_relaxed);
+}
+
+Task *WorkStealingDeque::pop() {
+  int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+  Ring *ring = ring_.load(std::memory_order_relaxed);
+  bottom_.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = top_.load(std::memory_order_relaxed);
+  if (t > b) {  // empty
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  Task *task = ring->get(b);
+  if (t == b) {
+    // last one, race with thieves.
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      task = nullptr;
     }
-  };
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+  return task;
+}
+
+Task *WorkStealingDeque::steal() {
+  int64_t t = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = bottom_.load(std::memory_order_acquire);
+  if (t >= b) {
+    return nullptr;
+  }
+  Ring *ring = ring_.load(std::memory_order_acquire);
+  Task *task = ring->get(t);
+  if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  return task;
+}
 
+ThreadPool::ThreadPool(size_t thread_num) {
+  ctx_ = std::make_shared<Context>();
+  ctx_->owner = this;
+  for (size_t i = 0; i < thread_num; ++i) {
+    ctx_->workers.emplace_back(new Worker());
+  }
+  // start threads after all deques exist, workers steal from each other.
   for (size_t i = 0; i < thread_num; ++i) {
-    ctx_->workers.emplace_back(work);
+    ctx_->workers[i]->thread = std::thread(workerLoop, ctx_, (int64_t)i);
+  }
+}
+
+ThreadPool::ThreadPool(ThreadPool &&other) noexcept
+    : ctx_(std::move(other.ctx_)) {
+  if (ctx_ != nullptr) {
+    ctx_->owner = this;
   }
 }
 
@@ -61,8 +138,205 @@ ThreadPool::~ThreadPool() {
     ctx_->is_shutdown = true;
   }
   ctx_->cond.notify_all();
-  for (std::thread &worker : ctx_->workers) {
-    worker.join();
+  for (auto &worker : ctx_->workers) {
+    worker->thread.join();
+  }
+  if (ctx_->error != nullptr) {
+    try {
+      std::rethrow_exception(ctx_->error);
+    } catch (std::exception &e) {
+      LOG(ERROR) << "ThreadPool: a task threw " << e.what();
+    } catch (...) {
+      LOG(ERROR) << "ThreadPool: a task threw an unknown exception.";
+    }
+  }
+}
+
+ThreadPool *ThreadPool::current() {
+  if (tls_pool_ctx == nullptr) {
+    return nullptr;
+  }
+  return static_cast<Context *>(tls_pool_ctx)->owner;
+}
+
+void ThreadPool::submit(Task &&task) {
+  Context *ctx = ctx_.get();
+  GTEST_CHECK(ctx != nullptr, "ThreadPool: enqueue to an empty pool.");
+  Task *node = new Task(std::move(task));
+  ctx->unfinished.fetch_add(1, std::memory_order_relaxed);
+  if (tls_pool_ctx == ctx) {
+    ctx->workers[tls_worker_id]->deque.push(node);
+  } else {
+    std::lock_guard<std::mutex> lk(ctx->mtx);
+    ctx->injection.push_back(node);
+  }
+  // pairs with the sleepers/pending check in workerLoop, so a worker about
+  // to sleep either sees this task or gets notified.
+  ctx->pending.fetch_add(1, std::memory_order_seq_cst);
+  if (ctx->sleepers.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lk(ctx->mtx);
+    ctx->cond.notify_one();
+  }
+}
+
+Task *ThreadPool::takeTask(Context *ctx, int64_t self) {
+  Task *task = nullptr;
+  if (self >= 0) {
+    task = ctx->workers[self]->deque.pop();
+  }
+  if (task == nullptr && ctx->pending.load(std::memory_order_acquire) > 0) {
+    {
+      std::lock_guard<std::mutex> lk(ctx->mtx);
+      if (!ctx->injection.empty()) {
+        task = ctx->injection.front();
+        ctx->injection.pop_front();
+      }
+    }
+    int64_t n = ctx->workers.size();
+    for (int64_t i = 1; task == nullptr && i <= n; ++i) {
+      int64_t victim = (self + i) % n;
+      if (victim != self) {
+        task = ctx->workers[victim]->deque.steal();
+      }
+    }
+  }
+  if (task != nullptr) {
+    ctx->pending.fetch_sub(1, std::memory_order_acq_rel);
+  }
+  return task;
+}
+
+void ThreadPool::runTask(Context *ctx, Task *node) {
+  std::unique_ptr<Task> task(node);
+  try {
+    (*task)();
+  } catch (...) {
+    std::lock_guard<std::mutex> lk(ctx->mtx);
+    if (ctx->error == nullptr) {
+      ctx->error = std::current_exception();
+    }
+  }
+  task.reset();
+  if (ctx->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    std::lock_guard<std::mutex> lk(ctx->mtx);
+    ctx->done.notify_all();
+  }
+}
+
+void ThreadPool::workerLoop(std::shared_ptr<Context> ctx, int64_t self) {
+  tls_pool_ctx = ctx.get();
+  tls_worker_id = self;
+  int idle = 0;
+  for (;;) {
+    Task *task = takeTask(ctx.get(), self);
+    if (task != nullptr) {
+      runTask(ctx.get(), task);
+      idle = 0;
+      continue;
+    }
+    if (++idle < IDLE_SPIN) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(ctx->mtx);
+    if (ctx->pending.load(std::memory_order_seq_cst) > 0) {
+      continue;  // a task is still queued somewhere, go and find it.
+    }
+    if (ctx->is_shutdown) {
+      break;
+    }
+    ctx->sleepers.fetch_add(1, std::memory_order_seq_cst);
+    ctx->cond.wait(lk, [&] {
+      return ctx->is_shutdown ||
+             ctx->pending.load(std::memory_order_seq_cst) > 0;
+    });
+    ctx->sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    idle = 0;
+  }
+  tls_pool_ctx = nullptr;
+  tls_worker_id = -1;
+}
+
+void ThreadPool::wait() {
+  if (ctx_ == nullptr) {
+    return;
+  }
+  Context *ctx = ctx_.get();
+  GTEST_CHECK(tls_pool_ctx != ctx, "ThreadPool: wait() on its own worker.");
+  std::exception_ptr error = nullptr;
+  {
+    std::unique_lock<std::mutex> lk(ctx->mtx);
+    ctx->done.wait(lk, [ctx] {
+      return ctx->unfinished.load(std::memory_order_acquire) == 0;
+    });
+    std::swap(error, ctx->error);
+  }
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+
+void parallelFor(size_t begin, size_t end, size_t grain,
+                 const std::function<void(size_t, size_t)> &func,
+                 ThreadPool *pool) {
+  if (begin >= end) {
+    return;
+  }
+  grain = std::max<size_t>(grain, 1);
+  size_t chunk_num = (end - begin + grain - 1) / grain;
+  if (pool == nullptr || pool->size() <= 1 || chunk_num == 1) {
+    func(begin, end);
+    return;
+  }
+  // no more chunks than needed to keep every worker busy a few times over.
+  chunk_num = std::min(chunk_num, pool->size() * 4);
+  size_t chunk = (end - begin + chunk_num - 1) / chunk_num;
+  chunk_num = (end - begin + chunk - 1) / chunk;
+
+  struct State {
+    std::atomic<size_t> next{0};  // next chunk to claim
+    size_t remain = 0;             // chunks not done yet, guarded by mtx
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::exception_ptr error = nullptr;
+  };
+  auto state = std::make_shared<State>();
+  state->remain = chunk_num;
+  const auto *fn = &func;
+  // claim chunks until none is left. a helper which starts after the caller
+  // returned finds none, and never touches func.
+  auto work = [state, fn, begin, end, chunk, chunk_num]() {
+    for (;;) {
+      size_t i = state->next.fetch_add(1, std::memory_order_relaxed);
+      if (i >= chunk_num) {
+        return;
+      }
+      size_t b = begin + i * chunk;
+      std::exception_ptr error = nullptr;
+      try {
+        (*fn)(b, std::min(end, b + chunk));
+      } catch (...) {
+        error = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lk(state->mtx);
+      if (error != nullptr && state->error == nullptr) {
+        state->error = error;
+      }
+      if (--state->remain == 0) {
+        state->cond.notify_all();
+      }
+    }
+  };
+  for (size_t i = 1; i < std::min(chunk_num, pool->size() + 1); ++i) {
+    pool->enqueue(work);
+  }
+  // the caller only works on chunks of this loop, then blocks for those
+  // still running on other workers.
+  work();
+  std::unique_lock<std::mutex> lk(state->mtx);
+  state->cond.wait(lk, [&state] { return state->remain == 0; });
+  if (state->error != nullptr) {
+    std::rethrow_exception(state->error);
   }
 }
 
@@ -41,6 +41,7 @@
 #include "perf_test.h"
 #include "accuracy_test.h"
 #include "math_half.h"
+#include "math_cast.h"
 
 namespace mluoptest {
 
@@ -584,17 +585,26 @@ size_t proc_usage_peak() {
   return 0;
 }
 
-void arrayCastFloatToHalf(int16_t *dst, float *src, size_t num) {
-  while (num > 0) {
-    int count = (int)std::min(num, (size_t)(INT_MAX));
-    GTEST_CHECK(cnrtCastDataType_V2(src, cnrtFloat, dst, cnrtHalf, count, NULL,
-                                    cnrtRounding_rm) == cnrtSuccess);
-    dst += count;
-    src += count;
-    num -= count;
+// split array into blocks for openmp, each block is cast by simd kernel in
+// math_cast.h.
+template <typename TDst, typename TSrc>
+static void arrayCastParallel(void (*cast)(TDst *, const TSrc *, size_t),
+                              TDst *dst, const TSrc *src, size_t num) {
+  const size_t block = 1 << 16;
+  const size_t block_num = (num + block - 1) / block;
+#pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < block_num; ++b) {
+    size_t begin = b * block;
+    cast(dst + begin, src + begin, std::min(block, num - begin));
   }
 }
 
+// rounding mode: rn, same as cnrtCastDataType_V2 with cnrtRounding_rm.
+void arrayCastFloatToHalf(int16_t *dst, float *src, size_t num) {
+  arrayCastParallel(castFloatToHalf, reinterpret_cast<uint16_t *>(dst),
+                    (const float *)src, num);
+}
+
 template <AlgoHalfToFloat algo>
 void arrayCastHalfToFloatAlgoImpl(float *dst, uint16_t *src, size_t num) {
 #pragma omp parallel for schedule(guided)
@@ -617,6 +627,13 @@ void arrayCastHalfToFloatAlgoImpl<AlgoHalfToFloat::CNRT>(float *dst,
   }
 }
 
+// same result as cvtHalfToFloatImpl<CPU_INTRINSIC>, but vectorized.
+template <>
+void arrayCastHalfToFloatAlgoImpl<AlgoHalfToFloat::CPU_INTRINSIC>(
+    float *dst, uint16_t *src, size_t num) {
+  arrayCastParallel(castHalfToFloat, dst, (const uint16_t *)src, num);
+}
+
 void arrayCastHalfToFloatInvalidInf(float *dst, uint16_t *src, size_t num) {
   constexpr AlgoHalfToFloat algo{AlgoHalfToFloat::MLUOPGTEST2};
   VLOG(4) << __func__ << " using algo " << AlgoHalfToFloatStr.at(algo).c_str();
@@ -687,24 +704,33 @@ void arrayCastFloatAndNormal<float, bool>(void *dst, void *src, size_t num) {
   }
 }
 
+template <>
+void arrayCastFloatAndNormal<float, int8_t>(void *dst, void *src, size_t num) {
+  arrayCastParallel(castFloatToInt8, (int8_t *)dst, (const float *)src, num);
+}
+
+template <>
+void arrayCastFloatAndNormal<float, int16_t>(void *dst, void *src,
+                                             size_t num) {
+  arrayCastParallel(castFloatToInt16, (int16_t *)dst, (const float *)src, num);
+}
+
+template <>
+void arrayCastFloatAndNormal<int8_t, float>(void *dst, void *src, size_t num) {
+  arrayCastParallel(castInt8ToFloat, (float *)dst, (const int8_t *)src, num);
+}
+
+template <>
+void arrayCastFloatAndNormal<int16_t, float>(void *dst, void *src,
+                                             size_t num) {
+  arrayCastParallel(castInt16ToFloat, (float *)dst, (const int16_t *)src, num);
+}
+
 // Note: here uint16_t is acutally bf16
 void arrayCastFloatToBF16(uint16_t *dst, float *src, size_t num) {
-// rounding mode: rn
-#pragma omp parallel for schedule(guided)
-  for (size_t i = 0; i < num; ++i) {
-    union {
-      uint32_t src_i_u32;
-      float src_i_f32;
-    };
-    src_i_f32 = src[i];
-    if (std::isnan(src_i_f32)) {
-      // XXX(zhaolianshui): loosing sign and quiet_nan/signaling_nan info
-      ((uint16_t *)dst)[i] = 0x7FC0;
-    } else {
-      uint32_t rounding_bias = ((src_i_u32 >> 16) & 1) + (uint32_t)0x7FFF;
-      dst[i] = static_cast<uint16_t>((src_i_u32 + rounding_bias) >> 16);
-    }
-  }
+  // rounding mode: rn
+  // XXX(zhaolianshui): loosing sign and quiet_nan/signaling_nan info
+  arrayCastParallel(castFloatToBF16, dst, (const float *)src, num);
 }
 
 // the actual dtype of src is bf16
@@ -720,11 +746,7 @@ float cvtBF16ToFloat(uint16_t src_i) {
 
 // Note: here uint16_t is acutally bf16
 void arrayCastBF16ToFloat(float *dst, uint16_t *src, size_t num) {
-#pragma omp parallel for schedule(guided)
-  for (size_t i = 0; i < num; ++i) {
-    uint16_t src_i = src[i];
-    dst[i] = cvtBF16ToFloat(src_i);
-  }
+  arrayCastParallel(castBF16ToFloat, dst, (const uint16_t *)src, num);
 }
 
 // support uint8, uint16, uint32, uint64, int8, int16, int32, int64, bool
@@ -82,6 +82,15 @@ void GlobalVar::init(int *argc, char **argv) {
     get_vmpeak_ = getParam(arg, "--get_vmpeak").empty()
                       ? get_vmpeak_
                       : getParam(arg, "--get_vmpeak");
+    case_history_ = getParam(arg, "--case_history").empty()
+                        ? case_history_
+                        : getParam(arg, "--case_history");
+    minimize_dir_ = getParam(arg, "--minimize").empty()
+                        ? minimize_dir_
+                        : getParam(arg, "--minimize");
+    stream_result_ = getParam(arg, "--stream_result").empty()
+                         ? stream_result_
+                         : getParam(arg, "--stream_result");
     rand_n_ = getParam(arg, "--rand_n").empty()
                   ? rand_n_
                   : to_int(getParam(arg, "--rand_n"), "--rand_n");
@@ -107,6 +116,7 @@ void GlobalVar::init(int *argc, char **argv) {
     auto_tuning_ =
         paramDefinedMatch(arg, "--auto_tuning") ? true : auto_tuning_;
     shuffle_ = paramDefinedMatch(arg, "--gtest_shuffle") ? true : shuffle_;
+    resume_ = paramDefinedMatch(arg, "--resume") ? true : resume_;
     mlu_only_ = paramDefinedMatch(arg, "--mlu_only") ? true : mlu_only_;
     test_llc_ = paramDefinedMatch(arg, "--test_llc") ? true : test_llc_;
     use_default_queue_ = paramDefinedMatch(arg, "--use_default_queue")
@@ -154,6 +164,9 @@ void GlobalVar::init(int *argc, char **argv) {
     current_arg_valid = false;
   }
   // get args from env
+  if (case_history_.empty() && std::getenv("MLUOP_GTEST_CASE_HISTORY")) {
+    case_history_ = std::getenv("MLUOP_GTEST_CASE_HISTORY");
+  }
   use_default_queue_ = (use_default_queue_ == false)
                            ? getEnv("MLUOP_GTEST_USE_DEFAULT_QUEUE", false)
                            : use_default_queue_;
@@ -220,6 +233,10 @@ void GlobalVar::print() {
   std::cout << "cases_list is " << cases_list_ << ENDL;
   std::cout << "cases_path is " << case_path_ << ENDL;
   std::cout << "get_vmpeak is " << get_vmpeak_ << ENDL;
+  std::cout << "case_history is " << case_history_ << ENDL;
+  std::cout << "minimize is " << minimize_dir_ << ENDL;
+  std::cout << "stream_result is " << stream_result_ << ENDL;
+  std::cout << "resume is " << resume_ << ENDL;
   std::cout << "rand_n is " << rand_n_ << ENDL;
   std::cout << "repeat is " << repeat_ << ENDL;
   std::cout << "thread is " << thread_num_ << ENDL;
@@ -242,9 +259,17 @@ void GlobalVar::print() {
 }
 
 void GlobalVar::checkUnsupportedTest() const {
+  if (resume_ && stream_result_.empty()) {
+    LOG(ERROR) << "--resume needs --stream_result to read the finished tests.";
+    exit(EXIT_FAILURE_MLUOP);
+  }
   // random_mlu_address use MLU memory pool, which is not mutex guarded, so
   // don't use it in multi-thread mode
   if (thread_num_ > 1) {
+    if (!minimize_dir_.empty()) {
+      LOG(ERROR) << "Does not support minimize in multi-thread mode.";
+      exit(EXIT_FAILURE_MLUOP);
+    }
     if (random_mlu_address_) {
       LOG(ERROR) << "Does not support random_mlu_address in multi-thread mode.";
       exit(EXIT_FAILURE_MLUOP);
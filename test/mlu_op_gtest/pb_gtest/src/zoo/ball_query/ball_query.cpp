@@ -28,6 +28,7 @@
 
 #include "mlu_op.h"
 #include "core/type.h"
+#include "point_index.h"
 
 namespace mluoptest {
 void BallQueryExecutor::paramCheck() {
@@ -94,34 +95,34 @@ void BallQueryExecutor::cpuCompute() {
   float max_radius2 = max_radius_ * max_radius_;
 
   for (int b_idx = 0; b_idx < b; ++b_idx) {
-    for (int row = 0; row < m; ++row) {
-      int record_idx = 0;
-      bool in_ball = false;
-      for (int col = 0; col < n; ++col) {
-        float sub_x1 = new_xyz_host[b_idx * m * 3 + row * 3 + 0] -
-                       xyz_host[b_idx * n * 3 + col * 3 + 0];
-        float sub_y1 = new_xyz_host[b_idx * m * 3 + row * 3 + 1] -
-                       xyz_host[b_idx * n * 3 + col * 3 + 1];
-        float sub_z1 = new_xyz_host[b_idx * m * 3 + row * 3 + 2] -
-                       xyz_host[b_idx * n * 3 + col * 3 + 2];
-        float distance2 = sub_x1 * sub_x1 + sub_y1 * sub_y1 + sub_z1 * sub_z1;
-        if (distance2 == 0 ||
-            (distance2 >= min_radius2 && distance2 < max_radius2)) {
-          in_ball = true;
-          if (record_idx == 0) {
-            for (int i = 0; i < nsample_; ++i) {
-              idx_host[b_idx * m * nsample_ + row * nsample_ + i] = col;
-            }
+    // the first nsample_ xyz points in the ball by index, from the grid
+    // candidates within max_radius_ in ascending order.
+    const float *xyz = xyz_host + b_idx * n * 3;
+    PointGrid grid(xyz, n, max_radius_);
+#pragma omp parallel
+    {
+      std::vector<int> candidates;
+#pragma omp for
+      for (int row = 0; row < m; ++row) {
+        const float *point = new_xyz_host + b_idx * m * 3 + row * 3;
+        float *idx = idx_host + b_idx * m * nsample_ + row * nsample_;
+        grid.query(point, max_radius_, &candidates);
+        int record_idx = 0;
+        for (int col : candidates) {
+          if (record_idx >= nsample_) {
+            break;
+          }
+          float distance2 = pointDistance2(point, xyz + col * 3);
+          if (distance2 == 0 ||
+              (distance2 >= min_radius2 && distance2 < max_radius2)) {
+            idx[record_idx++] = col;
           }
-          idx_host[b_idx * m * nsample_ + row * nsample_ + record_idx] = col;
-          ++record_idx;
-          if (record_idx >= nsample_) break;
         }
-      }
-      if (!in_ball) {  // for one nex_xyz point, if xyz points are out of
-                       // ball,then set this idx_host to 0
-        for (int i = 0; i < nsample_; ++i) {
-          idx_host[b_idx * m * nsample_ + row * nsample_ + i] = 0;
+        // the rest repeats the first point in the ball, or is 0 if the ball
+        // is empty.
+        const float fill = record_idx > 0 ? idx[0] : 0;
+        for (int i = record_idx; i < nsample_; ++i) {
+          idx[i] = fill;
         }
       }
     }
@@ -0,0 +1,113 @@
+/*******************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS self.tcp LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *******************************************************************************/
+#include "border_align_forward_impl.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "bilinear_sample.h"
+#include "core/logging.h"
+
+namespace mluoptest {
+
+// the value at (y, x) of the C channels of a border, 0 outside of the map.
+static void borderSample(const float *input, const int32_t H, const int32_t W,
+                         const int32_t C, float y, float x, float *value) {
+  BilinearSample sample;
+  if (bilinearSampleClamped(H, W, (int64_t)C * 4, y, x, &sample)) {
+    bilinearGather(input, sample, C, value);
+  } else {
+    std::fill(value, value + C, 0.0f);
+  }
+}
+
+void borderAlignForwardCpu(const float *input, const float *boxes,
+                           const int32_t N, const int32_t H, const int32_t W,
+                           const int32_t C, const int32_t K,
+                           const int32_t pool_size, float *output,
+                           float *argmax_idx) {
+  // the channels of a border share its sample points, each point is
+  // interpolated for all of them at once.
+#pragma omp parallel
+  {
+    std::vector<float> max_pool_result_temp(C);
+#pragma omp for
+    for (int32_t nk = 0; nk < N * K; ++nk) {
+      const int32_t n = nk / K;
+      int32_t bbox_offset = nk * 4;
+      float x1 = boxes[bbox_offset];
+      float y1 = boxes[bbox_offset + 1];
+      float x2 = boxes[bbox_offset + 2];
+      float y2 = boxes[bbox_offset + 3];
+      float bbox_width = x2 - x1;
+      float bbox_height = y2 - y1;
+      for (int32_t border_loop = 0; border_loop < 4; ++border_loop) {
+        float x_stride = 0;
+        float y_stride = 0;
+        if (pool_size != 0) {
+          switch (border_loop) {
+            case 0: {
+              x_stride = bbox_width / pool_size;
+            } break;
+            case 1: {
+              y_stride = bbox_height / pool_size;
+            } break;
+            case 2: {
+              x_stride = -bbox_width / pool_size;
+            } break;
+            case 3: {
+              y_stride = -bbox_height / pool_size;
+            } break;
+            default: {
+              VLOG(4) << "Invalid Border Type.";
+            } break;
+          }
+        }
+        float x = boxes[bbox_offset + border_loop / 2 * 2];
+        float y = boxes[bbox_offset + border_loop / 2 * 2 + 1];
+        int64_t i = ((int64_t)nk * 4 + border_loop) * C;
+        float *max_pool_result = output + i;
+        float *argmax_idx_ptr = argmax_idx + i;
+        const float *input_offset =
+            input + (int64_t)n * H * W * C * 4 + border_loop * C;
+        borderSample(input_offset, H, W, C, y, x, max_pool_result);
+        std::fill(argmax_idx_ptr, argmax_idx_ptr + C, 0.0f);
+        for (int32_t pool_size_idx = 1; pool_size_idx <= pool_size;
+             ++pool_size_idx) {
+          x += x_stride;
+          y += y_stride;
+          borderSample(input_offset, H, W, C, y, x,
+                       max_pool_result_temp.data());
+          for (int32_t c = 0; c < C; ++c) {
+            if (max_pool_result_temp[c] - max_pool_result[c] > 0) {
+              max_pool_result[c] = max_pool_result_temp[c];
+              argmax_idx_ptr[c] = pool_size_idx;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace mluoptest
@@ -0,0 +1,36 @@
+/*******************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS self.tcp LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *******************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_SRC_ZOO_BORDER_ALIGN_FORWARD_BORDER_ALIGN_FORWARD_IMPL_H_  // NOLINT
+#define TEST_MLU_OP_GTEST_SRC_ZOO_BORDER_ALIGN_FORWARD_BORDER_ALIGN_FORWARD_IMPL_H_  // NOLINT
+#include <cstdint>
+namespace mluoptest {
+// the border_align forward of BorderAlignForwardExecutor::cpuCompute: input
+// (N, H, W, 4 * C) with the C channels of each border side by side, boxes
+// (N, K, 4) as x1, y1, x2, y2. output and argmax_idx are (N, K, 4, C).
+void borderAlignForwardCpu(const float *input, const float *boxes,
+                           const int32_t N, const int32_t H, const int32_t W,
+                           const int32_t C, const int32_t K,
+                           const int32_t pool_size, float *output,
+                           float *argmax_idx);
+}  // namespace mluoptest
+#endif  // TEST_MLU_OP_GTEST_SRC_ZOO_BORDER_ALIGN_FORWARD_BORDER_ALIGN_FORWARD_IMPL_H_  // NOLINT
@@ -34,6 +34,8 @@ class CarafeBackwardExecutor : public Executor {
   void paramCheck();
   void compute();
   void cpuCompute();
+  // theory ops are counted by cpuCompute(), which a cache hit skips.
+  bool baselineCacheable() { return false; }
   int64_t getTheoryOps() override;
 
  private:
@@ -25,6 +25,7 @@
 #include <set>
 #include "carafe_forward.h"
 #include "mlu_op.h"
+#include "bilinear_sample.h"
 
 namespace mluoptest {
 std::set<Evaluator::Formula> CarafeForwardExecutor::getCriterionsUse() const {
@@ -120,47 +121,55 @@ void CarafeForwardExecutor::cpuCompute() {
     host_output[i] = 0.0;
   }
 
-  // calculate weighted sum on each output location
-  for (int index1_output = 0; index1_output < output_size; index1_output++) {
-    // output[index1_output] -> output[no,ho,wo,co]
-    int co = index1_output % output_dimC;
-    int wo = (index1_output / output_dimC) % output_dimW;
-    int ho = (index1_output / output_dimC / output_dimW) % output_dimH;
-    int no = index1_output / output_dimC / output_dimW / output_dimH;
-    // co -> mask_group
-    int mask_group = co / channels_per_group;
+  // calculate weighted sum on each output location, the channels of a
+  // group share the mask of a kernel window element
+  const int output_pixels = output_dimN * output_dimH * output_dimW;
+  int64_t theory_ops = 0;
+#pragma omp parallel for reduction(+ : theory_ops)
+  for (int index1_pixel = 0; index1_pixel < output_pixels; index1_pixel++) {
+    // output[index1_pixel] -> output[no,ho,wo]
+    int wo = index1_pixel % output_dimW;
+    int ho = (index1_pixel / output_dimW) % output_dimH;
+    int no = index1_pixel / output_dimW / output_dimH;
     // kernel window's bottom-left location on the input feature map
     int min_hi = ho / scale_factor - half_kernel_size;
     int min_wi = wo / scale_factor - half_kernel_size;
-    // calculate weighted sum over the kernel window
-    for (int kh = 0; kh < kernel_size; kh++) {
-      // corresponding input location
-      int hi = min_hi + kh;
-      // skip elements outside of the input feature map
-      if (hi < 0 || hi > input_dimH - 1) {
-        continue;
-      }
-      for (int kw = 0; kw < kernel_size; kw++) {
+    for (int mask_group = 0; mask_group < group_size; mask_group++) {
+      int co = mask_group * channels_per_group;
+      float *output_group =
+          host_output + (int64_t)index1_pixel * output_dimC + co;
+      // calculate weighted sum over the kernel window
+      for (int kh = 0; kh < kernel_size; kh++) {
         // corresponding input location
-        int wi = min_wi + kw;
+        int hi = min_hi + kh;
         // skip elements outside of the input feature map
-        if (wi < 0 || wi > input_dimW - 1) {
+        if (hi < 0 || hi > input_dimH - 1) {
           continue;
         }
-        // corresponding mask location: index1(group,kh,kw)
-        int mask_c = (mask_group * kernel_size + kh) * kernel_size + kw;
-        // calculate the weighted sum
-        // output[no,ho,wo,co] = input[no,hi,wi,co] * mask[no,hi,wi,mask_c]
-        int index1_input =
-            co + input_dimC * (wi + input_dimW * (hi + input_dimH * no));
-        int index1_mask =
-            mask_c + mask_dimC * (wo + mask_dimW * (ho + mask_dimH * no));
-        host_output[index1_output] +=
-            host_input[index1_input] * host_mask[index1_mask];
-        theory_ops_ += 2;  // one is multiply, the other is addition
-      }                    // kernel_width
-    }                      // kernel_height
-  }                        // each output element
+        for (int kw = 0; kw < kernel_size; kw++) {
+          // corresponding input location
+          int wi = min_wi + kw;
+          // skip elements outside of the input feature map
+          if (wi < 0 || wi > input_dimW - 1) {
+            continue;
+          }
+          // corresponding mask location: index1(group,kh,kw)
+          int mask_c = (mask_group * kernel_size + kh) * kernel_size + kw;
+          // calculate the weighted sum
+          // output[no,ho,wo,co] = input[no,hi,wi,co] * mask[no,hi,wi,mask_c]
+          int index1_input =
+              co + input_dimC * (wi + input_dimW * (hi + input_dimH * no));
+          int index1_mask =
+              mask_c + mask_dimC * (wo + mask_dimW * (ho + mask_dimH * no));
+          weightedAdd(host_input + index1_input, host_mask[index1_mask],
+                      channels_per_group, output_group);
+          // one is multiply, the other is addition
+          theory_ops += 2 * channels_per_group;
+        }  // kernel_width
+      }    // kernel_height
+    }      // mask_group
+  }        // each output location
+  theory_ops_ += theory_ops;
 }
 
 int64_t CarafeForwardExecutor::getTheoryOps() {
@@ -36,6 +36,8 @@ class CarafeForwardExecutor : public Executor {
   void paramCheck();
   void compute();
   void cpuCompute();
+  // theory ops are counted by cpuCompute(), which a cache hit skips.
+  bool baselineCacheable() { return false; }
   int64_t getTheoryOps() override;
   std::set<Evaluator::Formula> getCriterionsUse() const override;
 
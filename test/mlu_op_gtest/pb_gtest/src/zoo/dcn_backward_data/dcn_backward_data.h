@@ -41,6 +41,8 @@ class DcnBackwardDataExecutor : public Executor {
   void workspaceMalloc();
   void workspaceFree();
   void cpuCompute();
+  // theory ops are counted by cpuCompute(), which a cache hit skips.
+  bool baselineCacheable() { return false; }
   int64_t getTheoryOps() override;
 
  private:
@@ -38,6 +38,8 @@ class DcnBackwardWeightExecutor : public Executor {
   void paramCheck();
   void compute();
   void cpuCompute();
+  // theory ops are counted by cpuCompute(), which a cache hit skips.
+  bool baselineCacheable() { return false; }
   int64_t getTheoryOps() override;
 
  private:
@@ -34,6 +34,8 @@ class DeformRoiPoolBackwardExecutor : public Executor {
   void paramCheck() override;
   void compute() override;
   void cpuCompute() override;
+  // theory ops are counted by cpuCompute(), which a cache hit skips.
+  bool baselineCacheable() override { return false; }
   int64_t getTheoryOps() override;
 
  private:
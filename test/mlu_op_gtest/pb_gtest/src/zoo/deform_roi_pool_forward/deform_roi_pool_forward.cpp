@@ -25,6 +25,8 @@
 #include <algorithm>
 #include <string>
 
+#include "bilinear_sample.h"
+
 namespace mluoptest {
 
 void DeformRoiPoolForwardExecutor::printDataInfo() {
@@ -106,57 +108,17 @@ void DeformRoiPoolForwardExecutor::compute() {
   interface_timer_.stop();
 }
 
-// Modyfied from mmcv
-float bilinear_interpolate(const float *input, const int height,
-                           const int width, const int channels, float y,
-                           float x, int c,
-                           const int index /* index for debug only*/) {
-  // deal with cases that inverse elements are out of feature map boundary
-  if (y < -1.0 || y > height || x < -1.0 || x > width) return 0;
-
-  if (y <= 0) y = 0;
-  if (x <= 0) x = 0;
-
-  int y_low = (int)y;
-  int x_low = (int)x;
-  int y_high;
-  int x_high;
-
-  if (y_low >= height - 1) {
-    y_high = y_low = height - 1;
-    y = (float)y_low;
-  } else {
-    y_high = y_low + 1;
-  }
-
-  if (x_low >= width - 1) {
-    x_high = x_low = width - 1;
-    x = (float)x_low;
-  } else {
-    x_high = x_low + 1;
-  }
-
-  float ly = y - y_low;
-  float lx = x - x_low;
-  float hy = 1. - ly, hx = 1. - lx;
-
-  float v1 = input[y_low * width * channels + x_low * channels + c];
-  float v2 = input[y_low * width * channels + x_high * channels + c];
-  float v3 = input[y_high * width * channels + x_low * channels + c];
-  float v4 = input[y_high * width * channels + x_high * channels + c];
-  float w1 = hy * hx, w2 = hy * lx, w3 = ly * hx, w4 = ly * lx;
-  float val = (w1 * v1 + w2 * v2 + w3 * v3 + w4 * v4);
-  return val;
-}
-
 void DeformRoiPoolForwardExecutor::cpuCompute() {
-  int output_size = parser_->getOutputDataCount(0);
-  for (int index = 0; index < output_size; index++) {
-    // (n, ph, pw, c) is an element in the pooled output
-    const int c = index % channels;
-    const int pw = (index / channels) % pooled_width;
-    const int ph = (index / channels / pooled_width) % pooled_height;
-    const int n = index / channels / pooled_width / pooled_height;
+  // the channels of a bin share its sample points, each point is
+  // interpolated for all of them at once.
+  const int bins =
+      channels > 0 ? parser_->getOutputDataCount(0) / channels : 0;
+#pragma omp parallel for
+  for (int index = 0; index < bins; index++) {
+    // (n, ph, pw) is a bin of the pooled output
+    const int pw = index % pooled_width;
+    const int ph = (index / pooled_width) % pooled_height;
+    const int n = index / pooled_width / pooled_height;
     const float *offset_rois = cpu_fp32_input_[1] + n * 5;
     const int roi_batch_ind = offset_rois[0];
 
@@ -196,9 +158,11 @@ void DeformRoiPoolForwardExecutor::cpuCompute() {
       roi_start_w += offset_roi_w;
       roi_start_h += offset_roi_h;
     }
-    // We do average pooling inside a bin
+    // We do average pooling inside a bin, a sample outside of the feature
+    // map adds 0 and is skipped
     const float count = std::max(roi_bin_grid_h * roi_bin_grid_w, 1);
-    float output_val = 0.;
+    float *output_val = cpu_fp32_output_[0] + (int64_t)index * channels;
+    std::fill(output_val, output_val + channels, 0.0f);
     for (int iy = 0; iy < roi_bin_grid_h; iy++) {
       const float y = roi_start_h + ph * bin_size_h +
                       static_cast<float>(iy + .5f) * bin_size_h /
@@ -207,12 +171,15 @@ void DeformRoiPoolForwardExecutor::cpuCompute() {
         const float x = roi_start_w + pw * bin_size_w +
                         static_cast<float>(ix + .5f) * bin_size_w /
                             static_cast<float>(roi_bin_grid_w);
-        float val = bilinear_interpolate(offset_input, height, width, channels,
-                                         y, x, c, index);
-        output_val += val;
+        BilinearSample sample;
+        if (bilinearSampleClamped(height, width, channels, y, x, &sample)) {
+          bilinearGatherAdd(offset_input, sample, channels, 1.0f, output_val);
+        }
       }
     }
-    cpu_fp32_output_[0][index] = output_val / count;
+    for (int c = 0; c < channels; c++) {
+      output_val[c] = output_val[c] / count;
+    }
   }
 }
 
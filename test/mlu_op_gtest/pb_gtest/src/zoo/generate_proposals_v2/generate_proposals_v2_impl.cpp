@@ -26,7 +26,9 @@
 #include <float.h>
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <vector>
 
 using namespace std;  // NOLINT
 
@@ -170,25 +172,7 @@ void creatAndFilterProposalsBox(T *anchors_slice, T *bbox_deltas_slice,
 }
 
 template <typename T>
-void findMaxScore(T *h_scores_buf, int size, T *max_score, int *max_score_id) {
-  if (size == 0) {
-    return;
-  }
-  T max_score_local = h_scores_buf[0];
-  int max_score_id_local = 0;
-  for (int i = 1; i < size; ++i) {
-    if (h_scores_buf[i] > max_score_local) {
-      max_score_local = h_scores_buf[i];
-      max_score_id_local = i;
-    }
-  }
-  *max_score = max_score_local;
-  *max_score_id = max_score_id_local;
-  return;
-}
-
-template <typename T>
-T calcIoU(T *a, T *b, bool pixel_offset) {
+T calcIoU(const T *a, const T *b, bool pixel_offset) {
   float offset = pixel_offset ? static_cast<float>(1.0) : 0;
   float left = max(a[0], b[0]), right = min(a[2], b[2]);
   float top = max(a[1], b[1]), bottom = min(a[3], b[3]);
@@ -202,108 +186,103 @@ T calcIoU(T *a, T *b, bool pixel_offset) {
 
 bool equal(float a, float b) { return abs(a - b) < 0.001; }
 
+std::vector<int> topK(const float *scores, const int size, const int k) {
+  std::vector<int> ids(size);
+  for (int i = 0; i < size; ++i) {
+    ids[i] = i;
+  }
+  auto greater = [scores](int a, int b) {
+    // nan goes last, so the comparison stays a strict weak order.
+    if (std::isnan(scores[a]) || std::isnan(scores[b])) {
+      return !std::isnan(scores[a]) || (std::isnan(scores[b]) && a < b);
+    }
+    return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+  };
+  if (k < size) {
+    std::nth_element(ids.begin(), ids.begin() + k, ids.end(), greater);
+    ids.resize(k);
+  }
+  std::sort(ids.begin(), ids.end(), greater);
+  return ids;
+}
+
+std::vector<int> nmsSorted(const float *scores, const float *boxes,
+                           const int num, const int max_num,
+                           const float nms_thresh, const bool pixel_offset) {
+  // proposals are already in descending score, so greedy nms visits them in
+  // order and each kept box suppresses the boxes after it.
+  std::vector<int> keep;
+  std::vector<char> suppressed(num, 0);
+  for (int id = 0; id < num && (int)keep.size() < max_num; ++id) {
+    if (suppressed[id]) {
+      continue;
+    }
+    // nan scores are last, the device never picks them.
+    if (!(scores[id] > FLOAT_MIN)) {
+      break;
+    }
+    keep.push_back(id);
+    const float *a = boxes + id * 4;
+    for (int inner_id = id + 1; inner_id < num; ++inner_id) {
+      if (!suppressed[inner_id] &&
+          calcIoU(a, boxes + inner_id * 4, pixel_offset) > nms_thresh) {
+        suppressed[inner_id] = 1;
+      }
+    }
+  }
+  return keep;
+}
+
 template <typename T>
 void ProposalForOneImage(T *scores_slice, T *bbox_deltas_slice,
                          T *im_shape_slice, T *anchors_slice,
                          T *variances_slice, int H, int W, int A, T *rpn_rois,
                          T *rpn_roi_probs, int *one_image_proposal_num,
-                         const int rpn_rois_batch_num, const int pre_nms_top_n,
-                         const int post_nms_top_n, const T nms_thresh,
-                         const T min_size, const bool pixel_offset) {
+                         const int pre_nms_top_n, const int post_nms_top_n,
+                         const T nms_thresh, const T min_size,
+                         const bool pixel_offset) {
   const int HWA = A * H * W;
   int proposals_num = 0;
 
   int pre_nms_num =
       (pre_nms_top_n <= 0 || pre_nms_top_n > HWA) ? HWA : pre_nms_top_n;
-  int post_nms_num = post_nms_top_n;
-  if (post_nms_num > pre_nms_num) {
-    post_nms_num = pre_nms_num;
-  }
 
-  T k_score = 0.0f;
-  T *out_scores_buf = new T[pre_nms_num];
-  T *out_box_buf = new T[pre_nms_num * 4];
-  T *out_area_buf = new T[pre_nms_num];
-  T *temp_scores = new T[HWA];
-  memcpy(temp_scores, scores_slice, HWA * sizeof(T));
+  std::vector<T> out_scores_buf(pre_nms_num);
+  std::vector<T> out_box_buf(pre_nms_num * 4);
+  std::vector<T> out_area_buf(pre_nms_num);
   // top k, creatbox, filter box
-  for (int top_id = 0; top_id < pre_nms_num; ++top_id) {
-    int max_score_id = top_id;
-    T max_score = scores_slice[max_score_id];
-
-    findMaxScore(temp_scores, HWA, &max_score, &max_score_id);
-    temp_scores[max_score_id] = FLOAT_MIN;
-
+  for (int max_score_id : topK(scores_slice, HWA, pre_nms_num)) {
     creatAndFilterProposalsBox<T>(
         anchors_slice, bbox_deltas_slice, im_shape_slice, variances_slice,
-        out_scores_buf, out_box_buf, out_area_buf, A, H, W, min_size, max_score,
-        max_score_id, pixel_offset, &proposals_num);
+        out_scores_buf.data(), out_box_buf.data(), out_area_buf.data(), A, H,
+        W, min_size, scores_slice[max_score_id], max_score_id, pixel_offset,
+        &proposals_num);
   }
 
   if (proposals_num == 0) {
     *one_image_proposal_num = 1;
-    rpn_rois[rpn_rois_batch_num * 4 + 0] = 0;
-    rpn_rois[rpn_rois_batch_num * 4 + 1] = 0;
-    rpn_rois[rpn_rois_batch_num * 4 + 2] = 0;
-    rpn_rois[rpn_rois_batch_num * 4 + 3] = 0;
-    rpn_roi_probs[rpn_rois_batch_num] = 0;
+    rpn_rois[0] = 0;
+    rpn_rois[1] = 0;
+    rpn_rois[2] = 0;
+    rpn_rois[3] = 0;
+    rpn_roi_probs[0] = 0;
     return;
   }
 
-  float offset = pixel_offset ? 1 : 0;
   int real_proposal_num = 0;
-  int nms_num = std::min(proposals_num, post_nms_top_n);
-
-  for (int nms_id = 0; nms_id < nms_num; ++nms_id) {
-    // Find max score
-    float max_score = 0.0f;
-    int max_score_id = 0;
-    findMaxScore(out_scores_buf, proposals_num, &max_score, &max_score_id);
-    out_scores_buf[max_score_id] = FLOAT_MIN;
-
-    if (max_score <= FLOAT_MIN) {
-      break;
-    }
-    // Compute max area
-    float max_score_x0 = out_box_buf[max_score_id * 4 + 0];
-    float max_score_y0 = out_box_buf[max_score_id * 4 + 1];
-    float max_score_x1 = out_box_buf[max_score_id * 4 + 2];
-    float max_score_y1 = out_box_buf[max_score_id * 4 + 3];
+  for (int id : nmsSorted(out_scores_buf.data(), out_box_buf.data(),
+                          proposals_num, post_nms_top_n, nms_thresh,
+                          pixel_offset)) {
     // save max score and box to output
-    rpn_rois[(rpn_rois_batch_num + real_proposal_num) * 4 + 0] = max_score_x0;
-    rpn_rois[(rpn_rois_batch_num + real_proposal_num) * 4 + 1] = max_score_y0;
-    rpn_rois[(rpn_rois_batch_num + real_proposal_num) * 4 + 2] = max_score_x1;
-    rpn_rois[(rpn_rois_batch_num + real_proposal_num) * 4 + 3] = max_score_y1;
-
-    rpn_roi_probs[rpn_rois_batch_num + real_proposal_num] = max_score;
+    T *a = out_box_buf.data() + id * 4;
+    rpn_rois[real_proposal_num * 4 + 0] = a[0];
+    rpn_rois[real_proposal_num * 4 + 1] = a[1];
+    rpn_rois[real_proposal_num * 4 + 2] = a[2];
+    rpn_rois[real_proposal_num * 4 + 3] = a[3];
+    rpn_roi_probs[real_proposal_num] = out_scores_buf[id];
     real_proposal_num++;
-
-    float max_score_area = out_area_buf[max_score_id];
-
-    for (int inner_id = 0; inner_id < proposals_num; ++inner_id) {
-      if (inner_id == max_score_id) {
-        continue;
-      }
-
-      float *a = out_box_buf + max_score_id * 4;
-      float *b = out_box_buf + inner_id * 4;
-      float iou = calcIoU(a, b, pixel_offset);
-      if (iou > nms_thresh) {
-        out_scores_buf[inner_id] = FLOAT_MIN;
-      }
-    }
   }
   *one_image_proposal_num = real_proposal_num;
-
-  delete[] out_scores_buf;
-  delete[] out_box_buf;
-  delete[] out_area_buf;
-  delete[] temp_scores;
-
-  out_scores_buf = nullptr;
-  out_box_buf = nullptr;
-  out_area_buf = nullptr;
-  temp_scores = nullptr;
 }
 
 void generateProposalsV2CPUImpl(
@@ -314,25 +293,39 @@ void generateProposalsV2CPUImpl(
     float *rpn_rois, float *rpn_roi_probs, float *rpn_rois_num,
     float *rpn_rois_batch_size) {
   const int HWA = A * H * W;
-  int rpn_rois_batch_num = 0;
+  const int pre_nms_num =
+      (pre_nms_top_n <= 0 || pre_nms_top_n > HWA) ? HWA : pre_nms_top_n;
 
+  // images are independent, each writes its rois to its own buffer and the
+  // buffers are packed in batch order afterwards.
+  std::vector<std::vector<float>> image_rois(N), image_roi_probs(N);
+  std::vector<int> image_proposal_num(N, 0);
+#pragma omp parallel for schedule(dynamic)
   for (int i = 0; i < N; ++i) {
-    float *scores_slice = scores + i * HWA;
-    float *bbox_deltas_slice = bbox_deltas + i * HWA * 4;
+    float *scores_slice = scores + (int64_t)i * HWA;
+    float *bbox_deltas_slice = bbox_deltas + (int64_t)i * HWA * 4;
     float *im_shape_slice = im_shape + 2 * i;
     float *anchors_slice = anchors;      // [H, W, A, 4]
     float *variances_slice = variances;  // [H, W, A, 4]
-    float *rpn_rois_slice = rpn_rois + rpn_rois_batch_num * 4;
-    float *rpn_roi_probs_slice = rpn_roi_probs + rpn_rois_batch_num * 1;
-    float *rpn_rois_num_slice = rpn_rois_num + rpn_rois_batch_num * 1;
+    image_rois[i].resize(std::max(pre_nms_num, 1) * 4);
+    image_roi_probs[i].resize(std::max(pre_nms_num, 1));
 
-    int one_image_proposal_num = 0;
     ProposalForOneImage<float>(
         scores_slice, bbox_deltas_slice, im_shape_slice, anchors_slice,
-        variances_slice, H, W, A, rpn_rois, rpn_roi_probs,
-        &one_image_proposal_num, rpn_rois_batch_num, pre_nms_top_n,
+        variances_slice, H, W, A, image_rois[i].data(),
+        image_roi_probs[i].data(), &image_proposal_num[i], pre_nms_top_n,
         post_nms_top_n, nms_thresh, min_size, pixel_offset);
+  }
 
+  int rpn_rois_batch_num = 0;
+  for (int i = 0; i < N; ++i) {
+    int one_image_proposal_num = image_proposal_num[i];
+    std::copy(image_rois[i].begin(),
+              image_rois[i].begin() + one_image_proposal_num * 4,
+              rpn_rois + rpn_rois_batch_num * 4);
+    std::copy(image_roi_probs[i].begin(),
+              image_roi_probs[i].begin() + one_image_proposal_num,
+              rpn_roi_probs + rpn_rois_batch_num);
     rpn_rois_batch_num += one_image_proposal_num;
     rpn_rois_num[i] = one_image_proposal_num;
   }
@@ -28,6 +28,18 @@
 #include "executor.h"
 
 namespace GenerateProposalsV2 {
+// the ids of the top k scores, in descending score and ascending id for equal
+// scores, the order in which the device picks them. nan scores go last, a
+// nan at id 0 too, where the old findMaxScore scan took it first.
+std::vector<int> topK(const float* scores, const int size, const int k);
+
+// greedy nms of num boxes x0, y0, x1, y1 in descending score, the kept ids.
+// stops after max_num boxes, or at a score of -FLT_MAX or below, or nan. the
+// old scan kept a nan in front, here all nan scores give no boxes.
+std::vector<int> nmsSorted(const float* scores, const float* boxes,
+                           const int num, const int max_num,
+                           const float nms_thresh, const bool pixel_offset);
+
 void generateProposalsV2CPUImpl(
     float* scores, float* bbox_deltas, float* im_shape, float* anchors,
     float* variances, const int pre_nms_top_n, const int post_nms_top_n,
@@ -25,7 +25,9 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <utility>
 #include "get_indice_pairs.h"
+#include "get_indice_pairs_impl.h"
 #include "mlu_op.h"
 
 namespace mluoptest {
@@ -144,33 +146,30 @@ void GetIndicePairsExecutor::diffPreprocess() {
   for (int i = 0; i < filter_space_.size(); i++) {
     kernel_volume *= filter_space_[i];
   }
-  std::vector<float> input;
-  std::vector<float> input_copy;
-  std::vector<float> output;
+  // sort the pairs of each kernel offset by input, a pair takes the output of
+  // the first pair with the same input.
+#pragma omp parallel for schedule(dynamic)
   for (int i = 0; i < kernel_volume; i++) {
+    float *input = cpu_input + (int64_t)i * input_active_in * 2;
+    float *output = input + input_active_in;
+    std::vector<std::pair<float, float>> pairs;
     for (int j = 0; j < input_active_in; j++) {
-      if (cpu_input[i * input_active_in * 2 + j] != -1.0) {
-        input.push_back(cpu_input[i * input_active_in * 2 + j]);
-        input_copy.push_back(cpu_input[i * input_active_in * 2 + j]);
-        output.push_back(
-            cpu_input[i * input_active_in * 2 + input_active_in + j]);
+      if (input[j] != -1.0) {
+        pairs.emplace_back(input[j], output[j]);
       }
     }
-    sort(input.begin(), input.end());
-    for (int k = 0; k < input.size(); k++) {
-      cpu_input[i * input_active_in * 2 + k] = input[k];
-      int32_t index = -1;
-      for (int j = 0; j < input_copy.size(); j++) {
-        if (input_copy[j] == input[k]) {
-          index = j;
-          break;
-        }
+    std::stable_sort(pairs.begin(), pairs.end(),
+                     [](const std::pair<float, float> &a,
+                        const std::pair<float, float> &b) {
+                       return a.first < b.first;
+                     });
+    for (int k = 0; k < pairs.size(); k++) {
+      if (k > 0 && pairs[k].first == pairs[k - 1].first) {
+        pairs[k].second = pairs[k - 1].second;
       }
-      cpu_input[i * input_active_in * 2 + input_active_in + k] = output[index];
+      input[k] = pairs[k].first;
+      output[k] = pairs[k].second;
     }
-    input.clear();
-    output.clear();
-    input_copy.clear();
   }
 }
 
@@ -179,15 +178,6 @@ void GetIndicePairsExecutor::cpuCompute() {
   int *cpu_indice_out = (int *)cpu_fp32_output_[0];
   int *cpu_indice_pairs = (int *)cpu_fp32_output_[1];
   int *cpu_indice_num = (int *)cpu_fp32_output_[2];
-  int32_t grid_out_size = batch_;
-  for (int i = 0; i < (dimNb_ - 2); i++) {
-    grid_out_size = grid_out_size * output_space_[i];
-  }
-  int *cpu_grid_out =
-      (int *)cpu_runtime_.allocate((uint64_t)sizeof(int) * grid_out_size);
-  for (int32_t i = 0; i < grid_out_size; i++) {
-    cpu_grid_out[i] = -1;
-  }
   int32_t indice_pairs_size = mluOpGetTensorElementNum(indice_pairs_desc_);
   for (int i = 0; i < indice_pairs_size; i++) {
     cpu_indice_pairs[i] = -1;
@@ -202,8 +192,9 @@ void GetIndicePairsExecutor::cpuCompute() {
   }
 
   VLOG(4) << "call cpuGetIndicePairs()";
-  cpuGetIndicePairs(cpu_indice_in, cpu_indice_pairs, cpu_indice_out,
-                    cpu_indice_num, cpu_grid_out, indice_in_desc_,
+  cpuGetIndicePairs(cpu_indice_in, indice_in_desc_->getDimIndex(0),
+                    cpu_indice_pairs, cpu_indice_out,
+                    indice_out_desc_->getDimIndex(0), cpu_indice_num,
                     filter_space_, pad_, stride_, dilation_, output_space_,
                     dimNb_, sub_m_, batch_);
 
@@ -226,185 +217,10 @@ void GetIndicePairsExecutor::cpuCompute() {
   memcpy(cpu_indice_out, cpu_result32, indice_out_size * sizeof(float));
 
   cpu_runtime_.deallocate(cpu_result32);
-  cpu_runtime_.deallocate(cpu_grid_out);
   cpu_runtime_.deallocate(input_host_);
   return;
 }
 
-int32_t GetIndicePairsExecutor::getValidOutPos(
-    int32_t *input_pos, std::vector<int32_t> kernel_size,
-    std::vector<int32_t> pad, std::vector<int32_t> stride,
-    std::vector<int32_t> dilation, std::vector<int32_t> out_spatail_shape,
-    int32_t *out, int32_t NDim) {
-  int32_t lowers[NDim];
-  int32_t uppers[NDim];
-  int32_t counter[NDim];
-  int32_t counter_size[NDim];
-  int32_t point_counter = 0;
-  int32_t val;
-  int32_t num_points = 1;
-  int32_t m, offset;
-  bool valid = false;
-  for (int i = 0; i < NDim; ++i) {
-    lowers[i] = (input_pos[i] - (kernel_size[i] - 1) * dilation[i] - 1 +
-                 stride[i] + pad[i]) /
-                stride[i];
-    uppers[i] = (input_pos[i] + pad[i]) / stride[i];
-  }
-  for (int i = 0; i < NDim; ++i) {
-    counter_size[i] = ((uppers[i] - lowers[i]) / dilation[i] + 1);
-    num_points *= counter_size[i];
-  }
-  for (int i = 0; i < NDim; ++i) {
-    counter[i] = 0;
-  }
-
-  for (int i = 0; i < num_points; ++i) {
-    valid = true;
-    m = 1;
-    offset = 0;
-    for (int j = NDim - 1; j >= 0; --j) {
-      val = uppers[j] - counter[j] * dilation[j];
-      out[point_counter * (NDim + 1) + j] = val;
-      if (val < 0 || val > (out_spatail_shape[j] - 1)) {
-        valid = false;
-      }
-      offset += m * (input_pos[j] - val * stride[j] + pad[j]) / dilation[j];
-      m *= kernel_size[j];
-    }  // NDim
-    out[point_counter * (NDim + 1) + NDim] = offset;
-    if (valid) point_counter++;
-    counter[NDim - 1] += 1;
-    for (int c = NDim - 1; c >= 0; --c) {
-      if (counter[c] == counter_size[c] && c > 0) {
-        counter[c - 1] += 1;
-        counter[c] = 0;
-      }
-    }
-  }  // num_points
-  return point_counter;
-}
-
-void GetIndicePairsExecutor::cpuGetIndicePairs(
-    int32_t *indice_in, int32_t *indice_pairs, int32_t *indice_out,
-    int32_t *indice_num, int32_t *grid_out,
-    const mluOpTensorDescriptor_t indice_in_desc,
-    std::vector<int32_t> kernel_size, std::vector<int32_t> pad,
-    std::vector<int32_t> stride, std::vector<int32_t> dilation,
-    std::vector<int32_t> out_spatail_shape, const int32_t dimNb,
-    const int32_t sub_m, const int32_t batch_size) {
-  int32_t num_act = 0;
-  int32_t num_act_in = indice_in_desc->getDimIndex(0);
-  int32_t batch_idx = 0;
-  int32_t spatail_volume = 1;
-  int32_t NDim = dimNb - 2;
-  for (int i = 0; i < NDim; ++i) {
-    spatail_volume *= out_spatail_shape[i];
-  }
-  int32_t kernel_volume = 1;
-  for (int i = 0; i < NDim; ++i) {
-    kernel_volume *= kernel_size[i];
-  }
-  int32_t num_valid_points = 0;
-  int *valid_points_ =
-      (int *)cpu_runtime_.allocate(kernel_volume * (NDim + 1) * sizeof(int));
-  int *indicePairUnqie =
-      (int *)cpu_runtime_.allocate(kernel_volume * num_act_in * sizeof(int));
-  int32_t *point_ptr = nullptr;
-  int32_t index = 0;
-  int32_t output_space_size = batch_size * spatail_volume + 1;
-  for (int i = 0; i < kernel_volume * num_act_in; i++) {
-    indicePairUnqie[i] = output_space_size;
-  }
-
-  auto getIndex = [](int32_t *indice_in_temp, std::vector<int32_t> kernel_size,
-                     int32_t NDim) -> int32_t {
-    int32_t index_return = 0;
-    int32_t size_temp = 1;
-    for (int k = NDim - 1; k >= 0; --k) {
-      index_return += indice_in_temp[k] * size_temp;
-      size_temp *= kernel_size[k];
-    }
-    return index_return;
-  };
-
-  if (sub_m) {
-    // prepareSubmGridKernel
-    for (int j = 0; j < num_act_in; ++j) {
-      index =
-          getIndex(indice_in + j * (NDim + 1) + 1, out_spatail_shape, NDim) +
-          spatail_volume * ((indice_in + j * (NDim + 1))[0]);
-      grid_out[index] = j;
-    }
-    for (int j = 0; j < num_act_in * (NDim + 1); j++) {
-      indice_out[j] = indice_in[j];
-    }
-  }
-
-  for (int j = 0; j < num_act_in; ++j) {
-    int32_t batchIdx = (indice_in + j * (NDim + 1))[0];
-    num_valid_points =
-        getValidOutPos(indice_in + j * (NDim + 1) + 1, kernel_size, pad, stride,
-                       dilation, out_spatail_shape, valid_points_, NDim);
-    for (int i = 0; i < num_valid_points; ++i) {
-      point_ptr = valid_points_ + i * (NDim + 1);
-      int32_t offset = point_ptr[NDim];  // filter_index
-      index = getIndex(point_ptr, out_spatail_shape, NDim) +
-              spatail_volume * batchIdx;
-      if (sub_m) {
-        if (grid_out[index] > -1) {
-          int32_t  oldNum = indice_num[offset];
-          indice_num[offset]++;
-          indice_pairs[offset * 2 * num_act_in + oldNum] = j;
-          indice_pairs[offset * 2 * num_act_in + num_act_in +
-                       oldNum] = grid_out[index];
-        }
-      } else {
-        int32_t oldNum = indice_num[offset];
-        indice_num[offset]++;
-        indice_pairs[offset * 2 * num_act_in + oldNum] = j;
-        indice_pairs[offset * 2 * num_act_in + num_act_in + oldNum] = index;
-        indicePairUnqie[offset * num_act_in + oldNum] = index;
-      }  //  sub_m
-    }    // num_valid_points
-  }      //  num_act_in(L)
-
-  if (!sub_m) {
-    std::vector<int> indice_unique;
-    for (int i = 0; i < kernel_volume * num_act_in; i++) {
-      indice_unique.push_back(indicePairUnqie[i]);
-    }
-    sort(indice_unique.begin(), indice_unique.end());
-    auto num_act = unique(indice_unique.begin(), indice_unique.end());
-    indice_unique.erase(num_act, indice_unique.end());
-    auto num_act_out = indice_unique.size() - 1;
-    for (int j = 0; j < num_act_out; ++j) {
-      index = indice_unique[j];
-      grid_out[index] = j;
-      indice_out[j * (NDim + 1)] = index / spatail_volume;  //  n
-      index -= indice_out[j * (NDim + 1)] * spatail_volume;
-      indice_out[j * (NDim + 1) + 1] =
-          index / (out_spatail_shape[2] * out_spatail_shape[1]);  //  d
-      index -= indice_out[j * (NDim + 1) + 1] *
-               (out_spatail_shape[2] * out_spatail_shape[1]);
-      indice_out[j * (NDim + 1) + 2] = index / out_spatail_shape[2];  //  h
-      index -= indice_out[j * (NDim + 1) + 2] * out_spatail_shape[2];
-      indice_out[j * (NDim + 1) + 3] = index;  //  w
-    }
-
-    for (int j = 0; j < num_act_in; ++j) {
-      for (int k = 0; k < kernel_volume; k++) {
-        index = indice_pairs[k * 2 * num_act_in + num_act_in + j];
-        if (index > -1) {
-          indice_pairs[k * 2 * num_act_in + num_act_in + j] = grid_out[index];
-        }
-      }
-    }
-  }  //  !sub_m
-  cpu_runtime_.deallocate(valid_points_);
-  cpu_runtime_.deallocate(indicePairUnqie);
-}
-
 int64_t GetIndicePairsExecutor::getTheoryOps() {
   int64_t kernel_volume = indice_pairs_desc_->getDimIndex(0);
   int64_t active_input_in = indice_pairs_desc_->getDimIndex(2);
@@ -48,18 +48,6 @@ class GetIndicePairsExecutor : public Executor {
 
  private:
   void initParam();
-  void cpuGetIndicePairs(
-      int32_t *indice_in, int32_t *indice_pairs, int32_t *indice_out,
-      int32_t *indice_num, int32_t *grid_out,
-      mluOpTensorDescriptor_t indice_in_desc, std::vector<int32_t> kernel_size,
-      std::vector<int32_t> pad, std::vector<int32_t> stride,
-      std::vector<int32_t> dilation, std::vector<int32_t> out_spatail_shape,
-      const int32_t dimNb, const int32_t sub_m, const int32_t batch_size);
-  int32_t getValidOutPos(int32_t *input_pos, std::vector<int32_t> kernel_size,
-                         std::vector<int32_t> pad, std::vector<int32_t> stride,
-                         std::vector<int32_t> dilation,
-                         std::vector<int32_t> out_spatail_shape, int32_t *out,
-                         int NDim);
   int32_t dimNb_;
   int32_t batch_;
   int32_t sub_m_;
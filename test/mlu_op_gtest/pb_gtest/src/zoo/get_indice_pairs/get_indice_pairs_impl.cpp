@@ -0,0 +1,242 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+
+#include "get_indice_pairs_impl.h"
+#include <algorithm>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "gtest/gtest.h"
+#include "check_tools.h"
+#include "coord_hash.h"
+
+namespace mluoptest {
+
+int32_t getValidOutPos(
+    const int32_t *input_pos, const std::vector<int32_t> &kernel_size,
+    const std::vector<int32_t> &pad, const std::vector<int32_t> &stride,
+    const std::vector<int32_t> &dilation,
+    const std::vector<int32_t> &out_spatail_shape, int32_t *out,
+    int32_t NDim) {
+  int32_t lowers[NDim];
+  int32_t uppers[NDim];
+  int32_t counter[NDim];
+  int32_t counter_size[NDim];
+  int32_t point_counter = 0;
+  int32_t val;
+  int32_t num_points = 1;
+  int32_t m, offset;
+  bool valid = false;
+  for (int i = 0; i < NDim; ++i) {
+    lowers[i] = (input_pos[i] - (kernel_size[i] - 1) * dilation[i] - 1 +
+                 stride[i] + pad[i]) /
+                stride[i];
+    uppers[i] = (input_pos[i] + pad[i]) / stride[i];
+  }
+  for (int i = 0; i < NDim; ++i) {
+    counter_size[i] = ((uppers[i] - lowers[i]) / dilation[i] + 1);
+    num_points *= counter_size[i];
+  }
+  for (int i = 0; i < NDim; ++i) {
+    counter[i] = 0;
+  }
+
+  for (int i = 0; i < num_points; ++i) {
+    valid = true;
+    m = 1;
+    offset = 0;
+    for (int j = NDim - 1; j >= 0; --j) {
+      val = uppers[j] - counter[j] * dilation[j];
+      out[point_counter * (NDim + 1) + j] = val;
+      if (val < 0 || val > (out_spatail_shape[j] - 1)) {
+        valid = false;
+      }
+      offset += m * (input_pos[j] - val * stride[j] + pad[j]) / dilation[j];
+      m *= kernel_size[j];
+    }  // NDim
+    out[point_counter * (NDim + 1) + NDim] = offset;
+    if (valid) point_counter++;
+    counter[NDim - 1] += 1;
+    for (int c = NDim - 1; c >= 0; --c) {
+      if (counter[c] == counter_size[c] && c > 0) {
+        counter[c - 1] += 1;
+        counter[c] = 0;
+      }
+    }
+  }  // num_points
+  return point_counter;
+}
+
+void cpuGetIndicePairs(
+    const int32_t *indice_in, int32_t num_act_in, int32_t *indice_pairs,
+    int32_t *indice_out, int64_t max_act_out, int32_t *indice_num,
+    const std::vector<int32_t> &kernel_size, const std::vector<int32_t> &pad,
+    const std::vector<int32_t> &stride, const std::vector<int32_t> &dilation,
+    const std::vector<int32_t> &out_spatail_shape, const int32_t dimNb,
+    const int32_t sub_m, const int32_t batch_size) {
+  int32_t NDim = dimNb - 2;
+  int64_t spatail_volume = 1;
+  for (int i = 0; i < NDim; ++i) {
+    spatail_volume *= out_spatail_shape[i];
+  }
+  int32_t kernel_volume = 1;
+  for (int i = 0; i < NDim; ++i) {
+    kernel_volume *= kernel_size[i];
+  }
+
+  // output sites are keyed by their packed (batch, z, y, x), so the grid
+  // costs O(active sites) instead of O(batch * output space).
+  auto getIndex = [&](const int32_t *pos, int32_t batch_idx) -> int64_t {
+    int64_t index_return = 0;
+    int64_t size_temp = 1;
+    for (int k = NDim - 1; k >= 0; --k) {
+      index_return += pos[k] * size_temp;
+      size_temp *= out_spatail_shape[k];
+    }
+    return index_return + spatail_volume * batch_idx;
+  };
+  CoordHash grid_out(num_act_in);
+
+  if (sub_m) {
+    // prepareSubmGridKernel
+    for (int j = 0; j < num_act_in; ++j) {
+      const int32_t *site = indice_in + (int64_t)j * (NDim + 1);
+      grid_out.set(getIndex(site + 1, site[0]), j);
+    }
+    for (int64_t j = 0; j < (int64_t)num_act_in * (NDim + 1); j++) {
+      indice_out[j] = indice_in[j];
+    }
+  }
+
+  // the pairs of a kernel offset are in the order of the input sites, so the
+  // inputs are split into contiguous chunks that collect their pairs, then
+  // each chunk copies its pairs of an offset behind those of earlier chunks.
+  int32_t chunks = 1;
+#ifdef _OPENMP
+  chunks = omp_get_max_threads() * 4;
+#endif
+  chunks = std::max(1, std::min(chunks, num_act_in));
+  std::vector<int32_t> chunk_num((size_t)chunks * kernel_volume, 0);
+  std::vector<std::vector<int32_t>> chunk_pairs(chunks);  // offset, in, out
+  // !sub_m: the packed output key may not fit int32 (batch * output space
+  // over INT32_MAX), it is kept here until output sites are numbered.
+  std::vector<std::vector<int64_t>> chunk_keys(chunks);
+#pragma omp parallel for schedule(dynamic)
+  for (int32_t c = 0; c < chunks; ++c) {
+    std::vector<int32_t> valid_points(kernel_volume * (NDim + 1));
+    int32_t *num = chunk_num.data() + (size_t)c * kernel_volume;
+    int32_t begin = (int64_t)num_act_in * c / chunks;
+    int32_t end = (int64_t)num_act_in * (c + 1) / chunks;
+    for (int32_t j = begin; j < end; ++j) {
+      const int32_t *site = indice_in + (int64_t)j * (NDim + 1);
+      int32_t num_valid_points =
+          getValidOutPos(site + 1, kernel_size, pad, stride, dilation,
+                         out_spatail_shape, valid_points.data(), NDim);
+      for (int i = 0; i < num_valid_points; ++i) {
+        const int32_t *point_ptr = valid_points.data() + i * (NDim + 1);
+        int32_t offset = point_ptr[NDim];  // filter_index
+        int64_t index = getIndex(point_ptr, site[0]);
+        int32_t out = 0;
+        if (sub_m) {
+          const int32_t *found = grid_out.find(index);
+          if (found == nullptr) {
+            continue;
+          }
+          out = *found;
+        } else {
+          chunk_keys[c].push_back(index);
+        }
+        chunk_pairs[c].insert(chunk_pairs[c].end(), {offset, j, out});
+        num[offset]++;
+      }  // num_valid_points
+    }    // chunk of num_act_in(L)
+  }
+  for (int32_t k = 0; k < kernel_volume; ++k) {
+    for (int32_t c = 0; c < chunks; ++c) {
+      int32_t count = chunk_num[(size_t)c * kernel_volume + k];
+      chunk_num[(size_t)c * kernel_volume + k] = indice_num[k];
+      indice_num[k] += count;
+    }
+  }
+  // same layout as the output half of indice_pairs.
+  std::vector<int64_t> pairs_key(sub_m ? 0
+                                       : (size_t)kernel_volume * num_act_in);
+#pragma omp parallel for schedule(dynamic)
+  for (int32_t c = 0; c < chunks; ++c) {
+    int32_t *num = chunk_num.data() + (size_t)c * kernel_volume;
+    for (size_t i = 0; i < chunk_pairs[c].size(); i += 3) {
+      int32_t offset = chunk_pairs[c][i];
+      int32_t *pairs = indice_pairs + (int64_t)offset * 2 * num_act_in;
+      pairs[num[offset]] = chunk_pairs[c][i + 1];
+      if (sub_m) {
+        pairs[num_act_in + num[offset]] = chunk_pairs[c][i + 2];
+      } else {
+        pairs_key[(size_t)offset * num_act_in + num[offset]] =
+            chunk_keys[c][i / 3];
+      }
+      num[offset]++;
+    }
+    std::vector<int32_t>().swap(chunk_pairs[c]);
+    std::vector<int64_t>().swap(chunk_keys[c]);
+  }
+
+  if (!sub_m) {
+    // output sites are numbered in ascending order of their packed
+    // coordinate.
+    for (int32_t k = 0; k < kernel_volume; ++k) {
+      const int64_t *keys = pairs_key.data() + (size_t)k * num_act_in;
+      for (int32_t i = 0; i < indice_num[k]; ++i) {
+        grid_out.insert(keys[i], 0);
+      }
+    }
+    std::vector<int64_t> indice_unique = grid_out.keys();
+    std::sort(indice_unique.begin(), indice_unique.end());
+    int64_t num_act_out = indice_unique.size();
+    GTEST_CHECK(num_act_out <= max_act_out,
+                "get_indice_pairs: ", num_act_out,
+                " output sites overflow indice_out.");
+#pragma omp parallel for schedule(static)
+    for (int64_t j = 0; j < num_act_out; ++j) {
+      int64_t index = indice_unique[j];
+      *grid_out.find(index) = j;
+      int32_t *out = indice_out + j * (NDim + 1);
+      for (int k = NDim - 1; k >= 0; --k) {  //  w, h, d
+        out[k + 1] = index % out_spatail_shape[k];
+        index /= out_spatail_shape[k];
+      }
+      out[0] = index;  //  n
+    }
+#pragma omp parallel for schedule(dynamic)
+    for (int32_t k = 0; k < kernel_volume; k++) {
+      int32_t *pairs_out =
+          indice_pairs + (int64_t)k * 2 * num_act_in + num_act_in;
+      const int64_t *keys = pairs_key.data() + (size_t)k * num_act_in;
+      for (int32_t i = 0; i < indice_num[k]; ++i) {
+        pairs_out[i] = *grid_out.find(keys[i]);
+      }
+    }
+  }  //  !sub_m
+}
+
+}  // namespace mluoptest
@@ -0,0 +1,50 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_SRC_ZOO_GET_INDICE_PAIRS_GET_INDICE_PAIRS_IMPL_H_
+#define TEST_MLU_OP_GTEST_SRC_ZOO_GET_INDICE_PAIRS_GET_INDICE_PAIRS_IMPL_H_
+#include <cstdint>
+#include <vector>
+
+namespace mluoptest {
+// output sites of NDim input_pos reaches, each is NDim coordinates then the
+// kernel offset, returns their number.
+int32_t getValidOutPos(const int32_t *input_pos,
+                       const std::vector<int32_t> &kernel_size,
+                       const std::vector<int32_t> &pad,
+                       const std::vector<int32_t> &stride,
+                       const std::vector<int32_t> &dilation,
+                       const std::vector<int32_t> &out_spatail_shape,
+                       int32_t *out, int NDim);
+
+// rulebook of a sparse convolution, dimNb - 2 spatial dims. indice_pairs,
+// indice_out and indice_num are filled with -1, -1 and 0 by the caller.
+// indice_out holds at most max_act_out sites.
+void cpuGetIndicePairs(
+    const int32_t *indice_in, int32_t num_act_in, int32_t *indice_pairs,
+    int32_t *indice_out, int64_t max_act_out, int32_t *indice_num,
+    const std::vector<int32_t> &kernel_size, const std::vector<int32_t> &pad,
+    const std::vector<int32_t> &stride, const std::vector<int32_t> &dilation,
+    const std::vector<int32_t> &out_spatail_shape, const int32_t dimNb,
+    const int32_t sub_m, const int32_t batch_size);
+}  // namespace mluoptest
+#endif  // TEST_MLU_OP_GTEST_SRC_ZOO_GET_INDICE_PAIRS_GET_INDICE_PAIRS_IMPL_H_
@@ -22,9 +22,11 @@
  *************************************************************************/
 #include "indice_convolution_backward_data.h"
 
+#include <algorithm>
 #include <vector>
 
 #include "test/mlu_op_gtest/include/tools.h"
+#include "cpu_gemm.h"
 
 namespace mluoptest {
 
@@ -298,40 +300,59 @@ void IndiceConvolutionBackwardDataExecutor::cpuCompute() {
     input_grad[i] = 0;
   }
   // main loop: filter_transpose K in [K, dxc, dyc]
+  std::vector<float> gathered;
+  std::vector<float> products;
   for (int kk = 0; kk < K; ++kk) {
     int filter_offset = kk * dxc * dyc;
     int index_num = (int)(indice_num_[kk]);
     GTEST_CHECK(L >= index_num);
+    float *sub_filter = filter_transpose_cpu + filter_offset;
+    if (is_float) {
+      // gather the output_grad rows, multiply them with sub_filter^T in one
+      // gemm, and scatter-add the products to input_grad.
+      gathered.resize((size_t)index_num * dyc);
+      products.resize((size_t)index_num * dxc);
+      for (int l = 0; l < index_num; ++l) {
+        int output_idx = indice_pairs[kk * 2 * L + L + l];
+        std::copy(output_grad + output_idx * dyc,
+                  output_grad + (output_idx + 1) * dyc,
+                  gathered.begin() + (size_t)l * dyc);
+      }
+      cpuGemm(false, true, index_num, dxc, dyc, 1.0f, gathered.data(), dyc,
+              sub_filter, dyc, 0.0f, products.data(), dxc);
+      for (int l = 0; l < index_num; ++l) {
+        int input_idx = indice_pairs[kk * 2 * L + l];
+        float *input_slice = input_grad + input_idx * dxc;
+        for (int dxc_i = 0; dxc_i < dxc; ++dxc_i) {
+          input_slice[dxc_i] += products[(size_t)l * dxc + dxc_i];
+        }
+      }
+      continue;
+    }
     for (int l = 0; l < index_num; ++l) {  // index_pair data loop
       int input_idx = indice_pairs[kk * 2 * L + l];
       int output_idx = indice_pairs[kk * 2 * L + L + l];
-      float *sub_filter = filter_transpose_cpu + filter_offset;
       float *input_slice = input_grad + input_idx * dxc;
       float *output_slice = output_grad + output_idx * dyc;
       for (int dxc_i = 0; dxc_i < dxc; ++dxc_i) {
         float *input_grad_result = input_slice + dxc_i;
         float input_grad_accumulate = 0;
         for (int dyc_i = 0; dyc_i < dyc; ++dyc_i) {
-          float input_grad_tmp = 0;
+          // half, round every step like the mlu does.
           float output_grad_tmp = output_slice[dyc_i];
           float filter_tmp = sub_filter[dxc_i * dyc + dyc_i];
-          if (is_float) {
-            input_grad_tmp = output_grad_tmp * filter_tmp;
-            input_grad_accumulate += input_grad_tmp;
-          } else {
-            // half
-            uint16_t temp;
-            wrapRtConvertFloatToHalf(&temp, output_grad_tmp);
-            wrapRtConvertHalfToFloat(&output_grad_tmp, temp);
-            wrapRtConvertFloatToHalf(&temp, filter_tmp);
-            wrapRtConvertHalfToFloat(&filter_tmp, temp);
-            input_grad_tmp = output_grad_tmp * filter_tmp;
-            wrapRtConvertFloatToHalf(&temp, input_grad_tmp);
-            wrapRtConvertHalfToFloat(&input_grad_tmp, temp);
-            input_grad_accumulate += input_grad_tmp;
-            wrapRtConvertFloatToHalf(&temp, input_grad_accumulate);
-            wrapRtConvertHalfToFloat(&input_grad_accumulate, temp);
-          }
+          float input_grad_tmp = 0;
+          uint16_t temp;
+          wrapRtConvertFloatToHalf(&temp, output_grad_tmp);
+          wrapRtConvertHalfToFloat(&output_grad_tmp, temp);
+          wrapRtConvertFloatToHalf(&temp, filter_tmp);
+          wrapRtConvertHalfToFloat(&filter_tmp, temp);
+          input_grad_tmp = output_grad_tmp * filter_tmp;
+          wrapRtConvertFloatToHalf(&temp, input_grad_tmp);
+          wrapRtConvertHalfToFloat(&input_grad_tmp, temp);
+          input_grad_accumulate += input_grad_tmp;
+          wrapRtConvertFloatToHalf(&temp, input_grad_accumulate);
+          wrapRtConvertHalfToFloat(&input_grad_accumulate, temp);
         }
         *input_grad_result += input_grad_accumulate;
       }
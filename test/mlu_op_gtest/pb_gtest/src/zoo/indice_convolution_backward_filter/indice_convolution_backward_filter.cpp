@@ -21,10 +21,12 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *************************************************************************/
 #include "indice_convolution_backward_filter.h"
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <set>
 #include "mlu_op.h"
+#include "cpu_gemm.h"
 
 namespace mluoptest {
 
@@ -143,29 +145,29 @@ void IndiceConvolutionBackwardFilterExecutor::cpuCompute() {
   int64_t kw = mluOpGetTensordimH(diffw_desc_);
   int64_t kernel_volume = kd * kh * kw;
 
-  for (int64_t kd_index = 0; kd_index < kd; ++kd_index) {
-    for (int64_t kh_index = 0; kh_index < kh; ++kh_index) {
-      for (int64_t kw_index = 0; kw_index < kw; ++kw_index) {
-        int64_t kernel_index = kd_index * kh * kw + kh_index * kw + kw_index;
-        for (int64_t ci_index = 0; ci_index < ci; ++ci_index) {
-          for (int64_t co_index = 0; co_index < co; ++co_index) {
-            float temp_res = 0.0;
-            for (int64_t indice_i = 0; indice_i < indice_num_[kernel_index];
-                 ++indice_i) {
-              int64_t input_pos =
-                  indice_pair[kernel_index * 2 * in_active_num + indice_i];
-              int64_t diffy_pos = indice_pair[kernel_index * 2 * in_active_num +
-                                              1 * in_active_num + indice_i];
-              temp_res += input_indices[input_pos * ci + ci_index] *
-                          diffy_indices[diffy_pos * co + co_index];
-            }
-
-            temp_diffw[kernel_index * ci * co + ci_index * co + co_index] =
-                temp_res;
-          }
-        }
-      }
+  // diffw[k] = input[k]^T * diffy[k], where input[k] and diffy[k] are the
+  // rows gathered by the k-th indice pairs.
+  std::vector<float> input_rows;
+  std::vector<float> diffy_rows;
+  for (int64_t kernel_index = 0; kernel_index < kernel_volume;
+       ++kernel_index) {
+    const int64_t num = indice_num_[kernel_index];
+    const int32_t *pairs = indice_pair + kernel_index * 2 * in_active_num;
+    input_rows.resize(num * ci);
+    diffy_rows.resize(num * co);
+    for (int64_t indice_i = 0; indice_i < num; ++indice_i) {
+      int64_t input_pos = pairs[indice_i];
+      int64_t diffy_pos = pairs[in_active_num + indice_i];
+      std::copy(input_indices + input_pos * ci,
+                input_indices + (input_pos + 1) * ci,
+                input_rows.begin() + indice_i * ci);
+      std::copy(diffy_indices + diffy_pos * co,
+                diffy_indices + (diffy_pos + 1) * co,
+                diffy_rows.begin() + indice_i * co);
     }
+    cpuGemm(true, false, ci, co, num, 1.0f, input_rows.data(), ci,
+            diffy_rows.data(), co, 0.0f, temp_diffw + kernel_index * ci * co,
+            co);
   }
   // trans
   if (diffw_trans_) {
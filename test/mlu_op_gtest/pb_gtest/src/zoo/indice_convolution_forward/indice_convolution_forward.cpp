@@ -21,7 +21,9 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *************************************************************************/
 #include "indice_convolution_forward.h"
+#include <vector>
 #include "mlu_op.h"
+#include "cpu_gemm.h"
 
 namespace mluoptest {
 
@@ -145,27 +147,33 @@ void IndiceConvolutionForwardExecutor::cpuCompute() {
          mluOpDataTypeBytes(features_out_desc_->getDtype()) *
              features_out_data_count);
 
-  for (int64_t kdi = 0; kdi < kd; ++kdi) {
-    for (int64_t khi = 0; khi < kh; ++khi) {
-      for (int64_t kwi = 0; kwi < kw; ++kwi) {
-        int64_t filters_index = kdi * kh * kw + khi * kw + kwi;
-        for (int64_t ipi = 0; ipi < indice_num_[filters_index]; ++ipi) {
-          int64_t input_offset =
-              indice_pairs[filters_index * 2 * num_active_in + ipi];
-          int64_t output_offset =
-              indice_pairs[filters_index * 2 * num_active_in + num_active_in +
-                           ipi];
-          if (output_offset < 0 || input_offset < 0) continue;
-          for (int64_t cii = 0; cii < ci; ++cii) {
-            for (int64_t coi = 0; coi < co; ++coi) {
-              float temp_res = 0.0;
-              temp_res +=
-                  features[input_offset * ci + cii] *
-                  filters_transed[filters_index * ci * co + cii * co + coi];
-              features_out[output_offset * co + coi] += temp_res;
-            }
-          }
-        }
+  // for each filter position, gather the active input rows, multiply them
+  // with the ci x co filter in one gemm, and scatter-add the products.
+  std::vector<float> gathered;
+  std::vector<float> products;
+  std::vector<int64_t> output_rows;
+  for (int64_t filters_index = 0; filters_index < num_filters;
+       ++filters_index) {
+    const int32_t *pairs = indice_pairs + filters_index * 2 * num_active_in;
+    gathered.clear();
+    output_rows.clear();
+    for (int64_t ipi = 0; ipi < indice_num_[filters_index]; ++ipi) {
+      int64_t input_offset = pairs[ipi];
+      int64_t output_offset = pairs[num_active_in + ipi];
+      if (output_offset < 0 || input_offset < 0) continue;
+      gathered.insert(gathered.end(), features + input_offset * ci,
+                      features + (input_offset + 1) * ci);
+      output_rows.push_back(output_offset);
+    }
+    const int64_t rows = output_rows.size();
+    products.resize(rows * co);
+    cpuGemm(false, false, rows, co, ci, 1.0f, gathered.data(), ci,
+            filters_transed + filters_index * ci * co, co, 0.0f,
+            products.data(), co);
+    for (int64_t r = 0; r < rows; ++r) {
+      float *output_row = features_out + output_rows[r] * co;
+      for (int64_t coi = 0; coi < co; ++coi) {
+        output_row[coi] += products[r * co + coi];
       }
     }
   }
@@ -27,116 +27,10 @@
 #include <string>
 #include <vector>
 #include "math.h"
+#include "ms_deform_attn_forward_impl.h"
 
 namespace mluoptest {
 
-float MsDeformAttnForwardExecutor::ms_deform_attn_im2col_bilinear(
-    const float *&bottom_data,
-    const int &height,
-    const int &width,
-    const int &nheads,
-    const int &channels,
-    const float &h,
-    const float &w,
-    const int &m,
-    const int &c) {
-  const int h_low = floorf(h);
-  const int w_low = floorf(w);
-  const int h_high = h_low + 1;
-  const int w_high = w_low + 1;  const float lh = h - h_low;
-  const float lw = w - w_low;
-  const float hh = 1 - lh, hw = 1 - lw;
-  const int w_stride = nheads * channels;
-  const int h_stride = width * w_stride;
-  const int h_low_ptr_offset = h_low * h_stride;
-  const int h_high_ptr_offset = h_low_ptr_offset + h_stride;
-  const int w_low_ptr_offset = w_low * w_stride;
-  const int w_high_ptr_offset = w_low_ptr_offset + w_stride;
-  const int base_ptr = m * channels + c;
-  float v1 = 0;
-  if (h_low >= 0 && w_low >= 0) {
-    const int ptr1 = h_low_ptr_offset + w_low_ptr_offset + base_ptr;
-    v1 = bottom_data[ptr1];
-  }
-  float v2 = 0;
-  if (h_low >= 0 && w_high <= width - 1) {
-    const int ptr2 = h_low_ptr_offset + w_high_ptr_offset + base_ptr;
-    v2 = bottom_data[ptr2];
-  }
-  float v3 = 0;
-  if (h_high <= height - 1 && w_low >= 0) {
-    const int ptr3 = h_high_ptr_offset + w_low_ptr_offset + base_ptr;
-    v3 = bottom_data[ptr3];
-  }
-  float v4 = 0;
-  if (h_high <= height - 1 && w_high <= width - 1) {
-    const int ptr4 = h_high_ptr_offset + w_high_ptr_offset + base_ptr;
-    v4 = bottom_data[ptr4];
-  }
-  const float w1 = hh * hw, w2 = hh * lw, w3 = lh * hw, w4 = lh * lw;
-  const float val = (w1 * v1 + w2 * v2 + w3 * v3 + w4 * v4);
-  return val;
-}
-
-void MsDeformAttnForwardExecutor::cpuMsDeformAttnForward(
-    const float *data_value,
-    const float *data_spatial_shapes,
-    const float *data_level_start_index,
-    const float *data_sampling_loc,
-    const float *data_attn_weight,
-    const int batch_size,
-    const int num_keys,
-    const int num_heads,
-    const int channels,
-    const int num_levels,
-    const int num_query,
-    const int num_point,
-    float *data_col) {
-  const int n = batch_size * num_query * num_heads * channels;
-  for (int index = 0; index < n; ++index) {
-    int _temp = index;
-    const int c_col = _temp % channels;
-    _temp /= channels;
-    const int sampling_index = _temp;
-    const int m_col = _temp % num_heads;
-    _temp /= num_heads;
-    _temp /= num_query;
-    const int b_col = _temp;
-    float *data_col_ptr = data_col + index;
-    int data_weight_ptr = sampling_index * num_levels * num_point;
-    int data_loc_w_ptr = data_weight_ptr << 1;
-    const int qid_stride = num_heads * channels;
-    const int data_value_ptr_init_offset = b_col * num_keys * qid_stride;
-    float col = 0;
-    for (int l_col = 0; l_col < num_levels; ++l_col) {
-      const int level_start_id = data_level_start_index[l_col];
-      const int spatial_h_ptr = l_col << 1;
-      const int spatial_h = data_spatial_shapes[spatial_h_ptr];
-      const int spatial_w = data_spatial_shapes[spatial_h_ptr + 1];
-      const float *data_value_ptr =
-          data_value +
-          (data_value_ptr_init_offset + level_start_id * qid_stride);
-      for (int p_col = 0; p_col < num_point; ++p_col) {
-        const float loc_w = data_sampling_loc[data_loc_w_ptr];
-        const float loc_h = data_sampling_loc[data_loc_w_ptr + 1];
-        const float weight = data_attn_weight[data_weight_ptr];
-        const float h_im = loc_h * spatial_h - 0.5;
-        const float w_im = loc_w * spatial_w - 0.5;
-        if (h_im > -1 && w_im > -1 && h_im < spatial_h && w_im < spatial_w) {
-          col += ms_deform_attn_im2col_bilinear(
-                     data_value_ptr, spatial_h, spatial_w, num_heads,
-                     channels, h_im, w_im, m_col, c_col) *
-                 weight;
-        }
-        data_weight_ptr += 1;
-        data_loc_w_ptr += 2;
-      }
-    }
-    *data_col_ptr = col;
-  }
-  return;
-}
-
 void MsDeformAttnForwardExecutor::paramCheck() {
   GTEST_CHECK(parser_->getInputNum() == 5,
               "[GTEST_MSDEFORMATTN_FORWARD] Input num must be 5.");
@@ -197,7 +91,7 @@ void MsDeformAttnForwardExecutor::cpuCompute() {
   auto data_sampling_loc = cpu_fp32_input_[3];
   auto data_attn_weight = cpu_fp32_input_[4];
   auto data_col = cpu_fp32_output_[0];
-  cpuMsDeformAttnForward(
+  msDeformAttnForwardCpu(
       data_value, data_spatial_shapes, data_level_start_index,
       data_sampling_loc, data_attn_weight, batch_size, num_keys, num_heads,
       channels, num_levels, num_query, num_point, data_col);
@@ -34,17 +34,6 @@ class MsDeformAttnForwardExecutor : public Executor {
   void cpuCompute();
   int64_t getTheoryIoSize() override;
   int64_t getTheoryOps() override;
- private:
-  float ms_deform_attn_im2col_bilinear(
-      const float *&bottom_data, const int &height, const int &width,
-      const int &nheads, const int &channels, const float &h, const float &w,
-      const int &m, const int &c);
-  void cpuMsDeformAttnForward(
-      const float *data_value, const float *data_spatial_shapes,
-      const float *data_level_start_index, const float *data_sampling_loc,
-      const float *data_attn_weight, const int batch_size, const int num_keys,
-      const int num_heads, const int channels, const int num_levels,
-      const int num_query, const int num_point, float *data_col);
 };
 }  // namespace mluoptest
 
@@ -0,0 +1,88 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "ms_deform_attn_forward_impl.h"
+
+#include <algorithm>
+#include <cstdint>
+#include "bilinear_sample.h"
+
+namespace mluoptest {
+
+void msDeformAttnForwardCpu(
+    const float *data_value,
+    const float *data_spatial_shapes,
+    const float *data_level_start_index,
+    const float *data_sampling_loc,
+    const float *data_attn_weight,
+    const int batch_size,
+    const int num_keys,
+    const int num_heads,
+    const int channels,
+    const int num_levels,
+    const int num_query,
+    const int num_point,
+    float *data_col) {
+  // weights are worked out once per sample point, and the channels of a
+  // head are gathered together.
+  const int n = batch_size * num_query * num_heads;
+  const int qid_stride = num_heads * channels;
+#pragma omp parallel for
+  for (int sampling_index = 0; sampling_index < n; ++sampling_index) {
+    const int m_col = sampling_index % num_heads;
+    const int b_col = sampling_index / num_heads / num_query;
+    float *data_col_ptr = data_col + (int64_t)sampling_index * channels;
+    int data_weight_ptr = sampling_index * num_levels * num_point;
+    int data_loc_w_ptr = data_weight_ptr << 1;
+    const int data_value_ptr_init_offset = b_col * num_keys * qid_stride;
+    std::fill(data_col_ptr, data_col_ptr + channels, 0.0f);
+    for (int l_col = 0; l_col < num_levels; ++l_col) {
+      const int level_start_id = data_level_start_index[l_col];
+      const int spatial_h_ptr = l_col << 1;
+      const int spatial_h = data_spatial_shapes[spatial_h_ptr];
+      const int spatial_w = data_spatial_shapes[spatial_h_ptr + 1];
+      const float *data_value_ptr =
+          data_value +
+          (data_value_ptr_init_offset + level_start_id * qid_stride) +
+          m_col * channels;
+      for (int p_col = 0; p_col < num_point; ++p_col) {
+        const float loc_w = data_sampling_loc[data_loc_w_ptr];
+        const float loc_h = data_sampling_loc[data_loc_w_ptr + 1];
+        const float weight = data_attn_weight[data_weight_ptr];
+        const float h_im = loc_h * spatial_h - 0.5;
+        const float w_im = loc_w * spatial_w - 0.5;
+        if (h_im > -1 && w_im > -1 && h_im < spatial_h && w_im < spatial_w) {
+          BilinearSample sample;
+          bilinearSampleZeroPad(spatial_h, spatial_w, qid_stride, h_im, w_im,
+                                &sample);
+          bilinearGatherAdd(data_value_ptr, sample, channels, weight,
+                            data_col_ptr);
+        }
+        data_weight_ptr += 1;
+        data_loc_w_ptr += 2;
+      }
+    }
+  }
+  return;
+}
+
+}  // namespace mluoptest
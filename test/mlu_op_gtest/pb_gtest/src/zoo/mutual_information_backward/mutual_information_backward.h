@@ -57,6 +57,9 @@ class MutualInformationBackwardExecutor : public Executor {
   void compute() override;
   void cpuCompute() override;
   void setMiscellaneousParam() override;
+  // theory ops are counted by cpuCompute(), which a cache hit skips, and
+  // cpuCompute() frees ans_grad_in_.
+  bool baselineCacheable() override { return false; }
   int64_t getTheoryOps() override;
 
  private:
@@ -58,6 +58,9 @@ class MutualInformationForwardExecutor : public Executor {
   void compute() override;
   void cpuCompute() override;
   void setMiscellaneousParam() override;
+  // theory ops are counted by cpuCompute(), which a cache hit skips, and
+  // cpuCompute() frees p_in_.
+  bool baselineCacheable() override { return false; }
   int64_t getTheoryOps() override;
 
  private:
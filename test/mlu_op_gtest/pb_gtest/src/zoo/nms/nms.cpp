@@ -21,10 +21,49 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *************************************************************************/
 #include <sys/time.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 #include "nms.h"
+#include "nms_impl.h"
 #include "mlu_op.h"
 
 namespace mluoptest {
+
+namespace {
+
+// write the kept box index with score and (x1, y1, x2, y2) as output_mode
+// asks, output_box_num is the number of boxes written before it.
+void saveNmsBox(float *output_data, int output_box_num, int keepNum,
+                mluOpNmsOutputMode_t output_mode, int index, float score,
+                float x1, float y1, float x2, float y2, int batch_idx,
+                int class_idx) {
+  if (output_mode == 0) {
+    // save index of max score
+    output_data[output_box_num] = index;
+  } else if (output_mode == 1) {
+    output_data[output_box_num * 5 + 0] = score;
+    output_data[output_box_num * 5 + 1] = x1;
+    output_data[output_box_num * 5 + 2] = y1;
+    output_data[output_box_num * 5 + 3] = x2;
+    output_data[output_box_num * 5 + 4] = y2;
+  } else if (output_mode == 2) {
+    output_data[0 * keepNum + output_box_num] = score;
+    output_data[1 * keepNum + output_box_num] = x1;
+    output_data[2 * keepNum + output_box_num] = y1;
+    output_data[3 * keepNum + output_box_num] = x2;
+    output_data[4 * keepNum + output_box_num] = y2;
+  } else if (output_mode == 3) {
+    output_data[output_box_num * 3 + 0] = batch_idx;
+    output_data[output_box_num * 3 + 1] = class_idx;
+    output_data[output_box_num * 3 + 2] = index;
+  } else {
+    VLOG(4) << "unsupport output mode now.";
+  }
+}
+
+}  // namespace
+
 void NmsExecutor::paramCheck() {
   if (!parser_->getProtoNode()->has_nms_param()) {
     LOG(ERROR) << "mluOpNms: Lose nms_param. ";
@@ -208,25 +247,34 @@ void NmsExecutor::nms3D_detection_cpu(float *output_data, int &output_box_num,
     VLOG(4) << "unsupport data layout now.";
   }
 
-  for (int cur_box = 0; cur_box < input_box_num; cur_box++) {
-    if (score[cur_box] == 0) {
-      continue;
+  if (thresh_iou >= 0) {
+    for (int cur_box : hardNms3DGrid(x1, y1, dx, dy, angle, input_box_num,
+                                     thresh_iou)) {
+      output_data[output_box_num] = cur_box;
+      output_box_num++;
     }
-    output_data[output_box_num] = cur_box;
-    output_box_num++;
-    // params box_a: [x, y, z, dx, dy, dz, heading]
-    box_a[0] = x1[cur_box], box_a[1] = y1[cur_box];
-    box_a[3] = dx[cur_box], box_a[4] = dy[cur_box];
-    box_a[6] = angle[cur_box];
-
-    for (int i = 0; i < input_box_num; i++) {
-      box_b[0] = x1[i], box_b[1] = y1[i];
-      box_b[3] = dx[i], box_b[4] = dy[i];
-      box_b[6] = angle[i];
-      // get IOU
-      float iou = Nms3DUtils::UtilsFunctions::iou_bev(box_a, box_b);
-      if (iou > thresh_iou) {
-        score[i] = 0;
+  } else {
+    // a negative thresh_iou, boxes which don't overlap suppress each other.
+    for (int cur_box = 0; cur_box < input_box_num; cur_box++) {
+      if (score[cur_box] == 0) {
+        continue;
+      }
+      output_data[output_box_num] = cur_box;
+      output_box_num++;
+      // params box_a: [x, y, z, dx, dy, dz, heading]
+      box_a[0] = x1[cur_box], box_a[1] = y1[cur_box];
+      box_a[3] = dx[cur_box], box_a[4] = dy[cur_box];
+      box_a[6] = angle[cur_box];
+
+      for (int i = 0; i < input_box_num; i++) {
+        box_b[0] = x1[i], box_b[1] = y1[i];
+        box_b[3] = dx[i], box_b[4] = dy[i];
+        box_b[6] = angle[i];
+        // get IOU
+        float iou = Nms3DUtils::UtilsFunctions::iou_bev(box_a, box_b);
+        if (iou > thresh_iou) {
+          score[i] = 0;
+        }
       }
     }
   }
@@ -301,28 +349,9 @@ void NmsExecutor::nms_detection_cpu(
     // VLOG(4) << "max_score: " << max_score << "x1: " << max_x1 << "y1: " <<
     // max_y1
     //        << "x2: " << max_x2 << "y2: " << max_y2;
-    if (output_mode == 0) {
-      // save index of max score
-      output_data[output_box_num] = max_index;
-    } else if (output_mode == 1) {
-      output_data[output_box_num * 5 + 0] = max_score;
-      output_data[output_box_num * 5 + 1] = max_x1;
-      output_data[output_box_num * 5 + 2] = max_y1;
-      output_data[output_box_num * 5 + 3] = max_x2;
-      output_data[output_box_num * 5 + 4] = max_y2;
-    } else if (output_mode == 2) {
-      output_data[0 * keepNum + output_box_num] = max_score;
-      output_data[1 * keepNum + output_box_num] = max_x1;
-      output_data[2 * keepNum + output_box_num] = max_y1;
-      output_data[3 * keepNum + output_box_num] = max_x2;
-      output_data[4 * keepNum + output_box_num] = max_y2;
-    } else if (output_mode == 3) {
-      output_data[output_box_num * 3 + 0] = batch_idx;
-      output_data[output_box_num * 3 + 1] = class_idx;
-      output_data[output_box_num * 3 + 2] = max_index;
-    } else {
-      VLOG(4) << "unsupport output mode now.";
-    }
+    saveNmsBox(output_data, output_box_num, keepNum, output_mode, max_index,
+               max_score, max_x1, max_y1, max_x2, max_y2, batch_idx,
+               class_idx);
     output_box_num++;
     score[max_index] = 0;
 
@@ -428,6 +457,60 @@ void NmsExecutor::nms_detection_cpu(
   cpu_runtime_.deallocate(y2);
 }
 
+void NmsExecutor::nms_batch_detection_cpu(
+    float *output_info, int &total_output_boxes_num, float *input_boxes,
+    float *input_conf, int input_batches_num, int input_classes_num,
+    int input_boxes_num, int keepNum, float thresh_iou, float thresh_score,
+    mluOpNmsOutputMode_t output_mode, int input_layout, mluOpNmsAlgo_t algo,
+    float offset, mluOpNmsBoxPointMode_t box_mode,
+    mluOpNmsMethodMode_t method_mode, float soft_nms_sigma) {
+  // hard nms of each batch and class runs in parallel, and the kept boxes
+  // are written in the order of the serial loop.
+  const bool grid_nms =
+      method_mode == 0 && thresh_score >= 0 && thresh_iou >= 0;
+  std::vector<std::vector<int>> keeps;
+  if (grid_nms) {
+    keeps.resize(input_batches_num * input_classes_num);
+#pragma omp parallel for schedule(dynamic)
+    for (int task = 0; task < (int)keeps.size(); ++task) {
+      int batch_idx = task / input_classes_num;
+      keeps[task] = hardNmsGrid(input_boxes + input_boxes_num * 4 * batch_idx,
+                                input_conf + input_boxes_num * task,
+                                input_boxes_num, keepNum, thresh_iou,
+                                thresh_score, input_layout, algo, offset,
+                                box_mode);
+    }
+  }
+  for (int batch_idx = 0; batch_idx < input_batches_num; ++batch_idx) {
+    for (int class_idx = 0; class_idx < input_classes_num; ++class_idx) {
+      int boxes_offset = input_boxes_num * 4 * batch_idx;
+      int conf_offset = input_classes_num * input_boxes_num * batch_idx +
+                        input_boxes_num * class_idx;
+      int output_offset = output_mode == 3 ? 3 * total_output_boxes_num : 0;
+      int output_boxes_num = 0;
+      if (grid_nms) {
+        const float *boxes = input_boxes + boxes_offset;
+        const int stride = input_layout == 0 ? 1 : input_boxes_num;
+        for (int index : keeps[batch_idx * input_classes_num + class_idx]) {
+          const float *box = boxes + (input_layout == 0 ? index * 4 : index);
+          saveNmsBox(output_info + output_offset, output_boxes_num, keepNum,
+                     output_mode, index, input_conf[conf_offset + index],
+                     box[0], box[stride], box[2 * stride], box[3 * stride],
+                     batch_idx, class_idx);
+          output_boxes_num++;
+        }
+      } else {
+        nms_detection_cpu(output_info + output_offset, output_boxes_num,
+                          input_boxes + boxes_offset, input_conf + conf_offset,
+                          input_boxes_num, keepNum, thresh_iou, thresh_score,
+                          output_mode, input_layout, algo, offset, box_mode,
+                          method_mode, soft_nms_sigma, batch_idx, class_idx);
+      }
+      total_output_boxes_num += output_boxes_num;
+    }
+  }
+}
+
 void NmsExecutor::cpuCompute() {
   GTEST_CHECK(parser_->getInputNum() == 2);
   // assert(parser_->getOutputNum() == 1);
@@ -497,23 +580,11 @@ void NmsExecutor::cpuCompute() {
     nms3D_detection_cpu(output_info, total_output_boxes_num, input_boxes,
                         input_boxes_num, iou_thresh, input_layout);
   } else {
-    for (int batch_idx = 0; batch_idx < input_batches_num; ++batch_idx) {
-      for (int class_idx = 0; class_idx < input_classes_num; ++class_idx) {
-        int boxes_offset = input_boxes_num * 4 * batch_idx;
-        int conf_offset = input_classes_num * input_boxes_num * batch_idx +
-                          input_boxes_num * class_idx;
-        int output_offset = mode == 3 ? 3 * total_output_boxes_num : 0;
-        int output_boxes_num = 0;
-        nms_detection_cpu((float *)output_info + output_offset,
-                          output_boxes_num, (float *)input_boxes + boxes_offset,
-                          (float *)input_conf + conf_offset, input_boxes_num,
-                          max_output_boxes, iou_thresh, confidence_threshold,
-                          mode, input_layout, algo, offset, box_mode,
-                          method_mode, soft_nms_sigma, batch_idx, class_idx);
-        total_output_boxes_num += output_boxes_num;
-        // VLOG(4) << "total_output_boxes:" << total_output_boxes_num;
-      }
-    }
+    nms_batch_detection_cpu(output_info, total_output_boxes_num, input_boxes,
+                            input_conf, input_batches_num, input_classes_num,
+                            input_boxes_num, max_output_boxes, iou_thresh,
+                            confidence_threshold, mode, input_layout, algo,
+                            offset, box_mode, method_mode, soft_nms_sigma);
   }
   // save the output boxes num, computed by CPU
   VLOG(4) << "total_output_boxes_num:" << total_output_boxes_num;
@@ -739,22 +810,11 @@ int64_t NmsExecutor::getTheoryOps() {
     nms3D_detection_cpu(output_info, total_output_boxes_num, input_boxes,
                         input_boxes_num, iou_thresh, input_layout);
   } else {
-    for (int batch_idx = 0; batch_idx < input_batches_num; ++batch_idx) {
-      for (int class_idx = 0; class_idx < input_classes_num; ++class_idx) {
-        int boxes_offset = input_boxes_num * 4 * batch_idx;
-        int conf_offset = input_classes_num * input_boxes_num * batch_idx +
-                          input_boxes_num * class_idx;
-        int output_offset = mode == 3 ? 3 * total_output_boxes_num : 0;
-        int output_boxes_num = 0;
-        nms_detection_cpu((float *)output_info + output_offset,
-                          output_boxes_num, (float *)input_boxes + boxes_offset,
-                          (float *)input_conf + conf_offset, input_boxes_num,
-                          max_output_boxes, iou_thresh, confidence_threshold,
-                          mode, input_layout, algo, offset, box_mode,
-                          method_mode, soft_nms_sigma, batch_idx, class_idx);
-        total_output_boxes_num += output_boxes_num;
-      }
-    }
+    nms_batch_detection_cpu(output_info, total_output_boxes_num, input_boxes,
+                            input_conf, input_batches_num, input_classes_num,
+                            input_boxes_num, max_output_boxes, iou_thresh,
+                            confidence_threshold, mode, input_layout, algo,
+                            offset, box_mode, method_mode, soft_nms_sigma);
   }
   cpu_runtime_.deallocate(output_info);
   cp_count *= total_output_boxes_num;
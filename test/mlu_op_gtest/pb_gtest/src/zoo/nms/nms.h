@@ -47,10 +47,20 @@ class NmsExecutor : public Executor {
                          mluOpNmsBoxPointMode_t box_mode,
                          mluOpNmsMethodMode_t method_mode, float soft_nms_sigma,
                          int batch_idx, int class_idx);
+  // nms_detection_cpu of each batch and class, the outputs of mode 3 are
+  // concatenated.
+  void nms_batch_detection_cpu(
+      float *output_info, int &total_output_boxes_num, float *input_boxes,
+      float *input_conf, int input_batches_num, int input_classes_num,
+      int input_boxes_num, int keepNum, float thresh_iou, float thresh_score,
+      mluOpNmsOutputMode_t output_mode, int input_layout, mluOpNmsAlgo_t algo,
+      float offset, mluOpNmsBoxPointMode_t box_mode,
+      mluOpNmsMethodMode_t method_mode, float soft_nms_sigma);
   int64_t getTheoryOps() override;
 
  private:
   void diffPreprocess();
+  bool needFullMluOutput() override { return true; }
   int output_boxes_;
   int theory_ops = 0;
   size_t workspace_size_ = 0;
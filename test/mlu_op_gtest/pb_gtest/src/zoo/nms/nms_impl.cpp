@@ -0,0 +1,193 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "nms_impl.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "box_grid.h"
+#include "nms3D_utils.h"
+
+namespace mluoptest {
+
+// The loop of nms_detection_cpu keeps the max remaining score (the lowest
+// index among equal scores) and zeroes the scores of all boxes overlapping it
+// by more than thresh_iou. With thresholds >= 0, a zeroed box is never picked
+// again and only boxes which intersect can suppress each other, so the boxes
+// are sorted once and each one is only tested against the kept boxes in
+// their grid cells.
+std::vector<int> hardNmsGrid(const float *input_data,
+                             const float *input_score, int input_box_num,
+                             int keepNum, float thresh_iou,
+                             float thresh_score, int input_layout,
+                             mluOpNmsAlgo_t algo, float offset,
+                             mluOpNmsBoxPointMode_t box_mode) {
+  std::vector<float> x1(input_box_num), y1(input_box_num),
+      x2(input_box_num), y2(input_box_num);
+  std::vector<float> area_max(input_box_num), area_cur(input_box_num);
+  std::vector<float> grid_x2(input_box_num), grid_y2(input_box_num);
+  // same box and area arithmetic as nms_detection_cpu, for equal ious.
+  const float inter_offset = algo == 1 ? offset : 0;
+  for (int i = 0; i < input_box_num; ++i) {
+    float x1_cur, y1_cur, x2_cur, y2_cur;
+    if (input_layout == 0) {
+      x1_cur = input_data[0 + i * 4];
+      y1_cur = input_data[1 + i * 4];
+      x2_cur = input_data[2 + i * 4];
+      y2_cur = input_data[3 + i * 4];
+    } else {
+      x1_cur = input_data[i];
+      y1_cur = input_data[1 * input_box_num + i];
+      x2_cur = input_data[2 * input_box_num + i];
+      y2_cur = input_data[3 * input_box_num + i];
+    }
+    if (box_mode == 0) {
+      if (x1_cur > x2_cur) {
+        std::swap(x1_cur, x2_cur);
+      }
+      if (y1_cur > y2_cur) {
+        std::swap(y1_cur, y2_cur);
+      }
+    } else if (box_mode == 1) {
+      x1_cur = x1_cur - x2_cur * 0.5;
+      x2_cur = x1_cur + x2_cur;
+      y1_cur = y1_cur - y2_cur * 0.5;
+      y2_cur = y1_cur + y2_cur;
+    }
+    x1[i] = x1_cur;
+    y1[i] = y1_cur;
+    x2[i] = x2_cur;
+    y2[i] = y2_cur;
+    if (algo == 0 || offset == 0.0) {
+      area_max[i] = (x2_cur - x1_cur) * (y2_cur - y1_cur);
+    } else {
+      area_max[i] = (x2_cur - x1_cur + offset) * (y2_cur - y1_cur + offset);
+    }
+    if (algo == 1) {
+      area_cur[i] = (x2_cur - x1_cur + offset) * (y2_cur - y1_cur + offset);
+    } else {
+      area_cur[i] = (x2_cur - x1_cur) * (y2_cur - y1_cur);
+    }
+    // the intersection is positive only where [x1, x2 + inter_offset]
+    // overlap.
+    grid_x2[i] = x2_cur + inter_offset;
+    grid_y2[i] = y2_cur + inter_offset;
+  }
+
+  std::vector<int> order;
+  for (int i = 0; i < input_box_num; ++i) {
+    if (input_score[i] > thresh_score) {
+      order.push_back(i);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return input_score[a] > input_score[b];
+  });
+  // the loop starts its search from index 0, so a nan score there is picked
+  // first and a nan score elsewhere never.
+  if (input_box_num > 0 && std::isnan(input_score[0])) {
+    order.insert(order.begin(), 0);
+  }
+
+  std::vector<int> keep;
+  BoxGrid grid(x1.data(), y1.data(), grid_x2.data(), grid_y2.data(),
+               input_box_num);
+  std::vector<int> near;
+  for (int cur : order) {
+    if ((int)keep.size() >= keepNum) {
+      break;
+    }
+    grid.query(cur, &near);
+    int suppressed = 0;
+    const int near_num = near.size();
+#pragma omp simd reduction(| : suppressed)
+    for (int n = 0; n < near_num; ++n) {
+      const int k = near[n];
+      float inter_x1 = (x1[k] > x1[cur] ? x1[k] : x1[cur]);
+      float inter_y1 = (y1[k] > y1[cur] ? y1[k] : y1[cur]);
+      float inter_x2 = (x2[k] > x2[cur] ? x2[cur] : x2[k]);
+      float inter_y2 = (y2[k] > y2[cur] ? y2[cur] : y2[k]);
+      float inter_w = inter_x2 - inter_x1 + inter_offset;
+      float inter_h = inter_y2 - inter_y1 + inter_offset;
+      inter_w = inter_w < 0 ? 0 : inter_w;
+      inter_h = inter_h < 0 ? 0 : inter_h;
+      float area_I = inter_w * inter_h;
+      float area_U = area_max[k] + area_cur[cur] - area_I;
+      suppressed |= area_I / area_U > thresh_iou;
+    }
+    if (!suppressed) {
+      keep.push_back(cur);
+      grid.insert(cur);
+    }
+  }
+  return keep;
+}
+
+std::vector<int> hardNms3DGrid(const float *x, const float *y,
+                               const float *dx, const float *dy,
+                               const float *angle, int input_box_num,
+                               float thresh_iou) {
+  // a box is kept unless a kept box before it overlaps it by more than
+  // thresh_iou, which needs their bev bounds to intersect, so each box is
+  // only tested against the kept boxes in its grid cells. The bounds get
+  // 0.02 more for the 1e-2 margin of check_in_box2d.
+  std::vector<float> bx1(input_box_num), by1(input_box_num),
+      bx2(input_box_num), by2(input_box_num);
+  for (int i = 0; i < input_box_num; i++) {
+    float c = std::fabs(std::cos(angle[i]));
+    float s = std::fabs(std::sin(angle[i]));
+    float hx = (std::fabs(dx[i]) * c + std::fabs(dy[i]) * s) / 2 + 0.02f;
+    float hy = (std::fabs(dx[i]) * s + std::fabs(dy[i]) * c) / 2 + 0.02f;
+    bx1[i] = x[i] - hx;
+    by1[i] = y[i] - hy;
+    bx2[i] = x[i] + hx;
+    by2[i] = y[i] + hy;
+  }
+  BoxGrid grid(bx1.data(), by1.data(), bx2.data(), by2.data(),
+               input_box_num);
+  std::vector<int> keep;
+  std::vector<int> near;
+  float box_a[7] = {0}, box_b[7] = {0};
+  for (int cur_box = 0; cur_box < input_box_num; cur_box++) {
+    box_b[0] = x[cur_box], box_b[1] = y[cur_box];
+    box_b[3] = dx[cur_box], box_b[4] = dy[cur_box];
+    box_b[6] = angle[cur_box];
+    grid.query(cur_box, &near);
+    bool suppressed = false;
+    for (int i : near) {
+      box_a[0] = x[i], box_a[1] = y[i];
+      box_a[3] = dx[i], box_a[4] = dy[i];
+      box_a[6] = angle[i];
+      if (Nms3DUtils::UtilsFunctions::iou_bev(box_a, box_b) > thresh_iou) {
+        suppressed = true;
+        break;
+      }
+    }
+    if (!suppressed) {
+      keep.push_back(cur_box);
+      grid.insert(cur_box);
+    }
+  }
+  return keep;
+}
+
+}  // namespace mluoptest
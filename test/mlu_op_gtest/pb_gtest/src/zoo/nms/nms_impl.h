@@ -0,0 +1,44 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_SRC_ZOO_NMS_NMS_IMPL_H_
+#define TEST_MLU_OP_GTEST_SRC_ZOO_NMS_NMS_IMPL_H_
+#include <vector>
+#include "mlu_op.h"
+namespace mluoptest {
+// the hard nms of NmsExecutor::nms_detection_cpu (method_mode 0) for
+// thresh_score >= 0 and thresh_iou >= 0, the kept indices in output order.
+std::vector<int> hardNmsGrid(const float *input_data,
+                             const float *input_score, int input_box_num,
+                             int keepNum, float thresh_iou,
+                             float thresh_score, int input_layout,
+                             mluOpNmsAlgo_t algo, float offset,
+                             mluOpNmsBoxPointMode_t box_mode);
+
+// the nms of NmsExecutor::nms3D_detection_cpu for thresh_iou >= 0, boxes
+// x, y, dx, dy, angle in input order, the kept indices.
+std::vector<int> hardNms3DGrid(const float *x, const float *y,
+                               const float *dx, const float *dy,
+                               const float *angle, int input_box_num,
+                               float thresh_iou);
+}  // namespace mluoptest
+#endif  // TEST_MLU_OP_GTEST_SRC_ZOO_NMS_NMS_IMPL_H_
@@ -25,18 +25,6 @@
 #include "executor.h"
 namespace mluoptest {
 
-template <typename T>
-struct Box;
-
-template <typename T>
-struct Point;
-
-template <typename T>
-inline T dot2d(const Point<T> &A, const Point<T> &B);
-
-template <typename T>
-inline T cross2d(const Point<T> &A, const Point<T> &B);
-
 class NmsRotatedExecutor : public Executor {
  public:
   NmsRotatedExecutor() {}
@@ -52,24 +40,9 @@ class NmsRotatedExecutor : public Executor {
   int64_t out_num_;
 
  private:
-  template <typename T>
   void cpuNmsRotated(
-          const T *boxes, const T *scores, T *output,
+          const float *boxes, const float *scores, float *output,
           const int num_box, const float iou_threshold, const int box_dim);
-  template <typename T>
-  T singleBoxIouRotated(const T *box1, const T *box2, const int mode);
-  template <typename T>
-  T rotatedBoxesIntersection(const Box<T> box1, const Box<T> box2);
-  template <typename T>
-  void getRotatedVertices(const Box<T> &box, Point<T> (&pts)[4]);
-  template <typename T>
-  T getIntersectionPoints(const Point<T> (&pts1)[4], const Point<T> (&pts2)[4],
-                          Point<T> (&intersections)[24]);
-  template <typename T>
-  int convexHullGraham(const Point<T> (&p)[24], const int &num_in,
-                       Point<T> (&q)[24]);
-  template <typename T>
-  T polygonArea(const Point<T> (&q)[24], const int &m);
 };  // class Executor
 }  // namespace mluoptest
 #endif  // TEST_MLU_OP_GTEST_SRC_ZOO_NMS_ROTATED_NMS_ROTATED_H_
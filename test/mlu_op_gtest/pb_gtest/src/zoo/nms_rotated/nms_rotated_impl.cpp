@@ -0,0 +1,71 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "nms_rotated_impl.h"
+#include <algorithm>
+#include <vector>
+#include "box_grid.h"
+#include "rotated_iou.h"
+
+namespace mluoptest {
+
+std::vector<int> nmsRotatedGrid(const float *boxes, const float *scores,
+                                int num_box, float iou_threshold,
+                                int box_dim) {
+  std::vector<int32_t> order(num_box);
+  for (int i = 0; i < num_box; i++) order[i] = i;
+  sort(order.begin(), order.end(), [&scores] (int i1, int i2)
+    {return scores[i1] > scores[i2];});
+
+  // mmcv's nms_rotated: cosf / sinf and divisions as reciprocals
+  const RotatedIouArith arith = {true, true};
+  RotatedBoxes rotated(boxes, num_box, box_dim, arith);
+  // a box is kept unless a box kept before it overlaps it too much, so only
+  // the kept boxes whose bounds meet its own are compared with it. Boxes
+  // apart have iou 0, which is over a negative threshold though.
+  const bool all_pairs = iou_threshold < 0;
+  BoxGrid grid(rotated.x1(), rotated.y1(), rotated.x2(), rotated.y2(),
+               num_box);
+  std::vector<int> kept, near;
+  for (int32_t _j = 0; _j < num_box; _j++) {
+    auto j = order[_j];
+    if (all_pairs) {
+      near = kept;
+    } else {
+      grid.query(j, &near);
+    }
+    bool suppressed = false;
+    for (int i : near) {
+      if (rotated.iou(i, rotated, j, 0) > iou_threshold) {
+        suppressed = true;
+        break;
+      }
+    }
+    if (!suppressed) {
+      kept.push_back(j);
+      grid.insert(j);
+    }
+  }
+  return kept;
+}
+
+}  // namespace mluoptest
@@ -21,7 +21,13 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *************************************************************************/
 #include "points_in_boxes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include "mlu_op.h"
+#include "box_bvh.h"
 
 namespace mluoptest {
 
@@ -47,6 +53,10 @@ static int check_pt_in_box3d_cpu(const float *pt, const float *box3d,
   return in_flag;
 }
 
+static bool allFinite(const float *v, int n) {
+  return std::all_of(v, v + n, [](float x) { return std::isfinite(x); });
+}
+
 static void points_in_boxes_cpu(
     const mluOpTensorDescriptor_t points_desc, const void *points,
     const mluOpTensorDescriptor_t boxes_desc, const void *boxes,
@@ -56,18 +66,46 @@ static void points_in_boxes_cpu(
        i++) {
     *((float *)points_indices + i) = -1.0;
   }
+  const int64_t num_points = points_desc->getDimIndex(1);
+  const int64_t num_boxes = boxes_desc->getDimIndex(1);
   for (int64_t i = 0; i < points_desc->getDimIndex(0); i++) {
-    for (int64_t j = 0; j < points_desc->getDimIndex(1); j++) {
-      for (int64_t m = 0; m < boxes_desc->getDimIndex(1); m++) {
-        float local_x, local_y;
-        int cur_in_flag = check_pt_in_box3d_cpu(
-            (float *)points + (i * points_desc->getDimIndex(1) + j) * 3,
-            (float *)boxes + (i * boxes_desc->getDimIndex(1) + m) * 7, local_x,
-            local_y);
-        if (cur_in_flag) {
-          *((float *)points_indices + i * points_desc->getDimIndex(1) + j) =
-              (float)m;
-          break;
+    const float *batch_points = (float *)points + i * num_points * 3;
+    const float *batch_boxes = (float *)boxes + i * num_boxes * 7;
+    float *batch_indices = (float *)points_indices + i * num_points;
+    std::vector<float> lo(num_boxes * 3), hi(num_boxes * 3);
+    for (int64_t m = 0; m < num_boxes; m++) {
+      const float *box3d = batch_boxes + m * 7;
+      rotatedBoxBounds(box3d[0], box3d[1], box3d[2], box3d[3], box3d[4],
+                       box3d[5], box3d[6], 1e-5, &lo[m * 3], &hi[m * 3]);
+    }
+    BoxBvh bvh(lo.data(), hi.data(), num_boxes);
+
+    // each point takes the first box holding it.
+#pragma omp parallel
+    {
+      std::vector<int> candidates;
+#pragma omp for
+      for (int64_t j = 0; j < num_points; j++) {
+        const float *pt = batch_points + j * 3;
+        if (!allFinite(pt, 3)) {
+          // a nan z passes the z test of every box, test them all.
+          candidates.resize(num_boxes);
+          for (int64_t m = 0; m < num_boxes; m++) {
+            candidates[m] = m;
+          }
+        } else {
+          bvh.query(pt, &candidates);
+        }
+        int64_t first = num_boxes;
+        for (int m : candidates) {
+          float local_x, local_y;
+          if (m < first && check_pt_in_box3d_cpu(pt, batch_boxes + m * 7,
+                                                 local_x, local_y)) {
+            first = m;
+          }
+        }
+        if (first < num_boxes) {
+          batch_indices[j] = (float)first;
         }
       }
     }
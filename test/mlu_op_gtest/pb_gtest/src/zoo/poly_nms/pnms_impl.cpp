@@ -154,32 +154,33 @@ float iouPoly(vector<float> p, vector<float> q) {
   return iou;
 }
 
-bool campareValue(const pair<vector<float>, int> &a,
-                  const pair<vector<float>, int> &b) {
-  return (*(a.first.end() - 1) > *(b.first.end() - 1));
-}
-
 vector<int> PolyNmsImpl(vector<vector<float>> &p, const float thresh) {
-  vector<pair<vector<float>, int>> vp;
-  for (int i = 0; i < p.size(); i++) {
-    vp.push_back(make_pair(p[i], i));
+  const int num = p.size();
+  vector<int> order(num);
+  for (int i = 0; i < num; i++) {
+    order[i] = i;
   }
-
-  sort(vp.begin(), vp.end(), campareValue);
-
+  // by score, the last of each box; the comparisons, and so the order of
+  // ties, are those of sorting the boxes themselves
+  sort(order.begin(), order.end(),
+       [&](int a, int b) { return p[a].back() > p[b].back(); });
+
+  // a box is kept unless a box kept before it overlaps it too much. every
+  // pair is clipped, even with bounds apart: intersectArea sums signed
+  // triangles with the origin, which leave a residue in float (above 0.1
+  // for some thin quads at 1e5), and that residue can suppress a box.
   vector<int> keep;
-  while (vp.size()) {
-    keep.push_back(vp.begin()->second);
-    auto box = vp.begin()->first;
-    auto box_index = vp.begin()->second;
-    vp.erase(vp.begin());
-    for (int i = 0; i < vp.size(); i++) {
-      float iou = iouPoly(box, vp[i].first);
-      if (iou > thresh) {
-        vp.erase(vp.begin() + i);
-        i--;
+  for (int cur : order) {
+    bool suppressed = false;
+    for (int k : keep) {
+      if (iouPoly(p[k], p[cur]) > thresh) {
+        suppressed = true;
+        break;
       }
     }
+    if (!suppressed) {
+      keep.push_back(cur);
+    }
   }
 
   sort(keep.begin(), keep.end(), [&](int a, int b) { return a < b; });
@@ -29,6 +29,8 @@
 using namespace std;  // NOLINT
 
 namespace PNMS {
+// iou of two quads x0, y0, ..., x3, y3.
+float iouPoly(vector<float> p, vector<float> q);
 vector<int> PolyNmsImpl(vector<vector<float>> &p, const float thresh);
 }  // namespace PNMS
 #endif  // TEST_MLU_OP_GTEST_PB_GTEST_SRC_ZOO_POLY_NMS_PNMS_IMPL_H_
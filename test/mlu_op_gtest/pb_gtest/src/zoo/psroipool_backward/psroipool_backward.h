@@ -32,6 +32,8 @@ class PsroipoolBackwardExecutor : public Executor {
   void paramCheck() override;
   void compute() override;
   void cpuCompute() override;
+  // theory ops are counted by cpuCompute(), which a cache hit skips.
+  bool baselineCacheable() override { return false; }
   int64_t getTheoryOps() override;
 
  private:
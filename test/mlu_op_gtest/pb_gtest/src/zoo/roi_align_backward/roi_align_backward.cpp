@@ -26,6 +26,8 @@
 #include <iostream>
 #include <vector>
 
+#include "bilinear_sample.h"
+
 namespace mluoptest {
 
 void RoiAlignBackwardExecutor::paramCheck() {
@@ -178,44 +180,31 @@ void RoiAlignBackwardExecutor::cpuCompute() {
           (sampling_ratio > 0) ? sampling_ratio : ceil(roi_width / input_w);
       const float count = roi_bin_grid_h * roi_bin_grid_w;
 
+      // the channels of a bin share its sample points, so each point is
+      // scattered to all channels at once, which keeps the order the
+      // gradients of every output element are summed in.
       for (int ih = 0; ih < input_h; ++ih) {
         for (int iw = 0; iw < input_w; ++iw) {
-          for (int ic = 0; ic < input_c; ++ic) {
-            float input_this_bin =
-                input[idx_n * input_offset_n + ih * input_offset_h +
-                      iw * input_c + ic];
-            for (int iy = 0; iy < roi_bin_grid_h; ++iy) {
-              const float y = y1 + ih * bin_size_h +
-                              (iy + .5) * bin_size_h / (float)roi_bin_grid_h;
-              for (int ix = 0; ix < roi_bin_grid_w; ++ix) {
-                const float x = x1 + iw * bin_size_w +
-                                (ix + .5) * bin_size_w / (float)roi_bin_grid_w;
-
-                float w1, w2, w3, w4;
-                int x_low, x_high, y_low, y_high;
-                bilinear_interpolate_gradient(output_h, output_w, y, x, w1, w2,
-                                              w3, w4, x_low, x_high, y_low,
-                                              y_high);
-                float g1 = input_this_bin * w1 / count;
-                float g2 = input_this_bin * w2 / count;
-                float g3 = input_this_bin * w3 / count;
-                float g4 = input_this_bin * w4 / count;
-
-                if (x_low >= 0 && x_high >= 0 && y_low >= 0 && y_high >= 0) {
-                  output[output_offset + y_low * output_offset_h +
-                         x_low * output_c + ic] += g1;
-                  output[output_offset + y_low * output_offset_h +
-                         x_high * output_c + ic] += g2;
-                  output[output_offset + y_high * output_offset_h +
-                         x_low * output_c + ic] += g3;
-                  output[output_offset + y_high * output_offset_h +
-                         x_high * output_c + ic] += g4;
-                }
-              }  // for ix
-            }    // for iy
-          }      // for ic
-        }        // for iw
-      }          // for ih
+          const float *input_this_bin =
+              input + idx_n * input_offset_n + ih * input_offset_h +
+              iw * input_c;
+          for (int iy = 0; iy < roi_bin_grid_h; ++iy) {
+            const float y = y1 + ih * bin_size_h +
+                            (iy + .5) * bin_size_h / (float)roi_bin_grid_h;
+            for (int ix = 0; ix < roi_bin_grid_w; ++ix) {
+              const float x = x1 + iw * bin_size_w +
+                              (ix + .5) * bin_size_w / (float)roi_bin_grid_w;
+
+              BilinearSample sample;
+              if (bilinearSampleClamped(output_h, output_w, output_c, y, x,
+                                        &sample)) {
+                bilinearScatterAdd(output + output_offset, sample, input_c,
+                                   input_this_bin, count);
+              }
+            }  // for ix
+          }    // for iy
+        }      // for iw
+      }        // for ih
     }            // for idx_n
   } else if (pool_mode == 0) {
     auto argmax_x = parser_->getMetaTensor(2).cpu_ptr;
@@ -41,6 +41,8 @@ class RoiAlignRotatedBackwardExecutor : public Executor {
   void paramCheck() override;
   void compute() override;
   void cpuCompute() override;
+  // theory ops are counted by cpuCompute(), which a cache hit skips.
+  bool baselineCacheable() override { return false; }
   int64_t getTheoryOps() override;
 
  private:
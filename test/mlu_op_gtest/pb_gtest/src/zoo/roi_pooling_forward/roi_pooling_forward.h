@@ -34,6 +34,8 @@ class RoiPoolingForwardExecutor : public Executor {
   void compute() override;
   void cpuCompute() override;
   void initData();
+  // theory ops are counted by cpuCompute(), which a cache hit skips.
+  bool baselineCacheable() override { return false; }
   int64_t getTheoryOps() override;
 
   void cpuRoiPoolingForward(float *input_v,
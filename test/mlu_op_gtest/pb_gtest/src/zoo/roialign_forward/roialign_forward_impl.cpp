@@ -0,0 +1,199 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "roialign_forward_impl.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "bilinear_sample.h"
+
+namespace mluoptest {
+
+void roialignForwardCpu(const float *input, const float *input_rois,
+                        int height, int width, int channels, int num_rois,
+                        int roi_offset, int pooled_height, int pooled_width,
+                        float spatial_scale, int sampling_ratio, bool aligned,
+                        int pool_mode, float *output, float *output_argmax_x,
+                        float *output_argmax_y) {
+  if (pool_mode == 1) {
+#pragma omp parallel for schedule(dynamic)
+    for (int roi_idx = 0; roi_idx < num_rois; roi_idx++) {
+      std::vector<float> pooled_value(channels);
+      int batch_idx = int(input_rois[roi_idx * roi_offset]);
+      float roi_x1 = input_rois[roi_idx * roi_offset + 1];
+      float roi_y1 = input_rois[roi_idx * roi_offset + 2];
+      float roi_x2 = input_rois[roi_idx * roi_offset + 3];
+      float roi_y2 = input_rois[roi_idx * roi_offset + 4];
+
+      float offset = aligned ? 0.5 : 0.0;
+
+      float roi_start_w = roi_x1 * spatial_scale - offset;
+      float roi_start_h = roi_y1 * spatial_scale - offset;
+      float roi_end_w = roi_x2 * spatial_scale - offset;
+      float roi_end_h = roi_y2 * spatial_scale - offset;
+
+      float roi_width = roi_end_w - roi_start_w;
+      float roi_height = roi_end_h - roi_start_h;
+
+      if (!aligned) {
+        roi_width = roi_width > 1 ? roi_width : 1;
+        roi_height = roi_height > 1 ? roi_height : 1;
+      }
+
+      float bin_size_h = (float)roi_height / pooled_height;
+      float bin_size_w = (float)roi_width / pooled_width;
+
+      int roi_bin_grid_h =
+          (sampling_ratio > 0) ? sampling_ratio : ceil(bin_size_h);
+      int roi_bin_grid_w =
+          (sampling_ratio > 0) ? sampling_ratio : ceil(bin_size_w);
+      float count = (roi_bin_grid_h * roi_bin_grid_w) > 1
+                        ? roi_bin_grid_h * roi_bin_grid_w
+                        : 1;
+      float count_value = 1.0f / count;
+
+      for (int ph = 0; ph < pooled_height; ph++) {
+        for (int pw = 0; pw < pooled_width; pw++) {
+          float *output_channel_ptr =
+              output + roi_idx * pooled_height * pooled_width * channels +
+              ph * pooled_width * channels + pw * channels;
+
+          std::fill(pooled_value.begin(), pooled_value.end(), 0.0f);
+          for (int iy = 0; iy < roi_bin_grid_h; iy++) {
+            float y =
+                roi_start_h + ph * bin_size_h +
+                (iy + 0.5) * bin_size_h / (roi_bin_grid_h);  // center_point y
+            for (int ix = 0; ix < roi_bin_grid_w; ix++) {
+              float x =
+                  roi_start_w + pw * bin_size_w +
+                  (ix + 0.5) * bin_size_w / (roi_bin_grid_w);  // center_point x
+              // an empty sample adds 0, which leaves the sum as it is
+              BilinearSample sample;
+              if (bilinearSampleClamped(height, width, channels, y, x,
+                                        &sample)) {
+                const float *input_temp =
+                    input + batch_idx * width * height * channels;
+                bilinearGatherAdd(input_temp, sample, channels, 1.0f,
+                                  pooled_value.data());
+              }
+            }  // roi_bin_grid_w
+          }    // roi_bin_grid_h
+          for (int channel_idx = 0; channel_idx < channels; channel_idx++) {
+            pooled_value[channel_idx] = pooled_value[channel_idx] * count_value;
+          }
+          memcpy(output_channel_ptr, pooled_value.data(),
+                 channels * sizeof(float));
+        }  // pw
+      }    // ph
+    }      // roi
+  } else if (pool_mode == 0) {
+#pragma omp parallel for schedule(dynamic)
+    for (int roi_idx = 0; roi_idx < num_rois; roi_idx++) {
+      std::vector<float> pooled_value(channels);
+      std::vector<float> argmax_x_value(channels);
+      std::vector<float> argmax_y_value(channels);
+      std::vector<float> value(channels);
+      int batch_idx = int(input_rois[roi_idx * roi_offset + 0]);
+      float roi_x1 = input_rois[roi_idx * roi_offset + 1];
+      float roi_y1 = input_rois[roi_idx * roi_offset + 2];
+      float roi_x2 = input_rois[roi_idx * roi_offset + 3];
+      float roi_y2 = input_rois[roi_idx * roi_offset + 4];
+      float offset = aligned ? 0.5 : 0.0;
+      float roi_start_w = roi_x1 * spatial_scale - offset;
+      float roi_start_h = roi_y1 * spatial_scale - offset;
+      float roi_end_w = roi_x2 * spatial_scale - offset;
+      float roi_end_h = roi_y2 * spatial_scale - offset;
+
+      float roi_width = roi_end_w - roi_start_w;
+      float roi_height = roi_end_h - roi_start_h;
+
+      if (!aligned) {
+        roi_width = roi_width > 1 ? roi_width : 1;
+        roi_height = roi_height > 1 ? roi_height : 1;
+      }
+
+      float bin_size_h = (float)roi_height / pooled_height;
+      float bin_size_w = (float)roi_width / pooled_width;
+
+      int roi_bin_grid_h =
+          (sampling_ratio > 0) ? sampling_ratio : ceil(bin_size_h);
+      int roi_bin_grid_w =
+          (sampling_ratio > 0) ? sampling_ratio : ceil(bin_size_w);
+
+      for (int ph = 0; ph < pooled_height; ph++) {
+        for (int pw = 0; pw < pooled_width; pw++) {
+          float *output_channel_ptr =
+              output + roi_idx * pooled_height * pooled_width * channels +
+              ph * pooled_width * channels + pw * channels;
+          float *output_argmax_x_channel_ptr =
+              output_argmax_x +
+              roi_idx * pooled_height * pooled_width * channels +
+              ph * pooled_width * channels + pw * channels;
+          float *output_argmax_y_channel_ptr =
+              output_argmax_y +
+              roi_idx * pooled_height * pooled_width * channels +
+              ph * pooled_width * channels + pw * channels;
+
+          std::fill(pooled_value.begin(), pooled_value.end(), -FLT_MAX);
+          std::fill(argmax_x_value.begin(), argmax_x_value.end(), -1);
+          std::fill(argmax_y_value.begin(), argmax_y_value.end(), -1);
+          for (int iy = 0; iy < roi_bin_grid_h; iy++) {
+            float y = roi_start_h + ph * bin_size_h +
+                      (iy + 0.5) * bin_size_h / (roi_bin_grid_h);
+            for (int ix = 0; ix < roi_bin_grid_w; ix++) {
+              float x = roi_start_w + pw * bin_size_w +
+                        (ix + 0.5) * bin_size_w / (roi_bin_grid_w);
+              // an empty sample is 0, and still takes part in the max
+              BilinearSample sample;
+              if (bilinearSampleClamped(height, width, channels, y, x,
+                                        &sample)) {
+                const float *input_temp =
+                    input + batch_idx * width * height * channels;
+                bilinearGather(input_temp, sample, channels, value.data());
+              } else {
+                std::fill(value.begin(), value.end(), 0.0f);
+              }
+              for (int channel_idx = 0; channel_idx < channels; channel_idx++) {
+                if (value[channel_idx] > pooled_value[channel_idx]) {
+                  pooled_value[channel_idx] = value[channel_idx];
+                  argmax_x_value[channel_idx] = x;
+                  argmax_y_value[channel_idx] = y;
+                }
+              }  // channels
+            }    // sample w
+          }      // sample h
+          memcpy(output_channel_ptr, pooled_value.data(),
+                 channels * sizeof(float));
+          memcpy(output_argmax_x_channel_ptr, argmax_x_value.data(),
+                 channels * sizeof(float));
+          memcpy(output_argmax_y_channel_ptr, argmax_y_value.data(),
+                 channels * sizeof(float));
+        }  // pw
+      }    // ph
+    }      // roi
+  }
+}
+
+}  // namespace mluoptest
@@ -0,0 +1,37 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_SRC_ZOO_ROIALIGN_FORWARD_ROIALIGN_FORWARD_IMPL_H_
+#define TEST_MLU_OP_GTEST_SRC_ZOO_ROIALIGN_FORWARD_ROIALIGN_FORWARD_IMPL_H_
+namespace mluoptest {
+// the roialign of RoialignForwardExecutor::cpuCompute: a channel-last input
+// of height x width pixels, rois of roi_offset floats {batch, x1, y1, x2,
+// y2}. pool_mode 1 averages the samples of a bin, 0 takes their max and the
+// sample position of it per channel in output_argmax_x / output_argmax_y.
+void roialignForwardCpu(const float *input, const float *input_rois,
+                        int height, int width, int channels, int num_rois,
+                        int roi_offset, int pooled_height, int pooled_width,
+                        float spatial_scale, int sampling_ratio, bool aligned,
+                        int pool_mode, float *output, float *output_argmax_x,
+                        float *output_argmax_y);
+}  // namespace mluoptest
+#endif  // TEST_MLU_OP_GTEST_SRC_ZOO_ROIALIGN_FORWARD_ROIALIGN_FORWARD_IMPL_H_
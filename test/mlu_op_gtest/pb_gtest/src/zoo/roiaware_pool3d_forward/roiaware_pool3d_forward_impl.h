@@ -0,0 +1,42 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef GTEST_SRC_ZOO_ROIAWARE_POOL3D_FORWARD_ROIAWARE_POOL3D_FORWARD_IMPL_H_
+#define GTEST_SRC_ZOO_ROIAWARE_POOL3D_FORWARD_ROIAWARE_POOL3D_FORWARD_IMPL_H_
+
+namespace mluoptest {
+// the roiaware_pool3d forward of RoiawarePool3dForwardExecutor::cpuCompute:
+// rois (boxes_num, 7) [x, y, z, x_size, y_size, z_size, rz] with z at the
+// bottom, pts (pts_num, 3). pts_idx_of_voxels (boxes_num, out_x, out_y,
+// out_z, max_pts_each_voxel) holds a count, then the first points of each
+// voxel in point order; it and the outputs are expected zeroed. pool_method
+// 0 is max, 1 is avg.
+void cpuRoiawarePool3dForward(const int boxes_num, const int pts_num,
+                              const int channels, const int max_pts_each_voxel,
+                              const int out_x, const int out_y, const int out_z,
+                              const float *rois, const float *pts,
+                              const float *pts_feature, int *argmax,
+                              int *pts_idx_of_voxels, float *pooled_features,
+                              const int pool_method);
+}  // namespace mluoptest
+
+#endif  // GTEST_SRC_ZOO_ROIAWARE_POOL3D_FORWARD_ROIAWARE_POOL3D_FORWARD_IMPL_H_
@@ -0,0 +1,168 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "roipoint_pool3d_impl.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "box_bvh.h"
+
+namespace mluoptest {
+
+static void lidarToLocalCoords(float shift_x, float shift_y, float rz,
+                               float &local_x, float &local_y) {
+  float cosa = std::cos(-rz), sina = std::sin(-rz);
+  local_x = shift_x * cosa + shift_y * (-sina);
+  local_y = shift_x * sina + shift_y * cosa;
+}
+
+static int checkPointInBox3d(const float *pt, const float *box3d,
+                             float &local_x, float &local_y) {
+  // param pt: (x, y, z)
+  // param box3d: (cx, cy, cz, dx, dy, dz, rz) in LiDAR coordinate, cz in the
+  // bottom center
+  float x = pt[0], y = pt[1], z = pt[2];
+  float cx = box3d[0], cy = box3d[1], cz = box3d[2];
+  float dx = box3d[3], dy = box3d[4], dz = box3d[5], rz = box3d[6];
+  // shift to the center since cz in box3d is the bottom center
+  cz += dz / 2.0;
+
+  if ((z - cz) > (dz / 2.0) || (z - cz) < -(dz / 2.0)) {
+    return 0;
+  }
+  lidarToLocalCoords(x - cx, y - cy, rz, local_x, local_y);
+  int in_flag = (local_x > -dx / 2.0) & (local_x < dx / 2.0) &
+                (local_y > -dy / 2.0) & (local_y < dy / 2.0);
+  return in_flag;
+}
+
+static void getPooledIdx(int batch_size, int pts_num, int boxes_num,
+                         int sampled_pts_num, const float *xyz,
+                         const float *boxes3d, int *pts_idx,
+                         float *pooled_empty_flag) {
+  // params xyz: (B, N, 3)
+  // params boxes3d: (B, M, 7)
+  // params pts_idx: (B, M, sampled_pts_num)
+  // params pooled_empty_flag: (B, M)
+  for (int bs_idx = 0; bs_idx < batch_size; bs_idx++) {
+    const float *batch_xyz = xyz + bs_idx * pts_num * 3;
+    const float *batch_boxes3d = boxes3d + bs_idx * boxes_num * 7;
+    // candidate points of each box by its bounds, cz is the bottom center.
+    std::vector<float> lo(boxes_num * 3), hi(boxes_num * 3);
+    for (int box_idx = 0; box_idx < boxes_num; box_idx++) {
+      const float *box3d = batch_boxes3d + box_idx * 7;
+      rotatedBoxBounds(box3d[0], box3d[1], box3d[2] + box3d[5] / 2.0f,
+                       box3d[3], box3d[4], box3d[5], box3d[6], 0,
+                       &lo[box_idx * 3], &hi[box_idx * 3]);
+    }
+    std::vector<std::vector<int>> box_pts;
+    BoxBvh(lo.data(), hi.data(), boxes_num)
+        .pointsPerBox(batch_xyz, pts_num, &box_pts);
+
+    // the first sampled_pts_num points in each box.
+#pragma omp parallel for schedule(dynamic)
+    for (int box_idx = 0; box_idx < boxes_num; box_idx++) {
+      int cnt = 0;
+      for (int pt_idx : box_pts[box_idx]) {
+        if (cnt >= sampled_pts_num) {
+          break;
+        }
+        float local_x = 0, local_y = 0;
+        if (checkPointInBox3d(batch_xyz + pt_idx * 3,
+                              batch_boxes3d + box_idx * 7, local_x,
+                              local_y)) {
+          pts_idx[bs_idx * boxes_num * sampled_pts_num +
+                  box_idx * sampled_pts_num + cnt] = pt_idx;
+          cnt++;
+        }
+      }
+
+      if (cnt == 0) {
+        pooled_empty_flag[bs_idx * boxes_num + box_idx] = 1;
+      } else if (cnt < sampled_pts_num) {
+        // duplicate same points for sampling
+        for (int pt_idx = cnt; pt_idx < sampled_pts_num; pt_idx++) {
+          int duplicate_idx = pt_idx % cnt;
+          int base_offset =
+              bs_idx * boxes_num * sampled_pts_num + box_idx * sampled_pts_num;
+          pts_idx[base_offset + pt_idx] = pts_idx[base_offset + duplicate_idx];
+        }
+      }
+    }
+  }
+}
+
+static void roipointPool3dForward(int batch_size, int pts_num, int boxes_num,
+                                  int feature_in_len, int sampled_pts_num,
+                                  const float *xyz, const int *pts_idx,
+                                  const float *pts_feature,
+                                  float *pooled_features,
+                                  float *pooled_empty_flag) {
+  // params xyz: (B, N, 3)
+  // params pts_idx: (B, M, sampled_pts_num)
+  // params pts_feature: (B, N, C)
+  // params pooled_features: (B, M, sampled_pts_num, 3+C)
+  // params pooled_empty_flag: (B, M)
+#pragma omp parallel for collapse(2)
+  for (int bs_idx = 0; bs_idx < batch_size; bs_idx++) {
+    for (int box_idx = 0; box_idx < boxes_num; box_idx++) {
+      if (pooled_empty_flag[bs_idx * boxes_num + box_idx] == 1) {
+        continue;
+      }
+
+      for (int sample_pt_idx = 0; sample_pt_idx < sampled_pts_num;
+           sample_pt_idx++) {
+        int temp_idx = bs_idx * boxes_num * sampled_pts_num +
+                       box_idx * sampled_pts_num + sample_pt_idx;
+        int src_pt_idx = pts_idx[temp_idx];
+        int dst_feature_offset = temp_idx * (3 + feature_in_len);
+
+        for (int j = 0; j < 3; j++) {
+          pooled_features[dst_feature_offset + j] =
+              xyz[bs_idx * pts_num * 3 + src_pt_idx * 3 + j];
+        }
+
+        int src_feature_offset =
+            bs_idx * pts_num * feature_in_len + src_pt_idx * feature_in_len;
+        memcpy(pooled_features + dst_feature_offset + 3,
+               pts_feature + src_feature_offset,
+               feature_in_len * sizeof(float));
+      }
+    }
+  }
+}
+
+void cpuRoiPointPool3d(int batch_size, int pts_num, int boxes_num,
+                       int feature_len, int sampled_pts_num, float *points,
+                       float *point_features, float *boxes3d, int *pts_idx,
+                       float *pooled_features, float *pooled_empty_flag) {
+  getPooledIdx(batch_size, pts_num, boxes_num, sampled_pts_num, points,
+               boxes3d, pts_idx, pooled_empty_flag);
+  roipointPool3dForward(batch_size, pts_num, boxes_num, feature_len,
+                        sampled_pts_num, points, pts_idx, point_features,
+                        pooled_features, pooled_empty_flag);
+  return;
+}
+
+}  // namespace mluoptest
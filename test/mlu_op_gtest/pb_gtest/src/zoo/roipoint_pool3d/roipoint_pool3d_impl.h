@@ -0,0 +1,39 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLUOP_GTEST_SRC_ZOO_ROIPOINT_POOL3D_ROIPOINT_POOL3D_IMPL_H_
+#define TEST_MLUOP_GTEST_SRC_ZOO_ROIPOINT_POOL3D_ROIPOINT_POOL3D_IMPL_H_
+
+namespace mluoptest {
+// the roipoint_pool3d of RoipointPool3dExecutor::cpuCompute: points (B, N,
+// 3), point_features (B, N, C), boxes3d (B, M, 7) with z at the bottom.
+// pts_idx (B, M, sampled_pts_num) gets the first points of each box in
+// point order, repeated to fill it; pooled_features (B, M, sampled_pts_num,
+// 3 + C) their xyz and features. pooled_empty_flag (B, M), expected zeroed,
+// is set to 1 for a box without points, whose features are left untouched.
+void cpuRoiPointPool3d(int batch_size, int pts_num, int boxes_num,
+                       int feature_len, int sampled_pts_num, float *points,
+                       float *point_features, float *boxes3d, int *pts_idx,
+                       float *pooled_features, float *pooled_empty_flag);
+}  // namespace mluoptest
+
+#endif  // TEST_MLUOP_GTEST_SRC_ZOO_ROIPOINT_POOL3D_ROIPOINT_POOL3D_IMPL_H_
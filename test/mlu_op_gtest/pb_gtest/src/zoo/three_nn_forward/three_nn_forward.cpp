@@ -20,11 +20,13 @@
  * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *************************************************************************/
+#include <cmath>
 #include <vector>
 
 #include "three_nn_forward.h"
 
 #include "mlu_op.h"
+#include "point_index.h"
 
 namespace mluoptest {
 
@@ -94,46 +96,18 @@ void ThreeNnForwardExecutor::cpuCompute() {
   float *idx_start = (float *)cpu_fp32_output_[1];
 
   for (int64_t i = 0; i < b; ++i) {
+    // the 3 nearest known points by distance and then index, those not found
+    // are left at the brute force's initial 1e40 and 0.
+    PointKdTree tree(known, m);
+#pragma omp parallel for
     for (int64_t j = 0; j < n; ++j) {
-      float ux = unknown[j * 3 + 0];
-      float uy = unknown[j * 3 + 1];
-      float uz = unknown[j * 3 + 2];
-      double best1 = 1e40;
-      double best2 = 1e40;
-      double best3 = 1e40;
-      int besti1 = 0;
-      int besti2 = 0;
-      int besti3 = 0;
-
-      for (int k = 0; k < m; ++k) {
-        float x = known[k * 3 + 0];
-        float y = known[k * 3 + 1];
-        float z = known[k * 3 + 2];
-        double d =
-            (ux - x) * (ux - x) + (uy - y) * (uy - y) + (uz - z) * (uz - z);
-        if (d < best1) {
-          best3 = best2;
-          besti3 = besti2;
-          best2 = best1;
-          besti2 = besti1;
-          best1 = d;
-          besti1 = k;
-        } else if (d < best2) {
-          best3 = best2;
-          besti3 = besti2;
-          best2 = d;
-          besti2 = k;
-        } else if (d < best3) {
-          best3 = d;
-          besti3 = k;
-        }
+      float best[3];
+      int besti[3];
+      const int found = tree.nearest(unknown + j * 3, 3, best, besti);
+      for (int t = 0; t < 3; ++t) {
+        dist2[j * 3 + t] = t < found ? best[t] : INFINITY;
+        idx[j * 3 + t] = t < found ? besti[t] : 0;
       }
-      dist2[j * 3 + 0] = float(best1);
-      dist2[j * 3 + 1] = float(best2);
-      dist2[j * 3 + 2] = float(best3);
-      idx[j * 3 + 0] = besti1;
-      idx[j * 3 + 1] = besti2;
-      idx[j * 3 + 2] = besti3;
     }
     unknown += n * 3;
     known += m * 3;
@@ -22,6 +22,7 @@
  *************************************************************************/
 #include "voxelization.h"
 
+#include "voxelization_impl.h"
 #include "kernels/kernel.h"
 #include "mlu_op.h"
 
@@ -119,6 +120,7 @@ void dynamicVoxelize(const float *points, int32_t *coors, const float voxel_x,
                      const int32_t grid_x, const int32_t grid_y,
                      const int32_t grid_z, const size_t num_points,
                      const size_t num_features, const size_t NDim) {
+#pragma omp parallel for
   for (size_t index = 0; index < num_points; ++index) {
     const float *points_offset = points + index * num_features;
     int32_t *coors_offset = coors + index * NDim;
@@ -148,50 +150,6 @@ void dynamicVoxelize(const float *points, int32_t *coors, const float voxel_x,
   }
 }
 
-void pointToVoxelidx(const int32_t *coor, int32_t *point_to_voxelidx,
-                     int32_t *point_to_pointidx, const int32_t max_points,
-                     const int32_t max_voxels, const size_t num_points,
-                     const size_t NDim) {
-  for (size_t index = 0; index < num_points; ++index) {
-    const int32_t *coor_offset = coor + index * NDim;
-    if (coor_offset[0] == -1) {
-      point_to_pointidx[index] = -1;
-      point_to_voxelidx[index] = -1;
-      continue;
-    }
-
-    int32_t num = 0;
-    int32_t coor_x = coor_offset[0];
-    int32_t coor_y = coor_offset[1];
-    int32_t coor_z = coor_offset[2];
-
-    for (int i = 0; i < index; ++i) {
-      auto prev_coor = coor + i * NDim;
-      if (prev_coor[0] == -1) {
-        continue;
-      }
-
-      if ((prev_coor[0] == coor_x) && (prev_coor[1] == coor_y) &&
-          (prev_coor[2] == coor_z)) {
-        num++;
-        if (num == 1) {
-          point_to_pointidx[index] = i;
-        } else if (num >= max_points) {
-          break;
-        }
-      }
-    }
-    if (num == 0) {
-      point_to_pointidx[index] = index;
-    }
-    if (num < max_points) {
-      point_to_voxelidx[index] = num;
-    } else {
-      point_to_voxelidx[index] = -1;
-    }
-  }
-}
-
 void determinVoxelNum(float *num_points_per_voxel, int32_t *point_to_voxelidx,
                       int32_t *point_to_pointidx, int32_t *coor_to_voxelidx,
                       float *voxel_num, const int32_t max_points,
@@ -290,7 +248,7 @@ void VoxelizationExecutor::deterministic_hard_voxelize(
       (int32_t *)cpu_runtime_.allocate(count * sizeof(int32_t));
 
   pointToVoxelidx(temp_coors, point_to_voxelidx, point_to_pointidx, max_points,
-                  max_voxels, num_points, NDim);
+                  max_voxels, num_points, NDim, grid_x, grid_y);
 
   count = num_points;
   int32_t *coor_to_voxelidx =
@@ -0,0 +1,118 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include "voxelization_impl.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "coord_hash.h"
+
+namespace mluoptest {
+
+// Voxels are found by a hash of their packed coordinate: chunks of points
+// count their voxels in parallel, then the chunks are merged in order so each
+// voxel's count continues from the earlier chunks.
+void pointToVoxelidx(const int32_t *coor, int32_t *point_to_voxelidx,
+                     int32_t *point_to_pointidx, const int32_t max_points,
+                     const int32_t max_voxels, const size_t num_points,
+                     const size_t NDim, const int32_t grid_x,
+                     const int32_t grid_y) {
+  // the device counts earlier points up to max_points, but at least 2.
+  const int32_t max_num = std::max(max_points, 2);
+  const size_t chunk_size = 1 << 14;
+  const size_t chunks = (num_points + chunk_size - 1) / chunk_size;
+  struct Chunk {
+    CoordHash voxels;  // packed coordinate -> slot
+    std::vector<int64_t> keys;
+    std::vector<int32_t> first;  // first point, in the chunk then overall
+    std::vector<int32_t> count;  // points in the chunk, then points before
+  };
+  std::vector<Chunk> chunk_voxels(chunks);
+  auto packedCoor = [&](size_t index) -> int64_t {
+    const int32_t *coor_offset = coor + index * NDim;
+    return ((int64_t)coor_offset[0] * grid_y + coor_offset[1]) * grid_x +
+           coor_offset[2];
+  };
+
+  // the slot of each point in its chunk goes to point_to_pointidx and the
+  // number of points before it in the chunk to point_to_voxelidx.
+#pragma omp parallel for schedule(dynamic)
+  for (size_t c = 0; c < chunks; ++c) {
+    Chunk &chunk = chunk_voxels[c];
+    const size_t end = std::min(num_points, (c + 1) * chunk_size);
+    for (size_t index = c * chunk_size; index < end; ++index) {
+      if (coor[index * NDim] == -1) {
+        point_to_pointidx[index] = -1;
+        point_to_voxelidx[index] = -1;
+        continue;
+      }
+      const int64_t key = packedCoor(index);
+      int32_t slot = chunk.keys.size();
+      if (chunk.voxels.insert(key, slot)) {
+        chunk.keys.push_back(key);
+        chunk.first.push_back(index);
+        chunk.count.push_back(0);
+      } else {
+        slot = *chunk.voxels.find(key);
+      }
+      point_to_pointidx[index] = slot;
+      point_to_voxelidx[index] = chunk.count[slot]++;
+    }
+  }
+
+  CoordHash voxels;  // packed coordinate -> first point, count
+  std::vector<int32_t> voxel_first, voxel_count;
+  for (auto &chunk : chunk_voxels) {
+    for (size_t slot = 0; slot < chunk.keys.size(); ++slot) {
+      int32_t voxel = voxel_first.size();
+      if (voxels.insert(chunk.keys[slot], voxel)) {
+        voxel_first.push_back(chunk.first[slot]);
+        voxel_count.push_back(0);
+      } else {
+        voxel = *voxels.find(chunk.keys[slot]);
+      }
+      const int32_t count = chunk.count[slot];
+      chunk.first[slot] = voxel_first[voxel];
+      chunk.count[slot] = voxel_count[voxel];
+      voxel_count[voxel] += count;
+    }
+  }
+
+#pragma omp parallel for schedule(dynamic)
+  for (size_t c = 0; c < chunks; ++c) {
+    const Chunk &chunk = chunk_voxels[c];
+    const size_t end = std::min(num_points, (c + 1) * chunk_size);
+    for (size_t index = c * chunk_size; index < end; ++index) {
+      const int32_t slot = point_to_pointidx[index];
+      if (slot == -1) {
+        continue;
+      }
+      const int32_t num = std::min(
+          chunk.count[slot] + point_to_voxelidx[index], max_num);
+      point_to_pointidx[index] = chunk.first[slot];
+      point_to_voxelidx[index] = num < max_points ? num : -1;
+    }
+  }
+}
+
+}  // namespace mluoptest
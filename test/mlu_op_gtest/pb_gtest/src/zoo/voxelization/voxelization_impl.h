@@ -0,0 +1,39 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#ifndef TEST_MLU_OP_GTEST_SRC_ZOO_VOXELIZATION_VOXELIZATION_IMPL_H_
+#define TEST_MLU_OP_GTEST_SRC_ZOO_VOXELIZATION_VOXELIZATION_IMPL_H_
+#include <cstddef>
+#include <cstdint>
+
+namespace mluoptest {
+// for each point in a voxel, point_to_pointidx is the first point of the
+// voxel and point_to_voxelidx the number of points before it in the voxel,
+// or -1 from max_points on. coor is NDim coordinates of each point, -1 for a
+// point outside the grid.
+void pointToVoxelidx(const int32_t *coor, int32_t *point_to_voxelidx,
+                     int32_t *point_to_pointidx, const int32_t max_points,
+                     const int32_t max_voxels, const size_t num_points,
+                     const size_t NDim, const int32_t grid_x,
+                     const int32_t grid_y);
+}  // namespace mluoptest
+#endif  // TEST_MLU_OP_GTEST_SRC_ZOO_VOXELIZATION_VOXELIZATION_IMPL_H_
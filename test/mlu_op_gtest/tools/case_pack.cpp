@@ -0,0 +1,239 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <google/protobuf/text_format.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "mlu_op_test.pb.h"
+#include "case_archive.h"
+#include "tensor_file_ref.h"
+
+void usage() {
+  std::cout << "Pack cases into one case archive (*.pbpack). Usage:"
+            << std::endl;
+  std::cout << "[1]: [-z] src_path [src_path ...] dst_file.pbpack"
+            << std::endl;
+  std::cout << "  src_path: case file or dir of *pb/*prototxt, files "
+               "referenced by tensor path are packed too."
+            << std::endl;
+  std::cout << "  -z: compress members with zlib." << std::endl;
+  std::cout << "  prototxt is stored as pb, run directly from archive by "
+               "--cases_dir=dst_file.pbpack."
+            << std::endl;
+}
+
+void listFiles(std::string dir, std::vector<std::string> &files) {
+  DIR *dp = opendir(dir.c_str());
+  if (dp == NULL) {  // it's not dir or not exist
+    return;
+  }
+  struct dirent *dirp;
+  while ((dirp = readdir(dp)) != NULL) {
+    std::string name = std::string(dirp->d_name);
+    if (dirp->d_type == DT_DIR) {
+      if (name[name.length() - 1] != '.') {
+        // is dir and not "." or ".."
+        listFiles(dir + "/" + name, files);
+      }
+    } else if (dirp->d_type == DT_REG || dirp->d_type == DT_UNKNOWN) {
+      files.push_back(dir + "/" + name);
+    }
+  }
+  closedir(dp);
+}
+
+bool isDir(std::string dir) {
+  struct stat s;
+  return stat(dir.c_str(), &s) == 0 && (s.st_mode & S_IFDIR);
+}
+
+bool endsWith(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool readFile(const std::string &filename, std::string *data) {
+  std::ifstream fin(filename, std::ios::in | std::ios::binary);
+  if (!fin) {
+    return false;
+  }
+  std::ostringstream oss;
+  oss << fin.rdbuf();
+  *data = oss.str();
+  return true;
+}
+
+bool parseNode(const std::string &filename, const std::string &data,
+               mluoptest::Node *node) {
+  if (endsWith(filename, ".pb")) {
+    google::protobuf::io::CodedInputStream coded_input(
+        (const uint8_t *)data.data(), data.size());
+#if GOOGLE_PROTOBUF_VERSION > 3005000
+    coded_input.SetTotalBytesLimit(INT_MAX);
+#elif GOOGLE_PROTOBUF_VERSION
+    coded_input.SetTotalBytesLimit(INT_MAX, INT_MAX - 1);
+#endif
+    return node->ParseFromCodedStream(&coded_input);
+  }
+  return google::protobuf::TextFormat::ParseFromString(data, node);
+}
+
+std::string dirName(const std::string &path) {
+  size_t slash = path.rfind("/");
+  return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+// pack one case, member is its name in archive.
+bool packCase(mluoptest::CaseArchiveWriter *writer, const std::string &file,
+              std::string member, bool compress, size_t *data_num) {
+  std::string data, error;
+  mluoptest::Node node;
+  if (!readFile(file, &data) || !parseNode(file, data, &node)) {
+    std::cout << "Can't parse this file: " << file << std::endl;
+    return false;
+  }
+  if (endsWith(member, ".prototxt")) {
+    member = member.substr(0, member.size() - strlen(".prototxt")) + ".pb";
+    data.clear();
+    if (!node.SerializeToString(&data)) {
+      std::cout << "Serialize failed: " << file << std::endl;
+      return false;
+    }
+  }
+
+  // external data, resolved like Parser does: dir of case + tensor path.
+  std::vector<const mluoptest::Tensor *> tensors;
+  for (int i = 0; i < node.input_size(); ++i) {
+    tensors.push_back(&node.input(i));
+  }
+  for (int i = 0; i < node.output_size(); ++i) {
+    tensors.push_back(&node.output(i));
+  }
+  for (auto ts : tensors) {
+    if (!ts->has_path()) {
+      continue;
+    }
+    // the query part of an external tensor reference is kept in the case.
+    mluoptest::TensorFileRef ref;
+    if (!ref.parse(ts->path())) {
+      std::cout << "Malformed tensor path " << ts->path() << " in " << file
+                << std::endl;
+      return false;
+    }
+    std::string data_member = dirName(member) + ref.file;
+    if (writer->contains(data_member)) {
+      continue;
+    }
+    std::string blob;
+    if (!readFile(dirName(file) + ref.file, &blob)) {
+      std::cout << "Can't read " << dirName(file) + ref.file
+                << " referenced by " << file << std::endl;
+      return false;
+    }
+    if (!writer->add(data_member, mluoptest::CaseArchiveEntry::DATA, "",
+                     blob, compress, &error)) {
+      std::cout << error << std::endl;
+      return false;
+    }
+    (*data_num)++;
+  }
+
+  if (!writer->add(member, mluoptest::CaseArchiveEntry::CASE, node.op_name(),
+                   data, compress, &error)) {
+    std::cout << error << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool compress = false;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "-z") {
+      compress = true;
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (args.size() < 2 ||
+      !endsWith(args.back(), mluoptest::CaseArchive::SUFFIX)) {
+    usage();
+    exit(0);
+  }
+
+  std::string dst_file = args.back();
+  args.pop_back();
+  mluoptest::CaseArchiveWriter writer;
+  std::string error;
+  if (!writer.open(dst_file, &error)) {
+    std::cout << error << std::endl;
+    exit(1);
+  }
+
+  size_t case_num = 0, data_num = 0;
+  for (auto src_path : args) {
+    while (src_path.size() > 1 && src_path.back() == '/') {
+      src_path.pop_back();
+    }
+    // (file, member name), a single file keeps its parent dir (op name).
+    std::vector<std::pair<std::string, std::string>> cases;
+    if (isDir(src_path)) {
+      std::vector<std::string> all_files;
+      listFiles(src_path, all_files);
+      std::sort(all_files.begin(), all_files.end());
+      for (auto &file : all_files) {
+        if (endsWith(file, ".pb") || endsWith(file, ".prototxt")) {
+          cases.emplace_back(file, file.substr(src_path.size() + 1));
+        }
+      }
+    } else {
+      std::string dir = dirName(src_path);
+      std::string parent = dirName(dir.substr(0, dir.size() - 1));
+      cases.emplace_back(src_path, src_path.substr(parent.size()));
+    }
+    for (auto &c : cases) {
+      if (!packCase(&writer, c.first, c.second, compress, &data_num)) {
+        exit(1);
+      }
+      case_num++;
+    }
+  }
+
+  if (!writer.finish(&error)) {
+    std::cout << error << std::endl;
+    exit(1);
+  }
+  std::cout << "Packed " << case_num << " cases and " << data_num
+            << " data files into " << dst_file << std::endl;
+}
@@ -0,0 +1,152 @@
+/*************************************************************************
+ * Copyright (C) [2024] by Cambricon, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *************************************************************************/
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include "mlu_op_test.pb.h"
+#include "case_archive.h"
+#include "tensor_file_ref.h"
+
+void usage() {
+  std::cout << "Unpack or list a case archive (*.pbpack). Usage:"
+            << std::endl;
+  std::cout << "[1]: src_file.pbpack [--op=op_name]  (list members)"
+            << std::endl;
+  std::cout << "[2]: src_file.pbpack dst_path [--op=op_name]" << std::endl;
+  std::cout << "  --op: only cases of op_name and the data files they use."
+            << std::endl;
+}
+
+// mkdir -p for the parent dirs of file
+void makeParentDir(const std::string &file) {
+  for (size_t pos = file.find('/', 1); pos != std::string::npos;
+       pos = file.find('/', pos + 1)) {
+    std::string dir = file.substr(0, pos);
+    if (0 != access(dir.c_str(), 0)) {
+      mkdir(dir.c_str(), 0777);
+    }
+  }
+}
+
+std::string dirName(const std::string &path) {
+  size_t slash = path.rfind("/");
+  return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+int main(int argc, char **argv) {
+  std::string src_file, dst_path, op_name;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.find("--op=") == 0) {
+      op_name = arg.substr(5);
+    } else if (src_file.empty()) {
+      src_file = arg;
+    } else if (dst_path.empty()) {
+      dst_path = arg;
+    } else {
+      usage();
+      exit(0);
+    }
+  }
+  if (src_file.empty()) {
+    usage();
+    exit(0);
+  }
+
+  std::string error;
+  auto archive = mluoptest::CaseArchive::open(src_file, &error);
+  if (archive == nullptr) {
+    std::cout << error << std::endl;
+    exit(1);
+  }
+
+  // with --op, data files referenced by the selected cases go with them.
+  std::set<std::string> data_members;
+  for (const auto &entry : archive->entries()) {
+    if (op_name.empty() || entry.kind != mluoptest::CaseArchiveEntry::CASE ||
+        entry.op_name != op_name) {
+      continue;
+    }
+    std::string data;
+    mluoptest::Node node;
+    if (!archive->read(entry, &data, &error) ||
+        !node.ParseFromString(data)) {
+      std::cout << "Can't parse " << entry.name << " " << error << std::endl;
+      exit(1);
+    }
+    for (int i = 0; i < node.input_size() + node.output_size(); ++i) {
+      const mluoptest::Tensor &ts = i < node.input_size()
+                                        ? node.input(i)
+                                        : node.output(i - node.input_size());
+      mluoptest::TensorFileRef ref;
+      if (ts.has_path() && ref.parse(ts.path())) {
+        data_members.insert(mluoptest::CaseArchive::normalizeName(
+            dirName(entry.name) + ref.file));
+      }
+    }
+  }
+  auto selected = [&](const mluoptest::CaseArchiveEntry &entry) {
+    if (op_name.empty()) {
+      return true;
+    }
+    return entry.kind == mluoptest::CaseArchiveEntry::CASE
+               ? entry.op_name == op_name
+               : data_members.count(entry.name) != 0;
+  };
+
+  size_t num = 0;
+  for (const auto &entry : archive->entries()) {
+    if (!selected(entry)) {
+      continue;
+    }
+    num++;
+    if (dst_path.empty()) {
+      std::cout
+          << (entry.kind == mluoptest::CaseArchiveEntry::CASE ? "case "
+                                                              : "data ")
+          << entry.name << " op: " << entry.op_name
+          << " size: " << entry.raw_size << " stored: " << entry.stored_size
+          << std::endl;
+      continue;
+    }
+    std::string data;
+    if (!archive->read(entry, &data, &error)) {
+      std::cout << error << std::endl;
+      exit(1);
+    }
+    std::string dst_file = dst_path + "/" + entry.name;
+    makeParentDir(dst_file);
+    std::ofstream fout(dst_file, std::ios::out | std::ios::binary);
+    fout.write(data.data(), data.size());
+    if (!fout) {
+      std::cout << "Write " << dst_file << " failed." << std::endl;
+      exit(1);
+    }
+  }
+  std::cout << num << " members" << (dst_path.empty() ? "" : " unpacked to ")
+            << dst_path << std::endl;
+}
@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+# Copyright (C) [2024] by Cambricon, Inc.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+# OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+# pylint: disable=invalid-name, missing-function-docstring
+
+"""merge the json lines written by `mluop_gtest --stream_result=xxx.jsonl`
+(several shards, or a run and its --resume runs) into one report, in the
+format of --gtest_output=xml or --gtest_output=json.
+
+    ./merge_result.py -o result.xml shard0.jsonl shard1.jsonl
+"""
+
+import argparse
+import datetime
+import json
+import logging
+import os
+import re
+import sys
+from collections import OrderedDict
+from xml.sax.saxutils import quoteattr
+
+# same as xmlPrinter::PrintXmlTestCase, for AutoJira
+JIRA_PROPERTIES = [
+    ("project", "MLUOPCORE"),
+    ("component", "mluOp"),
+    ("bug_level", "一般"),
+    ("bug_label", "master"),
+    ("product_component", "MLUOP-Core"),
+    ("bug_source", "集成测试"),
+    ("bug_category", "功能"),
+    ("bug_frequency", "必现"),
+    ("bug_boardform", " "),
+    ("bug_scenarios", "通用"),
+]
+
+# characters not allowed in xml 1.0, see xmlPrinter::IsValidXmlCharacter
+INVALID_XML = re.compile("[\x00-\x08\x0b\x0c\x0e-\x1f]")
+
+
+def load(paths):
+    """testsuite name -> test name -> record, the later record of a test wins
+    """
+    suites = OrderedDict()
+    for path in paths:
+        with open(path, encoding="utf-8") as f:
+            for lineno, line in enumerate(f, 1):
+                try:
+                    record = json.loads(line)
+                    suite, name = record["testsuite"], record["name"]
+                except (ValueError, KeyError):
+                    # the partial last line of a crashed run
+                    logging.warning("%s:%d: skip broken record", path, lineno)
+                    continue
+                suites.setdefault(suite, OrderedDict())[name] = record
+    return suites
+
+
+def seconds(record):
+    return float(record.get("time", "0s").rstrip("s") or 0)
+
+
+def value_param(record):
+    """basename of the case, like MLUOP_XML_VALUE_PARAM_PROCESS=ON
+    """
+    value = record["value_param"]
+    if os.environ.get("MLUOP_XML_VALUE_PARAM_PROCESS") != "ON":
+        return value
+    start = value.rfind("/") + 1
+    end = value.find(".pb")
+    if end >= 0:
+        end += len(".pb")
+    elif ".prototxt" in value:
+        end = value.find(".prototxt") + len(".prototxt")
+    if start == 0 or end < 0:
+        return value
+    return value[start:end]
+
+
+def attr(name, value):
+    return " %s=%s" % (name, quoteattr(INVALID_XML.sub("", str(value))))
+
+
+def write_xml(out, suites, timestamp):
+    records = [r for tests in suites.values() for r in tests.values()]
+    failures = sum(1 for r in records if r.get("failures"))
+    out.write('<?xml version="1.0" encoding="UTF-8"?>\n')
+    out.write("<testsuites" + attr("tests", len(records)) +
+              attr("failures", failures) + attr("disabled", 0) +
+              attr("errors", 0) + attr("timestamp", timestamp) +
+              attr("time", "%g" % sum(map(seconds, records))) +
+              attr("name", "AllTests") + ">\n")
+    for suite, tests in suites.items():
+        out.write("  <testsuite" + attr("name", suite) +
+                  attr("tests", len(tests)) +
+                  attr("failures",
+                       sum(1 for r in tests.values() if r.get("failures"))) +
+                  attr("disabled", 0) + attr("errors", 0) +
+                  attr("time", "%g" % sum(map(seconds, tests.values()))) +
+                  ">\n")
+        out.write("    <properties>\n")
+        for name, value in JIRA_PROPERTIES:
+            out.write("      <property" + attr("name", name) +
+                      attr("value", value) + " />\n")
+        out.write("    </properties>\n")
+        for record in tests.values():
+            write_xml_testcase(out, record)
+        out.write("  </testsuite>\n")
+    out.write("</testsuites>\n")
+
+
+def write_xml_testcase(out, record):
+    out.write("    <testcase" + attr("name", record["name"]))
+    if "value_param" in record:
+        out.write(attr("value_param", value_param(record)))
+    if "type_param" in record:
+        out.write(attr("type_param", record["type_param"]))
+    out.write(attr("status", record["status"].lower()) +
+              attr("time", "%g" % seconds(record)) +
+              attr("classname", record["classname"]))
+    failures = record.get("failures", [])
+    properties = record.get("properties", {})
+    if not failures and not properties:
+        out.write(" />\n")
+        return
+    out.write(">\n")
+    for failure in failures:
+        detail = INVALID_XML.sub("", failure["failure"])
+        out.write("      <failure" + attr("message", failure["message"]) +
+                  ' type=""><![CDATA[' +
+                  detail.replace("]]>", "]]>]]&gt;<![CDATA[") +
+                  "]]></failure>\n")
+    if properties:
+        out.write("<properties>\n")
+        for name, value in properties.items():
+            out.write("<property" + attr("name", name) +
+                      attr("value", value) + " />\n")
+        out.write("</properties>\n")
+    out.write("    </testcase>\n")
+
+
+def write_json(out, suites, timestamp):
+    def testcase(record):
+        case = OrderedDict()
+        for key in ("name", "value_param", "type_param", "status", "time",
+                    "classname"):
+            if key in record:
+                case[key] = record[key]
+        case.update(record.get("properties", {}))
+        if record.get("failures"):
+            case["failures"] = [{"failure": f["failure"], "type": f["type"]}
+                                for f in record["failures"]]
+        return case
+
+    records = [r for tests in suites.values() for r in tests.values()]
+    report = OrderedDict([
+        ("tests", len(records)),
+        ("failures", sum(1 for r in records if r.get("failures"))),
+        ("disabled", 0),
+        ("errors", 0),
+        ("timestamp", timestamp),
+        ("time", "%gs" % sum(map(seconds, records))),
+        ("name", "AllTests"),
+        ("testsuites", [OrderedDict([
+            ("name", suite),
+            ("tests", len(tests)),
+            ("failures", sum(1 for r in tests.values() if r.get("failures"))),
+            ("disabled", 0),
+            ("errors", 0),
+            ("time", "%gs" % sum(map(seconds, tests.values()))),
+            ("testsuite", [testcase(r) for r in tests.values()]),
+        ]) for suite, tests in suites.items()]),
+    ])
+    json.dump(report, out, indent=2, ensure_ascii=False)
+    out.write("\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("inputs", nargs="+", help="*.jsonl to merge, in order")
+    parser.add_argument("-o", "--output", required=True,
+                        help="report to write, *.xml or *.json")
+    parser.add_argument("--format", choices=["xml", "json"],
+                        help="report format, by default from the suffix of -o")
+    args = parser.parse_args()
+    logging.basicConfig(format="%(levelname)s: %(message)s")
+
+    fmt = args.format or ("json" if args.output.endswith(".json") else "xml")
+    timestamp = datetime.datetime.fromtimestamp(
+        min(os.path.getmtime(p) for p in args.inputs)).strftime(
+            "%Y-%m-%dT%H:%M:%S")
+    suites = load(args.inputs)
+    with open(args.output, "w", encoding="utf-8") as out:
+        if fmt == "xml":
+            write_xml(out, suites, timestamp)
+        else:
+            write_json(out, suites, timestamp + "Z")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())